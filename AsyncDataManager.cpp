@@ -0,0 +1,405 @@
+#include "AsyncDataManager.h"
+#include <QMetaObject>
+#include <QPromise>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+#include "CallHistory.h"
+#include "Metrics.h"
+
+AsyncDataManager::AsyncDataManager(DataManager *dataManager, QObject *parent)
+    : QObject(parent), dataManager(dataManager) {
+    writerPool.setMaxThreadCount(1);
+}
+
+AsyncDataManager::~AsyncDataManager() {
+    pendingStatistics.cancel();
+    cancel();
+    if (loadCanceled) {
+        loadCanceled->store(true);
+    }
+    // Потоки пулов должны завершиться раньше DataManager: у них открыты соединения его пула
+    writerPool.waitForDone();
+    readerPool.waitForDone();
+}
+
+bool AsyncDataManager::isBusy() const {
+    return pendingWrites > 0;
+}
+
+bool AsyncDataManager::isLoading() const {
+    return loading;
+}
+
+bool AsyncDataManager::whenLoaded(std::function<void()> change) {
+    if (!loading) {
+        change();
+        return true;
+    }
+    deferredChanges.push_back(std::move(change));
+    return false;
+}
+
+void AsyncDataManager::cancel() {
+    if (cancelRequested) {
+        cancelRequested->store(true);
+    }
+}
+
+ProgressCallback AsyncDataManager::progressReporter(const QString& stage,
+                                                     std::shared_ptr<std::atomic<bool>> canceled) {
+    auto lastPercent = std::make_shared<int>(-1);
+    return [this, stage, canceled, lastPercent](qint64 done, qint64 total) {
+        const int percent = total > 0 ? static_cast<int>(done * 100 / total) : 100;
+        if (percent != *lastPercent) {
+            *lastPercent = percent;
+            // Сигнал из рабочего потока доставляется получателям в их потоках (очередью)
+            emit progressChanged(stage, percent);
+        }
+        return !(canceled && canceled->load());
+    };
+}
+
+template <typename T, typename Job>
+QFuture<T> AsyncDataManager::runWrite(const QString& stage, bool cancellable, Job job) {
+    auto promise = std::make_shared<QPromise<T>>();
+    QFuture<T> future = promise->future();
+
+    // Отмена идет через флаг, а не через QFuture::cancel: операция сама откатывает
+    // транзакцию и возвращает -1, а уже записанное в БД всегда применяется к памяти
+    std::shared_ptr<std::atomic<bool>> canceled;
+    if (cancellable) {
+        canceled = std::make_shared<std::atomic<bool>>(false);
+        cancelRequested = canceled;
+    }
+    if (pendingWrites++ == 0) {
+        emit busyChanged(true);
+    }
+
+    ProgressCallback progress = progressReporter(stage, canceled);
+    promise->start();
+    writerPool.start([this, promise, progress, job]() mutable {
+        job(*promise, progress);
+        promise->finish();
+        // Ставится в очередь после продолжений then(this, ...), поэтому busyChanged(false)
+        // приходит, когда результат уже применен
+        QMetaObject::invokeMethod(this, [this]() { finishWrite(); }, Qt::QueuedConnection);
+    });
+    return future;
+}
+
+void AsyncDataManager::finishWrite() {
+    if (--pendingWrites == 0) {
+        cancelRequested.reset();
+        emit busyChanged(false);
+    }
+}
+
+QFuture<void> AsyncDataManager::load() {
+    ATC_TIMED_OPERATION(timer, "async.load");
+    // Не через runWrite: busyChanged не выставляется, интерфейсом можно пользоваться,
+    // а изменения копятся в whenLoaded. Писатели из очереди пула пойдут после загрузки.
+    if (!loading) {
+        loading = true;
+        emit loadingChanged(true);
+    }
+    auto canceled = std::make_shared<std::atomic<bool>>(false);
+    loadCanceled = canceled;
+
+    // Большие векторы передаются через общий буфер, а не копией результата QFuture
+    auto tables = std::make_shared<LoadedTables>();
+    auto promise = std::make_shared<QPromise<bool>>();
+    QFuture<bool> future = promise->future();
+    DataManager *dm = dataManager;
+    ProgressCallback progress = progressReporter("Загрузка данных", canceled);
+    promise->start();
+    writerPool.start([this, dm, tables, promise, progress]() {
+        // Индекс автодополнения строится здесь, а не в первом поиске в окне.
+        // Копия абонентов для раннего показа и итоговые таблицы дают те же id строк.
+        std::shared_ptr<SubscriberIndex> index;
+        *tables = dm->readTables(progress, [this, dm, &index](LoadedTables&& reference) {
+            index = std::make_shared<SubscriberIndex>();
+            index->build(reference.subscribers);
+            reference.subscriberIndex = index;
+            auto shared = std::make_shared<LoadedTables>(std::move(reference));
+            // Событие встает в очередь раньше продолжения then(this, ...) ниже
+            QMetaObject::invokeMethod(this, [this, dm, shared]() {
+                dm->adoptTables(std::move(*shared));
+                emit referenceDataLoaded();
+            }, Qt::QueuedConnection);
+        });
+        if (!index) {
+            index = std::make_shared<SubscriberIndex>();
+            index->build(tables->subscribers);
+        }
+        tables->subscriberIndex = index;
+        promise->addResult(true);
+        promise->finish();
+    });
+    return future.then(this, [this, dm, tables](bool) {
+        dm->adoptTables(std::move(*tables));
+        saveLoyaltyTiers();
+        finishLoad();
+    });
+}
+
+void AsyncDataManager::finishLoad() {
+    loadCanceled.reset();
+    loading = false;
+    emit loadingChanged(false);
+    // Отложенные изменения - по порядку поступления, поверх полностью загруженных данных
+    std::vector<std::function<void()>> changes;
+    changes.swap(deferredChanges);
+    for (auto& change : changes) {
+        change();
+    }
+}
+
+void AsyncDataManager::saveLoyaltyTiers() {
+    auto update = std::make_shared<LoyaltyTierUpdate>(dataManager->pendingLoyaltyTiers());
+    if (update->changes.empty()) {
+        return;
+    }
+    auto promise = std::make_shared<QPromise<bool>>();
+    QFuture<bool> future = promise->future();
+    DataManager *dm = dataManager;
+    promise->start();
+    writerPool.start([dm, update, promise]() {
+        promise->addResult(dm->writeLoyaltyTiers(*update));
+        promise->finish();
+    });
+    future.then(this, [dm, update](bool written) {
+        if (written) {
+            dm->adoptLoyaltyTiers(*update);
+        }
+    });
+}
+
+QFuture<int> AsyncDataManager::insertCalls(std::vector<Call> batch) {
+    ATC_TIMED_OPERATION(timer, "async.insertCalls");
+    // Абоненты для проверки ниже еще не загружены - откладываем всю операцию
+    if (loading) {
+        auto deferred = std::make_shared<QPromise<int>>();
+        deferred->start();
+        auto shared = std::make_shared<std::vector<Call>>(std::move(batch));
+        whenLoaded([this, deferred, shared]() {
+            insertCalls(std::move(*shared)).then([deferred](int written) {
+                deferred->addResult(written);
+                deferred->finish();
+            });
+        });
+        return deferred->future();
+    }
+
+    // Проверка целостности - по данным в памяти, пока мы в потоке-владельце
+    const SubscriberStore& subscribers = dataManager->subscribers();
+    std::unordered_set<std::uint32_t> nameIds;
+    for (SubscriberKind kind : {SubscriberKind::Regular, SubscriberKind::Vip}) {
+        for (int i = 0; i < subscribers.count(kind); ++i) {
+            nameIds.insert(subscribers.at(kind, i).nameId);
+        }
+    }
+    batch.erase(std::remove_if(batch.begin(), batch.end(), [&](const Call& call) {
+                    return nameIds.count(subscribers.textId(call.getCallerName())) == 0;
+                }),
+                batch.end());
+
+    auto shared = std::make_shared<std::vector<Call>>(std::move(batch));
+    auto ids = std::make_shared<std::vector<qint64>>();
+    DataManager *dm = dataManager;
+    return runWrite<int>("Запись звонков", true,
+                         [dm, shared, ids](QPromise<int>& promise, const ProgressCallback& progress) {
+        promise.addResult(dm->writeCalls(*shared, ids.get(), progress));
+    }).then(this, [this, dm, shared, ids](int written) {
+        if (written >= 0) {
+            dm->adoptCalls(*shared, *ids);
+            saveLoyaltyTiers();
+        }
+        return written;
+    });
+}
+
+QFuture<ImportResult> AsyncDataManager::ingestCalls(std::vector<Call> batch, std::vector<CdrCheckpoint> checkpoints) {
+    ATC_TIMED_OPERATION(timer, "async.ingestCalls");
+    auto shared = std::make_shared<std::vector<Call>>(std::move(batch));
+    auto ids = std::make_shared<std::vector<qint64>>();
+    auto promise = std::make_shared<QPromise<ImportResult>>();
+    QFuture<ImportResult> future = promise->future();
+    DataManager *dm = dataManager;
+    promise->start();
+    writerPool.start([dm, shared, ids, promise, checkpoints = std::move(checkpoints)]() {
+        ImportResult result;
+        result.imported = dm->writeCalls(*shared, checkpoints, ids.get(), &result.duplicates);
+        promise->addResult(result);
+        promise->finish();
+    });
+    return future.then(this, [this, dm, shared, ids](ImportResult result) {
+        if (result.imported >= 0) {
+            dm->adoptCalls(*shared, *ids);
+            saveLoyaltyTiers();
+        }
+        return result;
+    });
+}
+
+QFuture<bool> AsyncDataManager::reloadTariffs(const QString& filePath) {
+    ATC_TIMED_OPERATION(timer, "async.reloadTariffs");
+    auto tariffs = std::make_shared<std::shared_ptr<const TariffSet>>();
+    auto promise = std::make_shared<QPromise<bool>>();
+    QFuture<bool> future = promise->future();
+    DataManager *dm = dataManager;
+    promise->start();
+    writerPool.start([dm, filePath, tariffs, promise]() {
+        std::shared_ptr<const TariffSet> loaded = filePath.isEmpty() ? dm->readTariffSet() : dm->readTariffFile(filePath);
+        bool ok = loaded && (filePath.isEmpty() || dm->writeTariffSet(*loaded));
+        if (ok && !filePath.isEmpty()) {
+            // Записанный набор - вместе с версиями цен, которые добавили триггеры
+            loaded = dm->readTariffSet();
+            ok = loaded != nullptr;
+        }
+        if (ok) {
+            *tariffs = std::move(loaded);
+        }
+        promise->addResult(ok);
+        promise->finish();
+    });
+    // Публикация - в потоке-владельце: ссылки getTariffs() в нем остаются целыми
+    return future.then(this, [dm, tariffs](bool ok) {
+        if (ok) {
+            dm->publishTariffs(std::move(*tariffs));
+        }
+        return ok;
+    });
+}
+
+QFuture<ImportResult> AsyncDataManager::importCSV(const QString& filePath) {
+    ATC_TIMED_OPERATION(timer, "async.importCSV");
+    auto tables = std::make_shared<LoadedTables>();
+    DataManager *dm = dataManager;
+    return runWrite<ImportResult>("Импорт CSV", true,
+                                  [dm, filePath, tables](QPromise<ImportResult>& promise, const ProgressCallback& progress) {
+        ImportResult result;
+        result.imported = dm->importCSVToDatabase(filePath, progress, &result.duplicates);
+        if (result.imported >= 0) {
+            // Транзакция уже зафиксирована - перечитываем таблицы без возможности отмены
+            *tables = dm->readTables();
+        }
+        promise.addResult(result);
+    }).then(this, [this, dm, tables](ImportResult result) {
+        if (result.imported >= 0) {
+            dm->adoptTables(std::move(*tables));
+            saveLoyaltyTiers();
+        }
+        return result;
+    });
+}
+
+QFuture<bool> AsyncDataManager::backup(const QString& destinationPath) {
+    ATC_TIMED_OPERATION(timer, "async.backup");
+    DataManager *dm = dataManager;
+    return runWrite<bool>("Резервное копирование", false,
+                          [dm, destinationPath](QPromise<bool>& promise, const ProgressCallback&) {
+        promise.addResult(dm->backupDatabase(destinationPath));
+    });
+}
+
+QFuture<bool> AsyncDataManager::exportCSV(const QString& filePath) {
+    ATC_TIMED_OPERATION(timer, "async.exportCSV");
+    std::shared_ptr<const DataSnapshot> snapshot = dataManager->snapshot();
+    auto promise = std::make_shared<QPromise<bool>>();
+    QFuture<bool> future = promise->future();
+    DataManager *dm = dataManager;
+    promise->start();
+    readerPool.start([dm, snapshot, filePath, promise]() {
+        promise->addResult(dm->exportToCSV(*snapshot, filePath));
+        promise->finish();
+    });
+    return future;
+}
+
+QFuture<SimulationReport> AsyncDataManager::simulateTariffs(const QString& filePath) {
+    ATC_TIMED_OPERATION(timer, "async.simulateTariffs");
+    std::shared_ptr<const DataSnapshot> snapshot = dataManager->snapshot();
+    auto promise = std::make_shared<QPromise<SimulationReport>>();
+    QFuture<SimulationReport> future = promise->future();
+    DataManager *dm = dataManager;
+    promise->start();
+    readerPool.start([dm, snapshot, filePath, promise]() {
+        SimulationReport report;
+        std::shared_ptr<const TariffSet> proposed = dm->readTariffFile(filePath);
+        CallHistory history;
+        if (proposed && dm->readCallHistory(&history)) {
+            report.simulation = dm->simulateTariffs(history, *snapshot->subscribers, *proposed);
+            report.ok = true;
+        }
+        promise->addResult(std::move(report));
+        promise->finish();
+    });
+    return future;
+}
+
+QFuture<bool> AsyncDataManager::restore(const QString& sourcePath) {
+    ATC_TIMED_OPERATION(timer, "async.restore");
+    // Отчеты читают через соединения, которые восстановление закроет
+    pendingStatistics.cancel();
+    auto tables = std::make_shared<LoadedTables>();
+    DataManager *dm = dataManager;
+    QThreadPool *readers = &readerPool;
+    return runWrite<bool>("Восстановление БД", false,
+                          [dm, sourcePath, tables, readers](QPromise<bool>& promise, const ProgressCallback& progress) {
+        readers->waitForDone();
+        const bool restored = dm->replaceDatabaseFile(sourcePath);
+        if (restored) {
+            *tables = dm->readTables(progress);
+        }
+        promise.addResult(restored);
+    }).then(this, [this, dm, tables](bool restored) {
+        if (restored) {
+            dm->adoptTables(std::move(*tables));
+            saveLoyaltyTiers();
+        }
+        return restored;
+    });
+}
+
+QFuture<StatisticsReport> AsyncDataManager::statistics() {
+    ATC_TIMED_OPERATION(timer, "async.statistics");
+    // Повторное обновление статистики делает предыдущий запрос ненужным
+    pendingStatistics.cancel();
+
+    auto promise = std::make_shared<QPromise<StatisticsReport>>();
+    pendingStatistics = promise->future();
+    promise->start();
+
+    DataManager *dm = dataManager;
+    readerPool.start([dm, promise]() {
+        StatisticsReport report;
+        // Между этапами проверяем отмену: отмененный запрос не тратит время на остальное
+        if (!promise->isCanceled()) report.totalRevenue = dm->reportTotalRevenue();
+        if (!promise->isCanceled()) report.clients = dm->reportClientUsageParallel();
+        if (!promise->isCanceled()) report.destinations = dm->reportRevenueByDestination();
+        if (!promise->isCanceled()) promise->addResult(std::move(report));
+        promise->finish();
+    });
+    return pendingStatistics;
+}
+
+QFuture<std::vector<SubscriberHit>> AsyncDataManager::searchSubscribers(const QString& text, int limit) {
+    pendingSearch.cancel();
+
+    auto promise = std::make_shared<QPromise<std::vector<SubscriberHit>>>();
+    pendingSearch = promise->future();
+    promise->start();
+
+    DataManager *dm = dataManager;
+    readerPool.start([dm, promise, text, limit]() {
+        // Запрос, отмененный до начала (оператор печатает дальше), в БД не идет
+        if (!promise->isCanceled()) {
+            std::vector<SubscriberHit> hits = dm->searchSubscribersFullText(text, limit);
+            if (!promise->isCanceled()) promise->addResult(std::move(hits));
+        }
+        promise->finish();
+    });
+    return pendingSearch;
+}
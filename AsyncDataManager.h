@@ -0,0 +1,123 @@
+#ifndef ASYNCDATAMANAGER_H
+#define ASYNCDATAMANAGER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <QFuture>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include "DataManager.h"
+
+// Сводная статистика для окна "Статистика"
+struct StatisticsReport {
+    double totalRevenue = 0.0;
+    std::vector<ClientUsage> clients;
+    std::vector<DestinationRevenue> destinations;
+};
+
+// Итог импорта CSV; imported = -1 при ошибке или отмене
+struct ImportResult {
+    int imported = -1;
+    int duplicates = 0;
+};
+
+// Итог моделирования тарифов; ok = false - ошибка в DataManager::lastError
+struct SimulationReport {
+    bool ok = false;
+    TariffSimulation simulation;
+};
+
+// Асинхронный фасад над DataManager. Запросы к БД выполняются в рабочих потоках
+// через их собственные соединения пула, а результат применяется к данным в памяти
+// продолжением в потоке-владельце (там, где живет этот объект). Возвращаемое
+// будущее завершается уже после применения результата.
+//
+// Изменяющие операции идут через один поток-писатель и выполняются строго по очереди;
+// на время такой операции вызывающая сторона не должна менять DataManager сама
+// (см. сигнал busyChanged). Отчеты читаются параллельно.
+//
+// Начальная загрузка (load) интерфейс не блокирует: сначала приходят тарифы и
+// абоненты (referenceDataLoaded), затем звонки. Изменения, пришедшие до ее окончания,
+// передаются через whenLoaded и применяются по порядку после загрузки.
+class AsyncDataManager : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AsyncDataManager(DataManager *dataManager, QObject *parent = nullptr);
+    ~AsyncDataManager();
+
+    // Перечитать все таблицы из БД; звонки читаются последними
+    QFuture<void> load();
+    bool isLoading() const;
+    // Выполняет изменение сразу (true) или, если идет загрузка, после нее (false)
+    bool whenLoaded(std::function<void()> change);
+    // Пакетная вставка звонков; звонки клиентов, которых нет, отбрасываются сразу,
+    // повторные CDR - при записи. Результат - число вставленных звонков или -1 при ошибке.
+    QFuture<int> insertCalls(std::vector<Call> batch);
+    // Звонки из приема CDR (CdrTailer) вместе с позициями источников, одной транзакцией.
+    // busyChanged не выставляется: прием идет постоянно и интерфейс не блокирует, а
+    // порядок с остальными изменениями сохраняет тот же поток-писатель.
+    QFuture<ImportResult> ingestCalls(std::vector<Call> batch, std::vector<CdrCheckpoint> checkpoints);
+    // Горячая перезагрузка тарифов: набор читается (из файла - с записью в БД) и
+    // проверяется в потоке-писателе, затем публикуется одной заменой указателя.
+    // Пустой путь - перечитать из БД. Тарификация не останавливается, busyChanged нет.
+    QFuture<bool> reloadTariffs(const QString& filePath = QString());
+    // Импорт CSV с последующей перезагрузкой таблиц
+    QFuture<ImportResult> importCSV(const QString& filePath);
+    QFuture<bool> backup(const QString& destinationPath);
+    // Экспорт CSV по срезу данных (DataManager::snapshot) в потоке чтения: окно и
+    // прием CDR работают дальше, в файл попадает состояние на момент вызова
+    QFuture<bool> exportCSV(const QString& filePath);
+    QFuture<bool> restore(const QString& sourcePath);
+    // Моделирование тарифов из CSV по всей истории (с архивом) в потоке чтения: набор
+    // из файла только читается, тарифы, звонки и БД не меняются. Скидки VIP - по срезу
+    // абонентов на момент вызова
+    QFuture<SimulationReport> simulateTariffs(const QString& filePath);
+
+    // Новый запрос отменяет предыдущий незавершенный: его продолжение не выполнится
+    QFuture<StatisticsReport> statistics();
+    // Полнотекстовый поиск абонентов (DataManager::searchSubscribersFullText) в потоке
+    // чтения; как и статистика, новый запрос отменяет предыдущий - для поиска по мере ввода
+    QFuture<std::vector<SubscriberHit>> searchSubscribers(const QString& text, int limit);
+
+    // Отмена текущей изменяющей операции (если она поддерживает отмену)
+    void cancel();
+    bool isBusy() const;
+
+signals:
+    void busyChanged(bool busy);
+    void loadingChanged(bool loading);
+    // Тарифы и абоненты уже в DataManager, звонки еще загружаются
+    void referenceDataLoaded();
+    // Прогресс текущей изменяющей операции, 0..100
+    void progressChanged(const QString& stage, int percent);
+
+private:
+    template <typename T, typename Job>
+    QFuture<T> runWrite(const QString& stage, bool cancellable, Job job);
+    void finishWrite();
+    void finishLoad();
+    // Уровни лояльности, измененные adopt*, - в БД через поток-писатель
+    void saveLoyaltyTiers();
+    ProgressCallback progressReporter(const QString& stage, std::shared_ptr<std::atomic<bool>> canceled);
+
+    DataManager *dataManager;
+    // Один поток: изменения БД не перекрываются между собой
+    QThreadPool writerPool;
+    QThreadPool readerPool;
+
+    int pendingWrites = 0;
+    bool loading = false;
+    std::vector<std::function<void()>> deferredChanges;
+    std::shared_ptr<std::atomic<bool>> loadCanceled;
+    // Флаг отмены последней поставленной в очередь отменяемой операции
+    std::shared_ptr<std::atomic<bool>> cancelRequested;
+    QFuture<StatisticsReport> pendingStatistics;
+    QFuture<std::vector<SubscriberHit>> pendingSearch;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "BloomFilter.h"
+#include <algorithm>
+
+namespace {
+
+const int Probes = 7;
+const std::size_t BitsPerKey = 10;
+const std::size_t MinimumKeys = 1024;
+
+// Перемешивание ключа (финализатор splitmix64): ключи - хэши, но младшие биты
+// у некоторых хэшей распределены плохо
+std::uint64_t mix(std::uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+} // namespace
+
+BloomFilter::BloomFilter(std::size_t expectedKeys) {
+    reset(expectedKeys);
+}
+
+void BloomFilter::reset(std::size_t expectedKeys) {
+    expected = std::max(expectedKeys, MinimumKeys);
+    std::size_t bits = 64;
+    while (bits < expected * BitsPerKey) {
+        bits *= 2;
+    }
+    words.assign(bits / 64, 0);
+    bitMask = bits - 1;
+    keys = 0;
+}
+
+// Пробы - двойное хэширование: h1 + i * h2 (h2 нечетный, размер - степень двойки)
+void BloomFilter::add(std::uint64_t key) {
+    const std::uint64_t h1 = mix(key);
+    const std::uint64_t h2 = mix(h1) | 1;
+    for (int i = 0; i < Probes; ++i) {
+        const std::uint64_t bit = (h1 + i * h2) & bitMask;
+        words[bit / 64] |= std::uint64_t(1) << (bit % 64);
+    }
+    ++keys;
+}
+
+bool BloomFilter::mayContain(std::uint64_t key) const {
+    const std::uint64_t h1 = mix(key);
+    const std::uint64_t h2 = mix(h1) | 1;
+    for (int i = 0; i < Probes; ++i) {
+        const std::uint64_t bit = (h1 + i * h2) & bitMask;
+        if ((words[bit / 64] & (std::uint64_t(1) << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t BloomFilter::size() const {
+    return keys;
+}
+
+std::size_t BloomFilter::capacity() const {
+    return expected;
+}
+
+std::size_t BloomFilter::memoryUsage() const {
+    return words.capacity() * sizeof(std::uint64_t);
+}
@@ -0,0 +1,31 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Фильтр Блума по 64-битным ключам: отвечает "точно нет" или "возможно есть".
+// 10 бит и 7 проб на ключ - около 1% ложных срабатываний, пока ключей не больше
+// capacity(). Удалять ключи нельзя: после удаления строк фильтр только чаще
+// отвечает "возможно", поэтому за ним всегда идет точная проверка.
+class BloomFilter {
+public:
+    explicit BloomFilter(std::size_t expectedKeys = 0);
+
+    void reset(std::size_t expectedKeys);
+    void add(std::uint64_t key);
+    bool mayContain(std::uint64_t key) const;
+
+    std::size_t size() const;
+    std::size_t capacity() const;
+    std::size_t memoryUsage() const;
+
+private:
+    std::vector<std::uint64_t> words;
+    std::uint64_t bitMask = 0;
+    std::size_t keys = 0;
+    std::size_t expected = 0;
+};
+
+#endif
@@ -1,12 +1,12 @@
 #include "Call.h"
 #include <iostream>
 
-Call::Call() : callerName(""), destination(""), duration(0), cost(0.0) {}
+Call::Call() : callerName(""), destination(""), duration(0), cost(0.0), startTime(0) {}
 
 Call::Call(const std::string& callerName, const std::string& destination,
-           int duration, double cost)
+           int duration, double cost, std::int64_t startTime)
     : callerName(callerName), destination(destination),
-    duration(duration), cost(cost) {}
+    duration(duration), cost(cost), startTime(startTime) {}
 
 // ДОБАВЬТЕ:
 std::string Call::getCallerName() const {
@@ -25,6 +25,10 @@ double Call::getCost() const {
     return cost;
 }
 
+std::int64_t Call::getStartTime() const {
+    return startTime;
+}
+
 void Call::display() const {
     std::cout << "Абонент: " << callerName << ", Направление: " << destination
               << ", Длительность: " << duration << " мин, Стоимость: "
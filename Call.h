@@ -1,6 +1,7 @@
 #ifndef CALL_H
 #define CALL_H
 
+#include <cstdint>
 #include <string>
 
 class Call {
@@ -9,17 +10,20 @@ private:
     std::string destination;
     int duration;
     double cost;
+    // Начало звонка в секундах Unix; 0 - неизвестно (звонки, записанные до появления поля)
+    std::int64_t startTime;
 
 public:
     Call();
     Call(const std::string& callerName, const std::string& destination,
-         int duration, double cost);
+         int duration, double cost, std::int64_t startTime = 0);
 
     // ДОБАВЬТЕ ЭТИ МЕТОДЫ:
     std::string getCallerName() const;
     std::string getDestination() const;
     int getDuration() const;
     double getCost() const;
+    std::int64_t getStartTime() const;
 
     void display() const;
 };
@@ -0,0 +1,319 @@
+#include "CallArchive.h"
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include "Metrics.h"
+
+namespace {
+
+const quint32 Magic = 0x41544341u;  // "ATCA"
+
+void putVarint(QByteArray& out, quint64 value) {
+    while (value >= 0x80) {
+        out.append(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+// Знаковые значения: маленькие по модулю числа кодируются коротко при любом знаке
+quint64 zigzag(qint64 value) {
+    return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+}
+
+qint64 unzigzag(quint64 value) {
+    return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+}
+
+// Последовательное чтение varint из распакованной колонки
+class VarintReader {
+public:
+    explicit VarintReader(const QByteArray& data)
+        : cursor(reinterpret_cast<const uchar*>(data.constData())), end(cursor + data.size()) {}
+
+    quint64 next() {
+        quint64 value = 0;
+        int shift = 0;
+        while (cursor < end && shift < 64) {
+            const uchar byte = *cursor++;
+            value |= static_cast<quint64>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+            shift += 7;
+        }
+        good = false;
+        return 0;
+    }
+
+    const uchar* take(quint64 size) {
+        if (static_cast<quint64>(end - cursor) < size) {
+            good = false;
+            return nullptr;
+        }
+        const uchar* data = cursor;
+        cursor += size;
+        return data;
+    }
+
+    bool ok() const { return good; }
+
+private:
+    const uchar* cursor;
+    const uchar* end;
+    bool good = true;
+};
+
+// Словарь строк колонки и номера строк по порядку появления
+QByteArray encodeDictionary(const std::vector<ArchivedCall>& calls, std::string ArchivedCall::*field,
+                            QByteArray* indexes) {
+    std::unordered_map<std::string, quint64> ids;
+    std::vector<const std::string*> values;
+    for (const auto& call : calls) {
+        const std::string& value = call.*field;
+        auto it = ids.find(value);
+        if (it == ids.end()) {
+            it = ids.emplace(value, values.size()).first;
+            values.push_back(&it->first);
+        }
+        putVarint(*indexes, it->second);
+    }
+
+    QByteArray dictionary;
+    putVarint(dictionary, values.size());
+    for (const std::string* value : values) {
+        putVarint(dictionary, value->size());
+        dictionary.append(value->data(), static_cast<qsizetype>(value->size()));
+    }
+    return dictionary;
+}
+
+bool fail(QString* error, const QString& message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+} // namespace
+
+bool CallArchive::write(const QString& path, const std::vector<ArchivedCall>& calls, QString* error) {
+    ATC_TIMED_OPERATION(timer, "archive.write");
+    QByteArray columns[ColumnCount];
+    columns[CallerDictionary] = encodeDictionary(calls, &ArchivedCall::caller, &columns[CallerColumn]);
+    columns[DestinationDictionary] = encodeDictionary(calls, &ArchivedCall::destination, &columns[DestinationColumn]);
+
+    qint64 previousId = 0;
+    qint64 previousStart = 0;
+    for (const auto& call : calls) {
+        putVarint(columns[IdColumn], zigzag(call.id - previousId));
+        putVarint(columns[StartTimeColumn], zigzag(call.startTime - previousStart));
+        putVarint(columns[DurationColumn], zigzag(call.duration));
+        putVarint(columns[CostColumn], zigzag(std::llround(call.cost * CostScale)));
+        previousId = call.id;
+        previousStart = call.startTime;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail(error, "Не удалось создать файл архива: " + file.errorString());
+    }
+    for (auto& column : columns) {
+        column = qCompress(column);
+    }
+
+    QDataStream out(&file);
+    out << Magic << FormatVersion << static_cast<qint64>(calls.size())
+        << (calls.empty() ? qint64(0) : calls.front().id) << (calls.empty() ? qint64(0) : calls.back().id);
+    for (const auto& column : columns) {
+        out << static_cast<qint64>(column.size());
+    }
+    for (const auto& column : columns) {
+        out.writeRawData(column.constData(), static_cast<int>(column.size()));
+    }
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        return fail(error, "Ошибка записи архива: " + file.errorString());
+    }
+    timer.addRows(calls.size());
+    return true;
+}
+
+bool CallArchive::open(const QString& path, QString* error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(error, "Не удалось открыть архив: " + path);
+    }
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version >> rows >> firstCallId >> lastCallId;
+    if (magic != Magic || version != FormatVersion) {
+        return fail(error, "Неизвестный формат архива: " + path);
+    }
+
+    for (int i = 0; i < ColumnCount; ++i) {
+        in >> columnSize[i];
+    }
+    // Колонки лежат подряд сразу за заголовком
+    qint64 offset = file.pos();
+    for (int i = 0; i < ColumnCount; ++i) {
+        columnOffset[i] = offset;
+        offset += columnSize[i];
+    }
+    if (in.status() != QDataStream::Ok || offset != file.size()) {
+        return fail(error, "Архив поврежден: " + path);
+    }
+    filePath = path;
+    return true;
+}
+
+qint64 CallArchive::rowCount() const {
+    return rows;
+}
+
+qint64 CallArchive::firstId() const {
+    return firstCallId;
+}
+
+qint64 CallArchive::lastId() const {
+    return lastCallId;
+}
+
+QByteArray CallArchive::column(Column which) const {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(columnOffset[which])) {
+        return QByteArray();
+    }
+    // qUncompress проверяет контрольную сумму zlib: поврежденная колонка дает пустой результат
+    return qUncompress(file.read(columnSize[which]));
+}
+
+std::vector<std::string> CallArchive::dictionary(Column which) const {
+    const QByteArray data = column(which);
+    VarintReader reader(data);
+    std::vector<std::string> values(reader.next());
+    for (auto& value : values) {
+        const quint64 size = reader.next();
+        const uchar* bytes = reader.take(size);
+        if (!reader.ok()) {
+            return {};
+        }
+        value.assign(reinterpret_cast<const char*>(bytes), size);
+    }
+    return values;
+}
+
+double CallArchive::totalRevenue() const {
+    ATC_TIMED_OPERATION(timer, "archive.totalRevenue");
+    // Нужна одна колонка из восьми; сумма - в целых единицах фиксированной точки
+    const QByteArray costs = column(CostColumn);
+    VarintReader reader(costs);
+    qint64 total = 0;
+    for (qint64 i = 0; i < rows && reader.ok(); ++i) {
+        total += unzigzag(reader.next());
+    }
+    timer.addRows(static_cast<std::uint64_t>(rows));
+    return static_cast<double>(total) / CostScale;
+}
+
+std::vector<ClientUsage> CallArchive::clientUsage() const {
+    ATC_TIMED_OPERATION(timer, "archive.clientUsage");
+    const std::vector<std::string> callers = dictionary(CallerDictionary);
+    const QByteArray callerColumn = column(CallerColumn);
+    const QByteArray durationColumn = column(DurationColumn);
+    const QByteArray costColumn = column(CostColumn);
+
+    // Счетчики по номеру в словаре - без поиска строк
+    std::vector<ClientUsage> usage(callers.size());
+    std::vector<qint64> costs(callers.size(), 0);
+    for (std::size_t i = 0; i < callers.size(); ++i) {
+        usage[i] = {callers[i], 0, 0, 0.0};
+    }
+    VarintReader caller(callerColumn);
+    VarintReader duration(durationColumn);
+    VarintReader cost(costColumn);
+    for (qint64 i = 0; i < rows; ++i) {
+        const quint64 index = caller.next();
+        const qint64 minutes = unzigzag(duration.next());
+        const qint64 amount = unzigzag(cost.next());
+        if (!caller.ok() || !duration.ok() || !cost.ok() || index >= usage.size()) {
+            return {};
+        }
+        usage[index].callCount += 1;
+        usage[index].totalDuration += minutes;
+        costs[index] += amount;
+    }
+    for (std::size_t i = 0; i < usage.size(); ++i) {
+        usage[i].totalCost = static_cast<double>(costs[i]) / CostScale;
+    }
+    timer.addRows(static_cast<std::uint64_t>(rows));
+    return usage;
+}
+
+std::vector<DestinationRevenue> CallArchive::revenueByDestination() const {
+    ATC_TIMED_OPERATION(timer, "archive.revenueByDestination");
+    const std::vector<std::string> destinations = dictionary(DestinationDictionary);
+    const QByteArray destinationColumn = column(DestinationColumn);
+    const QByteArray costColumn = column(CostColumn);
+
+    std::vector<DestinationRevenue> revenue(destinations.size());
+    std::vector<qint64> costs(destinations.size(), 0);
+    for (std::size_t i = 0; i < destinations.size(); ++i) {
+        revenue[i] = {destinations[i], 0, 0.0};
+    }
+    VarintReader destination(destinationColumn);
+    VarintReader cost(costColumn);
+    for (qint64 i = 0; i < rows; ++i) {
+        const quint64 index = destination.next();
+        const qint64 amount = unzigzag(cost.next());
+        if (!destination.ok() || !cost.ok() || index >= revenue.size()) {
+            return {};
+        }
+        revenue[index].callCount += 1;
+        costs[index] += amount;
+    }
+    for (std::size_t i = 0; i < revenue.size(); ++i) {
+        revenue[i].revenue = static_cast<double>(costs[i]) / CostScale;
+    }
+    timer.addRows(static_cast<std::uint64_t>(rows));
+    return revenue;
+}
+
+std::vector<ArchivedCall> CallArchive::readAll() const {
+    const std::vector<std::string> callers = dictionary(CallerDictionary);
+    const std::vector<std::string> destinations = dictionary(DestinationDictionary);
+    QByteArray columns[ColumnCount];
+    for (int i = CallerColumn; i < ColumnCount; ++i) {
+        columns[i] = column(static_cast<Column>(i));
+    }
+    VarintReader caller(columns[CallerColumn]);
+    VarintReader destination(columns[DestinationColumn]);
+    VarintReader id(columns[IdColumn]);
+    VarintReader start(columns[StartTimeColumn]);
+    VarintReader duration(columns[DurationColumn]);
+    VarintReader cost(columns[CostColumn]);
+
+    std::vector<ArchivedCall> calls;
+    calls.reserve(static_cast<std::size_t>(rows));
+    qint64 previousId = 0;
+    qint64 previousStart = 0;
+    for (qint64 i = 0; i < rows; ++i) {
+        const quint64 callerIndex = caller.next();
+        const quint64 destinationIndex = destination.next();
+        previousId += unzigzag(id.next());
+        previousStart += unzigzag(start.next());
+        const int minutes = static_cast<int>(unzigzag(duration.next()));
+        const qint64 amount = unzigzag(cost.next());
+        if (!caller.ok() || !destination.ok() || !id.ok() || !start.ok() || !duration.ok() || !cost.ok() ||
+            callerIndex >= callers.size() || destinationIndex >= destinations.size()) {
+            return {};
+        }
+        calls.push_back({previousId, previousStart, callers[callerIndex], destinations[destinationIndex],
+                         minutes, static_cast<double>(amount) / CostScale});
+    }
+    return calls;
+}
@@ -0,0 +1,74 @@
+#ifndef CALLARCHIVE_H
+#define CALLARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include "DataManager.h"
+
+// Звонок, переносимый в архив
+struct ArchivedCall {
+    qint64 id;
+    qint64 startTime;
+    std::string caller;
+    std::string destination;
+    int duration;
+    double cost;
+};
+
+// Холодный архив звонков: колоночный файл, каждая колонка сжата отдельно (qCompress).
+//  - абоненты и направления - словари, в колонках строк только номера в словаре;
+//  - id и время начала - разность с предыдущей строкой (строки идут по id);
+//  - длительность - varint, стоимость - фиксированная точка (1/10000 рубля).
+// Файл не изменяется после записи. Агрегаты считаются прямо по колонкам:
+// читаются и распаковываются только те, что нужны запросу.
+class CallArchive {
+public:
+    static const quint32 FormatVersion = 1;
+    // Масштаб фиксированной точки стоимости
+    static const qint64 CostScale = 10000;
+
+    // calls - по возрастанию id
+    static bool write(const QString& path, const std::vector<ArchivedCall>& calls, QString* error);
+
+    // Читает только заголовок; колонки - по запросу
+    bool open(const QString& path, QString* error);
+
+    qint64 rowCount() const;
+    qint64 firstId() const;
+    qint64 lastId() const;
+
+    double totalRevenue() const;
+    std::vector<ClientUsage> clientUsage() const;
+    std::vector<DestinationRevenue> revenueByDestination() const;
+    std::vector<ArchivedCall> readAll() const;
+
+private:
+    enum Column {
+        CallerDictionary,
+        DestinationDictionary,
+        CallerColumn,
+        DestinationColumn,
+        IdColumn,
+        StartTimeColumn,
+        DurationColumn,
+        CostColumn,
+        ColumnCount
+    };
+
+    // Распакованная колонка (пустая, если файл поврежден)
+    QByteArray column(Column which) const;
+    std::vector<std::string> dictionary(Column which) const;
+
+    QString filePath;
+    qint64 rows = 0;
+    qint64 firstCallId = 0;
+    qint64 lastCallId = 0;
+    qint64 columnOffset[ColumnCount] = {};
+    qint64 columnSize[ColumnCount] = {};
+};
+
+#endif
@@ -0,0 +1,515 @@
+#include "CallHistory.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <QSemaphore>
+#include <QThreadPool>
+#include "Metrics.h"
+
+namespace {
+
+std::uint8_t bitWidth(std::uint64_t value) {
+    std::uint8_t bits = 0;
+    while (value != 0) {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+std::uint64_t bitMask(std::uint8_t bits) {
+    return bits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << bits) - 1;
+}
+
+std::int64_t toFixed(double cost) {
+    return std::llround(cost * CallHistory::CostScale);
+}
+
+// Словарь блока: различные id по возрастанию, в codes - номера в нем
+std::size_t encodeDictionary(const std::vector<std::int64_t>& ids, std::vector<std::int64_t>* dictionary,
+                             std::vector<std::int64_t>* codes) {
+    dictionary->assign(ids.begin(), ids.end());
+    std::sort(dictionary->begin(), dictionary->end());
+    dictionary->erase(std::unique(dictionary->begin(), dictionary->end()), dictionary->end());
+    codes->resize(ids.size());
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        (*codes)[i] = std::lower_bound(dictionary->begin(), dictionary->end(), ids[i]) - dictionary->begin();
+    }
+    return dictionary->size();
+}
+
+// Итоги моделирования тарифов; суммы в фиксированной точке, как колонка стоимости
+struct SimulationTotals {
+    std::int64_t calls = 0;
+    std::int64_t current = 0;
+    std::int64_t proposed = 0;
+
+    void add(std::int64_t now, std::int64_t next) {
+        ++calls;
+        current += now;
+        proposed += next;
+    }
+    void add(const SimulationTotals& other) {
+        calls += other.calls;
+        current += other.current;
+        proposed += other.proposed;
+    }
+};
+
+// Итоги одной части истории (одного потока)
+struct SimulationPart {
+    std::unordered_map<std::uint32_t, SimulationTotals> destinations;   // по id пула строк
+    SimulationTotals segments[2];                                       // обычные, VIP
+    std::int64_t unrated = 0;
+};
+
+// Все, что нужно знать о строке пула: она может быть и именем, и направлением.
+// Цены и скидка берутся один раз на строку; стоимость считается так же, как
+// callCost в DataManager, и совпадает с ней до бита
+struct SimulatedString {
+    double factor = 1.0;        // множитель скидки абонента с таким именем
+    bool vip = false;
+    bool rated = false;         // у направления есть тариф в обоих наборах
+    double currentFee = 0.0;
+    double currentPrice = 0.0;
+    double proposedFee = 0.0;
+    double proposedPrice = 0.0;
+};
+
+void simulateCall(const SimulatedString& caller, const SimulatedString& destination, std::int64_t duration,
+                  std::int64_t storedCost, SimulationTotals* totals, SimulationPart* part) {
+    std::int64_t now = storedCost;
+    std::int64_t next = storedCost;
+    if (destination.rated) {
+        now = toFixed((destination.currentFee + destination.currentPrice * duration) * caller.factor);
+        next = toFixed((destination.proposedFee + destination.proposedPrice * duration) * caller.factor);
+    } else {
+        ++part->unrated;
+    }
+    totals->add(now, next);
+    part->segments[caller.vip ? 1 : 0].add(now, next);
+}
+
+RevenueDelta toRevenueDelta(std::string name, const SimulationTotals& totals) {
+    return {std::move(name), totals.calls, static_cast<double>(totals.current) / CallHistory::CostScale,
+            static_cast<double>(totals.proposed) / CallHistory::CostScale};
+}
+
+} // namespace
+
+CallHistory::CallHistory() {
+    tail.reserve(BlockSize);
+}
+
+void CallHistory::append(std::int64_t id, std::string_view caller, std::string_view destination,
+                         int duration, double cost, std::int64_t startTime) {
+    tail.push_back({id, startTime, cost, strings.intern(caller), strings.intern(destination), duration});
+    if (tail.size() == BlockSize) {
+        seal();
+    }
+}
+
+void CallHistory::append(const CallStore& calls) {
+    for (int i = 0; i < calls.count(); ++i) {
+        const CallRecord& call = calls.at(i);
+        append(call.id, calls.text(call.callerId), calls.text(call.destinationId), call.duration, call.cost,
+               call.startTime);
+    }
+}
+
+void CallHistory::clear() {
+    strings.clear();
+    blocks.clear();
+    blocks.shrink_to_fit();
+    tail.clear();
+}
+
+void CallHistory::seal() {
+    const std::size_t count = tail.size();
+    std::vector<std::int64_t> callers(count);
+    std::vector<std::int64_t> destinations(count);
+    std::vector<std::int64_t> column(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        callers[i] = tail[i].callerId;
+        destinations[i] = tail[i].destinationId;
+    }
+
+    Block block;
+    std::vector<std::int64_t> dictionary;
+    std::vector<std::int64_t> codes;
+    pack(block, CallerDictionary, dictionary.data(), encodeDictionary(callers, &dictionary, &codes));
+    pack(block, CallerColumn, codes.data(), count);
+    pack(block, DestinationDictionary, dictionary.data(), encodeDictionary(destinations, &dictionary, &codes));
+    pack(block, DestinationColumn, codes.data(), count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        column[i] = tail[i].id;
+    }
+    pack(block, IdColumn, column.data(), count);
+    for (std::size_t i = 0; i < count; ++i) {
+        column[i] = tail[i].startTime;
+    }
+    pack(block, StartTimeColumn, column.data(), count);
+    for (std::size_t i = 0; i < count; ++i) {
+        column[i] = tail[i].duration;
+    }
+    pack(block, DurationColumn, column.data(), count);
+    for (std::size_t i = 0; i < count; ++i) {
+        column[i] = toFixed(tail[i].cost);
+    }
+    pack(block, CostColumn, column.data(), count);
+
+    block.words.shrink_to_fit();
+    blocks.push_back(std::move(block));
+    tail.clear();
+}
+
+void CallHistory::pack(Block& block, ColumnId id, const std::int64_t* values, std::size_t count) {
+    Column& column = block.columns[id];
+    column.offset = static_cast<std::uint32_t>(block.words.size());
+    column.size = static_cast<std::uint32_t>(count);
+    if (count == 0) {
+        return;
+    }
+    const auto range = std::minmax_element(values, values + count);
+    column.base = *range.first;
+    column.bits = bitWidth(static_cast<std::uint64_t>(*range.second) - static_cast<std::uint64_t>(column.base));
+
+    block.words.resize(column.offset + (count * column.bits + 63) / 64, 0);
+    std::uint64_t* words = block.words.data() + column.offset;
+    for (std::size_t i = 0; i < count && column.bits > 0; ++i) {
+        const std::uint64_t value = static_cast<std::uint64_t>(values[i]) - static_cast<std::uint64_t>(column.base);
+        const std::size_t bit = i * column.bits;
+        const unsigned shift = bit % 64;
+        words[bit / 64] |= value << shift;
+        if (shift + column.bits > 64) {
+            words[bit / 64 + 1] |= value >> (64 - shift);
+        }
+    }
+}
+
+void CallHistory::unpack(const Block& block, ColumnId id, std::int64_t* values) {
+    const Column& column = block.columns[id];
+    if (column.bits == 0) {
+        std::fill(values, values + column.size, column.base);
+        return;
+    }
+    const std::uint64_t* words = block.words.data() + column.offset;
+    const std::uint64_t mask = bitMask(column.bits);
+    for (std::size_t i = 0; i < column.size; ++i) {
+        const std::size_t bit = i * column.bits;
+        const unsigned shift = bit % 64;
+        std::uint64_t value = words[bit / 64] >> shift;
+        if (shift + column.bits > 64) {
+            value |= words[bit / 64 + 1] << (64 - shift);
+        }
+        values[i] = static_cast<std::int64_t>(static_cast<std::uint64_t>(column.base) + (value & mask));
+    }
+}
+
+std::int64_t CallHistory::valueAt(const Block& block, ColumnId id, std::size_t index) {
+    const Column& column = block.columns[id];
+    if (column.bits == 0) {
+        return column.base;
+    }
+    const std::uint64_t* words = block.words.data() + column.offset;
+    const std::size_t bit = index * column.bits;
+    const unsigned shift = bit % 64;
+    std::uint64_t value = words[bit / 64] >> shift;
+    if (shift + column.bits > 64) {
+        value |= words[bit / 64 + 1] << (64 - shift);
+    }
+    return static_cast<std::int64_t>(static_cast<std::uint64_t>(column.base) + (value & bitMask(column.bits)));
+}
+
+std::size_t CallHistory::count() const {
+    return blocks.size() * BlockSize + tail.size();
+}
+
+Call CallHistory::callAt(std::size_t index) const {
+    if (index >= blocks.size() * BlockSize) {
+        const CallRecord& record = tail[index - blocks.size() * BlockSize];
+        return Call(std::string(strings.at(record.callerId)), std::string(strings.at(record.destinationId)),
+                    record.duration, record.cost, record.startTime);
+    }
+    const Block& block = blocks[index / BlockSize];
+    const std::size_t row = index % BlockSize;
+    const auto caller = valueAt(block, CallerDictionary, valueAt(block, CallerColumn, row));
+    const auto destination = valueAt(block, DestinationDictionary, valueAt(block, DestinationColumn, row));
+    return Call(std::string(strings.at(static_cast<std::uint32_t>(caller))),
+                std::string(strings.at(static_cast<std::uint32_t>(destination))),
+                static_cast<int>(valueAt(block, DurationColumn, row)),
+                static_cast<double>(valueAt(block, CostColumn, row)) / CostScale,
+                valueAt(block, StartTimeColumn, row));
+}
+
+std::size_t CallHistory::memoryUsage() const {
+    std::size_t bytes = blocks.capacity() * sizeof(Block) + tail.capacity() * sizeof(CallRecord) +
+                        strings.memoryUsage();
+    for (const auto& block : blocks) {
+        bytes += block.words.capacity() * sizeof(std::uint64_t);
+    }
+    return bytes;
+}
+
+double CallHistory::totalRevenue() const {
+    ATC_TIMED_OPERATION(timer, "history.totalRevenue");
+    // Здесь и в других отчетах буферы колонок в куче: отчеты идут и из потоков пула
+    std::vector<std::int64_t> costs(BlockSize);
+    std::int64_t total = 0;
+    for (const auto& block : blocks) {
+        unpack(block, CostColumn, costs.data());
+        for (std::size_t i = 0; i < BlockSize; ++i) {
+            total += costs[i];
+        }
+    }
+    for (const auto& record : tail) {
+        total += toFixed(record.cost);
+    }
+    timer.addRows(count());
+    return static_cast<double>(total) / CostScale;
+}
+
+double CallHistory::clientTotalCost(std::string_view clientName) const {
+    ATC_TIMED_OPERATION(timer, "history.clientTotalCost");
+    const std::uint32_t callerId = strings.find(clientName);
+    if (callerId == StringPool::NotFound) {
+        return 0.0;
+    }
+
+    std::vector<std::int64_t> dictionary(BlockSize);
+    std::vector<std::int64_t> callers(BlockSize);
+    std::vector<std::int64_t> costs(BlockSize);
+    std::int64_t total = 0;
+    for (const auto& block : blocks) {
+        const std::size_t dictionarySize = block.columns[CallerDictionary].size;
+        unpack(block, CallerDictionary, dictionary.data());
+        const auto end = dictionary.begin() + static_cast<std::ptrdiff_t>(dictionarySize);
+        const auto found = std::lower_bound(dictionary.begin(), end, callerId);
+        if (found == end || *found != callerId) {
+            continue;
+        }
+        const std::int64_t code = found - dictionary.begin();
+        unpack(block, CallerColumn, callers.data());
+        unpack(block, CostColumn, costs.data());
+        for (std::size_t i = 0; i < BlockSize; ++i) {
+            total += callers[i] == code ? costs[i] : 0;
+        }
+    }
+    for (const auto& record : tail) {
+        if (record.callerId == callerId) {
+            total += toFixed(record.cost);
+        }
+    }
+    timer.addRows(count());
+    return static_cast<double>(total) / CostScale;
+}
+
+std::vector<ClientUsage> CallHistory::clientUsage() const {
+    ATC_TIMED_OPERATION(timer, "history.clientUsage");
+    // Итоги по id общего пула строк
+    std::vector<std::int64_t> calls(strings.size(), 0);
+    std::vector<std::int64_t> durations(strings.size(), 0);
+    std::vector<std::int64_t> costs(strings.size(), 0);
+
+    std::vector<std::int64_t> dictionary(BlockSize);
+    std::vector<std::int64_t> callerColumn(BlockSize);
+    std::vector<std::int64_t> durationColumn(BlockSize);
+    std::vector<std::int64_t> costColumn(BlockSize);
+    std::vector<std::int64_t> blockCalls;
+    std::vector<std::int64_t> blockDurations;
+    std::vector<std::int64_t> blockCosts;
+    for (const auto& block : blocks) {
+        const std::size_t dictionarySize = block.columns[CallerDictionary].size;
+        unpack(block, CallerDictionary, dictionary.data());
+        unpack(block, CallerColumn, callerColumn.data());
+        unpack(block, DurationColumn, durationColumn.data());
+        unpack(block, CostColumn, costColumn.data());
+
+        blockCalls.assign(dictionarySize, 0);
+        blockDurations.assign(dictionarySize, 0);
+        blockCosts.assign(dictionarySize, 0);
+        for (std::size_t i = 0; i < BlockSize; ++i) {
+            const std::int64_t code = callerColumn[i];
+            blockCalls[code] += 1;
+            blockDurations[code] += durationColumn[i];
+            blockCosts[code] += costColumn[i];
+        }
+        for (std::size_t code = 0; code < dictionarySize; ++code) {
+            const std::int64_t id = dictionary[code];
+            calls[id] += blockCalls[code];
+            durations[id] += blockDurations[code];
+            costs[id] += blockCosts[code];
+        }
+    }
+    for (const auto& record : tail) {
+        calls[record.callerId] += 1;
+        durations[record.callerId] += record.duration;
+        costs[record.callerId] += toFixed(record.cost);
+    }
+
+    std::vector<ClientUsage> result;
+    for (std::uint32_t id = 0; id < calls.size(); ++id) {
+        if (calls[id] > 0) {
+            result.push_back({std::string(strings.at(id)), static_cast<int>(calls[id]), durations[id],
+                              static_cast<double>(costs[id]) / CostScale});
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const ClientUsage& a, const ClientUsage& b) {
+        return a.clientName < b.clientName;
+    });
+    timer.addRows(count());
+    return result;
+}
+
+std::vector<DestinationRevenue> CallHistory::revenueByDestination() const {
+    ATC_TIMED_OPERATION(timer, "history.revenueByDestination");
+    std::vector<std::int64_t> calls(strings.size(), 0);
+    std::vector<std::int64_t> costs(strings.size(), 0);
+
+    std::vector<std::int64_t> dictionary(BlockSize);
+    std::vector<std::int64_t> destinationColumn(BlockSize);
+    std::vector<std::int64_t> costColumn(BlockSize);
+    std::vector<std::int64_t> blockCalls;
+    std::vector<std::int64_t> blockCosts;
+    for (const auto& block : blocks) {
+        const std::size_t dictionarySize = block.columns[DestinationDictionary].size;
+        unpack(block, DestinationDictionary, dictionary.data());
+        unpack(block, DestinationColumn, destinationColumn.data());
+        unpack(block, CostColumn, costColumn.data());
+
+        blockCalls.assign(dictionarySize, 0);
+        blockCosts.assign(dictionarySize, 0);
+        for (std::size_t i = 0; i < BlockSize; ++i) {
+            blockCalls[destinationColumn[i]] += 1;
+            blockCosts[destinationColumn[i]] += costColumn[i];
+        }
+        for (std::size_t code = 0; code < dictionarySize; ++code) {
+            calls[dictionary[code]] += blockCalls[code];
+            costs[dictionary[code]] += blockCosts[code];
+        }
+    }
+    for (const auto& record : tail) {
+        calls[record.destinationId] += 1;
+        costs[record.destinationId] += toFixed(record.cost);
+    }
+
+    std::vector<DestinationRevenue> result;
+    for (std::uint32_t id = 0; id < calls.size(); ++id) {
+        if (calls[id] > 0) {
+            result.push_back({std::string(strings.at(id)), static_cast<int>(calls[id]),
+                              static_cast<double>(costs[id]) / CostScale});
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const DestinationRevenue& a, const DestinationRevenue& b) {
+        return a.revenue > b.revenue;
+    });
+    timer.addRows(count());
+    return result;
+}
+
+TariffSimulation CallHistory::simulateTariffs(const TariffSet& current, const TariffSet& proposed,
+                                              const SubscriberStore& subscribers, QThreadPool* pool,
+                                              int workers) const {
+    ATC_TIMED_OPERATION(timer, "history.simulateTariffs");
+    std::vector<SimulatedString> ratings(strings.size());
+    for (std::uint32_t id = 0; id < ratings.size(); ++id) {
+        const std::string text(strings.at(id));
+        SimulatedString& rating = ratings[id];
+        const SubscriberRecord* caller = subscribers.find(text);
+        if (caller && caller->kind == SubscriberKind::Vip) {
+            rating.factor = 1.0 - caller->discount / 100.0;
+            rating.vip = true;
+        }
+        const Tariff* now = current.findByCity(text);
+        const Tariff* next = proposed.findByCity(text);
+        if (now && next) {
+            rating.rated = true;
+            rating.currentFee = now->getConnectionFee();
+            rating.currentPrice = now->getPricePerMinute();
+            rating.proposedFee = next->getConnectionFee();
+            rating.proposedPrice = next->getPricePerMinute();
+        }
+    }
+
+    // Буферы колонок - в куче: у потоков пула стек может быть маленьким
+    auto simulateBlocks = [this, &ratings](std::size_t from, std::size_t to, SimulationPart* part) {
+        std::vector<std::int64_t> callerDictionary(BlockSize);
+        std::vector<std::int64_t> destinationDictionary(BlockSize);
+        std::vector<std::int64_t> callerColumn(BlockSize);
+        std::vector<std::int64_t> destinationColumn(BlockSize);
+        std::vector<std::int64_t> durationColumn(BlockSize);
+        std::vector<std::int64_t> costColumn(BlockSize);
+        std::vector<SimulationTotals> blockTotals;
+        for (std::size_t b = from; b < to; ++b) {
+            const Block& block = blocks[b];
+            unpack(block, CallerDictionary, callerDictionary.data());
+            unpack(block, DestinationDictionary, destinationDictionary.data());
+            unpack(block, CallerColumn, callerColumn.data());
+            unpack(block, DestinationColumn, destinationColumn.data());
+            unpack(block, DurationColumn, durationColumn.data());
+            unpack(block, CostColumn, costColumn.data());
+
+            // Итоги по номерам словаря блока, в общую таблицу - по разу на направление
+            const std::size_t destinationCount = block.columns[DestinationDictionary].size;
+            blockTotals.assign(destinationCount, SimulationTotals());
+            for (std::size_t i = 0; i < BlockSize; ++i) {
+                const std::int64_t code = destinationColumn[i];
+                simulateCall(ratings[callerDictionary[callerColumn[i]]], ratings[destinationDictionary[code]],
+                             durationColumn[i], costColumn[i], &blockTotals[code], part);
+            }
+            for (std::size_t code = 0; code < destinationCount; ++code) {
+                part->destinations[static_cast<std::uint32_t>(destinationDictionary[code])].add(blockTotals[code]);
+            }
+        }
+    };
+
+    if (workers <= 0) {
+        workers = pool->maxThreadCount();
+    }
+    workers = static_cast<int>(std::min<std::size_t>(static_cast<std::size_t>(std::max(workers, 1)), blocks.size()));
+    // Последняя часть - несжатый хвост, считается в вызывающем потоке
+    std::vector<SimulationPart> parts(workers + 1);
+    QSemaphore done;
+    for (int w = 0; w < workers; ++w) {
+        const std::size_t from = blocks.size() * w / workers;
+        const std::size_t to = blocks.size() * (w + 1) / workers;
+        pool->start([&simulateBlocks, &parts, &done, from, to, w]() {
+            simulateBlocks(from, to, &parts[w]);
+            done.release();
+        });
+    }
+    SimulationPart& tailPart = parts.back();
+    for (const auto& record : tail) {
+        simulateCall(ratings[record.callerId], ratings[record.destinationId], record.duration,
+                     toFixed(record.cost), &tailPart.destinations[record.destinationId], &tailPart);
+    }
+    done.acquire(workers);
+
+    std::unordered_map<std::uint32_t, SimulationTotals> destinations;
+    SimulationTotals segments[2];
+    TariffSimulation result;
+    for (const auto& part : parts) {
+        for (const auto& entry : part.destinations) {
+            destinations[entry.first].add(entry.second);
+        }
+        segments[0].add(part.segments[0]);
+        segments[1].add(part.segments[1]);
+        result.unratedCalls += part.unrated;
+    }
+
+    for (const auto& entry : destinations) {
+        result.destinations.push_back(toRevenueDelta(std::string(strings.at(entry.first)), entry.second));
+    }
+    std::sort(result.destinations.begin(), result.destinations.end(), [](const RevenueDelta& a, const RevenueDelta& b) {
+        return std::fabs(a.delta()) > std::fabs(b.delta());
+    });
+    SimulationTotals total = segments[0];
+    total.add(segments[1]);
+    result.regular = toRevenueDelta("Обычные клиенты", segments[0]);
+    result.vip = toRevenueDelta("VIP-клиенты", segments[1]);
+    result.total = toRevenueDelta("Всего", total);
+    timer.addRows(count());
+    return result;
+}
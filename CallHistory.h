@@ -0,0 +1,92 @@
+#ifndef CALLHISTORY_H
+#define CALLHISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "CallStore.h"
+#include "DataManager.h"
+#include "StringPool.h"
+#include "SubscriberStore.h"
+#include "TariffSet.h"
+
+// Сжатая история звонков в памяти для аналитики (только добавление).
+// Звонки собираются в блоки по BlockSize; в блоке каждая колонка упакована
+// побитно относительно своего минимума (frame of reference):
+//  - абонент и направление - номера в локальном словаре блока (отсортированные
+//    id общего пула строк), обычно 8-12 бит;
+//  - id, начало, длительность и стоимость (фиксированная точка 1/10000) -
+//    разность с минимумом блока минимальной ширины.
+// Агрегаты считаются по блокам: колонка распаковывается в буфер на стеке,
+// суммы копятся по номерам локального словаря и лишь потом переводятся в имена.
+// Последний неполный блок хранится несжатым.
+class CallHistory {
+public:
+    static const std::size_t BlockSize = 4096;
+    static const std::int64_t CostScale = 10000;
+
+    CallHistory();
+    CallHistory(const CallHistory&) = delete;
+    CallHistory& operator=(const CallHistory&) = delete;
+
+    void append(std::int64_t id, std::string_view caller, std::string_view destination,
+                int duration, double cost, std::int64_t startTime);
+    void append(const CallStore& calls);
+    void clear();
+
+    std::size_t count() const;
+    Call callAt(std::size_t index) const;
+    std::size_t memoryUsage() const;
+
+    double totalRevenue() const;
+    // Пропускает блоки, в словаре которых нет абонента
+    double clientTotalCost(std::string_view clientName) const;
+    // По имени абонента
+    std::vector<ClientUsage> clientUsage() const;
+    // По убыванию выручки
+    std::vector<DestinationRevenue> revenueByDestination() const;
+    // Выручка по наборам current и proposed со скидками VIP (DataManager::simulateTariffs).
+    // Блоки делятся на workers непрерывных частей - задачи pool со своими итогами,
+    // итоги складываются в вызывающем потоке. Скидка и тарифы ищутся один раз на
+    // строку пула, а не на звонок
+    TariffSimulation simulateTariffs(const TariffSet& current, const TariffSet& proposed,
+                                     const SubscriberStore& subscribers, QThreadPool* pool, int workers) const;
+
+private:
+    enum ColumnId {
+        CallerDictionary,
+        DestinationDictionary,
+        CallerColumn,
+        DestinationColumn,
+        IdColumn,
+        StartTimeColumn,
+        DurationColumn,
+        CostColumn,
+        ColumnCount
+    };
+
+    struct Column {
+        std::int64_t base = 0;      // минимум колонки
+        std::uint32_t offset = 0;   // начало в words (в 64-битных словах)
+        std::uint32_t size = 0;     // число значений
+        std::uint8_t bits = 0;      // ширина значения; 0 - все равны base
+    };
+
+    struct Block {
+        Column columns[ColumnCount];
+        std::vector<std::uint64_t> words;
+    };
+
+    void seal();
+    static void pack(Block& block, ColumnId id, const std::int64_t* values, std::size_t count);
+    static void unpack(const Block& block, ColumnId id, std::int64_t* values);
+    static std::int64_t valueAt(const Block& block, ColumnId id, std::size_t index);
+
+    StringPool strings;
+    std::vector<Block> blocks;
+    std::vector<CallRecord> tail;
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "CallStore.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+namespace {
+
+const std::size_t DefaultArenaBytes = 4096;
+
+// Блок или пул можно менять на месте, только если других ссылок на него нет.
+// Новую ссылку может взять только копия хранилища, а копии создаются в потоке
+// оригинала, поэтому use_count() == 1 здесь окончательный ответ.
+template <typename T>
+bool exclusive(const std::shared_ptr<T>& pointer) {
+    if (pointer.use_count() != 1) {
+        return false;
+    }
+    // Чтения копии, которая только что отпустила ссылку, завершены до наших записей
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+} // namespace
+
+CallStore::Strings::Strings(std::size_t initialBytes) : arena(initialBytes), pool(&arena) {}
+
+CallStore::CallStore() : shared(std::make_shared<Strings>(DefaultArenaBytes)) {}
+
+void CallStore::add(const Call& call, std::int64_t id) {
+    add(id, call.getCallerName(), call.getDestination(), call.getDuration(), call.getCost(), call.getStartTime());
+}
+
+void CallStore::add(std::int64_t id, std::string_view caller, std::string_view destination,
+                    int duration, double cost, std::int64_t startTime) {
+    // Обычно обе строки уже есть в пуле, и общий пул не копируется
+    std::uint32_t callerId = shared->pool.find(caller);
+    if (callerId == StringPool::NotFound) {
+        callerId = writableStrings().intern(caller);
+    }
+    std::uint32_t destinationId = shared->pool.find(destination);
+    if (destinationId == StringPool::NotFound) {
+        destinationId = writableStrings().intern(destination);
+    }
+
+    if (chunks.empty() || chunks.back()->size() == static_cast<std::size_t>(ChunkSize)) {
+        auto chunk = std::make_shared<Chunk>();
+        chunk->reserve(ChunkSize);
+        chunks.push_back(std::move(chunk));
+    }
+    writableChunk(chunks.size() - 1).push_back({id, startTime, cost, callerId, destinationId, duration});
+    ++total;
+}
+
+void CallStore::remove(int index) {
+    if (index < 0 || index >= total) {
+        return;
+    }
+    // Сдвиг копирует только блоки от удаляемого звонка до конца
+    for (int i = index; i + 1 < total; ++i) {
+        writableAt(i) = at(i + 1);
+    }
+    truncate(total - 1);
+}
+
+int CallStore::removeStartedBefore(std::int64_t cutoff) {
+    return removeIf([cutoff](const CallRecord& record) { return record.startTime > 0 && record.startTime < cutoff; });
+}
+
+int CallStore::removeIf(const std::function<bool(const CallRecord&)>& drop) {
+    int kept = 0;
+    for (int i = 0; i < total; ++i) {
+        const CallRecord& record = at(i);
+        if (drop(record)) {
+            continue;
+        }
+        if (kept != i) {
+            writableAt(kept) = record;
+        }
+        ++kept;
+    }
+    const int removed = total - kept;
+    truncate(kept);
+    return removed;
+}
+
+int CallStore::renameCaller(std::string_view from, std::string_view to) {
+    return rename(from, to, &CallRecord::callerId);
+}
+
+int CallStore::renameDestination(std::string_view from, std::string_view to) {
+    return rename(from, to, &CallRecord::destinationId);
+}
+
+int CallStore::rename(std::string_view from, std::string_view to, std::uint32_t CallRecord::*field) {
+    const std::uint32_t fromId = shared->pool.find(from);
+    if (fromId == StringPool::NotFound || from == to) {
+        return 0;
+    }
+    std::uint32_t toId = shared->pool.find(to);
+    if (toId == StringPool::NotFound) {
+        toId = writableStrings().intern(to);
+    }
+    // Копируются только блоки, где есть звонки с этим именем
+    int renamed = 0;
+    for (int i = 0; i < total; ++i) {
+        if (at(i).*field == fromId) {
+            writableAt(i).*field = toId;
+            ++renamed;
+        }
+    }
+    return renamed;
+}
+
+void CallStore::reset(std::size_t count) {
+    clear();
+    chunks.reserve(count / ChunkSize + 1);
+}
+
+void CallStore::clear() {
+    shared = std::make_shared<Strings>(DefaultArenaBytes);
+    chunks.clear();
+    total = 0;
+}
+
+int CallStore::count() const {
+    return total;
+}
+
+const CallRecord& CallStore::at(int index) const {
+    return (*chunks[index / ChunkSize])[index % ChunkSize];
+}
+
+std::string_view CallStore::text(std::uint32_t id) const {
+    return shared->pool.at(id);
+}
+
+std::uint32_t CallStore::textId(std::string_view value) const {
+    return shared->pool.find(value);
+}
+
+Call CallStore::callAt(int index) const {
+    const CallRecord& record = at(index);
+    return Call(std::string(text(record.callerId)), std::string(text(record.destinationId)),
+                record.duration, record.cost, record.startTime);
+}
+
+void CallStore::sortByDuration(bool ascending) {
+    std::vector<CallRecord> records;
+    records.reserve(total);
+    forEachChunk([&records](const CallRecord* chunk, std::size_t count) {
+        records.insert(records.end(), chunk, chunk + count);
+    });
+    std::sort(records.begin(), records.end(), [ascending](const CallRecord& a, const CallRecord& b) {
+        return ascending ? a.duration < b.duration : a.duration > b.duration;
+    });
+    // Отсортированные записи - в новые блоки, снимки сохраняют старый порядок
+    chunks.clear();
+    for (std::size_t start = 0; start < records.size(); start += ChunkSize) {
+        const std::size_t end = std::min(records.size(), start + ChunkSize);
+        auto chunk = std::make_shared<Chunk>(records.begin() + start, records.begin() + end);
+        chunk->reserve(ChunkSize);
+        chunks.push_back(std::move(chunk));
+    }
+    total = static_cast<int>(records.size());
+}
+
+std::size_t CallStore::memoryUsage() const {
+    std::size_t bytes = shared->pool.memoryUsage() + chunks.capacity() * sizeof(std::shared_ptr<Chunk>);
+    for (const auto& chunk : chunks) {
+        bytes += chunk->capacity() * sizeof(CallRecord);
+    }
+    return bytes;
+}
+
+const StringPool& CallStore::strings() const {
+    return shared->pool;
+}
+
+void CallStore::forEachChunk(const std::function<void(const CallRecord*, std::size_t)>& visit) const {
+    for (const auto& chunk : chunks) {
+        visit(chunk->data(), chunk->size());
+    }
+}
+
+bool CallStore::assign(const StringPool::Image& strings, const CallRecord* records, std::size_t count) {
+    const std::size_t arenaBytes = strings.byteCount +
+                                   (strings.offsetCount + strings.bucketCount) * sizeof(std::uint32_t) + 1024;
+    auto loaded = std::make_shared<Strings>(std::max(arenaBytes, DefaultArenaBytes));
+    if (!loaded->pool.assign(strings)) {
+        return false;
+    }
+    std::vector<std::shared_ptr<Chunk>> loadedChunks;
+    loadedChunks.reserve(count / ChunkSize + 1);
+    for (std::size_t start = 0; start < count; start += ChunkSize) {
+        const std::size_t end = std::min(count, start + ChunkSize);
+        auto chunk = std::make_shared<Chunk>(records + start, records + end);
+        chunk->reserve(ChunkSize);
+        loadedChunks.push_back(std::move(chunk));
+    }
+    shared = std::move(loaded);
+    chunks = std::move(loadedChunks);
+    total = static_cast<int>(count);
+    return true;
+}
+
+CallStore::Chunk& CallStore::writableChunk(std::size_t index) {
+    std::shared_ptr<Chunk>& chunk = chunks[index];
+    if (!exclusive(chunk)) {
+        auto copy = std::make_shared<Chunk>();
+        copy->reserve(ChunkSize);
+        copy->assign(chunk->begin(), chunk->end());
+        chunk = std::move(copy);
+    }
+    return *chunk;
+}
+
+StringPool& CallStore::writableStrings() {
+    if (!exclusive(shared)) {
+        const StringPool::Image image = shared->pool.image();
+        const std::size_t arenaBytes = image.byteCount +
+                                       (image.offsetCount + image.bucketCount) * sizeof(std::uint32_t) + 1024;
+        auto copy = std::make_shared<Strings>(std::max(arenaBytes, DefaultArenaBytes));
+        copy->pool.assign(image);
+        shared = std::move(copy);
+    }
+    return shared->pool;
+}
+
+CallRecord& CallStore::writableAt(int index) {
+    return writableChunk(static_cast<std::size_t>(index / ChunkSize))[index % ChunkSize];
+}
+
+void CallStore::truncate(int count) {
+    if (count >= total) {
+        return;
+    }
+    const std::size_t chunkCount = (static_cast<std::size_t>(count) + ChunkSize - 1) / ChunkSize;
+    chunks.resize(chunkCount);
+    if (chunkCount > 0) {
+        const std::size_t last = static_cast<std::size_t>(count) - (chunkCount - 1) * ChunkSize;
+        if (chunks.back()->size() != last) {
+            writableChunk(chunkCount - 1).resize(last);
+        }
+    }
+    total = count;
+}
@@ -0,0 +1,99 @@
+#ifndef CALLSTORE_H
+#define CALLSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "Call.h"
+#include "StringPool.h"
+
+// Плоская запись звонка. Имена абонентов и направления интернированы:
+// различных значений мало, а звонков - миллионы.
+struct CallRecord {
+    std::int64_t id;            // id строки в таблице calls (0 - еще не записан)
+    std::int64_t startTime;     // секунды Unix, 0 - неизвестно
+    double cost;
+    std::uint32_t callerId;
+    std::uint32_t destinationId;
+    std::int32_t duration;
+};
+
+// Звонки в памяти DataManager; Call используется только как представление (callAt)
+//
+// Записи лежат блоками по ChunkSize, пул строк - отдельно. Копия хранилища делит
+// с оригиналом и блоки, и пул (копируются только указатели), а изменение копирует
+// лишь затронутый блок (или пул при новой строке), если на него ссылается другая
+// копия. Так DataManager::snapshot отдает отчетам неизменный срез звонков, пока
+// прием дописывает новые. Копию можно читать в другом потоке, а создавать и
+// менять - только в потоке оригинала.
+class CallStore {
+public:
+    static const int ChunkSize = 16384;
+
+    CallStore();
+    CallStore(const CallStore&) = default;
+    CallStore& operator=(const CallStore&) = default;
+    CallStore(CallStore&&) = default;
+    CallStore& operator=(CallStore&&) = default;
+
+    void add(const Call& call, std::int64_t id);
+    void add(std::int64_t id, std::string_view caller, std::string_view destination,
+             int duration, double cost, std::int64_t startTime);
+    void remove(int index);
+    // Удаляет звонки, начавшиеся раньше cutoff, за один проход; возвращает их число.
+    // Звонки с неизвестным временем (startTime = 0) не трогает
+    int removeStartedBefore(std::int64_t cutoff);
+    // То же для любого условия: оставшиеся звонки сдвигаются одним проходом
+    int removeIf(const std::function<bool(const CallRecord& record)>& drop);
+    // Новое имя абонента или направления у всех его звонков (в БД звонки ссылаются
+    // на строку абонента или тарифа, и переименование видно в истории); число звонков
+    int renameCaller(std::string_view from, std::string_view to);
+    int renameDestination(std::string_view from, std::string_view to);
+
+    // Пустое хранилище под count звонков
+    void reset(std::size_t count);
+    void clear();
+
+    int count() const;
+    const CallRecord& at(int index) const;
+    std::string_view text(std::uint32_t id) const;
+    std::uint32_t textId(std::string_view value) const;
+    Call callAt(int index) const;
+
+    void sortByDuration(bool ascending);
+    std::size_t memoryUsage() const;
+
+    // Двоичный снимок (Snapshot), как у SubscriberStore; записи - по блокам, по порядку
+    const StringPool& strings() const;
+    void forEachChunk(const std::function<void(const CallRecord* records, std::size_t count)>& visit) const;
+    bool assign(const StringPool::Image& strings, const CallRecord* records, std::size_t count);
+
+private:
+    // Пул строк в своей арене, как у SubscriberStore
+    struct Strings {
+        explicit Strings(std::size_t initialBytes);
+
+        std::pmr::monotonic_buffer_resource arena;
+        StringPool pool;
+    };
+    using Chunk = std::vector<CallRecord>;
+
+    // Блок для записи: если его делит другая копия, он копируется
+    Chunk& writableChunk(std::size_t index);
+    StringPool& writableStrings();
+    CallRecord& writableAt(int index);
+    void truncate(int count);
+    int rename(std::string_view from, std::string_view to, std::uint32_t CallRecord::*field);
+
+    std::shared_ptr<Strings> shared;
+    // Все блоки, кроме последнего, заполнены
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    int total = 0;
+};
+
+#endif
@@ -0,0 +1,300 @@
+#include "CdrTailer.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QHash>
+#include <QPromise>
+#include <algorithm>
+#include "AsyncDataManager.h"
+#include "Metrics.h"
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Отпечаток первой строки файла (FNV-1a): она уже не меняется, пока файл дописывается
+qint64 fingerprintOf(const QByteArray& line) {
+    quint64 hash = 14695981039346656037ull;
+    for (char c : line) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash == 0 ? 1 : static_cast<qint64>(hash);
+}
+
+// Разбор одной строки источника; пустые строки и комментарии пропускаются
+void parseLine(const QByteArray& bytes, std::vector<DialedCall>& calls, int& malformed) {
+    const QString text = QString::fromUtf8(bytes).trimmed();
+    if (text.isEmpty() || text.startsWith('#')) {
+        return;
+    }
+    DialedCall call;
+    if (parseDialedCall(text, &call)) {
+        calls.push_back(std::move(call));
+    } else {
+        ++malformed;
+    }
+}
+
+} // namespace
+
+CdrTailer::CdrTailer(AsyncDataManager *asyncData, DataManager *dataManager, QObject *parent)
+    : QObject(parent), asyncData(asyncData), dataManager(dataManager) {
+    readerPool.setMaxThreadCount(1);
+    connect(&pollTimer, &QTimer::timeout, this, &CdrTailer::poll);
+}
+
+CdrTailer::~CdrTailer() {
+    stop();
+}
+
+bool CdrTailer::start(const QString& sourcePath) {
+    stop();
+    const QFileInfo info(sourcePath);
+    if (info.isDir()) {
+        fifo = false;
+    } else if (info.exists() && !info.isFile()) {
+        // Не каталог и не обычный файл - именованный канал
+#ifdef Q_OS_UNIX
+        // Без O_NONBLOCK open ждал бы отправителя, а read - данных
+        fifoDescriptor = ::open(QFile::encodeName(sourcePath).constData(), O_RDONLY | O_NONBLOCK);
+        if (fifoDescriptor < 0) {
+            fail("Не удалось открыть канал CDR: " + sourcePath);
+            return false;
+        }
+        fifo = true;
+#else
+        fail("Прием CDR из именованного канала поддерживается только в Unix");
+        return false;
+#endif
+    } else {
+        fail("Источник CDR должен быть каталогом или именованным каналом: " + sourcePath);
+        return false;
+    }
+
+    path = sourcePath;
+    current = CdrIngestStatus();
+    current.source = sourcePath;
+    current.running = true;
+    ++generation;
+    rateTimer.start();
+    pollTimer.start(PollIntervalMs);
+    emit statusChanged();
+    QTimer::singleShot(0, this, &CdrTailer::poll);
+    return true;
+}
+
+void CdrTailer::stop() {
+    pollTimer.stop();
+    // Цикл чтения трогает буфер и дескриптор канала - дожидаемся его
+    readerPool.waitForDone();
+    ++generation;
+#ifdef Q_OS_UNIX
+    if (fifoDescriptor >= 0) {
+        ::close(fifoDescriptor);
+    }
+#endif
+    fifoDescriptor = -1;
+    fifoBuffer.clear();
+    if (current.running) {
+        current.running = false;
+        current.callsPerSecond = 0.0;
+        emit statusChanged();
+    }
+}
+
+bool CdrTailer::isRunning() const {
+    return current.running;
+}
+
+CdrIngestStatus CdrTailer::status() const {
+    return current;
+}
+
+void CdrTailer::fail(const QString& message) {
+    current.lastError = message;
+    emit statusChanged();
+}
+
+void CdrTailer::poll() {
+    // Тарификация идет по абонентам и тарифам в памяти - ждем конца загрузки и
+    // операций, которые их заменяют (импорт, восстановление)
+    if (inFlight || !current.running || asyncData->isLoading() || asyncData->isBusy()) {
+        return;
+    }
+    inFlight = true;
+    const int cycle = generation;
+    auto chunk = std::make_shared<Chunk>();
+    auto promise = std::make_shared<QPromise<void>>();
+    QFuture<void> future = promise->future();
+    promise->start();
+    readerPool.start([this, chunk, promise]() {
+        ATC_TIMED_OPERATION(timer, "cdrTailer.read");
+        if (fifo) {
+            readFifo(*chunk);
+        } else {
+            readDirectory(*chunk);
+        }
+        timer.addRows(chunk->calls.size());
+        promise->finish();
+    });
+
+    future.then(this, [this, chunk, cycle]() {
+        if (cycle != generation) {
+            inFlight = false;
+            return;
+        }
+        RatingStats stats;
+        std::vector<Call> rated = dataManager->rateDialedCalls(chunk->calls, &stats);
+        const int rejected = chunk->malformed + stats.invalid + stats.unknownCaller + stats.unrouted;
+        if (chunk->calls.empty() && chunk->checkpoints.empty()) {
+            finishCycle(*chunk, 0, 0, rejected);
+            return;
+        }
+        asyncData->ingestCalls(std::move(rated), chunk->checkpoints)
+            .then(this, [this, chunk, cycle, rejected](ImportResult result) {
+                if (cycle != generation) {
+                    inFlight = false;
+                    return;
+                }
+                if (result.imported < 0) {
+                    // Позиции не сдвинулись: те же строки будут прочитаны в следующем цикле
+                    inFlight = false;
+                    fail(dataManager->lastError());
+                    return;
+                }
+                finishCycle(*chunk, result.imported, result.duplicates, rejected);
+            });
+    });
+}
+
+void CdrTailer::readDirectory(Chunk& chunk) const {
+    QHash<QString, CdrCheckpoint> known;
+    for (const CdrCheckpoint& checkpoint : dataManager->readCdrCheckpoints()) {
+        known.insert(checkpoint.source, checkpoint);
+    }
+
+    // Файлы коммутатора именуются по времени: порядок имен - порядок звонков
+    const QFileInfoList files = QDir(path).entryInfoList({"*.cdr"}, QDir::Files | QDir::Readable, QDir::Name);
+    int budget = BatchSize;
+    for (const QFileInfo& info : files) {
+        const QString source = info.absoluteFilePath();
+        const qint64 size = info.size();
+        const bool tracked = known.contains(source);
+        CdrCheckpoint checkpoint = tracked ? known.value(source) : CdrCheckpoint{source, 0, 0};
+        if (tracked && checkpoint.offset == size) {
+            continue;
+        }
+        if (budget == 0) {
+            chunk.backlogBytes += size - std::min(size, checkpoint.offset);
+            continue;
+        }
+
+        QFile file(source);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        // Пока первая строка не дописана, файл не читается: по ней узнается подмена файла
+        const QByteArray first = file.readLine();
+        if (!first.endsWith('\n')) {
+            chunk.backlogBytes += size;
+            continue;
+        }
+        const qint64 fingerprint = fingerprintOf(first);
+        if (checkpoint.fingerprint != fingerprint || checkpoint.offset > size) {
+            checkpoint.offset = 0;
+            checkpoint.fingerprint = fingerprint;
+        }
+
+        const qint64 start = checkpoint.offset;
+        file.seek(start);
+        while (budget > 0 && !file.atEnd()) {
+            const QByteArray line = file.readLine();
+            // Последняя строка еще дописывается - дочитаем в следующем цикле
+            if (!line.endsWith('\n')) {
+                break;
+            }
+            checkpoint.offset += line.size();
+            const std::size_t before = chunk.calls.size();
+            parseLine(line, chunk.calls, chunk.malformed);
+            budget -= static_cast<int>(chunk.calls.size() - before);
+        }
+        if (checkpoint.offset != start || !tracked || known.value(source).fingerprint != fingerprint) {
+            chunk.checkpoints.push_back(checkpoint);
+        }
+        chunk.backlogBytes += size - checkpoint.offset;
+    }
+    chunk.full = budget == 0 && chunk.backlogBytes > 0;
+}
+
+void CdrTailer::readFifo(Chunk& chunk) {
+#ifdef Q_OS_UNIX
+    char buffer[64 * 1024];
+    while (fifoBuffer.size() < FifoBufferLimit) {
+        // -1 (EAGAIN) - данных пока нет, 0 - отправитель закрыл канал; в обоих случаях ждем цикла
+        const ssize_t received = ::read(fifoDescriptor, buffer, sizeof(buffer));
+        if (received <= 0) {
+            break;
+        }
+        fifoBuffer.append(buffer, static_cast<qsizetype>(received));
+    }
+#endif
+    qsizetype position = 0;
+    int budget = BatchSize;
+    while (budget > 0) {
+        const qsizetype end = fifoBuffer.indexOf('\n', position);
+        if (end < 0) {
+            break;
+        }
+        const std::size_t before = chunk.calls.size();
+        parseLine(fifoBuffer.mid(position, end - position), chunk.calls, chunk.malformed);
+        budget -= static_cast<int>(chunk.calls.size() - before);
+        position = end + 1;
+    }
+    chunk.consumedFifoBytes = position;
+    chunk.backlogBytes = fifoBuffer.size() - position;
+    chunk.full = budget == 0 && fifoBuffer.indexOf('\n', position) >= 0;
+}
+
+void CdrTailer::finishCycle(const Chunk& chunk, int written, int duplicates, int rejected) {
+    if (fifo) {
+        fifoBuffer.remove(0, static_cast<qsizetype>(chunk.consumedFifoBytes));
+    }
+    current.ingested += written;
+    current.duplicates += duplicates;
+    current.rejected += rejected;
+    current.backlogBytes = chunk.backlogBytes;
+    current.lastError.clear();
+
+    // Отставание - по времени начала самого позднего звонка пакета
+    qint64 newest = 0;
+    for (const DialedCall& call : chunk.calls) {
+        newest = std::max<qint64>(newest, call.startTime);
+    }
+    if (newest > 0) {
+        current.lagSeconds = std::max<qint64>(0, QDateTime::currentSecsSinceEpoch() - newest);
+    } else if (chunk.backlogBytes == 0) {
+        current.lagSeconds = 0;
+    }
+
+    const qint64 elapsedMs = rateTimer.restart();
+    if (elapsedMs > 0) {
+        const double sample = written * 1000.0 / elapsedMs;
+        current.callsPerSecond = current.callsPerSecond * 0.7 + sample * 0.3;
+    }
+
+    inFlight = false;
+    emit statusChanged();
+    if (written > 0) {
+        emit callsIngested(written);
+    }
+    // Источник не дочитан - следующий пакет сразу, без ожидания таймера
+    if (chunk.full) {
+        QTimer::singleShot(0, this, &CdrTailer::poll);
+    }
+}
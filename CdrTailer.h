@@ -0,0 +1,99 @@
+#ifndef CDRTAILER_H
+#define CDRTAILER_H
+
+#include <memory>
+#include <vector>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "DataManager.h"
+
+class AsyncDataManager;
+
+// Состояние приема CDR для строки состояния окна и atc-cli
+struct CdrIngestStatus {
+    QString source;
+    bool running = false;
+    qint64 ingested = 0;          // записано звонков с начала приема
+    qint64 duplicates = 0;        // повторные CDR (уже были в БД)
+    qint64 rejected = 0;          // неизвестный абонент, нет маршрута, ошибка формата
+    double callsPerSecond = 0.0;  // скользящее среднее
+    qint64 backlogBytes = 0;      // еще не прочитанный хвост источника
+    qint64 lagSeconds = 0;        // от начала последнего записанного звонка до текущего момента
+    QString lastError;
+};
+
+// Непрерывный прием CDR из каталога (файлы *.cdr, по имени) или из именованного
+// канала (FIFO). Строки - в формате parseDialedCall. Один цикл: прочитать и разобрать
+// новые полные строки (поток чтения), тарифицировать по номерам (поток-владелец) и
+// записать пакет вместе с позициями файлов через AsyncDataManager::ingestCalls.
+// Следующий пакет читается только после фиксации предыдущего: пока писатель занят,
+// данные ждут в файлах (а канал заполняется и останавливает отправителя).
+//
+// Позиции берутся из БД в начале каждого цикла и пишутся в той же транзакции, что и
+// звонки, поэтому перезапуск не теряет и не повторяет строки файлов. У канала позиций
+// нет: строки, прочитанные, но не записанные до аварийного завершения, теряются.
+class CdrTailer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit CdrTailer(AsyncDataManager *asyncData, DataManager *dataManager, QObject *parent = nullptr);
+    ~CdrTailer();
+
+    // Каталог или FIFO; false (с текстом в status().lastError), если источник не подходит
+    bool start(const QString& path);
+    void stop();
+    bool isRunning() const;
+    CdrIngestStatus status() const;
+
+signals:
+    void statusChanged();
+    // Пакет звонков записан и добавлен в DataManager
+    void callsIngested(int count);
+
+private:
+    // Результат чтения источника (заполняется в потоке чтения)
+    struct Chunk {
+        std::vector<DialedCall> calls;
+        std::vector<CdrCheckpoint> checkpoints;
+        int malformed = 0;
+        qint64 backlogBytes = 0;
+        // Байт, разобранных из буфера канала; удаляются после записи пакета
+        qint64 consumedFifoBytes = 0;
+        bool full = false;
+    };
+
+    void poll();
+    void readDirectory(Chunk& chunk) const;
+    void readFifo(Chunk& chunk);
+    void finishCycle(const Chunk& chunk, int written, int duplicates, int rejected);
+    void fail(const QString& message);
+
+    static const int BatchSize = 5000;
+    static const int PollIntervalMs = 500;
+    // Предел непрочитанного из канала в памяти: дальше отправитель ждет
+    static const int FifoBufferLimit = 4 * 1024 * 1024;
+
+    AsyncDataManager *asyncData;
+    DataManager *dataManager;
+    QTimer pollTimer;
+    // Один поток: циклы не перекрываются, буфер канала трогает только он
+    QThreadPool readerPool;
+
+    QString path;
+    bool fifo = false;
+    int fifoDescriptor = -1;
+    QByteArray fifoBuffer;
+
+    bool inFlight = false;
+    // Номер запуска: продолжение цикла, начатого до stop(), результат не применяет
+    int generation = 0;
+    QElapsedTimer rateTimer;
+    CdrIngestStatus current;
+};
+
+#endif
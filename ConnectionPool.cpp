@@ -0,0 +1,103 @@
+#include "ConnectionPool.h"
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QMutexLocker>
+
+ConnectionPool::ConnectionPool(const QString& databasePath) : dbPath(databasePath) {}
+
+ConnectionPool::~ConnectionPool() {
+    closeAll();
+}
+
+QSqlDatabase ConnectionPool::connection() {
+    return current().db;
+}
+
+StatementCache& ConnectionPool::statements() {
+    return *current().statements;
+}
+
+ConnectionPool::ThreadConnection& ConnectionPool::current() {
+    QThread* thread = QThread::currentThread();
+
+    QMutexLocker locker(&mutex);
+    auto& slot = connections[thread];
+    if (slot && slot->db.isOpen()) {
+        return *slot;
+    }
+
+    if (!slot) {
+        slot.reset(new ThreadConnection());
+        slot->name = QString("atc_%1_%2")
+                         .arg(reinterpret_cast<quintptr>(this))
+                         .arg(reinterpret_cast<quintptr>(thread));
+        slot->db = QSqlDatabase::addDatabase("QSQLITE", slot->name);
+        slot->db.setDatabaseName(dbPath);
+
+        // Поток пула завершился - его соединение больше никому не нужно.
+        // DirectConnection: слот выполняется в завершающемся потоке.
+        if (thread != nullptr) {
+            QObject::connect(thread, &QThread::finished, &threadWatcher,
+                             [this, thread]() { release(thread); }, Qt::DirectConnection);
+        }
+    }
+
+    slot->statements.reset(new StatementCache(slot->db));
+    if (!slot->db.open()) {
+        lastErrorText = slot->db.lastError().text();
+        return *slot;
+    }
+
+    QSqlQuery pragma(slot->db);
+    // WAL: читатели не блокируют писателя и друг друга
+    pragma.exec("PRAGMA journal_mode=WAL");
+    pragma.exec("PRAGMA synchronous=NORMAL");
+    // Писатель в другом потоке держит блокировку - ждем, а не падаем с SQLITE_BUSY
+    pragma.exec("PRAGMA busy_timeout=5000");
+    // Ссылки звонков на абонентов и тарифы проверяет SQLite (по умолчанию выключено)
+    pragma.exec("PRAGMA foreign_keys=ON");
+    pragma.finish();
+
+    return *slot;
+}
+
+void ConnectionPool::release(QThread* thread) {
+    QMutexLocker locker(&mutex);
+    auto it = connections.find(thread);
+    if (it == connections.end()) {
+        return;
+    }
+    closeConnection(*it->second);
+    connections.erase(it);
+}
+
+void ConnectionPool::closeConnection(ThreadConnection& connection) {
+    const QString name = connection.name;
+    connection.statements.reset();
+    connection.db.close();
+    connection.db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+}
+
+void ConnectionPool::closeAll() {
+    QMutexLocker locker(&mutex);
+    for (auto& entry : connections) {
+        closeConnection(*entry.second);
+    }
+    connections.clear();
+}
+
+QString ConnectionPool::databasePath() const {
+    return dbPath;
+}
+
+QString ConnectionPool::lastError() const {
+    QMutexLocker locker(&mutex);
+    return lastErrorText;
+}
+
+int ConnectionPool::connectionCount() const {
+    QMutexLocker locker(&mutex);
+    return static_cast<int>(connections.size());
+}
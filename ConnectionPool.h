@@ -0,0 +1,58 @@
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <memory>
+#include <unordered_map>
+#include <QMutex>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QString>
+
+#include "StatementCache.h"
+
+class QThread;
+
+// Пул соединений SQLite: у каждого потока свое именованное соединение и свой
+// кэш подготовленных выражений (QSqlDatabase нельзя использовать из чужого потока).
+// БД переводится в режим WAL, поэтому читатели работают параллельно с писателем.
+class ConnectionPool {
+public:
+    explicit ConnectionPool(const QString& databasePath);
+    ~ConnectionPool();
+
+    // Соединение текущего потока; открывается при первом обращении
+    QSqlDatabase connection();
+    // Кэш выражений соединения текущего потока
+    StatementCache& statements();
+
+    // Закрывает все соединения (например, перед заменой файла БД).
+    // Вызывать только когда рабочие потоки не выполняют запросов.
+    void closeAll();
+
+    QString databasePath() const;
+    QString lastError() const;
+    int connectionCount() const;
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+private:
+    struct ThreadConnection {
+        QString name;
+        QSqlDatabase db;
+        std::unique_ptr<StatementCache> statements;
+    };
+
+    ThreadConnection& current();
+    void release(QThread* thread);
+    static void closeConnection(ThreadConnection& connection);
+
+    QString dbPath;
+    QString lastErrorText;
+    mutable QMutex mutex;
+    // Контекст подписок на QThread::finished: отключаются вместе с пулом
+    QObject threadWatcher;
+    std::unordered_map<QThread*, std::unique_ptr<ThreadConnection>> connections;
+};
+
+#endif
@@ -1,458 +1,3298 @@
 #include "DataManager.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QVariant>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QStringList>
+#include <QDateTime>
+#include <QLoggingCategory>
+#include "Metrics.h"
+#include "Snapshot.h"
+#include "CallArchive.h"
+#include "CallHistory.h"
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
-#include <iostream>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <map>
+
+// Сообщения ядра идут в категорию atc.data, чтобы их можно было отключить
+// в пакетных запусках: QT_LOGGING_RULES="atc.data.info=false"
+Q_LOGGING_CATEGORY(lcData, "atc.data")
+
+// Гистограмма SQL-выражения, закэшированная в месте вызова
+#define ATC_SQL_METRIC(name) \
+    ([]() -> OperationHistogram& { \
+        static OperationHistogram& histogram = MetricsRegistry::instance().sql(name); \
+        return histogram; \
+    }())
+
+namespace {
+
+// Выполнение SQL с замером длительности; для DML учитываются затронутые строки
+bool execTimed(QSqlQuery& query, OperationHistogram& metric, const QString& sql = QString()) {
+    ScopedTimer timer(metric);
+    bool ok = sql.isEmpty() ? query.exec() : query.exec(sql);
+    if (ok && !query.isSelect()) {
+        timer.addRows(static_cast<std::uint64_t>(std::max(0, query.numRowsAffected())));
+    }
+    return ok;
+}
 
-DataManager::DataManager() {
-    // Указываем жесткий путь к файлу базы данных
-    dbPath = "/Users/kostiashka/lab4_atc_gui/atc_database.sqlite";
+// Фиксация транзакции записи. Ревизия данных (db_revision) увеличивается один раз
+// на транзакцию, а не построчно: массовая запись не платит за каждую строку
+bool commitTimed(QSqlDatabase& db) {
+    QSqlQuery query(db);
+    if (!execTimed(query, ATC_SQL_METRIC("db_revision.bump"), "UPDATE db_revision SET revision = revision + 1")) {
+        return false;
+    }
+    ScopedTimer timer(ATC_SQL_METRIC("COMMIT"));
+    return db.commit();
+}
 
-    // При запуске подключаемся, создаем таблицы и загружаем данные в память
-    if (connectToDatabase()) {
-        createTables();
-        loadFromDatabase();
+// Экранирование поля CSV: кавычки удваиваются, поле с ';' или '"' берется в кавычки
+QString csvField(const QString& value) {
+    if (value.contains(';') || value.contains('"') || value.contains('\n')) {
+        QString escaped = value;
+        escaped.replace("\"", "\"\"");
+        return "\"" + escaped + "\"";
     }
+    return value;
 }
 
-DataManager::~DataManager() {
-    if (db.isOpen()) {
-        db.close();
+QString csvLine(const QStringList& fields) {
+    QStringList escaped;
+    for (const auto& field : fields) {
+        escaped << csvField(field);
     }
+    return escaped.join(';');
 }
 
+QStringList parseCsvLine(const QString& line) {
+    QStringList fields;
+    QString current;
+    bool inQuotes = false;
+    for (int i = 0; i < line.size(); ++i) {
+        const QChar ch = line[i];
+        if (inQuotes) {
+            if (ch == '"') {
+                if (i + 1 < line.size() && line[i + 1] == '"') {
+                    current += '"';
+                    ++i;
+                } else {
+                    inQuotes = false;
+                }
+            } else {
+                current += ch;
+            }
+        } else if (ch == '"') {
+            inQuotes = true;
+        } else if (ch == ';') {
+            fields << current;
+            current.clear();
+        } else {
+            current += ch;
+        }
+    }
+    fields << current;
+    return fields;
+}
 
-bool DataManager::connectToDatabase() {
-    db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName(dbPath);
+// Excel в русской локали пишет дробную часть через запятую
+double parseCsvNumber(const QString& text, bool* ok) {
+    QString normalized = text.trimmed();
+    normalized.replace(',', '.');
+    return normalized.toDouble(ok);
+}
 
-    if (!db.open()) {
-        qDebug() << "CRITICAL ERROR: Не удалось открыть БД:" << db.lastError().text();
-        return false;
-    }
+QString csvNumber(double value) {
+    return QString::number(value, 'g', 15);
+}
 
-    qDebug() << "==================================================";
-    qDebug() << "БАЗА ДАННЫХ ПОДКЛЮЧЕНА:" << dbPath;
-    qDebug() << "==================================================";
+// Время звонка в CSV - ISO 8601 в местном времени; пустое поле - время неизвестно
+QString csvTime(qint64 startTime) {
+    return startTime > 0 ? QDateTime::fromSecsSinceEpoch(startTime).toString(Qt::ISODate) : QString();
+}
 
-    return true;
+qlonglong parseCsvTime(const QString& text) {
+    const QDateTime time = QDateTime::fromString(text.trimmed(), Qt::ISODate);
+    return time.isValid() ? time.toSecsSinceEpoch() : 0;
 }
 
+std::string_view utf8View(const QByteArray& bytes) {
+    return std::string_view(bytes.constData(), static_cast<std::size_t>(bytes.size()));
+}
 
-bool DataManager::backupDatabase(const QString& destinationPath) {
-    // Если файл назначения уже существует, удаляем его, чтобы перезаписать
-    if (QFile::exists(destinationPath)) {
-        if (!QFile::remove(destinationPath)) {
-            qDebug() << "Ошибка: Не удалось перезаписать файл резервной копии.";
-            return false;
-        }
+// Статистика по звонкам в памяти: у DataManager и у среза DataSnapshot одна и та же
+double callsRevenue(const CallStore& calls) {
+    double total = 0.0;
+    for (int i = 0; i < calls.count(); ++i) {
+        total += calls.at(i).cost;
     }
+    return total;
+}
 
-    // Копируем текущий рабочий файл базы данных в выбранное пользователем место
-    if (QFile::copy(dbPath, destinationPath)) {
-        qDebug() << "Backup успешно создан:" << destinationPath;
-        return true;
-    } else {
-        qDebug() << "Ошибка при создании Backup!";
-        return false;
+double clientCallsCost(const CallStore& calls, const std::string& clientName) {
+    double total = 0.0;
+    // Имя ищется в пуле один раз, дальше сравниваются 32-битные id
+    const std::uint32_t callerId = calls.textId(clientName);
+    if (callerId == StringPool::NotFound) {
+        return total;
+    }
+    for (int i = 0; i < calls.count(); ++i) {
+        const CallRecord& call = calls.at(i);
+        if (call.callerId == callerId) {
+            total += call.cost;
+        }
     }
+    return total;
 }
 
-bool DataManager::restoreDatabase(const QString& sourcePath) {
-    // 1. Закрываем текущее соединение с БД, чтобы освободить файл
-    db.close();
+int clientCallsCount(const CallStore& calls, const std::string& clientName) {
+    int count = 0;
+    const std::uint32_t callerId = calls.textId(clientName);
+    if (callerId == StringPool::NotFound) {
+        return count;
+    }
+    for (int i = 0; i < calls.count(); ++i) {
+        if (calls.at(i).callerId == callerId) {
+            count++;
+        }
+    }
+    return count;
+}
 
-    // 2. Удаляем текущий рабочий файл базы данных
-    if (QFile::exists(dbPath)) {
-        if (!QFile::remove(dbPath)) {
-            qDebug() << "Ошибка: Не удалось удалить текущую БД для замены.";
-            // Пытаемся открыть обратно, чтобы программа не упала
-            db.open();
-            return false;
+// Число строк таблицы и суммарная длина ее текстовых колонок в байтах UTF-8
+// (sql: SELECT COUNT(*)[, TOTAL(...)] FROM ...)
+void measureTable(QSqlQuery& query, OperationHistogram& metric, const QString& sql,
+                  qint64* rows, qint64* textBytes) {
+    *rows = 0;
+    *textBytes = 0;
+    if (execTimed(query, metric, sql) && query.next()) {
+        *rows = query.value(0).toLongLong();
+        if (query.record().count() > 1) {
+            *textBytes = query.value(1).toLongLong();
         }
     }
+    query.finish();
+}
 
-    // 3. Копируем файл пользователя (из бэкапа) на место нашей рабочей базы
-    if (QFile::copy(sourcePath, dbPath)) {
-        // 4. Открываем базу заново
-        if (db.open()) {
-            // 5. Загружаем данные из новой (восстановленной) базы в оперативную память
-            loadFromDatabase();
-            qDebug() << "База данных успешно восстановлена из:" << sourcePath;
-            return true;
+void mergeUsage(std::map<std::string, ClientUsage>& merged, const std::vector<ClientUsage>& part) {
+    for (const auto& usage : part) {
+        auto it = merged.find(usage.clientName);
+        if (it == merged.end()) {
+            merged.emplace(usage.clientName, usage);
         } else {
-            qDebug() << "Ошибка: Не удалось открыть восстановленную БД.";
+            it->second.callCount += usage.callCount;
+            it->second.totalDuration += usage.totalDuration;
+            it->second.totalCost += usage.totalCost;
         }
-    } else {
-        qDebug() << "Ошибка копирования файла восстановления.";
     }
-
-    return false;
 }
 
+void mergeRevenue(std::map<std::string, DestinationRevenue>& merged, const std::vector<DestinationRevenue>& part) {
+    for (const auto& revenue : part) {
+        auto it = merged.find(revenue.destination);
+        if (it == merged.end()) {
+            merged.emplace(revenue.destination, revenue);
+        } else {
+            it->second.callCount += revenue.callCount;
+            it->second.revenue += revenue.revenue;
+        }
+    }
+}
 
-void DataManager::createTables() {
-    QSqlQuery query;
-
-    // Таблица тарифов
-    query.exec("CREATE TABLE IF NOT EXISTS tariffs ("
-               "city TEXT PRIMARY KEY, "
-               "price REAL, "
-               "fee REAL)");
-
-    // Таблица клиентов
-    query.exec("CREATE TABLE IF NOT EXISTS clients ("
-               "name TEXT PRIMARY KEY, "
-               "phone TEXT, "
-               "balance REAL)");
-
-    // Таблица VIP клиентов
-    query.exec("CREATE TABLE IF NOT EXISTS vip_clients ("
-               "name TEXT PRIMARY KEY, "
-               "phone TEXT, "
-               "balance REAL, "
-               "discount REAL, "
-               "manager TEXT)");
+// Ключ CDR для поиска дубликатов: FNV-1a по абоненту, направлению, началу и
+// длительности (стоимость производная и может быть пересчитана). Числа - в
+// порядке little-endian, чтобы ключи в файле БД не зависели от машины.
+// 0 - ключа нет: без времени начала повторную передачу не отличить от нового звонка.
+qint64 cdrHash(std::string_view caller, std::string_view destination, qint64 startTime, int duration) {
+    if (startTime == 0) {
+        return 0;
+    }
+    quint64 hash = 14695981039346656037ull;
+    auto addByte = [&hash](unsigned char byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+    for (char c : caller) addByte(static_cast<unsigned char>(c));
+    addByte(0x1F);
+    for (char c : destination) addByte(static_cast<unsigned char>(c));
+    addByte(0x1F);
+    for (int i = 0; i < 8; ++i) addByte(static_cast<unsigned char>(static_cast<quint64>(startTime) >> (8 * i)));
+    for (int i = 0; i < 4; ++i) addByte(static_cast<unsigned char>(static_cast<quint32>(duration) >> (8 * i)));
+    return hash == 0 ? 1 : static_cast<qint64>(hash);
+}
 
-    // Таблица звонков
-    query.exec("CREATE TABLE IF NOT EXISTS calls ("
-               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "client_name TEXT, "
-               "destination TEXT, "
-               "duration INTEGER, "
-               "cost REAL)");
+qint64 cdrHash(const Call& call) {
+    return cdrHash(call.getCallerName(), call.getDestination(), call.getStartTime(), call.getDuration());
 }
 
-void DataManager::loadFromDatabase() {
-    // Очищаем векторы перед загрузкой новых данных
-    tariffs.clear();
-    clients.clear();
-    vipClients.clear();
-    calls.clear();
+QVariant cdrHashValue(qint64 hash) {
+    return hash == 0 ? QVariant() : QVariant(static_cast<qlonglong>(hash));
+}
 
-    QSqlQuery query;
+// Ключи для звонков, записанных до появления cdr_hash. Повторы уже в таблице не
+// удаляются (это данные пользователя): ключ получает только первый из них.
+int backfillCdrHashes(QSqlDatabase db) {
+    db.transaction();
+    QSqlQuery select(db);
+    select.setForwardOnly(true);
+    std::vector<std::pair<qlonglong, qint64>> keys;
+    std::unordered_set<qint64> seen;
+    int duplicates = 0;
+    if (execTimed(select, ATC_SQL_METRIC("calls.select_cdr_backfill"),
+                  "SELECT id, client_name, destination, started_at, duration FROM calls "
+                  "WHERE started_at != 0 ORDER BY id")) {
+        while (select.next()) {
+            const qint64 hash = cdrHash(select.value(1).toString().toStdString(),
+                                        select.value(2).toString().toStdString(),
+                                        select.value(3).toLongLong(), select.value(4).toInt());
+            if (seen.insert(hash).second) {
+                keys.emplace_back(select.value(0).toLongLong(), hash);
+            } else {
+                ++duplicates;
+            }
+        }
+    }
+    select.finish();
+
+    QSqlQuery update(db);
+    update.prepare("UPDATE calls SET cdr_hash = :hash WHERE id = :id");
+    for (const auto& key : keys) {
+        update.bindValue(":hash", static_cast<qlonglong>(key.second));
+        update.bindValue(":id", key.first);
+        execTimed(update, ATC_SQL_METRIC("calls.update_cdr_backfill"));
+    }
+    db.commit();
+    return duplicates;
+}
 
-    // Загрузка Тарифов
-    if (query.exec("SELECT * FROM tariffs")) {
+// Таблица префиксов мала и в снимок не входит: читается запросом при каждой загрузке
+void readTariffPrefixes(QSqlQuery& query, std::vector<TariffPrefix>* prefixes) {
+    if (execTimed(query, ATC_SQL_METRIC("tariff_prefixes.select"), "SELECT prefix, city FROM tariff_prefixes")) {
         while (query.next()) {
-            tariffs.push_back(Tariff(
-                query.value("city").toString().toStdString(),
-                query.value("price").toDouble(),
-                query.value("fee").toDouble()
-                ));
+            prefixes->push_back({query.value(0).toString().toStdString(), query.value(1).toString().toStdString()});
         }
     }
+    query.finish();
+}
 
-    // Загрузка Клиентов
-    if (query.exec("SELECT * FROM clients")) {
+// Версии цен действующих тарифов; таблица мала и, как префиксы, в снимок не входит
+void readTariffVersions(QSqlQuery& query, std::vector<TariffVersion>* versions) {
+    if (execTimed(query, ATC_SQL_METRIC("tariff_versions.select"),
+                  "SELECT t.city, v.price, v.fee, v.effective_from, v.effective_to FROM tariff_versions v "
+                  "JOIN tariffs t ON t.id = v.tariff_id WHERE t.active = 1")) {
         while (query.next()) {
-            clients.push_back(Client(
-                query.value("name").toString().toStdString(),
-                query.value("phone").toString().toStdString(),
-                query.value("balance").toDouble()
-                ));
+            versions->push_back({Tariff(query.value(0).toString().toStdString(), query.value(1).toDouble(),
+                                        query.value(2).toDouble()),
+                                 query.value(3).toLongLong(),
+                                 query.value(4).isNull() ? TariffVersion::OpenEnded : query.value(4).toLongLong()});
         }
     }
+    query.finish();
+}
+
+// Стоимость звонка по тарифу с учетом скидки VIP (caller может быть nullptr)
+double callCost(const Tariff& tariff, const SubscriberRecord* caller, int duration) {
+    double cost = tariff.getConnectionFee() + tariff.getPricePerMinute() * duration;
+    if (caller && caller->kind == SubscriberKind::Vip) {
+        cost *= (1.0 - caller->discount / 100.0);
+    }
+    return cost;
+}
 
-    // Загрузка VIP Клиентов
-    if (query.exec("SELECT * FROM vip_clients")) {
+bool tableHasColumn(QSqlQuery& query, const QString& table, const QString& column) {
+    bool found = false;
+    if (query.exec("PRAGMA table_info(" + table + ")")) {
         while (query.next()) {
-            vipClients.push_back(VIPClient(
-                query.value("name").toString().toStdString(),
-                query.value("phone").toString().toStdString(),
-                query.value("balance").toDouble(),
-                query.value("discount").toDouble(),
-                query.value("manager").toString().toStdString()
-                ));
+            found = found || query.value(1).toString() == column;
         }
     }
+    query.finish();
+    return found;
+}
 
-    // Загрузка Звонков
-    if (query.exec("SELECT * FROM calls")) {
+// id -> имя для справочной таблицы (абоненты, направления): звонки ссылаются на них числом
+std::unordered_map<qint64, QByteArray> readNameDictionary(QSqlQuery& query, OperationHistogram& metric,
+                                                          const QString& sql) {
+    std::unordered_map<qint64, QByteArray> names;
+    if (execTimed(query, metric, sql)) {
         while (query.next()) {
-            calls.push_back(Call(
-                query.value("client_name").toString().toStdString(),
-                query.value("destination").toString().toStdString(),
-                query.value("duration").toInt(),
-                query.value("cost").toDouble()
-                ));
+            names.emplace(query.value(0).toLongLong(), query.value(1).toString().toUtf8());
         }
     }
+    query.finish();
+    return names;
 }
 
+bool tableExists(QSqlQuery& query, const QString& table) {
+    query.prepare("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = :name");
+    query.bindValue(":name", table);
+    const bool found = query.exec() && query.next();
+    query.finish();
+    return found;
+}
 
-void DataManager::addTariff(const Tariff& tariff) {
-    QSqlQuery query;
-    query.prepare("INSERT INTO tariffs (city, price, fee) VALUES (:city, :price, :fee)");
-    query.bindValue(":city", QString::fromStdString(tariff.getCity()));
-    query.bindValue(":price", tariff.getPricePerMinute());
-    query.bindValue(":fee", tariff.getConnectionFee());
-
-    if (query.exec()) {
-        tariffs.push_back(tariff);
-    } else {
-        qDebug() << "SQL Error (addTariff):" << query.lastError().text();
-    }
+// Таблицы данных. Абонент - одна строка subscribers, у VIP к ней добавляется
+// строка vip_subscribers. Звонок хранит только целые ссылки на абонента и тариф.
+// Тариф не удаляется, а выключается (active = 0): строка остается направлением
+// звонков, сделанных по нему, и любой город из звонков - строка tariffs.
+void createDataTables(QSqlQuery& query) {
+    execTimed(query, ATC_SQL_METRIC("tariffs.create"), "CREATE TABLE IF NOT EXISTS tariffs ("
+               "id INTEGER PRIMARY KEY, "
+               "city TEXT NOT NULL UNIQUE, "
+               "price REAL, "
+               "fee REAL, "
+               "active INTEGER NOT NULL DEFAULT 1)");
+    execTimed(query, ATC_SQL_METRIC("subscribers.create"), "CREATE TABLE IF NOT EXISTS subscribers ("
+               "id INTEGER PRIMARY KEY, "
+               "name TEXT NOT NULL UNIQUE, "
+               "phone TEXT, "
+               "balance REAL)");
+    execTimed(query, ATC_SQL_METRIC("vip_subscribers.create"), "CREATE TABLE IF NOT EXISTS vip_subscribers ("
+               "subscriber_id INTEGER PRIMARY KEY REFERENCES subscribers(id) ON DELETE CASCADE, "
+               "discount REAL, "
+               "manager TEXT, "
+               "loyalty_tier INTEGER NOT NULL DEFAULT 0)");
+    // AUTOINCREMENT: id не используются повторно, на них опираются границы архива
+    execTimed(query, ATC_SQL_METRIC("calls.create"), "CREATE TABLE IF NOT EXISTS calls ("
+               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+               "client_id INTEGER NOT NULL REFERENCES subscribers(id), "
+               "tariff_id INTEGER NOT NULL REFERENCES tariffs(id), "
+               "duration INTEGER, "
+               "cost REAL, "
+               "started_at INTEGER NOT NULL DEFAULT 0, "
+               "cdr_hash INTEGER)");
 }
 
-void DataManager::removeTariff(int index) {
-    if (index >= 0 && index < static_cast<int>(tariffs.size())) {
-        std::string city = tariffs[index].getCity();
+// Перевод файла прежней схемы (clients, vip_clients, calls с именами) на
+// целочисленные ключи одной транзакцией; id звонков сохраняются. Звонки абонентов,
+// которых уже нет, не теряются: абонент восстанавливается с пустым номером.
+bool migrateLegacySchema(QSqlDatabase db) {
+    QSqlQuery query(db);
+    // Файлы, созданные до появления времени звонка: старые звонки получают 0 (неизвестно)
+    if (!tableHasColumn(query, "calls", "started_at")) {
+        execTimed(query, ATC_SQL_METRIC("calls.add_started_at"),
+                  "ALTER TABLE calls ADD COLUMN started_at INTEGER NOT NULL DEFAULT 0");
+    }
+    if (!tableHasColumn(query, "calls", "cdr_hash")) {
+        execTimed(query, ATC_SQL_METRIC("calls.add_cdr_hash"), "ALTER TABLE calls ADD COLUMN cdr_hash INTEGER");
+        const int duplicates = backfillCdrHashes(db);
+        if (duplicates > 0) {
+            qCWarning(lcData) << "В таблице calls уже есть повторяющиеся звонки:" << duplicates;
+        }
+    }
 
-        QSqlQuery query;
-        query.prepare("DELETE FROM tariffs WHERE city = :city");
-        query.bindValue(":city", QString::fromStdString(city));
+    ScopedTimer timer(ATC_SQL_METRIC("schema.migrate"));
+    db.transaction();
+    const char* steps[] = {
+        "ALTER TABLE tariffs RENAME TO legacy_tariffs",
+        "ALTER TABLE calls RENAME TO legacy_calls",
+        nullptr,  // новые таблицы
+        "INSERT INTO tariffs (city, price, fee, active) SELECT city, price, fee, 1 FROM legacy_tariffs",
+        "INSERT OR IGNORE INTO tariffs (city, price, fee, active) "
+        "SELECT DISTINCT destination, 0, 0, 0 FROM legacy_calls WHERE destination IS NOT NULL",
+        "INSERT INTO subscribers (name, phone, balance) SELECT name, phone, balance FROM clients",
+        // Имя VIP могло совпадать с обычным клиентом: запись VIP дополняет его
+        "INSERT OR IGNORE INTO subscribers (name, phone, balance) SELECT name, phone, balance FROM vip_clients",
+        "INSERT INTO vip_subscribers (subscriber_id, discount, manager) "
+        "SELECT s.id, v.discount, v.manager FROM vip_clients v JOIN subscribers s ON s.name = v.name",
+        "INSERT OR IGNORE INTO subscribers (name, phone, balance) "
+        "SELECT DISTINCT client_name, '', 0 FROM legacy_calls WHERE client_name IS NOT NULL",
+        "INSERT INTO calls (id, client_id, tariff_id, duration, cost, started_at, cdr_hash) "
+        "SELECT c.id, s.id, t.id, c.duration, c.cost, c.started_at, c.cdr_hash FROM legacy_calls c "
+        "JOIN subscribers s ON s.name = c.client_name JOIN tariffs t ON t.city = c.destination ORDER BY c.id",
+        // Счетчик AUTOINCREMENT не должен вернуться к id удаленных звонков
+        "UPDATE sqlite_sequence SET seq = (SELECT seq FROM sqlite_sequence WHERE name = 'legacy_calls') "
+        "WHERE name = 'calls' AND EXISTS (SELECT 1 FROM sqlite_sequence WHERE name = 'legacy_calls')",
+        "DROP TABLE legacy_calls",
+        "DROP TABLE legacy_tariffs",
+        "DROP TABLE vip_clients",
+        "DROP TABLE clients",
+    };
+    for (const char* step : steps) {
+        bool ok = true;
+        if (step == nullptr) {
+            createDataTables(query);
+            ok = !query.lastError().isValid();
+        } else {
+            ok = execTimed(query, ATC_SQL_METRIC("schema.migrate_step"), step);
+        }
+        if (!ok) {
+            qCCritical(lcData).noquote() << "Перевод БД на новую схему не выполнен:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    if (!commitTimed(db)) {
+        qCCritical(lcData).noquote() << "Перевод БД на новую схему не выполнен:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    // Место от текстовых колонок возвращается ОС только после VACUUM
+    execTimed(query, ATC_SQL_METRIC("VACUUM"), "VACUUM");
+    qCInfo(lcData) << "БД переведена на схему с целочисленными ключами";
+    return true;
+}
 
-        if (query.exec()) {
-            tariffs.erase(tariffs.begin() + index);
+// Окна трат всех VIP из subscribers по звонкам calls; число учтенных звонков
+std::uint64_t replayLoyalty(LoyaltyEngine& engine, const SubscriberStore& subscribers, const CallStore& calls) {
+    // id имени в пуле звонков -> id имени VIP в пуле абонентов
+    std::vector<std::uint32_t> vipByCaller(calls.strings().size(), StringPool::NotFound);
+    for (int i = 0; i < subscribers.count(SubscriberKind::Vip); ++i) {
+        const SubscriberRecord& vip = subscribers.at(SubscriberKind::Vip, i);
+        engine.track(vip.nameId, vip.tier);
+        const std::uint32_t callerId = calls.textId(subscribers.text(vip.nameId));
+        if (callerId != StringPool::NotFound) {
+            vipByCaller[callerId] = vip.nameId;
         }
     }
+    std::uint64_t recorded = 0;
+    calls.forEachChunk([&](const CallRecord* records, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::uint32_t nameId = vipByCaller[records[i].callerId];
+            if (nameId != StringPool::NotFound && engine.record(nameId, records[i].startTime, records[i].cost)) {
+                ++recorded;
+            }
+        }
+    });
+    return recorded;
 }
 
-void DataManager::updateTariff(int index, const Tariff& tariff) {
-    if (index >= 0 && index < static_cast<int>(tariffs.size())) {
-        removeTariff(index);
-        addTariff(tariff);
+// Изменившиеся уровни с именами абонентов: запись в БД не обращается к хранилищу
+LoyaltyTierUpdate tierUpdate(const LoyaltyEngine& engine, const SubscriberStore& subscribers) {
+    LoyaltyTierUpdate update;
+    update.changes = engine.changes();
+    for (const TierChange& change : update.changes) {
+        update.names.append(toQString(subscribers.text(change.clientId)));
     }
+    return update;
 }
 
-const std::vector<Tariff>& DataManager::getTariffs() const {
-    return tariffs;
+} // namespace
+
+bool parseDialedCall(const QString& line, DialedCall* call) {
+    const QStringList fields = line.split(';');
+    if (fields.size() < 3) {
+        return false;
+    }
+    bool ok = false;
+    call->callerNumber = fields[0].trimmed().toStdString();
+    call->dialedNumber = fields[1].trimmed().toStdString();
+    call->duration = fields[2].trimmed().toInt(&ok);
+    call->startTime = fields.size() >= 4 ? parseCsvTime(fields[3]) : 0;
+    return ok && !call->callerNumber.empty() && !call->dialedNumber.empty();
 }
 
-Tariff* DataManager::findTariffByCity(const std::string& city) {
-    for (auto& tariff : tariffs) {
-        if (tariff.getCity() == city) {
-            return &tariff;
+DataManager::DataManager(const QString& databasePath, bool loadData)
+    : publishedTariffs(std::make_shared<const TariffSet>()),
+      dbPath(databasePath.isEmpty() ? defaultDatabasePath() : databasePath) {
+    // При запуске подключаемся, создаем таблицы и загружаем данные в память
+    if (connectToDatabase()) {
+        createTables();
+        if (loadData) {
+            loadFromDatabase();
         }
     }
-    return nullptr;
 }
 
+DataManager::~DataManager() {
+    // Сначала дожидаемся потоков отчетов: их соединения закрываются при завершении потоков
+    reportPool.waitForDone();
+    pool.reset();
+}
 
-void DataManager::addClient(const Client& client) {
-    QSqlQuery query;
-    query.prepare("INSERT INTO clients (name, phone, balance) VALUES (:name, :phone, :balance)");
-    query.bindValue(":name", QString::fromStdString(client.getName()));
-    query.bindValue(":phone", QString::fromStdString(client.getPhoneNumber()));
-    query.bindValue(":balance", client.getBalance());
+QString DataManager::defaultDatabasePath() {
+    const QString fromEnv = qEnvironmentVariable("ATC_DB_PATH");
+    if (!fromEnv.isEmpty()) {
+        return fromEnv;
+    }
 
-    if (query.exec()) {
-        clients.push_back(client);
-    } else {
-        qDebug() << "SQL Error (addClient):" << query.lastError().text();
+    // Общий каталог данных, чтобы GUI и atc-cli по умолчанию работали с одной БД
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    if (dir.isEmpty()) {
+        dir = QDir::currentPath();
     }
+    dir += "/atc_system";
+    QDir().mkpath(dir);
+    return dir + "/atc_database.sqlite";
 }
 
-void DataManager::removeClient(int index) {
-    if (index >= 0 && index < static_cast<int>(clients.size())) {
-        std::string name = clients[index].getName();
-
-        QSqlQuery query;
-        query.prepare("DELETE FROM clients WHERE name = :name");
-        query.bindValue(":name", QString::fromStdString(name));
-
-        if (query.exec()) {
-            clients.erase(clients.begin() + index);
-        }
+void DataManager::setError(const QString& message) const {
+    {
+        QMutexLocker locker(&errorMutex);
+        lastErrorText = message;
     }
+    qCWarning(lcData).noquote() << message;
 }
 
-void DataManager::updateClient(int index, const Client& client) {
-    if (index >= 0 && index < static_cast<int>(clients.size())) {
-        removeClient(index);
-        addClient(client);
+int DataManager::execWrite(CachedStatement& statement, const char* operation) const {
+    QSqlDatabase db = database();
+    db.transaction();
+    if (!statement.exec()) {
+        const QString error = statement.query.lastError().text();
+        db.rollback();
+        setError(QString("SQL Error (%1): %2").arg(operation, error));
+        return -1;
+    }
+    // Число строк - до фиксации: commitTimed выполняет свой UPDATE ревизии
+    const int rows = statement.query.numRowsAffected();
+    if (!commitTimed(db)) {
+        const QString error = db.lastError().text();
+        db.rollback();
+        setError(QString("SQL Error (%1): %2").arg(operation, error));
+        return -1;
     }
+    return rows;
 }
 
-const std::vector<Client>& DataManager::getClients() const {
-    return clients;
+QString DataManager::lastError() const {
+    QMutexLocker locker(&errorMutex);
+    return lastErrorText;
 }
 
-bool DataManager::clientExists(const std::string& name) const {
-    for (const auto& client : clients) {
-        if (client.getName() == name) return true;
-    }
-    for (const auto& vip : vipClients) {
-        if (vip.getName() == name) return true;
-    }
-    return false;
+QSqlDatabase DataManager::database() const {
+    return pool->connection();
 }
 
+StatementCache& DataManager::statementCache() const {
+    return pool->statements();
+}
 
-void DataManager::addVIPClient(const VIPClient& client) {
-    QSqlQuery query;
-    query.prepare("INSERT INTO vip_clients (name, phone, balance, discount, manager) "
-                  "VALUES (:name, :phone, :balance, :discount, :manager)");
-    query.bindValue(":name", QString::fromStdString(client.getName()));
-    query.bindValue(":phone", QString::fromStdString(client.getPhoneNumber()));
-    query.bindValue(":balance", client.getBalance());
-    query.bindValue(":discount", client.getDiscount());
-    query.bindValue(":manager", QString::fromStdString(client.getPersonalManager()));
+QString DataManager::databasePath() const {
+    return dbPath;
+}
 
-    if (query.exec()) {
-        vipClients.push_back(client);
-    } else {
-        qDebug() << "SQL Error (addVIPClient):" << query.lastError().text();
-    }
+bool DataManager::isConnected() const {
+    return pool && database().isOpen();
 }
 
-void DataManager::removeVIPClient(int index) {
-    if (index >= 0 && index < static_cast<int>(vipClients.size())) {
-        std::string name = vipClients[index].getName();
+bool DataManager::connectToDatabase() {
+    ATC_TIMED_OPERATION(timer, "connectToDatabase");
+    // Соединения создаются пулом по одному на поток; первым открывается
+    // соединение текущего (владеющего DataManager) потока
+    pool.reset(new ConnectionPool(dbPath));
 
-        QSqlQuery query;
-        query.prepare("DELETE FROM vip_clients WHERE name = :name");
-        query.bindValue(":name", QString::fromStdString(name));
+    if (!database().isOpen()) {
+        setError("Не удалось открыть БД: " + pool->lastError());
+        return false;
+    }
+
+    qCInfo(lcData).noquote() << "База данных подключена:" << dbPath;
+    return true;
+}
 
-        if (query.exec()) {
-            vipClients.erase(vipClients.begin() + index);
+
+bool DataManager::backupDatabase(const QString& destinationPath) const {
+    ATC_TIMED_OPERATION(timer, "backupDatabase");
+    // Если файл назначения уже существует, удаляем его, чтобы перезаписать
+    if (QFile::exists(destinationPath)) {
+        if (!QFile::remove(destinationPath)) {
+            setError("Не удалось перезаписать файл резервной копии: " + destinationPath);
+            return false;
         }
     }
-}
 
-void DataManager::updateVIPClient(int index, const VIPClient& client) {
-    if (index >= 0 && index < static_cast<int>(vipClients.size())) {
-        removeVIPClient(index);
-        addVIPClient(client);
+    // В режиме WAL часть данных может лежать в файле -wal: переносим ее в основной файл
+    QSqlQuery checkpoint(database());
+    execTimed(checkpoint, ATC_SQL_METRIC("wal_checkpoint"), "PRAGMA wal_checkpoint(TRUNCATE)");
+    checkpoint.finish();
+
+    // Копируем текущий рабочий файл базы данных в выбранное пользователем место
+    if (QFile::copy(dbPath, destinationPath)) {
+        qCInfo(lcData).noquote() << "Backup успешно создан:" << destinationPath;
+        return true;
+    } else {
+        setError("Ошибка при создании резервной копии: " + destinationPath);
+        return false;
     }
 }
 
-const std::vector<VIPClient>& DataManager::getVIPClients() const {
-    return vipClients;
+bool DataManager::restoreDatabase(const QString& sourcePath) {
+    ATC_TIMED_OPERATION(timer, "restoreDatabase");
+    if (!replaceDatabaseFile(sourcePath)) {
+        return false;
+    }
+    // Загружаем данные из новой (восстановленной) базы в оперативную память
+    loadFromDatabase();
+    qCInfo(lcData).noquote() << "База данных успешно восстановлена из:" << sourcePath;
+    return true;
 }
 
+bool DataManager::replaceDatabaseFile(const QString& sourcePath) const {
+    ATC_TIMED_OPERATION(timer, "replaceDatabaseFile");
+    // 1. Закрываем все соединения пула, чтобы освободить файл. Соединение потока-владельца
+    // может закрываться из рабочего потока: запросов через него в это время нет
+    reportPool.waitForDone();
+    pool->closeAll();
 
-bool DataManager::addCall(const Call& call) {
-    // Проверка целостности данных: клиент должен существовать
-    if (!clientExists(call.getCallerName())) {
-        return false;
+    // 2. Удаляем текущий рабочий файл базы данных
+    if (QFile::exists(dbPath)) {
+        if (!QFile::remove(dbPath)) {
+            setError("Не удалось удалить текущую БД для замены.");
+            return false;
+        }
     }
+    // Журнал WAL старой базы нельзя применять к восстановленному файлу,
+    // а снимок старой базы может совпасть по ревизии с восстановленной
+    QFile::remove(dbPath + "-wal");
+    QFile::remove(dbPath + "-shm");
+    QFile::remove(snapshotPath());
+    invalidateCdrFilter();
 
-    QSqlQuery query;
-    query.prepare("INSERT INTO calls (client_name, destination, duration, cost) "
-                  "VALUES (:name, :dest, :dur, :cost)");
-    query.bindValue(":name", QString::fromStdString(call.getCallerName()));
-    query.bindValue(":dest", QString::fromStdString(call.getDestination()));
-    query.bindValue(":dur", call.getDuration());
-    query.bindValue(":cost", call.getCost());
+    // 3. Копируем файл пользователя (из бэкапа) на место нашей рабочей базы
+    if (!QFile::copy(sourcePath, dbPath)) {
+        setError("Ошибка копирования файла восстановления: " + sourcePath);
+        return false;
+    }
 
-    if (query.exec()) {
-        calls.push_back(call);
-        return true;
-    } else {
-        qDebug() << "SQL Error (addCall):" << query.lastError().text();
+    // 4. Открываем базу заново (пул откроет соединение при первом обращении)
+    if (!database().isOpen()) {
+        setError("Не удалось открыть восстановленную БД: " + pool->lastError());
         return false;
     }
+    // Копия могла быть снята до перехода на целочисленные ключи
+    createTables();
+    return true;
 }
 
-void DataManager::removeCall(int index) {
-    if (index >= 0 && index < static_cast<int>(calls.size())) {
-        Call c = calls[index];
-        QSqlQuery query;
-        // Удаляем по совпадению всех полей
-        query.prepare("DELETE FROM calls WHERE client_name = :name AND destination = :dest AND duration = :dur AND cost = :cost");
-        query.bindValue(":name", QString::fromStdString(c.getCallerName()));
-        query.bindValue(":dest", QString::fromStdString(c.getDestination()));
-        query.bindValue(":dur", c.getDuration());
-        query.bindValue(":cost", c.getCost());
 
-        if (query.exec()) {
-            calls.erase(calls.begin() + index);
+void DataManager::createTables() const {
+    ATC_TIMED_OPERATION(timer, "createTables");
+    QSqlQuery query(database());
+
+    // Ревизия данных: каждая транзакция записи (commitTimed) увеличивает счетчик, по
+    // нему проверяется, что двоичный снимок (Snapshot) соответствует БД. Таблица
+    // создается первой - ее обновляет уже перевод прежней схемы
+    execTimed(query, ATC_SQL_METRIC("db_revision.create"), "CREATE TABLE IF NOT EXISTS db_revision ("
+               "id INTEGER PRIMARY KEY CHECK (id = 0), "
+               "revision INTEGER NOT NULL)");
+    execTimed(query, ATC_SQL_METRIC("db_revision.init"), "INSERT OR IGNORE INTO db_revision (id, revision) VALUES (0, 0)");
+
+    // Файл прежней схемы (ключи - имена, текст в каждой строке звонков) переводится
+    // на целочисленные ключи один раз. Снимок прежней схемы сбрасывается и так:
+    // состав абонентов может измениться (VIP с именем обычного клиента)
+    if (tableExists(query, "clients") && migrateLegacySchema(database())) {
+        QFile::remove(snapshotPath());
+    }
+    createDataTables(query);
+    // Уровень лояльности VIP (LoyaltyEngine); в файлах, созданных раньше, - базовый,
+    // при загрузке он пересчитывается по звонкам
+    if (!tableHasColumn(query, "vip_subscribers", "loyalty_tier")) {
+        execTimed(query, ATC_SQL_METRIC("vip_subscribers.add_loyalty_tier"),
+                  "ALTER TABLE vip_subscribers ADD COLUMN loyalty_tier INTEGER NOT NULL DEFAULT 0");
+    }
+
+    // Префиксы номеров E.164 для маршрутизации по набранному номеру. Ссылка на
+    // город не внешний ключ: при удалении тарифа префиксы сохраняются, при смене города - переносятся
+    execTimed(query, ATC_SQL_METRIC("tariff_prefixes.create"), "CREATE TABLE IF NOT EXISTS tariff_prefixes ("
+               "prefix TEXT PRIMARY KEY, "
+               "city TEXT NOT NULL)");
+
+    execTimed(query, ATC_SQL_METRIC("calls.index_started_at"),
+              "CREATE INDEX IF NOT EXISTS calls_started_at ON calls(started_at)");
+    // Удаление абонента (проверка внешнего ключа и removeSubscribers) - без полного просмотра
+    execTimed(query, ATC_SQL_METRIC("calls.index_client_id"),
+              "CREATE INDEX IF NOT EXISTS calls_client_id ON calls(client_id)");
+    // Ключ CDR против повторной загрузки тех же звонков (см. cdrHash)
+    execTimed(query, ATC_SQL_METRIC("calls.index_cdr_hash"),
+              "CREATE UNIQUE INDEX IF NOT EXISTS calls_cdr_hash ON calls(cdr_hash) WHERE cdr_hash IS NOT NULL");
+
+    // Ключи CDR звонков, ушедших в архив: повторная загрузка тех же CDR
+    // отсекается и после archiveCallsBefore
+    execTimed(query, ATC_SQL_METRIC("archived_cdr_hashes.create"), "CREATE TABLE IF NOT EXISTS archived_cdr_hashes ("
+               "cdr_hash INTEGER PRIMARY KEY)");
+
+    // Файлы холодного архива звонков (CallArchive). Запись добавляется в той же
+    // транзакции, что удаляет звонки из calls, поэтому отчеты не считают их дважды
+    execTimed(query, ATC_SQL_METRIC("call_archives.create"), "CREATE TABLE IF NOT EXISTS call_archives ("
+               "file TEXT PRIMARY KEY, "
+               "first_call_id INTEGER, "
+               "last_call_id INTEGER, "
+               "call_count INTEGER, "
+               "cutoff INTEGER)");
+
+    // Позиции чтения файлов CDR (CdrTailer). Очистка данных их не сбрасывает:
+    // файлы в каталоге приема - внешний источник, повторно они не загружаются
+    execTimed(query, ATC_SQL_METRIC("cdr_checkpoints.create"), "CREATE TABLE IF NOT EXISTS cdr_checkpoints ("
+               "source TEXT PRIMARY KEY, "
+               "offset INTEGER NOT NULL, "
+               "fingerprint INTEGER NOT NULL)");
+
+    // Версии цен тарифов: [effective_from, effective_to) в секундах Unix, NULL - действует
+    // сейчас. Их ведут триггеры: новая цена закрывает открытую версию и открывает
+    // следующую с текущего момента. Первая версия направления действует с 0, чтобы
+    // цена нашлась и для звонков, загруженных задним числом; выключенная строка
+    // направления (без тарифа) версий не получает до включения
+    const bool versionsExisted = tableExists(query, "tariff_versions");
+    execTimed(query, ATC_SQL_METRIC("tariff_versions.create"), "CREATE TABLE IF NOT EXISTS tariff_versions ("
+               "id INTEGER PRIMARY KEY, "
+               "tariff_id INTEGER NOT NULL REFERENCES tariffs(id) ON DELETE CASCADE, "
+               "price REAL NOT NULL, "
+               "fee REAL NOT NULL, "
+               "effective_from INTEGER NOT NULL, "
+               "effective_to INTEGER, "
+               "UNIQUE (tariff_id, effective_from))");
+    if (!versionsExisted) {
+        execTimed(query, ATC_SQL_METRIC("tariff_versions.init"),
+                  "INSERT INTO tariff_versions (tariff_id, price, fee, effective_from) "
+                  "SELECT id, price, fee, 0 FROM tariffs WHERE active = 1");
+    }
+    execTimed(query, ATC_SQL_METRIC("tariff_versions.trigger"),
+              "CREATE TRIGGER IF NOT EXISTS tariffs_version_insert AFTER INSERT ON tariffs WHEN new.active = 1 BEGIN "
+              "INSERT INTO tariff_versions (tariff_id, price, fee, effective_from) "
+              "VALUES (new.id, new.price, new.fee, 0); END");
+    // Две правки за одну секунду оставили бы пустой интервал: он удаляется
+    execTimed(query, ATC_SQL_METRIC("tariff_versions.trigger"),
+              "CREATE TRIGGER IF NOT EXISTS tariffs_version_update AFTER UPDATE OF price, fee, active ON tariffs "
+              "WHEN new.active = 1 AND (old.price IS NOT new.price OR old.fee IS NOT new.fee OR "
+              "NOT EXISTS (SELECT 1 FROM tariff_versions WHERE tariff_id = new.id)) BEGIN "
+              "UPDATE tariff_versions SET effective_to = CAST(strftime('%s', 'now') AS INTEGER) "
+              "WHERE tariff_id = new.id AND effective_to IS NULL; "
+              "DELETE FROM tariff_versions WHERE tariff_id = new.id AND effective_to <= effective_from; "
+              "INSERT INTO tariff_versions (tariff_id, price, fee, effective_from) "
+              "SELECT new.id, new.price, new.fee, CASE WHEN EXISTS (SELECT 1 FROM tariff_versions "
+              "WHERE tariff_id = new.id) THEN CAST(strftime('%s', 'now') AS INTEGER) ELSE 0 END; END");
+
+    // Полнотекстовый поиск абонентов: имя, номер и менеджер VIP в одной строке на
+    // абонента (rowid - id в subscribers). Триграммы находят любой фрагмент от 3
+    // символов без учета регистра. Таблицу ведут триггеры; без FTS5 в сборке SQLite
+    // остается поиск по началу имени и номера (SubscriberIndex)
+    const bool fullTextExisted = tableExists(query, "subscribers_fts");
+    bool fullText = fullTextExisted ||
+                    execTimed(query, ATC_SQL_METRIC("subscribers_fts.create"),
+                              "CREATE VIRTUAL TABLE subscribers_fts USING fts5(name, phone, manager, tokenize = 'trigram')");
+    if (fullText && !fullTextExisted) {
+        fullText = execTimed(query, ATC_SQL_METRIC("subscribers_fts.rebuild"),
+                             "INSERT INTO subscribers_fts (rowid, name, phone, manager) "
+                             "SELECT s.id, s.name, s.phone, COALESCE(v.manager, '') FROM subscribers s "
+                             "LEFT JOIN vip_subscribers v ON v.subscriber_id = s.id");
+    }
+    if (fullText) {
+        for (const char* trigger : {
+                 "CREATE TRIGGER IF NOT EXISTS subscribers_fts_insert AFTER INSERT ON subscribers BEGIN "
+                 "INSERT INTO subscribers_fts (rowid, name, phone, manager) VALUES (new.id, new.name, new.phone, ''); END",
+                 "CREATE TRIGGER IF NOT EXISTS subscribers_fts_update AFTER UPDATE OF name, phone ON subscribers BEGIN "
+                 "UPDATE subscribers_fts SET name = new.name, phone = new.phone WHERE rowid = new.id; END",
+                 "CREATE TRIGGER IF NOT EXISTS subscribers_fts_delete AFTER DELETE ON subscribers BEGIN "
+                 "DELETE FROM subscribers_fts WHERE rowid = old.id; END",
+                 "CREATE TRIGGER IF NOT EXISTS vip_subscribers_fts_insert AFTER INSERT ON vip_subscribers BEGIN "
+                 "UPDATE subscribers_fts SET manager = new.manager WHERE rowid = new.subscriber_id; END",
+                 "CREATE TRIGGER IF NOT EXISTS vip_subscribers_fts_update AFTER UPDATE OF manager ON vip_subscribers BEGIN "
+                 "UPDATE subscribers_fts SET manager = new.manager WHERE rowid = new.subscriber_id; END",
+                 "CREATE TRIGGER IF NOT EXISTS vip_subscribers_fts_delete AFTER DELETE ON vip_subscribers BEGIN "
+                 "UPDATE subscribers_fts SET manager = '' WHERE rowid = old.subscriber_id; END"}) {
+            fullText = fullText && execTimed(query, ATC_SQL_METRIC("subscribers_fts.trigger"), trigger);
+        }
+    }
+    if (!fullText) {
+        qCWarning(lcData).noquote() << "Полнотекстовый поиск недоступен (FTS5):" << query.lastError().text();
+    }
+    fullTextReady = fullText;
+
+    // Построчные триггеры ревизии прежних версий: теперь ее увеличивает commitTimed
+    for (const char* table : {"tariffs", "subscribers", "vip_subscribers", "calls"}) {
+        for (const char* event : {"insert", "update", "delete"}) {
+            execTimed(query, ATC_SQL_METRIC("db_revision.drop_trigger"),
+                      QString("DROP TRIGGER IF EXISTS %1_%2_revision").arg(table, event));
         }
     }
 }
 
-const std::vector<Call>& DataManager::getCalls() const {
-    return calls;
+void DataManager::loadFromDatabase() {
+    ATC_TIMED_OPERATION(timer, "loadFromDatabase");
+    adoptTables(readTables());
+    saveLoyaltyTiers();
+    timer.addRows(currentTariffs()->tariffs().size() + subscriberStore.count(SubscriberKind::Regular) +
+                  subscriberStore.count(SubscriberKind::Vip) + callStore.count());
 }
 
+QString DataManager::snapshotPath() const {
+    return Snapshot::pathFor(dbPath);
+}
 
-double DataManager::calculateClientTotalCost(const std::string& clientName) const {
-    double total = 0.0;
-    for (const auto& call : calls) {
-        if (call.getCallerName() == clientName) {
-            total += call.getCost();
-        }
+bool DataManager::readRevision(qint64* revision) const {
+    QSqlQuery query(database());
+    const bool ok = execTimed(query, ATC_SQL_METRIC("db_revision.select"), "SELECT revision FROM db_revision") &&
+                    query.next();
+    if (ok) {
+        *revision = query.value(0).toLongLong();
     }
-    return total;
+    query.finish();
+    return ok;
 }
 
-int DataManager::getClientCallCount(const std::string& clientName) const {
-    int count = 0;
-    for (const auto& call : calls) {
-        if (call.getCallerName() == clientName) {
-            count++;
+LoadedTables DataManager::readTables(const ProgressCallback& progress,
+                                     const ReferenceTablesCallback& referenceLoaded) const {
+    ATC_TIMED_OPERATION(timer, "readTables");
+    LoadedTables tables;
+    const QString path = snapshotPath();
+
+    // Одна читающая транзакция: ревизия и таблицы берутся из одного состояния БД (WAL)
+    QSqlDatabase db = database();
+    db.transaction();
+    std::vector<TariffPrefix> prefixes;
+    std::vector<TariffVersion> versions;
+    {
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        readTariffPrefixes(query, &prefixes);
+        readTariffVersions(query, &versions);
+    }
+    qint64 revision = 0;
+    const bool hasRevision = !path.isEmpty() && readRevision(&revision);
+    if (hasRevision) {
+        QString reason;
+        if (Snapshot::read(path, revision, &tables, &reason)) {
+            db.commit();
+            tables.tariffPrefixes = std::move(prefixes);
+            tables.tariffVersions = std::move(versions);
+            tables.tariffSet = std::make_shared<const TariffSet>(tables.tariffs, tables.tariffPrefixes,
+                                                                 tables.tariffVersions);
+            if (progress) progress(1, 1);
+            timer.addRows(tables.tariffs.size() + tables.subscribers.count(SubscriberKind::Regular) +
+                          tables.subscribers.count(SubscriberKind::Vip) + tables.calls.count());
+            return tables;
         }
+        qCInfo(lcData).noquote() << "Снимок данных не используется:" << reason;
     }
-    return count;
-}
 
-double DataManager::calculateTotalRevenue() const {
-    double total = 0.0;
-    for (const auto& call : calls) {
-        total += call.getCost();
+    tables.tariffPrefixes = std::move(prefixes);
+    tables.tariffVersions = std::move(versions);
+    const bool complete = readTablesFromSql(&tables, progress, referenceLoaded);
+    db.commit();
+    if (!complete) {
+        return LoadedTables();
     }
-    return total;
-}
 
-void DataManager::sortTariffsByPrice(bool ascending) {
-    if (ascending) {
-        std::sort(tariffs.begin(), tariffs.end(),
-                  [](const Tariff& a, const Tariff& b) { return a.getPricePerMinute() < b.getPricePerMinute(); });
-    } else {
-        std::sort(tariffs.begin(), tariffs.end(),
-                  [](const Tariff& a, const Tariff& b) { return a.getPricePerMinute() > b.getPricePerMinute(); });
+    tables.tariffSet = std::make_shared<const TariffSet>(tables.tariffs, tables.tariffPrefixes, tables.tariffVersions);
+
+    // Уровни лояльности пересчитываются и записываются до снимка: запись после
+    // загрузки увеличила бы ревизию, и снимок устарел бы сразу. Ревизия снимка -
+    // следующая за прочитанной, только если между ними не писал никто другой
+    bool snapshotValid = hasRevision;
+    const int settled = settleLoyaltyTiers(&tables);
+    if (snapshotValid && settled != 0) {
+        qint64 settledRevision = 0;
+        snapshotValid = settled > 0 && readRevision(&settledRevision) && settledRevision == revision + 1;
+        revision = settledRevision;
     }
-}
 
-void DataManager::sortClientsByName(bool ascending) {
-    if (ascending) {
-        std::sort(clients.begin(), clients.end(),
-                  [](const Client& a, const Client& b) { return a.getName() < b.getName(); });
-    } else {
-        std::sort(clients.begin(), clients.end(),
-                  [](const Client& a, const Client& b) { return a.getName() > b.getName(); });
+    // Следующий запуск при той же ревизии возьмет данные из снимка
+    if (snapshotValid) {
+        QString reason;
+        if (!Snapshot::write(path, revision, tables, &reason)) {
+            qCWarning(lcData).noquote() << "Снимок данных не записан:" << reason;
+        }
     }
+    timer.addRows(tables.tariffs.size() + tables.subscribers.count(SubscriberKind::Regular) +
+                  tables.subscribers.count(SubscriberKind::Vip) + tables.calls.count());
+    return tables;
 }
 
-void DataManager::sortVIPClientsByDiscount(bool ascending) {
-    if (ascending) {
-        std::sort(vipClients.begin(), vipClients.end(),
-                  [](const VIPClient& a, const VIPClient& b) { return a.getDiscount() < b.getDiscount(); });
-    } else {
-        std::sort(vipClients.begin(), vipClients.end(),
-                  [](const VIPClient& a, const VIPClient& b) { return a.getDiscount() > b.getDiscount(); });
+bool DataManager::readTablesFromSql(LoadedTables* out, const ProgressCallback& progress,
+                                    const ReferenceTablesCallback& referenceLoaded) const {
+    ATC_TIMED_OPERATION(timer, "readTablesFromSql");
+    LoadedTables& tables = *out;
+    const qint64 stages = 4;
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+
+    // Сначала размеры таблиц: векторы и арены хранилищ выделяются один раз,
+    // а не растут по push_back. Колонки читаются по индексу, без поиска по имени.
+    qint64 rows = 0;
+    qint64 textBytes = 0;
+
+    // Загрузка Тарифов
+    measureTable(query, ATC_SQL_METRIC("tariffs.count"), "SELECT COUNT(*) FROM tariffs WHERE active = 1",
+                 &rows, &textBytes);
+    tables.tariffs.reserve(static_cast<std::size_t>(rows));
+    if (execTimed(query, ATC_SQL_METRIC("tariffs.select"),
+                  "SELECT city, price, fee FROM tariffs WHERE active = 1 ORDER BY id")) {
+        while (query.next()) {
+            tables.tariffs.push_back(Tariff(query.value(0).toString().toStdString(),
+                                            query.value(1).toDouble(),
+                                            query.value(2).toDouble()));
+        }
+    }
+    query.finish();
+    if (progress && !progress(1, stages)) return false;
+
+    // Загрузка Клиентов и VIP Клиентов
+    qint64 clientRows = 0;
+    qint64 clientBytes = 0;
+    measureTable(query, ATC_SQL_METRIC("subscribers.count"),
+                 "SELECT COUNT(*), TOTAL(LENGTH(CAST(name AS BLOB)) + LENGTH(CAST(phone AS BLOB))) FROM subscribers "
+                 "WHERE id NOT IN (SELECT subscriber_id FROM vip_subscribers)",
+                 &clientRows, &clientBytes);
+    measureTable(query, ATC_SQL_METRIC("vip_subscribers.count"),
+                 "SELECT COUNT(*), TOTAL(LENGTH(CAST(s.name AS BLOB)) + LENGTH(CAST(s.phone AS BLOB)) "
+                 "+ LENGTH(CAST(v.manager AS BLOB))) FROM vip_subscribers v JOIN subscribers s ON s.id = v.subscriber_id",
+                 &rows, &textBytes);
+    tables.subscribers.reset(static_cast<std::size_t>(clientRows), static_cast<std::size_t>(rows),
+                             static_cast<std::size_t>(clientBytes + textBytes));
+
+    // Обычный абонент - строка subscribers без расширения VIP
+    if (execTimed(query, ATC_SQL_METRIC("subscribers.select"),
+                  "SELECT s.name, s.phone, s.balance FROM subscribers s "
+                  "LEFT JOIN vip_subscribers v ON v.subscriber_id = s.id WHERE v.subscriber_id IS NULL ORDER BY s.id")) {
+        while (query.next()) {
+            const QByteArray name = query.value(0).toString().toUtf8();
+            const QByteArray phone = query.value(1).toString().toUtf8();
+            tables.subscribers.addRegular(utf8View(name), utf8View(phone), query.value(2).toDouble());
+        }
+    }
+    query.finish();
+    if (progress && !progress(2, stages)) return false;
+
+    if (execTimed(query, ATC_SQL_METRIC("vip_subscribers.select"),
+                  "SELECT s.name, s.phone, s.balance, v.discount, v.manager, v.loyalty_tier FROM vip_subscribers v "
+                  "JOIN subscribers s ON s.id = v.subscriber_id ORDER BY s.id")) {
+        while (query.next()) {
+            const QByteArray name = query.value(0).toString().toUtf8();
+            const QByteArray phone = query.value(1).toString().toUtf8();
+            const QByteArray manager = query.value(4).toString().toUtf8();
+            const int tier = std::clamp(query.value(5).toInt(), 0, LoyaltyEngine::TierCount - 1);
+            tables.subscribers.addVip(utf8View(name), utf8View(phone), query.value(2).toDouble(),
+                                      query.value(3).toDouble(), utf8View(manager), static_cast<std::uint8_t>(tier));
+        }
+    }
+    query.finish();
+    if (progress && !progress(3, stages)) return false;
+
+    // Звонков на порядки больше: справочные таблицы отдаем раньше, чтобы ими уже
+    // можно было пользоваться (копия - эти же данные нужны для снимка)
+    if (referenceLoaded) {
+        LoadedTables reference;
+        reference.tariffs = tables.tariffs;
+        reference.tariffPrefixes = tables.tariffPrefixes;
+        reference.subscribers = tables.subscribers.clone();
+        reference.callsLoaded = false;
+        referenceLoaded(std::move(reference));
+    }
+
+    // Загрузка Звонков: в строке только ссылки, имена берутся из словарей
+    // абонентов и направлений (с выключенными тарифами), прочитанных один раз
+    const std::unordered_map<qint64, QByteArray> callerNames =
+        readNameDictionary(query, ATC_SQL_METRIC("subscribers.select_names"), "SELECT id, name FROM subscribers");
+    const std::unordered_map<qint64, QByteArray> destinationNames =
+        readNameDictionary(query, ATC_SQL_METRIC("tariffs.select_names"), "SELECT id, city FROM tariffs");
+    const QByteArray unknown;
+    auto nameOf = [&unknown](const std::unordered_map<qint64, QByteArray>& names, qint64 id) -> const QByteArray& {
+        const auto it = names.find(id);
+        return it != names.end() ? it->second : unknown;
+    };
+    measureTable(query, ATC_SQL_METRIC("calls.count"), "SELECT COUNT(*) FROM calls", &rows, &textBytes);
+    tables.calls.reset(static_cast<std::size_t>(rows));
+    if (execTimed(query, ATC_SQL_METRIC("calls.select"),
+                  "SELECT id, client_id, tariff_id, duration, cost, started_at FROM calls")) {
+        while (query.next()) {
+            tables.calls.add(query.value(0).toLongLong(), utf8View(nameOf(callerNames, query.value(1).toLongLong())),
+                             utf8View(nameOf(destinationNames, query.value(2).toLongLong())),
+                             query.value(3).toInt(), query.value(4).toDouble(), query.value(5).toLongLong());
+        }
     }
+    query.finish();
+    if (progress) progress(stages, stages);
+
+    timer.addRows(tables.tariffs.size() + tables.subscribers.count(SubscriberKind::Regular) +
+                  tables.subscribers.count(SubscriberKind::Vip) + tables.calls.count());
+    return true;
 }
 
-void DataManager::sortCallsByDuration(bool ascending) {
-    if (ascending) {
-        std::sort(calls.begin(), calls.end(),
-                  [](const Call& a, const Call& b) { return a.getDuration() < b.getDuration(); });
+void DataManager::adoptTables(LoadedTables&& tables) {
+    if (!tables.tariffSet) {
+        tables.tariffSet = std::make_shared<const TariffSet>(std::move(tables.tariffs), std::move(tables.tariffPrefixes),
+                                                             std::move(tables.tariffVersions));
+    }
+    publishTariffs(std::move(tables.tariffSet));
+    // Прежние арены освобождаются целиком при замене хранилищ
+    subscriberStore = std::move(tables.subscribers);
+    callStore = std::move(tables.calls);
+    subscriberIndex = std::move(tables.subscriberIndex);
+    touchData(true);
+    if (tables.callsLoaded) {
+        rebuildLoyalty();
     } else {
-        std::sort(calls.begin(), calls.end(),
-                  [](const Call& a, const Call& b) { return a.getDuration() > b.getDuration(); });
+        loyalty.clear();
     }
 }
 
+void DataManager::rebuildLoyalty() {
+    ATC_TIMED_OPERATION(timer, "rebuildLoyalty");
+    loyalty.clear();
+    timer.addRows(replayLoyalty(loyalty, subscriberStore, callStore));
+}
 
-void DataManager::clearAll() {
-    QSqlQuery query;
-    query.exec("DELETE FROM calls");
-    query.exec("DELETE FROM vip_clients");
-    query.exec("DELETE FROM clients");
-    query.exec("DELETE FROM tariffs");
+int DataManager::settleLoyaltyTiers(LoadedTables* tables) const {
+    ATC_TIMED_OPERATION(timer, "settleLoyaltyTiers");
+    LoyaltyEngine engine;
+    replayLoyalty(engine, tables->subscribers, tables->calls);
+    const LoyaltyTierUpdate update = tierUpdate(engine, tables->subscribers);
+    if (update.changes.empty()) {
+        return 0;
+    }
+    if (!writeLoyaltyTiers(update)) {
+        return -1;
+    }
+    for (const TierChange& change : update.changes) {
+        tables->subscribers.setLoyaltyTier(change.clientId, change.tier, LoyaltyEngine::tier(change.tier).discount);
+    }
+    timer.addRows(update.changes.size());
+    return static_cast<int>(update.changes.size());
+}
+
+void DataManager::recordLoyalty(const Call& call) {
+    const std::uint32_t nameId = subscriberStore.textId(call.getCallerName());
+    if (nameId != StringPool::NotFound) {
+        loyalty.record(nameId, call.getStartTime(), call.getCost());
+    }
+}
+
+void DataManager::unrecordLoyalty(const CallRecord& record) {
+    if (loyalty.clientCount() == 0) {
+        return;
+    }
+    const std::uint32_t nameId = subscriberStore.textId(callStore.text(record.callerId));
+    if (nameId != StringPool::NotFound) {
+        loyalty.unrecord(nameId, record.startTime, record.cost);
+    }
+}
+
+LoyaltyTierUpdate DataManager::pendingLoyaltyTiers() const {
+    return tierUpdate(loyalty, subscriberStore);
+}
+
+bool DataManager::writeLoyaltyTiers(const LoyaltyTierUpdate& update) const {
+    if (update.changes.empty()) {
+        return true;
+    }
+    ATC_TIMED_OPERATION(timer, "writeLoyaltyTiers");
+    QSqlDatabase db = database();
+    db.transaction();
+    CachedStatement& statement = statementCache().prepare(
+        "UPDATE vip_subscribers SET loyalty_tier = :tier, discount = :discount "
+        "WHERE subscriber_id = (SELECT id FROM subscribers WHERE name = :name)");
+    for (std::size_t i = 0; i < update.changes.size(); ++i) {
+        const TierChange& change = update.changes[i];
+        statement.query.bindValue(":tier", static_cast<int>(change.tier));
+        statement.query.bindValue(":discount", LoyaltyEngine::tier(change.tier).discount);
+        statement.query.bindValue(":name", update.names.at(static_cast<int>(i)));
+        if (!statement.exec()) {
+            const QString error = statement.query.lastError().text();
+            db.rollback();
+            setError("SQL Error (writeLoyaltyTiers): " + error);
+            return false;
+        }
+    }
+    if (!commitTimed(db)) {
+        const QString error = db.lastError().text();
+        db.rollback();
+        setError("SQL Error (writeLoyaltyTiers): " + error);
+        return false;
+    }
+    timer.addRows(update.changes.size());
+    return true;
+}
+
+void DataManager::adoptLoyaltyTiers(const LoyaltyTierUpdate& update) {
+    // Пока шла запись, таблицы могли перечитаться (импорт, восстановление) с другими
+    // id имен: отмечается только то, что по-прежнему относится к тому же абоненту
+    std::vector<TierChange> saved;
+    for (std::size_t i = 0; i < update.changes.size(); ++i) {
+        const TierChange& change = update.changes[i];
+        if (subscriberStore.textId(update.names.at(static_cast<int>(i)).toStdString()) == change.clientId) {
+            subscriberStore.setLoyaltyTier(change.clientId, change.tier, LoyaltyEngine::tier(change.tier).discount);
+            saved.push_back(change);
+        }
+    }
+    if (saved.empty()) {
+        return;
+    }
+    loyalty.markSaved(saved);
+    touchData(true);
+}
+
+bool DataManager::saveLoyaltyTiers() {
+    const LoyaltyTierUpdate update = pendingLoyaltyTiers();
+    if (!writeLoyaltyTiers(update)) {
+        return false;
+    }
+    adoptLoyaltyTiers(update);
+    return true;
+}
+
+const LoyaltyEngine& DataManager::loyaltyEngine() const {
+    return loyalty;
+}
+
+
+bool DataManager::addTariff(const Tariff& tariff) {
+    ATC_TIMED_OPERATION(timer, "addTariff");
+    // Город удаленного тарифа остается строкой tariffs (на нее ссылаются звонки) -
+    // новый тариф включает ее снова; действующий тариф не перезаписывается
+    CachedStatement& statement = statementCache().prepare(
+        "INSERT INTO tariffs (city, price, fee, active) VALUES (:city, :price, :fee, 1) "
+        "ON CONFLICT(city) DO UPDATE SET price = excluded.price, fee = excluded.fee, active = 1 "
+        "WHERE tariffs.active = 0");
+    QSqlQuery& query = statement.query;
+    query.bindValue(":city", QString::fromStdString(tariff.getCity()));
+    query.bindValue(":price", tariff.getPricePerMinute());
+    query.bindValue(":fee", tariff.getConnectionFee());
+
+    const int rows = execWrite(statement, "addTariff");
+    if (rows >= 0) {
+        if (rows == 0) {
+            setError("Тариф для города уже есть: " + QString::fromStdString(tariff.getCity()));
+            return false;
+        }
+        const std::shared_ptr<const TariffSet> current = currentTariffs();
+        std::vector<Tariff> tariffs = current->tariffs();
+        tariffs.push_back(tariff);
+        replaceTariffs(std::move(tariffs), current->prefixes());
+        return true;
+    }
+    return false;
+}
+
+void DataManager::removeTariff(int index) {
+    ATC_TIMED_OPERATION(timer, "removeTariff");
+    const std::shared_ptr<const TariffSet> current = currentTariffs();
+    if (index >= 0 && index < static_cast<int>(current->tariffs().size())) {
+        std::string city = current->at(index).getCity();
+
+        // Строка остается направлением звонков, сделанных по тарифу
+        CachedStatement& statement = statementCache().prepare("UPDATE tariffs SET active = 0 WHERE city = :city");
+        QSqlQuery& query = statement.query;
+        query.bindValue(":city", QString::fromStdString(city));
+
+        if (execWrite(statement, "removeTariff") >= 0) {
+            std::vector<Tariff> tariffs = current->tariffs();
+            tariffs.erase(tariffs.begin() + index);
+            replaceTariffs(std::move(tariffs), current->prefixes());
+        }
+    }
+}
+
+// Изменение - одна транзакция: смена города переносит строку вместе с префиксами,
+// остальное пишет UPSERT. Тариф остается на своем месте в наборе.
+bool DataManager::updateTariff(int index, const Tariff& tariff) {
+    ATC_TIMED_OPERATION(timer, "updateTariff");
+    const std::shared_ptr<const TariffSet> current = currentTariffs();
+    if (index < 0 || index >= static_cast<int>(current->tariffs().size())) {
+        setError("Тариф не найден");
+        return false;
+    }
+    const QString oldCity = QString::fromStdString(current->at(index).getCity());
+    const QString city = QString::fromStdString(tariff.getCity());
+
+    QSqlDatabase db = database();
+    db.transaction();
+    bool ok = true;
+    QString error;
+    if (city != oldCity) {
+        // Город действующего тарифа занять нельзя. Направление удаленного тарифа
+        // сливается с переименованным: его звонки переходят на строку тарифа, а
+        // сама строка удаляется вместе с версиями цен прошлого тарифа
+        CachedStatement& existing = statementCache().prepare("SELECT id, active FROM tariffs WHERE city = :city");
+        existing.query.bindValue(":city", city);
+        qlonglong mergedId = -1;
+        bool taken = false;
+        if (!existing.exec()) {
+            ok = false;
+            error = existing.query.lastError().text();
+        } else if (existing.query.next()) {
+            mergedId = existing.query.value(0).toLongLong();
+            taken = existing.query.value(1).toInt() != 0;
+        }
+        existing.query.finish();
+        if (taken) {
+            db.rollback();
+            setError("Тариф для города уже есть: " + city);
+            return false;
+        }
+        if (ok && mergedId >= 0) {
+            CachedStatement& moveCalls = statementCache().prepare(
+                "UPDATE calls SET tariff_id = (SELECT id FROM tariffs WHERE city = :old) WHERE tariff_id = :merged");
+            moveCalls.query.bindValue(":old", oldCity);
+            moveCalls.query.bindValue(":merged", mergedId);
+            CachedStatement& dropRow = statementCache().prepare("DELETE FROM tariffs WHERE id = :merged");
+            dropRow.query.bindValue(":merged", mergedId);
+            if (!moveCalls.exec()) {
+                ok = false;
+                error = moveCalls.query.lastError().text();
+            } else if (!dropRow.exec()) {
+                ok = false;
+                error = dropRow.query.lastError().text();
+            }
+        }
+    }
+    if (ok && city != oldCity) {
+        // Звонки ссылаются на строку и получают новый город
+        CachedStatement& rename = statementCache().prepare("UPDATE tariffs SET city = :city WHERE city = :old");
+        rename.query.bindValue(":city", city);
+        rename.query.bindValue(":old", oldCity);
+        CachedStatement& prefixes = statementCache().prepare("UPDATE tariff_prefixes SET city = :city WHERE city = :old");
+        prefixes.query.bindValue(":city", city);
+        prefixes.query.bindValue(":old", oldCity);
+        if (!rename.exec()) {
+            ok = false;
+            error = rename.query.lastError().text();
+        } else if (!prefixes.exec()) {
+            ok = false;
+            error = prefixes.query.lastError().text();
+        }
+    }
+    if (ok) {
+        CachedStatement& upsert = statementCache().prepare(
+            "INSERT INTO tariffs (city, price, fee) VALUES (:city, :price, :fee) "
+            "ON CONFLICT(city) DO UPDATE SET price = excluded.price, fee = excluded.fee");
+        upsert.query.bindValue(":city", city);
+        upsert.query.bindValue(":price", tariff.getPricePerMinute());
+        upsert.query.bindValue(":fee", tariff.getConnectionFee());
+        if (!upsert.exec()) {
+            ok = false;
+            error = upsert.query.lastError().text();
+        }
+    }
+    if (ok && !commitTimed(db)) {
+        ok = false;
+        error = db.lastError().text();
+    }
+    if (!ok) {
+        db.rollback();
+        setError("SQL Error (updateTariff): " + error);
+        return false;
+    }
+
+    std::vector<Tariff> tariffs = current->tariffs();
+    std::vector<TariffPrefix> prefixes = current->prefixes();
+    tariffs[static_cast<std::size_t>(index)] = tariff;
+    if (city != oldCity) {
+        const std::string from = oldCity.toStdString();
+        for (TariffPrefix& entry : prefixes) {
+            if (entry.city == from) {
+                entry.city = tariff.getCity();
+            }
+        }
+        callStore.renameDestination(from, tariff.getCity());
+    }
+    replaceTariffs(std::move(tariffs), std::move(prefixes));
+    return true;
+}
+
+const std::vector<Tariff>& DataManager::getTariffs() const {
+    return currentTariffs()->tariffs();
+}
+
+const Tariff* DataManager::findTariffByCity(const std::string& city) const {
+    ATC_TIMED_OPERATION(timer, "findTariffByCity");
+    return currentTariffs()->findByCity(city);
+}
+
+bool DataManager::addTariffPrefix(const std::string& prefix, const std::string& city) {
+    ATC_TIMED_OPERATION(timer, "addTariffPrefix");
+    const std::string digits = RoutingTable::normalizeNumber(prefix);
+    if (digits.empty()) {
+        setError("Префикс должен состоять из цифр номера (не больше 15): " + QString::fromStdString(prefix));
+        return false;
+    }
+    if (!findTariffByCity(city)) {
+        setError("Тариф не найден: " + QString::fromStdString(city));
+        return false;
+    }
+
+    CachedStatement& statement = statementCache().prepare(
+        "INSERT OR REPLACE INTO tariff_prefixes (prefix, city) VALUES (:prefix, :city)");
+    statement.query.bindValue(":prefix", QString::fromStdString(digits));
+    statement.query.bindValue(":city", QString::fromStdString(city));
+    if (execWrite(statement, "addTariffPrefix") < 0) {
+        return false;
+    }
+
+    const std::shared_ptr<const TariffSet> current = currentTariffs();
+    std::vector<TariffPrefix> prefixes = current->prefixes();
+    auto it = std::find_if(prefixes.begin(), prefixes.end(),
+                           [&digits](const TariffPrefix& entry) { return entry.prefix == digits; });
+    if (it != prefixes.end()) {
+        it->city = city;
+    } else {
+        prefixes.push_back({digits, city});
+    }
+    replaceTariffs(current->tariffs(), std::move(prefixes));
+    return true;
+}
+
+bool DataManager::removeTariffPrefix(const std::string& prefix) {
+    ATC_TIMED_OPERATION(timer, "removeTariffPrefix");
+    const std::string digits = RoutingTable::normalizeNumber(prefix);
+    CachedStatement& statement = statementCache().prepare("DELETE FROM tariff_prefixes WHERE prefix = :prefix");
+    statement.query.bindValue(":prefix", QString::fromStdString(digits));
+    if (execWrite(statement, "removeTariffPrefix") < 0) {
+        return false;
+    }
+    const std::shared_ptr<const TariffSet> current = currentTariffs();
+    std::vector<TariffPrefix> prefixes = current->prefixes();
+    prefixes.erase(std::remove_if(prefixes.begin(), prefixes.end(),
+                                  [&digits](const TariffPrefix& entry) { return entry.prefix == digits; }),
+                   prefixes.end());
+    replaceTariffs(current->tariffs(), std::move(prefixes));
+    return true;
+}
+
+const std::vector<TariffPrefix>& DataManager::getTariffPrefixes() const {
+    return currentTariffs()->prefixes();
+}
+
+const Tariff* DataManager::findTariffByNumber(const std::string& number) const {
+    ATC_TIMED_OPERATION(timer, "findTariffByNumber");
+    return currentTariffs()->findByNumber(RoutingTable::normalizeNumber(number));
+}
+
+std::shared_ptr<const TariffSet> DataManager::currentTariffs() const {
+    return std::atomic_load(&publishedTariffs);
+}
+
+void DataManager::publishTariffs(std::shared_ptr<const TariffSet> tariffs) {
+    ATC_TIMED_OPERATION(timer, "publishTariffs");
+    timer.addRows(tariffs->tariffs().size() + tariffs->prefixes().size());
+    // Прежний набор освобождается, когда его отпустит последний пакет тарификации
+    std::atomic_store(&publishedTariffs, std::shared_ptr<const TariffSet>(std::move(tariffs)));
+}
+
+void DataManager::replaceTariffs(std::vector<Tariff> tariffs, std::vector<TariffPrefix> prefixes) {
+    // Версии цен после правки записали триггеры: перечитываются целиком
+    std::vector<TariffVersion> versions;
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    readTariffVersions(query, &versions);
+    publishTariffs(std::make_shared<const TariffSet>(std::move(tariffs), std::move(prefixes), std::move(versions)));
+    touchData();
+}
+
+std::shared_ptr<const TariffSet> DataManager::readTariffSet() const {
+    ATC_TIMED_OPERATION(timer, "readTariffSet");
+    QSqlDatabase db = database();
+    db.transaction();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    std::vector<Tariff> tariffs;
+    if (!execTimed(query, ATC_SQL_METRIC("tariffs.select"),
+                   "SELECT city, price, fee FROM tariffs WHERE active = 1 ORDER BY id")) {
+        setError("SQL Error (readTariffSet): " + query.lastError().text());
+        db.rollback();
+        return nullptr;
+    }
+    while (query.next()) {
+        tariffs.push_back(Tariff(query.value(0).toString().toStdString(),
+                                 query.value(1).toDouble(),
+                                 query.value(2).toDouble()));
+    }
+    query.finish();
+    std::vector<TariffPrefix> prefixes;
+    readTariffPrefixes(query, &prefixes);
+    std::vector<TariffVersion> versions;
+    readTariffVersions(query, &versions);
+    db.commit();
+    timer.addRows(tariffs.size() + prefixes.size() + versions.size());
+    // Из БД берется как есть: ее уже приняли CRUD, а висячие префиксы ни к чему не ведут
+    return std::make_shared<const TariffSet>(std::move(tariffs), std::move(prefixes), std::move(versions));
+}
+
+std::shared_ptr<const TariffSet> DataManager::readTariffFile(const QString& filePath) const {
+    ATC_TIMED_OPERATION(timer, "readTariffFile");
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        setError("Не удалось открыть файл тарифов: " + file.errorString());
+        return nullptr;
+    }
+    QTextStream in(&file);
+    in.setEncoding(QStringConverter::Utf8);
+
+    std::vector<Tariff> tariffs;
+    std::vector<TariffPrefix> prefixes;
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        ++lineNumber;
+        if (line.trimmed().isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        // Остальные записи экспорта (клиенты, звонки) к тарифам не относятся
+        const QStringList fields = parseCsvLine(line);
+        const QString kind = fields[0].trimmed();
+        bool ok1 = true, ok2 = true;
+        if (kind == "tariff" && fields.size() >= 4) {
+            double price = parseCsvNumber(fields[2], &ok1);
+            double fee = parseCsvNumber(fields[3], &ok2);
+            tariffs.push_back(Tariff(fields[1].trimmed().toStdString(), price, fee));
+        } else if (kind == "prefix" && fields.size() >= 3) {
+            // Нецифровой префикс станет пустым и не пройдет проверку
+            prefixes.push_back({RoutingTable::normalizeNumber(fields[1].toStdString()),
+                                fields[2].trimmed().toStdString()});
+        } else if (kind == "tariff" || kind == "prefix") {
+            ok1 = false;
+        }
+        if (!ok1 || !ok2) {
+            setError(QString("Файл тарифов, строка %1: запись не разобрана").arg(lineNumber));
+            return nullptr;
+        }
+    }
+
+    // Набор публикуется целиком или не публикуется вовсе
+    std::string reason;
+    if (!TariffSet::validate(tariffs, prefixes, &reason)) {
+        setError("Файл тарифов отклонен: " + QString::fromStdString(reason));
+        return nullptr;
+    }
+    timer.addRows(tariffs.size() + prefixes.size());
+    return std::make_shared<const TariffSet>(std::move(tariffs), std::move(prefixes));
+}
+
+bool DataManager::writeTariffSet(const TariffSet& tariffs) const {
+    ATC_TIMED_OPERATION(timer, "writeTariffSet");
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        setError("SQL Error (writeTariffSet): " + db.lastError().text());
+        return false;
+    }
+    QSqlQuery query(db);
+    // Строки тарифов не удаляются (на них ссылаются звонки): все выключаются,
+    // тарифы из набора включаются снова с новыми ценами
+    bool ok = execTimed(query, ATC_SQL_METRIC("tariff_prefixes.delete_all"), "DELETE FROM tariff_prefixes") &&
+              execTimed(query, ATC_SQL_METRIC("tariffs.deactivate_all"), "UPDATE tariffs SET active = 0");
+    QString error = query.lastError().text();
+    if (ok) {
+        CachedStatement& insertTariff = statementCache().prepare(
+            "INSERT INTO tariffs (city, price, fee, active) VALUES (:city, :price, :fee, 1) "
+            "ON CONFLICT(city) DO UPDATE SET price = excluded.price, fee = excluded.fee, active = 1");
+        for (const Tariff& tariff : tariffs.tariffs()) {
+            insertTariff.query.bindValue(":city", QString::fromStdString(tariff.getCity()));
+            insertTariff.query.bindValue(":price", tariff.getPricePerMinute());
+            insertTariff.query.bindValue(":fee", tariff.getConnectionFee());
+            if (!insertTariff.exec()) {
+                ok = false;
+                error = insertTariff.query.lastError().text();
+                break;
+            }
+        }
+    }
+    if (ok) {
+        CachedStatement& insertPrefix = statementCache().prepare(
+            "INSERT INTO tariff_prefixes (prefix, city) VALUES (:prefix, :city)");
+        for (const TariffPrefix& entry : tariffs.prefixes()) {
+            insertPrefix.query.bindValue(":prefix", QString::fromStdString(entry.prefix));
+            insertPrefix.query.bindValue(":city", QString::fromStdString(entry.city));
+            if (!insertPrefix.exec()) {
+                ok = false;
+                error = insertPrefix.query.lastError().text();
+                break;
+            }
+        }
+    }
+    if (ok && !commitTimed(db)) {
+        ok = false;
+        error = db.lastError().text();
+    }
+    if (!ok) {
+        db.rollback();
+        setError("SQL Error (writeTariffSet): " + error);
+        return false;
+    }
+    timer.addRows(tariffs.tariffs().size() + tariffs.prefixes().size());
+    return true;
+}
+
+std::vector<TariffVersion> DataManager::tariffVersions(const std::string& city) const {
+    ATC_TIMED_OPERATION(timer, "tariffVersions");
+    std::vector<TariffVersion> versions;
+    CachedStatement& statement = statementCache().prepare(
+        "SELECT v.price, v.fee, v.effective_from, v.effective_to FROM tariff_versions v "
+        "JOIN tariffs t ON t.id = v.tariff_id WHERE t.city = :city ORDER BY v.effective_from");
+    statement.query.bindValue(":city", QString::fromStdString(city));
+    if (!statement.exec()) {
+        setError("SQL Error (tariffVersions): " + statement.query.lastError().text());
+        return versions;
+    }
+    while (statement.query.next()) {
+        versions.push_back({Tariff(city, statement.query.value(0).toDouble(), statement.query.value(1).toDouble()),
+                            statement.query.value(2).toLongLong(),
+                            statement.query.value(3).isNull() ? TariffVersion::OpenEnded
+                                                              : statement.query.value(3).toLongLong()});
+    }
+    statement.query.finish();
+    timer.addRows(versions.size());
+    return versions;
+}
+
+
+bool DataManager::addClient(const Client& client) {
+    ATC_TIMED_OPERATION(timer, "addClient");
+    CachedStatement& statement = statementCache().prepare("INSERT INTO subscribers (name, phone, balance) VALUES (:name, :phone, :balance)");
+    QSqlQuery& query = statement.query;
+    query.bindValue(":name", QString::fromStdString(client.getName()));
+    query.bindValue(":phone", QString::fromStdString(client.getPhoneNumber()));
+    query.bindValue(":balance", client.getBalance());
+
+    if (execWrite(statement, "addClient") >= 0) {
+        subscriberStore.add(client);
+        if (subscriberIndex) {
+            subscriberIndex->add(subscriberStore, subscriberStore.at(SubscriberKind::Regular, clientCount() - 1));
+        }
+        touchData(true);
+        return true;
+    }
+    return false;
+}
+
+void DataManager::removeClient(int index) {
+    ATC_TIMED_OPERATION(timer, "removeClient");
+    if (index >= 0 && index < clientCount()) {
+        const std::uint32_t nameId = subscriberStore.at(SubscriberKind::Regular, index).nameId;
+        std::string name(subscriberStore.text(nameId));
+
+        // Абонента со звонками не даст удалить внешний ключ calls.client_id
+        CachedStatement& statement = statementCache().prepare(
+            "DELETE FROM subscribers WHERE name = :name AND id NOT IN (SELECT subscriber_id FROM vip_subscribers)");
+        QSqlQuery& query = statement.query;
+        query.bindValue(":name", QString::fromStdString(name));
+
+        if (execWrite(statement, "removeClient") >= 0) {
+            subscriberStore.remove(SubscriberKind::Regular, index);
+            if (subscriberIndex) {
+                subscriberIndex->remove(nameId, SubscriberKind::Regular);
+            }
+            touchData(true);
+        }
+    }
+}
+
+// Одна транзакция: смена имени переносит строку, остальное пишет UPSERT.
+// Запись в памяти заменяется на месте, без сдвига списка.
+bool DataManager::updateClient(int index, const Client& client) {
+    ATC_TIMED_OPERATION(timer, "updateClient");
+    if (index < 0 || index >= clientCount()) {
+        setError("Клиент не найден");
+        return false;
+    }
+    const SubscriberRecord previous = subscriberStore.at(SubscriberKind::Regular, index);
+    const QString oldName = toQString(subscriberStore.text(previous.nameId));
+    const QString name = QString::fromStdString(client.getName());
+
+    QSqlDatabase db = database();
+    db.transaction();
+    bool ok = true;
+    QString error;
+    if (name != oldName) {
+        // Звонки ссылаются на строку по id и получают новое имя вместе с ней
+        CachedStatement& rename = statementCache().prepare("UPDATE subscribers SET name = :name WHERE name = :old");
+        rename.query.bindValue(":name", name);
+        rename.query.bindValue(":old", oldName);
+        if (!rename.exec()) {
+            ok = false;
+            error = rename.query.lastError().text();
+        }
+    }
+    if (ok) {
+        CachedStatement& upsert = statementCache().prepare(
+            "INSERT INTO subscribers (name, phone, balance) VALUES (:name, :phone, :balance) "
+            "ON CONFLICT(name) DO UPDATE SET phone = excluded.phone, balance = excluded.balance");
+        upsert.query.bindValue(":name", name);
+        upsert.query.bindValue(":phone", QString::fromStdString(client.getPhoneNumber()));
+        upsert.query.bindValue(":balance", client.getBalance());
+        if (!upsert.exec()) {
+            ok = false;
+            error = upsert.query.lastError().text();
+        }
+    }
+    if (ok && !commitTimed(db)) {
+        ok = false;
+        error = db.lastError().text();
+    }
+    if (!ok) {
+        db.rollback();
+        setError("SQL Error (updateClient): " + error);
+        return false;
+    }
+
+    subscriberStore.update(index, client);
+    if (name != oldName) {
+        callStore.renameCaller(oldName.toStdString(), client.getName());
+    }
+    const SubscriberRecord& updated = subscriberStore.at(SubscriberKind::Regular, index);
+    // Индекс автодополнения хранит имя и номер; баланс его не касается
+    if (subscriberIndex && (updated.nameId != previous.nameId || updated.phoneId != previous.phoneId)) {
+        subscriberIndex->remove(previous.nameId, SubscriberKind::Regular);
+        subscriberIndex->add(subscriberStore, updated);
+    }
+    touchData(true);
+    return true;
+}
+
+int DataManager::clientCount() const {
+    return subscriberStore.count(SubscriberKind::Regular);
+}
+
+Client DataManager::clientAt(int index) const {
+    return subscriberStore.clientAt(index);
+}
+
+bool DataManager::clientExists(const std::string& name) const {
+    ATC_TIMED_OPERATION(timer, "clientExists");
+    return subscriberStore.find(name) != nullptr;
+}
+
+
+bool DataManager::addVIPClient(const VIPClient& client) {
+    ATC_TIMED_OPERATION(timer, "addVIPClient");
+    // Строка абонента и расширение VIP - одной транзакцией
+    QSqlDatabase db = database();
+    db.transaction();
+    CachedStatement& subscriber = statementCache().prepare(
+        "INSERT INTO subscribers (name, phone, balance) VALUES (:name, :phone, :balance)");
+    subscriber.query.bindValue(":name", QString::fromStdString(client.getName()));
+    subscriber.query.bindValue(":phone", QString::fromStdString(client.getPhoneNumber()));
+    subscriber.query.bindValue(":balance", client.getBalance());
+    CachedStatement& statement = statementCache().prepare(
+        "INSERT INTO vip_subscribers (subscriber_id, discount, manager) "
+        "SELECT id, :discount, :manager FROM subscribers WHERE name = :name");
+    QSqlQuery& query = statement.query;
+    query.bindValue(":name", QString::fromStdString(client.getName()));
+    // Новый VIP-клиент - нулевой уровень; скидку дальше меняет только settle/saveLoyaltyTiers
+    query.bindValue(":discount", LoyaltyEngine::tier(0).discount);
+    query.bindValue(":manager", QString::fromStdString(client.getPersonalManager()));
+
+    if (!subscriber.exec()) {
+        db.rollback();
+        setError("SQL Error (addVIPClient): " + subscriber.query.lastError().text());
+        return false;
+    }
+    if (statement.exec() && commitTimed(db)) {
+        subscriberStore.add(client);
+        const SubscriberRecord& added = subscriberStore.at(SubscriberKind::Vip, vipClientCount() - 1);
+        if (subscriberIndex) {
+            subscriberIndex->add(subscriberStore, added);
+        }
+        loyalty.track(added.nameId, added.tier);
+        touchData(true);
+        return true;
+    }
+    db.rollback();
+    setError("SQL Error (addVIPClient): " + query.lastError().text());
+    return false;
+}
+
+void DataManager::removeVIPClient(int index) {
+    ATC_TIMED_OPERATION(timer, "removeVIPClient");
+    if (index >= 0 && index < vipClientCount()) {
+        const std::uint32_t nameId = subscriberStore.at(SubscriberKind::Vip, index).nameId;
+        std::string name(subscriberStore.text(nameId));
+
+        // Расширение vip_subscribers удаляется каскадом
+        CachedStatement& statement = statementCache().prepare(
+            "DELETE FROM subscribers WHERE name = :name AND id IN (SELECT subscriber_id FROM vip_subscribers)");
+        QSqlQuery& query = statement.query;
+        query.bindValue(":name", QString::fromStdString(name));
+
+        if (execWrite(statement, "removeVIPClient") >= 0) {
+            subscriberStore.remove(SubscriberKind::Vip, index);
+            if (subscriberIndex) {
+                subscriberIndex->remove(nameId, SubscriberKind::Vip);
+            }
+            loyalty.forget(nameId);
+            touchData(true);
+        }
+    }
+}
+
+bool DataManager::updateVIPClient(int index, const VIPClient& client) {
+    ATC_TIMED_OPERATION(timer, "updateVIPClient");
+    if (index < 0 || index >= vipClientCount()) {
+        setError("VIP-клиент не найден");
+        return false;
+    }
+    const SubscriberRecord previous = subscriberStore.at(SubscriberKind::Vip, index);
+    const QString oldName = toQString(subscriberStore.text(previous.nameId));
+    const QString name = QString::fromStdString(client.getName());
+
+    QSqlDatabase db = database();
+    db.transaction();
+    bool ok = true;
+    QString error;
+    if (name != oldName) {
+        CachedStatement& rename = statementCache().prepare("UPDATE subscribers SET name = :name WHERE name = :old");
+        rename.query.bindValue(":name", name);
+        rename.query.bindValue(":old", oldName);
+        if (!rename.exec()) {
+            ok = false;
+            error = rename.query.lastError().text();
+        }
+    }
+    if (ok) {
+        CachedStatement& upsert = statementCache().prepare(
+            "INSERT INTO subscribers (name, phone, balance) VALUES (:name, :phone, :balance) "
+            "ON CONFLICT(name) DO UPDATE SET phone = excluded.phone, balance = excluded.balance");
+        upsert.query.bindValue(":name", name);
+        upsert.query.bindValue(":phone", QString::fromStdString(client.getPhoneNumber()));
+        upsert.query.bindValue(":balance", client.getBalance());
+        CachedStatement& vip = statementCache().prepare(
+            "INSERT INTO vip_subscribers (subscriber_id, discount, manager) "
+            "SELECT id, :discount, :manager FROM subscribers WHERE name = :name "
+            "ON CONFLICT(subscriber_id) DO UPDATE SET discount = excluded.discount, manager = excluded.manager");
+        vip.query.bindValue(":name", name);
+        // Скидка следует уровню лояльности, а не полю формы
+        vip.query.bindValue(":discount", LoyaltyEngine::tier(previous.tier).discount);
+        vip.query.bindValue(":manager", QString::fromStdString(client.getPersonalManager()));
+        if (!upsert.exec()) {
+            ok = false;
+            error = upsert.query.lastError().text();
+        } else if (!vip.exec()) {
+            ok = false;
+            error = vip.query.lastError().text();
+        }
+    }
+    if (ok && !commitTimed(db)) {
+        ok = false;
+        error = db.lastError().text();
+    }
+    if (!ok) {
+        db.rollback();
+        setError("SQL Error (updateVIPClient): " + error);
+        return false;
+    }
+
+    subscriberStore.update(index, client);
+    if (name != oldName) {
+        callStore.renameCaller(oldName.toStdString(), client.getName());
+    }
+    const SubscriberRecord& updated = subscriberStore.at(SubscriberKind::Vip, index);
+    if (subscriberIndex && (updated.nameId != previous.nameId || updated.phoneId != previous.phoneId)) {
+        subscriberIndex->remove(previous.nameId, SubscriberKind::Vip);
+        subscriberIndex->add(subscriberStore, updated);
+    }
+    loyalty.rename(previous.nameId, updated.nameId);
+    touchData(true);
+    return true;
+}
+
+int DataManager::vipClientCount() const {
+    return subscriberStore.count(SubscriberKind::Vip);
+}
+
+VIPClient DataManager::vipClientAt(int index) const {
+    return subscriberStore.vipClientAt(index);
+}
+
+const SubscriberRecord* DataManager::findSubscriber(const std::string& name) const {
+    ATC_TIMED_OPERATION(timer, "findSubscriber");
+    return subscriberStore.find(name);
+}
+
+const SubscriberStore& DataManager::subscribers() const {
+    return subscriberStore;
+}
+
+const SubscriberIndex& DataManager::searchIndex() const {
+    if (!subscriberIndex) {
+        subscriberIndex = std::make_shared<SubscriberIndex>();
+        subscriberIndex->build(subscriberStore);
+    }
+    return *subscriberIndex;
+}
+
+void DataManager::touchData(bool subscribers) {
+    ++dataVersion;
+    if (subscribers) {
+        subscriberCopy.reset();
+    }
+}
+
+std::shared_ptr<const DataSnapshot> DataManager::snapshot() const {
+    std::shared_ptr<const DataSnapshot> current = lastSnapshot.lock();
+    const std::shared_ptr<const TariffSet> tariffs = currentTariffs();
+    // Перезагрузка тарифов не меняет dataVersion, поэтому набор сверяется отдельно
+    if (current && current->version == dataVersion && current->tariffs == tariffs) {
+        return current;
+    }
+    ATC_TIMED_OPERATION(timer, "snapshot");
+    if (!subscriberCopy) {
+        // Абоненты меняются редко: копия живет до их следующего изменения
+        subscriberCopy = std::make_shared<const SubscriberStore>(subscriberStore.clone());
+    }
+    auto next = std::make_shared<DataSnapshot>();
+    next->version = dataVersion;
+    next->tariffs = tariffs;
+    next->subscribers = subscriberCopy;
+    // Только указатели на блоки: звонки не копируются
+    next->calls = callStore;
+    timer.addRows(callStore.count());
+    lastSnapshot = next;
+    return next;
+}
+
+std::vector<SubscriberMatch> DataManager::searchSubscribers(const QString& prefix, int limit) const {
+    ATC_TIMED_OPERATION(timer, "searchSubscribers");
+    const std::vector<SubscriberMatch> matches =
+        searchIndex().find(SubscriberIndex::searchKey(prefix.toStdString()), static_cast<std::size_t>(limit));
+    timer.addRows(matches.size());
+    return matches;
+}
+
+QString DataManager::fullTextQuery(const QString& text) {
+    // Каждое слово - фраза в кавычках: знаки оператора (+, -, *) ищутся как текст
+    QStringList phrases;
+    for (QString word : text.split(' ', Qt::SkipEmptyParts)) {
+        if (word.size() >= 3) {
+            phrases << "\"" + word.replace(QString("\""), QString("\"\"")) + "\"";
+        }
+    }
+    return phrases.join(' ');
+}
+
+bool DataManager::hasFullTextSearch() const {
+    return fullTextReady;
+}
+
+std::vector<SubscriberHit> DataManager::searchSubscribersFullText(const QString& text, int limit) const {
+    ATC_TIMED_OPERATION(timer, "searchSubscribersFullText");
+    std::vector<SubscriberHit> hits;
+    const QString match = fullTextQuery(text);
+    if (match.isEmpty() || !fullTextReady) {
+        return hits;
+    }
+    // Вес совпадений: имя 10, номер 5, менеджер 1. Ранжируются все совпадения:
+    // ORDER BY rank с LIMIT FTS5 выполняет сам, храня только лучшие limit строк.
+    // Фамилия, совпавшая с ~200 тыс. из 1 млн абонентов, - ~0.35 с (поиск в окне
+    // запускается с задержкой после ввода)
+    CachedStatement& statement = statementCache().prepare(
+        "SELECT name, phone, manager, rowid IN (SELECT subscriber_id FROM vip_subscribers) AS vip "
+        "FROM subscribers_fts WHERE subscribers_fts MATCH :match AND rank MATCH 'bm25(10.0, 5.0, 1.0)' "
+        "ORDER BY rank LIMIT :limit");
+    statement.query.bindValue(":match", match);
+    statement.query.bindValue(":limit", limit);
+    if (!statement.exec()) {
+        setError("SQL Error (searchSubscribersFullText): " + statement.query.lastError().text());
+        return hits;
+    }
+    while (statement.query.next()) {
+        hits.push_back({statement.query.value(0).toString().toStdString(),
+                        statement.query.value(1).toString().toStdString(),
+                        statement.query.value(2).toString().toStdString(),
+                        statement.query.value(3).toBool() ? SubscriberKind::Vip : SubscriberKind::Regular});
+    }
+    statement.query.finish();
+    timer.addRows(hits.size());
+    return hits;
+}
+
+
+bool DataManager::addCall(const Call& call) {
+    ATC_TIMED_OPERATION(timer, "addCall");
+    // Проверка целостности данных: клиент должен существовать
+    if (!clientExists(call.getCallerName())) {
+        setError("Клиент не найден в базе данных: " + QString::fromStdString(call.getCallerName()));
+        return false;
+    }
+    const qint64 hash = cdrHash(call);
+    if (isDuplicateCdr(hash)) {
+        setError("Такой звонок уже записан");
+        return false;
+    }
+    // Строка направления без тарифа и сам звонок - одной транзакцией, как в writeCallBatch
+    QSqlDatabase db = database();
+    db.transaction();
+    const qint64 destination = destinationId(call.getDestination());
+    if (destination < 0) {
+        db.rollback();
+        return false;
+    }
+
+    CachedStatement& statement = statementCache().prepare("INSERT OR IGNORE INTO calls "
+                  "(client_id, tariff_id, duration, cost, started_at, cdr_hash) "
+                  "SELECT id, :dest, :dur, :cost, :started, :hash FROM subscribers WHERE name = :name "
+                  "AND NOT EXISTS (SELECT 1 FROM archived_cdr_hashes WHERE cdr_hash = :archived)");
+    QSqlQuery& query = statement.query;
+    query.bindValue(":name", QString::fromStdString(call.getCallerName()));
+    query.bindValue(":dest", destination);
+    query.bindValue(":dur", call.getDuration());
+    query.bindValue(":cost", call.getCost());
+    query.bindValue(":started", static_cast<qlonglong>(call.getStartTime()));
+    query.bindValue(":hash", cdrHashValue(hash));
+    query.bindValue(":archived", cdrHashValue(hash));
+
+    if (!statement.exec()) {
+        setError("SQL Error (addCall): " + query.lastError().text());
+        db.rollback();
+        return false;
+    }
+    // Строку мог успеть записать другой процесс: уникальный индекс ее не пропустил
+    if (query.numRowsAffected() == 0) {
+        db.rollback();
+        setError("Такой звонок уже записан");
+        return false;
+    }
+    const qint64 id = query.lastInsertId().toLongLong();
+    if (!commitTimed(db)) {
+        setError("SQL Error (addCall): " + db.lastError().text());
+        db.rollback();
+        return false;
+    }
+    rememberCdr(hash);
+    callStore.add(call, id);
+    touchData();
+    recordLoyalty(call);
+    saveLoyaltyTiers();
+    return true;
+}
+
+void DataManager::removeCall(int index) {
+    ATC_TIMED_OPERATION(timer, "removeCall");
+    if (index >= 0 && index < callStore.count()) {
+        // Удаляем по id строки: одинаковые звонки больше не удаляются вместе
+        CachedStatement& statement = statementCache().prepare("DELETE FROM calls WHERE id = :id");
+        statement.query.bindValue(":id", static_cast<qlonglong>(callStore.at(index).id));
+
+        if (execWrite(statement, "removeCall") >= 0) {
+            unrecordLoyalty(callStore.at(index));
+            callStore.remove(index);
+            touchData();
+            saveLoyaltyTiers();
+        }
+    }
+}
+
+bool CallFilter::isEmpty() const {
+    return callerName.empty() && destination.empty() && startedFrom == 0 && startedBefore == 0 &&
+           minDuration == 0 && maxDuration == 0;
+}
+
+bool DataManager::stageBulkIds(const std::vector<qint64>& ids, QString* error) const {
+    QSqlQuery query(database());
+    if (!execTimed(query, ATC_SQL_METRIC("bulk_ids.create"),
+                   "CREATE TEMP TABLE IF NOT EXISTS bulk_ids (id INTEGER PRIMARY KEY)") ||
+        !execTimed(query, ATC_SQL_METRIC("bulk_ids.clear"), "DELETE FROM temp.bulk_ids")) {
+        *error = query.lastError().text();
+        return false;
+    }
+    CachedStatement& insert = statementCache().prepare("INSERT OR IGNORE INTO temp.bulk_ids (id) VALUES (:id)");
+    for (qint64 id : ids) {
+        insert.query.bindValue(":id", static_cast<qlonglong>(id));
+        if (!insert.exec()) {
+            *error = insert.query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DataManager::stageBulkNames(const QStringList& names, QString* error) const {
+    QSqlQuery query(database());
+    if (!execTimed(query, ATC_SQL_METRIC("bulk_names.create"),
+                   "CREATE TEMP TABLE IF NOT EXISTS bulk_names (name TEXT PRIMARY KEY)") ||
+        !execTimed(query, ATC_SQL_METRIC("bulk_names.clear"), "DELETE FROM temp.bulk_names")) {
+        *error = query.lastError().text();
+        return false;
+    }
+    CachedStatement& insert = statementCache().prepare("INSERT OR IGNORE INTO temp.bulk_names (name) VALUES (:name)");
+    for (const QString& name : names) {
+        insert.query.bindValue(":name", name);
+        if (!insert.exec()) {
+            *error = insert.query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+int DataManager::removeCalls(const std::vector<int>& indices) {
+    ATC_TIMED_OPERATION(timer, "removeCalls");
+    std::vector<qint64> ids;
+    ids.reserve(indices.size());
+    for (int index : indices) {
+        if (index >= 0 && index < callStore.count()) {
+            ids.push_back(callStore.at(index).id);
+        }
+    }
+    if (ids.empty()) {
+        return 0;
+    }
+
+    QSqlDatabase db = database();
+    db.transaction();
+    QString error;
+    int removed = -1;
+    if (stageBulkIds(ids, &error)) {
+        QSqlQuery query(db);
+        if (execTimed(query, ATC_SQL_METRIC("calls.delete_bulk"),
+                      "DELETE FROM calls WHERE id IN (SELECT id FROM temp.bulk_ids)")) {
+            removed = query.numRowsAffected();
+        } else {
+            error = query.lastError().text();
+        }
+    }
+    if (removed >= 0 && !commitTimed(db)) {
+        removed = -1;
+        error = db.lastError().text();
+    }
+    if (removed < 0) {
+        db.rollback();
+        setError("SQL Error (removeCalls): " + error);
+        return -1;
+    }
+
+    std::sort(ids.begin(), ids.end());
+    callStore.removeIf([this, &ids](const CallRecord& record) {
+        if (!std::binary_search(ids.begin(), ids.end(), static_cast<qint64>(record.id))) {
+            return false;
+        }
+        unrecordLoyalty(record);
+        return true;
+    });
+    touchData();
+    saveLoyaltyTiers();
+    timer.addRows(static_cast<std::uint64_t>(removed));
+    return removed;
+}
+
+int DataManager::removeCallsWhere(const CallFilter& filter) {
+    ATC_TIMED_OPERATION(timer, "removeCallsWhere");
+    if (filter.isEmpty()) {
+        setError("Не задано условие удаления звонков");
+        return -1;
+    }
+    // Одно и то же условие - в SQL и для звонков в памяти
+    QStringList conditions;
+    if (!filter.callerName.empty()) conditions << "client_id = (SELECT id FROM subscribers WHERE name = :caller)";
+    if (!filter.destination.empty()) conditions << "tariff_id = (SELECT id FROM tariffs WHERE city = :dest)";
+    if (filter.startedFrom > 0) conditions << "started_at >= :from";
+    if (filter.startedBefore > 0) conditions << "started_at < :before";
+    if (filter.minDuration > 0) conditions << "duration >= :min";
+    if (filter.maxDuration > 0) conditions << "duration <= :max";
+    CachedStatement& statement = statementCache().prepare("DELETE FROM calls WHERE " + conditions.join(" AND "));
+    if (!filter.callerName.empty()) statement.query.bindValue(":caller", QString::fromStdString(filter.callerName));
+    if (!filter.destination.empty()) statement.query.bindValue(":dest", QString::fromStdString(filter.destination));
+    if (filter.startedFrom > 0) statement.query.bindValue(":from", static_cast<qlonglong>(filter.startedFrom));
+    if (filter.startedBefore > 0) statement.query.bindValue(":before", static_cast<qlonglong>(filter.startedBefore));
+    if (filter.minDuration > 0) statement.query.bindValue(":min", filter.minDuration);
+    if (filter.maxDuration > 0) statement.query.bindValue(":max", filter.maxDuration);
+
+    QSqlDatabase db = database();
+    db.transaction();
+    // Число строк - до фиксации: commitTimed выполняет свой UPDATE ревизии
+    const bool deleted = statement.exec();
+    const int removed = deleted ? statement.query.numRowsAffected() : -1;
+    if (!deleted || !commitTimed(db)) {
+        const QString error = statement.query.lastError().isValid() ? statement.query.lastError().text()
+                                                                    : db.lastError().text();
+        db.rollback();
+        setError("SQL Error (removeCallsWhere): " + error);
+        return -1;
+    }
+
+    // Имени нет в пуле звонков - в памяти таких звонков нет
+    const std::uint32_t callerId = filter.callerName.empty() ? 0 : callStore.textId(filter.callerName);
+    const std::uint32_t destinationId = filter.destination.empty() ? 0 : callStore.textId(filter.destination);
+    if (callerId != StringPool::NotFound && destinationId != StringPool::NotFound) {
+        callStore.removeIf([this, &filter, callerId, destinationId](const CallRecord& record) {
+            const bool matches = (filter.callerName.empty() || record.callerId == callerId) &&
+                                 (filter.destination.empty() || record.destinationId == destinationId) &&
+                                 (filter.startedFrom <= 0 || record.startTime >= filter.startedFrom) &&
+                                 (filter.startedBefore <= 0 || record.startTime < filter.startedBefore) &&
+                                 (filter.minDuration <= 0 || record.duration >= filter.minDuration) &&
+                                 (filter.maxDuration <= 0 || record.duration <= filter.maxDuration);
+            if (matches) {
+                unrecordLoyalty(record);
+            }
+            return matches;
+        });
+    }
+    touchData();
+    saveLoyaltyTiers();
+    timer.addRows(static_cast<std::uint64_t>(removed));
+    return removed;
+}
+
+int DataManager::removeSubscribers(SubscriberKind kind, const std::vector<int>& indices, bool withCalls,
+                                   int* removedCalls) {
+    ATC_TIMED_OPERATION(timer, "removeSubscribers");
+    std::vector<int> rows;
+    for (int index : indices) {
+        if (index >= 0 && index < subscriberStore.count(kind)) {
+            rows.push_back(index);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (removedCalls) {
+        *removedCalls = 0;
+    }
+    if (rows.empty()) {
+        return 0;
+    }
+    QStringList names;
+    std::vector<std::uint32_t> nameIds;
+    for (int row : rows) {
+        const std::uint32_t nameId = subscriberStore.at(kind, row).nameId;
+        names << toQString(subscriberStore.text(nameId));
+        nameIds.push_back(nameId);
+    }
+
+    QSqlDatabase db = database();
+    db.transaction();
+    QString error;
+    int removed = -1;
+    int callsRemoved = 0;
+    if (stageBulkNames(names, &error)) {
+        QSqlQuery query(db);
+        const bool vip = kind == SubscriberKind::Vip;
+        // Звонки - раньше абонентов: на строку абонента ссылается внешний ключ
+        // calls.client_id, и без withCalls абонент со звонками не удаляется
+        bool ok = true;
+        if (withCalls) {
+            ok = execTimed(query, ATC_SQL_METRIC("calls.delete_by_client"),
+                           "DELETE FROM calls WHERE client_id IN "
+                           "(SELECT id FROM subscribers WHERE name IN (SELECT name FROM temp.bulk_names))");
+            callsRemoved = ok ? query.numRowsAffected() : 0;
+        } else if (execTimed(query, ATC_SQL_METRIC("calls.count_by_client"),
+                             "SELECT EXISTS (SELECT 1 FROM calls WHERE client_id IN "
+                             "(SELECT id FROM subscribers WHERE name IN (SELECT name FROM temp.bulk_names)))") &&
+                   query.next() && query.value(0).toBool()) {
+            query.finish();
+            ok = false;
+            error = "у абонентов есть звонки, удалите их вместе с абонентами";
+        }
+        if (ok && !execTimed(query, vip ? ATC_SQL_METRIC("vip_subscribers.delete_bulk")
+                                        : ATC_SQL_METRIC("subscribers.delete_bulk"),
+                             vip ? "DELETE FROM subscribers WHERE name IN (SELECT name FROM temp.bulk_names) "
+                                   "AND id IN (SELECT subscriber_id FROM vip_subscribers)"
+                                 : "DELETE FROM subscribers WHERE name IN (SELECT name FROM temp.bulk_names) "
+                                   "AND id NOT IN (SELECT subscriber_id FROM vip_subscribers)")) {
+            ok = false;
+        }
+        if (ok) {
+            removed = query.numRowsAffected();
+        } else if (error.isEmpty()) {
+            error = query.lastError().text();
+        }
+    }
+    if (removed >= 0 && !commitTimed(db)) {
+        removed = -1;
+        error = db.lastError().text();
+    }
+    if (removed < 0) {
+        db.rollback();
+        setError("SQL Error (removeSubscribers): " + error);
+        return -1;
+    }
+
+    if (withCalls) {
+        // Имена в пуле звонков - свои id
+        std::vector<std::uint32_t> callerIds;
+        for (const QString& name : names) {
+            const std::uint32_t id = callStore.textId(name.toStdString());
+            if (id != StringPool::NotFound) {
+                callerIds.push_back(id);
+            }
+        }
+        std::sort(callerIds.begin(), callerIds.end());
+        if (!callerIds.empty()) {
+            callStore.removeIf([&callerIds](const CallRecord& record) {
+                return std::binary_search(callerIds.begin(), callerIds.end(), record.callerId);
+            });
+        }
+    }
+    subscriberStore.remove(kind, rows);
+    if (subscriberIndex) {
+        std::sort(nameIds.begin(), nameIds.end());
+        subscriberIndex->remove(nameIds, kind);
+    }
+    if (kind == SubscriberKind::Vip) {
+        for (std::uint32_t nameId : nameIds) {
+            loyalty.forget(nameId);
+        }
+    }
+    touchData(true);
+    if (removedCalls) {
+        *removedCalls = callsRemoved;
+    }
+    timer.addRows(static_cast<std::uint64_t>(removed + callsRemoved));
+    return removed;
+}
+
+int DataManager::callCount() const {
+    return callStore.count();
+}
+
+Call DataManager::callAt(int index) const {
+    return callStore.callAt(index);
+}
+
+const CallStore& DataManager::calls() const {
+    return callStore;
+}
+
+qint64 DataManager::destinationId(const std::string& city, std::unordered_map<std::string, qint64>* cache) const {
+    if (cache) {
+        const auto it = cache->find(city);
+        if (it != cache->end()) {
+            return it->second;
+        }
+    }
+    const QString name = QString::fromStdString(city);
+    CachedStatement& select = statementCache().prepare("SELECT id FROM tariffs WHERE city = :city");
+    select.query.bindValue(":city", name);
+    qint64 id = -1;
+    if (select.exec() && select.query.next()) {
+        id = select.query.value(0).toLongLong();
+    }
+    select.query.finish();
+    if (id < 0) {
+        // Направление без тарифа - выключенная строка, чтобы на нее можно было сослаться
+        CachedStatement& insert = statementCache().prepare(
+            "INSERT INTO tariffs (city, price, fee, active) VALUES (:city, 0, 0, 0)");
+        insert.query.bindValue(":city", name);
+        if (!insert.exec()) {
+            setError("SQL Error (destinationId): " + insert.query.lastError().text());
+            return -1;
+        }
+        id = insert.query.lastInsertId().toLongLong();
+    }
+    if (cache) {
+        cache->emplace(city, id);
+    }
+    return id;
+}
+
+int DataManager::writeCalls(const std::vector<Call>& batch, std::vector<qint64>* insertedIds,
+                            const ProgressCallback& progress, int* duplicates) const {
+    return writeCallBatch(batch, nullptr, insertedIds, progress, duplicates);
+}
+
+int DataManager::writeCalls(const std::vector<Call>& batch, const std::vector<CdrCheckpoint>& checkpoints,
+                            std::vector<qint64>* insertedIds, int* duplicates) const {
+    return writeCallBatch(batch, &checkpoints, insertedIds, ProgressCallback(), duplicates);
+}
+
+int DataManager::writeCallBatch(const std::vector<Call>& batch, const std::vector<CdrCheckpoint>* checkpoints,
+                                std::vector<qint64>* insertedIds, const ProgressCallback& progress,
+                                int* duplicates) const {
+    ATC_TIMED_OPERATION(timer, "writeCalls");
+    // Существование клиентов проверяет вызывающий поток (по данным в памяти)
+    QSqlDatabase db = database();
+    db.transaction();
+    // Тот же текст, что в addCall. OR IGNORE - на случай, если тот же CDR
+    // записал другой процесс и фильтр о нем еще не знает
+    CachedStatement& statement = statementCache().prepare("INSERT OR IGNORE INTO calls "
+                  "(client_id, tariff_id, duration, cost, started_at, cdr_hash) "
+                  "SELECT id, :dest, :dur, :cost, :started, :hash FROM subscribers WHERE name = :name "
+                  "AND NOT EXISTS (SELECT 1 FROM archived_cdr_hashes WHERE cdr_hash = :archived)");
+    QSqlQuery& query = statement.query;
+    // Направлений в пакете единицы - id строки tariffs ищется один раз на каждое
+    std::unordered_map<std::string, qint64> destinations;
+
+    const qint64 total = static_cast<qint64>(batch.size());
+    int dropped = 0;
+    if (insertedIds) {
+        insertedIds->clear();
+        insertedIds->reserve(batch.size());
+    }
+    for (qint64 i = 0; i < total; ++i) {
+        const Call& call = batch[static_cast<size_t>(i)];
+        const qint64 hash = cdrHash(call);
+        // Повторы внутри пакета тоже находятся: свои незафиксированные строки видны
+        if (isDuplicateCdr(hash)) {
+            ++dropped;
+            if (insertedIds) {
+                insertedIds->push_back(0);
+            }
+            continue;
+        }
+        const qint64 destination = destinationId(call.getDestination(), &destinations);
+        if (destination < 0) {
+            db.rollback();
+            return -1;
+        }
+        query.bindValue(":name", QString::fromStdString(call.getCallerName()));
+        query.bindValue(":dest", destination);
+        query.bindValue(":dur", call.getDuration());
+        query.bindValue(":cost", call.getCost());
+        query.bindValue(":started", static_cast<qlonglong>(call.getStartTime()));
+        query.bindValue(":hash", cdrHashValue(hash));
+        query.bindValue(":archived", cdrHashValue(hash));
+        if (!statement.exec()) {
+            setError("SQL Error (writeCalls): " + query.lastError().text());
+            db.rollback();
+            return -1;
+        }
+        const bool inserted = query.numRowsAffected() > 0;
+        if (inserted) {
+            rememberCdr(hash);
+        } else {
+            ++dropped;
+        }
+        if (insertedIds) {
+            insertedIds->push_back(inserted ? query.lastInsertId().toLongLong() : 0);
+        }
+        if (progress && (i + 1) % 1000 == 0 && !progress(i + 1, total)) {
+            db.rollback();
+            return -1;
+        }
+    }
+
+    if (checkpoints) {
+        CachedStatement& checkpoint = statementCache().prepare(
+            "INSERT OR REPLACE INTO cdr_checkpoints (source, offset, fingerprint) VALUES (:source, :offset, :fingerprint)");
+        for (const CdrCheckpoint& entry : *checkpoints) {
+            checkpoint.query.bindValue(":source", entry.source);
+            checkpoint.query.bindValue(":offset", entry.offset);
+            checkpoint.query.bindValue(":fingerprint", entry.fingerprint);
+            if (!checkpoint.exec()) {
+                setError("SQL Error (writeCalls): " + checkpoint.query.lastError().text());
+                db.rollback();
+                return -1;
+            }
+        }
+    }
+
+    if (!commitTimed(db)) {
+        setError("SQL Error (writeCalls): " + db.lastError().text());
+        db.rollback();
+        return -1;
+    }
+    if (progress) progress(total, total);
+    if (dropped > 0) {
+        qCInfo(lcData) << "Запись звонков: отброшено дубликатов:" << dropped;
+    }
+    if (duplicates) {
+        *duplicates = dropped;
+    }
+    timer.addRows(batch.size());
+    return static_cast<int>(total) - dropped;
+}
+
+std::vector<CdrCheckpoint> DataManager::readCdrCheckpoints() const {
+    std::vector<CdrCheckpoint> checkpoints;
+    QSqlQuery query(database());
+    if (execTimed(query, ATC_SQL_METRIC("cdr_checkpoints.select"),
+                  "SELECT source, offset, fingerprint FROM cdr_checkpoints")) {
+        while (query.next()) {
+            checkpoints.push_back({query.value(0).toString(), query.value(1).toLongLong(), query.value(2).toLongLong()});
+        }
+    }
+    query.finish();
+    return checkpoints;
+}
+
+void DataManager::adoptCalls(const std::vector<Call>& batch, const std::vector<qint64>& ids) {
+    for (std::size_t i = 0; i < batch.size() && i < ids.size(); ++i) {
+        // 0 - дубликат, в БД не записан
+        if (ids[i] != 0) {
+            callStore.add(batch[i], ids[i]);
+            recordLoyalty(batch[i]);
+        }
+    }
+    touchData();
+}
+
+bool DataManager::isDuplicateCdr(qint64 hash) const {
+    if (hash == 0) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&cdrMutex);
+        // Переполненный фильтр почти всегда отвечает "возможно": строим заново по индексу
+        if (!cdrFilterReady || cdrFilter.size() > cdrFilter.capacity()) {
+            rebuildCdrFilter();
+        }
+        if (!cdrFilter.mayContain(hash)) {
+            return false;
+        }
+    }
+    CachedStatement& statement = statementCache().prepare(
+        "SELECT 1 FROM calls WHERE cdr_hash = :hash "
+        "UNION ALL SELECT 1 FROM archived_cdr_hashes WHERE cdr_hash = :archived");
+    statement.query.bindValue(":hash", static_cast<qlonglong>(hash));
+    statement.query.bindValue(":archived", static_cast<qlonglong>(hash));
+    const bool found = statement.exec() && statement.query.next();
+    statement.query.finish();
+    return found;
+}
+
+void DataManager::rememberCdr(qint64 hash) const {
+    QMutexLocker locker(&cdrMutex);
+    if (hash != 0 && cdrFilterReady) {
+        cdrFilter.add(static_cast<quint64>(hash));
+    }
+}
+
+// Вызывается под cdrMutex. Читаются только индекс calls_cdr_hash и ключи архива
+void DataManager::rebuildCdrFilter() const {
+    ATC_TIMED_OPERATION(timer, "rebuildCdrFilter");
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    qint64 keys = 0;
+    if (execTimed(query, ATC_SQL_METRIC("calls.count_cdr_hash"),
+                  "SELECT (SELECT COUNT(*) FROM calls WHERE cdr_hash IS NOT NULL) + "
+                  "(SELECT COUNT(*) FROM archived_cdr_hashes)") && query.next()) {
+        keys = query.value(0).toLongLong();
+    }
+    query.finish();
+
+    // Запас вдвое: до следующей перестройки таблица может вырасти в два раза
+    cdrFilter.reset(static_cast<std::size_t>(keys) * 2 + 65536);
+    if (execTimed(query, ATC_SQL_METRIC("calls.select_cdr_hash"),
+                  "SELECT cdr_hash FROM calls WHERE cdr_hash IS NOT NULL "
+                  "UNION ALL SELECT cdr_hash FROM archived_cdr_hashes")) {
+        while (query.next()) {
+            cdrFilter.add(static_cast<quint64>(query.value(0).toLongLong()));
+        }
+    }
+    query.finish();
+    cdrFilterReady = true;
+    timer.addRows(cdrFilter.size());
+}
+
+void DataManager::invalidateCdrFilter() const {
+    QMutexLocker locker(&cdrMutex);
+    cdrFilterReady = false;
+}
+
+
+double DataManager::calculateCallCost(const std::string& callerName, const std::string& destination,
+                                      int duration, qint64 startTime) const {
+    ATC_TIMED_OPERATION(timer, "calculateCallCost");
+    const Tariff* tariff = currentTariffs()->findByCity(destination, startTime);
+    if (!tariff) {
+        return -1.0;
+    }
+    return callCost(*tariff, subscriberStore.find(callerName), duration);
+}
+
+std::vector<Call> DataManager::rateDialedCalls(const std::vector<DialedCall>& batch, RatingStats* stats,
+                                               std::vector<std::size_t>* origins) const {
+    ATC_TIMED_OPERATION(timer, "rateDialedCalls");
+    // Весь пакет - по одной версии тарифов, даже если тем временем опубликована новая
+    const std::shared_ptr<const TariffSet> tariffs = currentTariffs();
+    // Маршруты всего пакета ищутся одним проходом по отсортированным номерам
+    std::vector<std::string> dialed;
+    dialed.reserve(batch.size());
+    for (const DialedCall& call : batch) {
+        dialed.push_back(RoutingTable::normalizeNumber(call.dialedNumber));
+    }
+    const std::vector<std::string_view> numbers(dialed.begin(), dialed.end());
+    std::vector<int> targets;
+    tariffs->routes().route(numbers, &targets);
+
+    const SubscriberIndex& index = searchIndex();
+    RatingStats counts;
+    std::vector<Call> rated;
+    rated.reserve(batch.size());
+    if (origins) {
+        origins->clear();
+    }
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        const DialedCall& call = batch[i];
+        SubscriberMatch match;
+        if (call.duration <= 0) {
+            ++counts.invalid;
+        } else if (!index.findPhone(RoutingTable::normalizeNumber(call.callerNumber), &match)) {
+            ++counts.unknownCaller;
+        } else if (targets[i] < 0) {
+            ++counts.unrouted;
+        } else {
+            // Поздний CDR тарифицируется по ценам на момент звонка, а не приема
+            const Tariff& tariff = tariffs->at(targets[i], call.startTime);
+            const std::string_view name = subscriberStore.text(match.nameId);
+            rated.emplace_back(std::string(name), tariff.getCity(), call.duration,
+                               callCost(tariff, subscriberStore.find(name), call.duration), call.startTime);
+            if (origins) {
+                origins->push_back(i);
+            }
+        }
+    }
+    counts.rated = static_cast<int>(rated.size());
+    if (stats) {
+        *stats = counts;
+    }
+    timer.addRows(batch.size());
+    return rated;
+}
+
+int DataManager::rerateCalls() {
+    ATC_TIMED_OPERATION(timer, "rerateCalls");
+    struct StoredCall {
+        qlonglong id;
+        std::string caller;
+        std::string destination;
+        int duration;
+        double cost;
+        qint64 startTime;
+    };
+
+    // Сначала читаем все звонки, чтобы не обновлять таблицу под открытым курсором
+    std::vector<StoredCall> stored;
+    QSqlQuery select(database());
+    if (!execTimed(select, ATC_SQL_METRIC("calls.select_for_rate"),
+                   "SELECT c.id, s.name, t.city, c.duration, c.cost, c.started_at FROM calls c "
+                   "JOIN subscribers s ON s.id = c.client_id JOIN tariffs t ON t.id = c.tariff_id")) {
+        setError("SQL Error (rerateCalls): " + select.lastError().text());
+        return -1;
+    }
+    while (select.next()) {
+        stored.push_back({select.value(0).toLongLong(),
+                          select.value(1).toString().toStdString(),
+                          select.value(2).toString().toStdString(),
+                          select.value(3).toInt(),
+                          select.value(4).toDouble(),
+                          select.value(5).toLongLong()});
+    }
+    select.finish();
+
+    QSqlDatabase db = database();
+    db.transaction();
+    CachedStatement& update = statementCache().prepare("UPDATE calls SET cost = :cost WHERE id = :id");
+
+    // Все звонки - по одному набору тарифов, каждый - по ценам на момент звонка
+    const std::shared_ptr<const TariffSet> tariffs = currentTariffs();
+    int changed = 0;
+    for (const auto& call : stored) {
+        // Тариф направления удален - оставляем прежнюю стоимость
+        const Tariff* tariff = tariffs->findByCity(call.destination, call.startTime);
+        if (!tariff) {
+            continue;
+        }
+        const double cost = callCost(*tariff, subscriberStore.find(call.caller), call.duration);
+        if (std::fabs(cost - call.cost) < 1e-9) {
+            continue;
+        }
+        update.query.bindValue(":cost", cost);
+        update.query.bindValue(":id", call.id);
+        if (!update.exec()) {
+            setError("SQL Error (rerateCalls): " + update.query.lastError().text());
+            db.rollback();
+            return -1;
+        }
+        ++changed;
+    }
+
+    if (!commitTimed(db)) {
+        setError("SQL Error (rerateCalls): " + db.lastError().text());
+        db.rollback();
+        return -1;
+    }
+
+    timer.addRows(static_cast<std::uint64_t>(changed));
+    loadFromDatabase();
+    return changed;
+}
+
+
+std::vector<ClientUsage> DataManager::clientUsageInRange(qlonglong fromId, qlonglong toId) const {
+    std::vector<ClientUsage> result;
+    CachedStatement& statement = statementCache().prepare(
+        "SELECT s.name, u.calls, u.seconds, u.cost FROM (SELECT client_id, COUNT(*) AS calls, "
+        "SUM(duration) AS seconds, SUM(cost) AS cost FROM calls WHERE id BETWEEN :from AND :to "
+        "GROUP BY client_id) u JOIN subscribers s ON s.id = u.client_id");
+    statement.query.bindValue(":from", fromId);
+    statement.query.bindValue(":to", toId);
+    if (!statement.exec()) {
+        setError("SQL Error (reportClientUsage): " + statement.query.lastError().text());
+        return result;
+    }
+    while (statement.query.next()) {
+        result.push_back({statement.query.value(0).toString().toStdString(),
+                          statement.query.value(1).toInt(),
+                          statement.query.value(2).toLongLong(),
+                          statement.query.value(3).toDouble()});
+    }
+    statement.query.finish();
+    return result;
+}
+
+std::vector<ClientUsage> DataManager::reportClientUsage() const {
+    ATC_TIMED_OPERATION(timer, "reportClientUsage");
+    QSqlDatabase db = database();
+    db.transaction();
+    std::map<std::string, ClientUsage> merged;
+    mergeUsage(merged, clientUsageInRange(0, std::numeric_limits<qlonglong>::max()));
+    const QStringList archives = archivePaths();
+    db.commit();
+    forEachArchive(archives, [&merged](const CallArchive& archive) { mergeUsage(merged, archive.clientUsage()); });
+
+    std::vector<ClientUsage> result;
+    result.reserve(merged.size());
+    for (auto& entry : merged) {
+        result.push_back(std::move(entry.second));
+    }
+    timer.addRows(result.size());
+    return result;
+}
+
+std::vector<ClientUsage> DataManager::reportClientUsageParallel(int workers) const {
+    ATC_TIMED_OPERATION(timer, "reportClientUsageParallel");
+
+    // Границы id и список архивов - из одного снимка, как в reportClientUsage
+    QSqlDatabase db = database();
+    db.transaction();
+    qlonglong minId = 0;
+    qlonglong maxId = -1;
+    CachedStatement& bounds = statementCache().prepare("SELECT MIN(id), MAX(id) FROM calls");
+    if (bounds.exec() && bounds.query.next() && !bounds.query.value(0).isNull()) {
+        minId = bounds.query.value(0).toLongLong();
+        maxId = bounds.query.value(1).toLongLong();
+    }
+    bounds.query.finish();
+    const QStringList archives = archivePaths();
+    db.commit();
+
+    if (workers <= 0) {
+        workers = reportPool.maxThreadCount();
+    }
+    const qlonglong span = maxId - minId + 1;
+    workers = static_cast<int>(std::min<qlonglong>(workers, std::max<qlonglong>(span, 0)));
+
+    // Диапазон id делится между потоками; каждый читает через свое соединение пула.
+    // Файлы архива сканируются отдельными задачами того же пула.
+    std::vector<std::vector<ClientUsage>> partial(workers + archives.size());
+    QSemaphore done;
+    for (int w = 0; w < workers; ++w) {
+        const qlonglong from = minId + span * w / workers;
+        const qlonglong to = minId + span * (w + 1) / workers - 1;
+        reportPool.start([this, from, to, w, &partial, &done]() {
+            partial[w] = clientUsageInRange(from, to);
+            done.release();
+        });
+    }
+    int slot = workers;
+    for (const QString& path : archives) {
+        reportPool.start([this, path, slot, &partial, &done]() {
+            forEachArchive({path}, [&](const CallArchive& archive) { partial[slot] = archive.clientUsage(); });
+            done.release();
+        });
+        ++slot;
+    }
+    done.acquire(static_cast<int>(partial.size()));
+
+    // Потоки читают своими соединениями уже после снимка. Если за это время
+    // archiveCallsBefore перенес звонки, часть их могла не попасть ни в calls,
+    // ни в прочитанный список архивов (по id их не отделить: звонки с
+    // неизвестным временем остаются в calls) - тогда отчет строится заново
+    // одной транзакцией
+    if (archivePaths() != archives) {
+        qCInfo(lcData) << "reportClientUsageParallel: архив изменился во время отчета, повтор в одном потоке";
+        return reportClientUsage();
+    }
+
+    std::map<std::string, ClientUsage> merged;
+    for (const auto& part : partial) {
+        mergeUsage(merged, part);
+    }
+
+    std::vector<ClientUsage> result;
+    result.reserve(merged.size());
+    for (auto& entry : merged) {
+        result.push_back(std::move(entry.second));
+    }
+    timer.addRows(result.size());
+    return result;
+}
+
+std::vector<DestinationRevenue> DataManager::reportRevenueByDestination() const {
+    ATC_TIMED_OPERATION(timer, "reportRevenueByDestination");
+    std::vector<DestinationRevenue> result;
+    QSqlDatabase db = database();
+    db.transaction();
+    CachedStatement& statement = statementCache().prepare(
+        "SELECT t.city, r.calls, r.revenue FROM (SELECT tariff_id, COUNT(*) AS calls, SUM(cost) AS revenue "
+        "FROM calls GROUP BY tariff_id) r JOIN tariffs t ON t.id = r.tariff_id ORDER BY 3 DESC");
+    if (!statement.exec()) {
+        setError("SQL Error (reportRevenueByDestination): " + statement.query.lastError().text());
+        db.rollback();
+        return result;
+    }
+    while (statement.query.next()) {
+        result.push_back({statement.query.value(0).toString().toStdString(),
+                          statement.query.value(1).toInt(),
+                          statement.query.value(2).toDouble()});
+    }
+    statement.query.finish();
+    const QStringList archives = archivePaths();
+    db.commit();
+
+    if (!archives.isEmpty()) {
+        std::map<std::string, DestinationRevenue> merged;
+        mergeRevenue(merged, result);
+        forEachArchive(archives, [&merged](const CallArchive& archive) {
+            mergeRevenue(merged, archive.revenueByDestination());
+        });
+        result.clear();
+        for (auto& entry : merged) {
+            result.push_back(std::move(entry.second));
+        }
+        std::sort(result.begin(), result.end(), [](const DestinationRevenue& a, const DestinationRevenue& b) {
+            return a.revenue > b.revenue;
+        });
+    }
+    timer.addRows(result.size());
+    return result;
+}
+
+double DataManager::reportTotalRevenue() const {
+    ATC_TIMED_OPERATION(timer, "reportTotalRevenue");
+    QSqlDatabase db = database();
+    db.transaction();
+    CachedStatement& statement = statementCache().prepare("SELECT TOTAL(cost) FROM calls");
+    double total = 0.0;
+    if (statement.exec() && statement.query.next()) {
+        total = statement.query.value(0).toDouble();
+    }
+    statement.query.finish();
+    const QStringList archives = archivePaths();
+    db.commit();
+    forEachArchive(archives, [&total](const CallArchive& archive) { total += archive.totalRevenue(); });
+    return total;
+}
+
+QString DataManager::archiveDirectory() const {
+    return dbPath + ".archive";
+}
+
+QStringList DataManager::archivePaths() const {
+    QStringList paths;
+    CachedStatement& statement = statementCache().prepare("SELECT file FROM call_archives ORDER BY first_call_id");
+    if (statement.exec()) {
+        while (statement.query.next()) {
+            paths << archiveDirectory() + "/" + statement.query.value(0).toString();
+        }
+    }
+    statement.query.finish();
+    return paths;
+}
+
+void DataManager::forEachArchive(const QStringList& paths,
+                                 const std::function<void(const CallArchive&)>& visit) const {
+    for (const QString& path : paths) {
+        CallArchive archive;
+        QString error;
+        if (!archive.open(path, &error)) {
+            // Недоступный файл архива не должен ломать отчет по оперативным данным
+            setError(error);
+            continue;
+        }
+        visit(archive);
+    }
+}
+
+qint64 DataManager::archivedCallCount() const {
+    CachedStatement& statement = statementCache().prepare("SELECT TOTAL(call_count) FROM call_archives");
+    qint64 count = 0;
+    if (statement.exec() && statement.query.next()) {
+        count = statement.query.value(0).toLongLong();
+    }
+    statement.query.finish();
+    return count;
+}
+
+int DataManager::archiveCallsBefore(qint64 cutoff) {
+    ATC_TIMED_OPERATION(timer, "archiveCallsBefore");
+    // Звонки окна лояльности должны оставаться в памяти: по ним считаются уровни VIP
+    if (cutoff > QDateTime::currentSecsSinceEpoch() - LoyaltyEngine::WindowDays * LoyaltyEngine::SecondsPerDay) {
+        setError(QString("В архив переносятся только звонки старше %1 дней (окно программы лояльности)")
+                     .arg(LoyaltyEngine::WindowDays));
+        return -1;
+    }
+    QSqlDatabase db = database();
+    QSqlQuery begin(db);
+    // IMMEDIATE: между выборкой и удалением никто не вставит и не изменит звонки
+    if (!execTimed(begin, ATC_SQL_METRIC("BEGIN IMMEDIATE"), "BEGIN IMMEDIATE")) {
+        setError("SQL Error (archiveCallsBefore): " + begin.lastError().text());
+        return -1;
+    }
+    begin.finish();
+
+    std::vector<ArchivedCall> archived;
+    CachedStatement& select = statementCache().prepare(
+        "SELECT c.id, c.started_at, s.name, t.city, c.duration, c.cost FROM calls c "
+        "JOIN subscribers s ON s.id = c.client_id JOIN tariffs t ON t.id = c.tariff_id "
+        "WHERE c.started_at > 0 AND c.started_at < :cutoff ORDER BY c.id");
+    select.query.bindValue(":cutoff", cutoff);
+    if (!select.exec()) {
+        setError("SQL Error (archiveCallsBefore): " + select.query.lastError().text());
+        db.rollback();
+        return -1;
+    }
+    while (select.query.next()) {
+        archived.push_back({select.query.value(0).toLongLong(), select.query.value(1).toLongLong(),
+                            select.query.value(2).toString().toStdString(),
+                            select.query.value(3).toString().toStdString(),
+                            select.query.value(4).toInt(), select.query.value(5).toDouble()});
+    }
+    select.query.finish();
+    if (archived.empty()) {
+        db.rollback();
+        return 0;
+    }
+
+    // Файл пишется до фиксации: если транзакция не пройдет, он просто удаляется
+    const QString fileName = QString("calls_%1_%2.cdra").arg(archived.front().id).arg(archived.back().id);
+    const QString path = archiveDirectory() + "/" + fileName;
+    QString error;
+    if (!QDir().mkpath(archiveDirectory()) || !CallArchive::write(path, archived, &error)) {
+        setError(error.isEmpty() ? "Не удалось создать каталог архива: " + archiveDirectory() : error);
+        db.rollback();
+        return -1;
+    }
+
+    CachedStatement& record = statementCache().prepare(
+        "INSERT INTO call_archives (file, first_call_id, last_call_id, call_count, cutoff) "
+        "VALUES (:file, :first, :last, :count, :cutoff)");
+    record.query.bindValue(":file", fileName);
+    record.query.bindValue(":first", static_cast<qlonglong>(archived.front().id));
+    record.query.bindValue(":last", static_cast<qlonglong>(archived.back().id));
+    record.query.bindValue(":count", static_cast<qlonglong>(archived.size()));
+    record.query.bindValue(":cutoff", cutoff);
+    // Ключи CDR остаются: фильтр их уже знает, а isDuplicateCdr найдет в таблице
+    CachedStatement& keepHashes = statementCache().prepare(
+        "INSERT OR IGNORE INTO archived_cdr_hashes (cdr_hash) SELECT cdr_hash FROM calls "
+        "WHERE started_at > 0 AND started_at < :cutoff AND cdr_hash IS NOT NULL");
+    keepHashes.query.bindValue(":cutoff", cutoff);
+    CachedStatement& remove = statementCache().prepare("DELETE FROM calls WHERE started_at > 0 AND started_at < :cutoff");
+    remove.query.bindValue(":cutoff", cutoff);
+
+    if (!record.exec() || !keepHashes.exec() || !remove.exec() || !commitTimed(db)) {
+        setError("SQL Error (archiveCallsBefore): " + db.lastError().text());
+        db.rollback();
+        QFile::remove(path);
+        return -1;
+    }
+
+    // Один проход сжатия по звонкам в памяти
+    callStore.removeStartedBefore(cutoff);
+    touchData();
+    timer.addRows(archived.size());
+    qCInfo(lcData).noquote() << "В архив перенесено звонков:" << archived.size() << "->" << path;
+    return static_cast<int>(archived.size());
+}
+
+bool DataManager::compactDatabase() {
+    ATC_TIMED_OPERATION(timer, "compactDatabase");
+    QSqlQuery query(database());
+    if (!execTimed(query, ATC_SQL_METRIC("VACUUM"), "VACUUM")) {
+        setError("SQL Error (compactDatabase): " + query.lastError().text());
+        return false;
+    }
+    return true;
+}
+
+
+bool DataManager::readCallHistory(CallHistory* history) const {
+    ATC_TIMED_OPERATION(timer, "readCallHistory");
+    history->clear();
+    QSqlDatabase db = database();
+    db.transaction();
+    // Архивы старше оперативных звонков: история складывается по возрастанию id
+    const QStringList archives = archivePaths();
+    forEachArchive(archives, [history](const CallArchive& archive) {
+        for (const auto& call : archive.readAll()) {
+            history->append(call.id, call.caller, call.destination, call.duration, call.cost, call.startTime);
+        }
+    });
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    // Как при загрузке: ссылки звонков разрешаются по словарям, прочитанным один раз
+    const std::unordered_map<qint64, QByteArray> callerNames =
+        readNameDictionary(query, ATC_SQL_METRIC("subscribers.select_names"), "SELECT id, name FROM subscribers");
+    const std::unordered_map<qint64, QByteArray> destinationNames =
+        readNameDictionary(query, ATC_SQL_METRIC("tariffs.select_names"), "SELECT id, city FROM tariffs");
+    if (!execTimed(query, ATC_SQL_METRIC("calls.select_history"),
+                   "SELECT id, client_id, tariff_id, duration, cost, started_at FROM calls ORDER BY id")) {
+        setError("SQL Error (readCallHistory): " + query.lastError().text());
+        db.rollback();
+        return false;
+    }
+    const QByteArray unknown;
+    while (query.next()) {
+        const auto caller = callerNames.find(query.value(1).toLongLong());
+        const auto destination = destinationNames.find(query.value(2).toLongLong());
+        history->append(query.value(0).toLongLong(),
+                        utf8View(caller != callerNames.end() ? caller->second : unknown),
+                        utf8View(destination != destinationNames.end() ? destination->second : unknown),
+                        query.value(3).toInt(), query.value(4).toDouble(), query.value(5).toLongLong());
+    }
+    query.finish();
+    db.commit();
+    timer.addRows(history->count());
+    return true;
+}
+
+TariffSimulation DataManager::simulateTariffs(const CallHistory& history, const SubscriberStore& subscribers,
+                                              const TariffSet& proposed, int workers) const {
+    ATC_TIMED_OPERATION(timer, "simulateTariffs");
+    // Текущий набор - один на все потоки, даже если тем временем опубликован новый
+    const std::shared_ptr<const TariffSet> current = currentTariffs();
+    TariffSimulation result = history.simulateTariffs(*current, proposed, subscribers, &reportPool, workers);
+    timer.addRows(static_cast<std::uint64_t>(result.total.callCount));
+    return result;
+}
+
+double DataManager::calculateClientTotalCost(const std::string& clientName) const {
+    ATC_TIMED_OPERATION(timer, "calculateClientTotalCost");
+    return clientCallsCost(callStore, clientName);
+}
+
+int DataManager::getClientCallCount(const std::string& clientName) const {
+    ATC_TIMED_OPERATION(timer, "getClientCallCount");
+    return clientCallsCount(callStore, clientName);
+}
+
+double DataManager::calculateTotalRevenue() const {
+    ATC_TIMED_OPERATION(timer, "calculateTotalRevenue");
+    return callsRevenue(callStore);
+}
+
+double DataSnapshot::totalRevenue() const {
+    ATC_TIMED_OPERATION(timer, "snapshot.totalRevenue");
+    return callsRevenue(calls);
+}
+
+double DataSnapshot::clientTotalCost(const std::string& clientName) const {
+    return clientCallsCost(calls, clientName);
+}
+
+int DataSnapshot::clientCallCount(const std::string& clientName) const {
+    return clientCallsCount(calls, clientName);
+}
+
+void DataManager::sortTariffsByPrice(bool ascending) {
+    ATC_TIMED_OPERATION(timer, "sortTariffsByPrice");
+    const std::shared_ptr<const TariffSet> current = currentTariffs();
+    std::vector<Tariff> tariffs = current->tariffs();
+    if (ascending) {
+        std::sort(tariffs.begin(), tariffs.end(),
+                  [](const Tariff& a, const Tariff& b) { return a.getPricePerMinute() < b.getPricePerMinute(); });
+    } else {
+        std::sort(tariffs.begin(), tariffs.end(),
+                  [](const Tariff& a, const Tariff& b) { return a.getPricePerMinute() > b.getPricePerMinute(); });
+    }
+    replaceTariffs(std::move(tariffs), current->prefixes());
+}
+
+void DataManager::sortClientsByName(bool ascending) {
+    ATC_TIMED_OPERATION(timer, "sortClientsByName");
+    subscriberStore.sortByName(SubscriberKind::Regular, ascending);
+    touchData(true);
+}
+
+void DataManager::sortVIPClientsByDiscount(bool ascending) {
+    ATC_TIMED_OPERATION(timer, "sortVIPClientsByDiscount");
+    subscriberStore.sortByDiscount(SubscriberKind::Vip, ascending);
+    touchData(true);
+}
 
-    tariffs.clear();
-    clients.clear();
-    vipClients.clear();
-    calls.clear();
+void DataManager::sortCallsByDuration(bool ascending) {
+    ATC_TIMED_OPERATION(timer, "sortCallsByDuration");
+    callStore.sortByDuration(ascending);
+    touchData();
+}
+
+
+bool DataManager::exportToCSV(const QString& filePath) {
+    return exportToCSV(*snapshot(), filePath);
+}
+
+bool DataManager::exportToCSV(const DataSnapshot& snapshot, const QString& filePath) const {
+    ATC_TIMED_OPERATION(timer, "exportToCSV");
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        setError("Не удалось открыть файл для экспорта: " + filePath);
+        return false;
+    }
+
+    QTextStream out(&file);
+    out.setEncoding(QStringConverter::Utf8);
+    // BOM нужен Excel, чтобы кириллица открылась корректно
+    out.setGenerateByteOrderMark(true);
+
+    out << "# tariff;city;price;fee\n";
+    for (const auto& tariff : snapshot.tariffs->tariffs()) {
+        out << csvLine({"tariff", QString::fromStdString(tariff.getCity()),
+                        csvNumber(tariff.getPricePerMinute()), csvNumber(tariff.getConnectionFee())}) << "\n";
+    }
+
+    out << "# prefix;prefix;city\n";
+    for (const auto& prefix : snapshot.tariffs->prefixes()) {
+        out << csvLine({"prefix", QString::fromStdString(prefix.prefix), QString::fromStdString(prefix.city)}) << "\n";
+    }
+
+    const SubscriberStore& store = *snapshot.subscribers;
+    out << "# client;name;phone;balance\n";
+    for (int i = 0; i < store.count(SubscriberKind::Regular); ++i) {
+        const SubscriberRecord& client = store.at(SubscriberKind::Regular, i);
+        out << csvLine({"client", toQString(store.text(client.nameId)),
+                        toQString(store.text(client.phoneId)), csvNumber(client.balance)}) << "\n";
+    }
+
+    out << "# vip;name;phone;balance;discount;manager\n";
+    for (int i = 0; i < store.count(SubscriberKind::Vip); ++i) {
+        const SubscriberRecord& vip = store.at(SubscriberKind::Vip, i);
+        out << csvLine({"vip", toQString(store.text(vip.nameId)),
+                        toQString(store.text(vip.phoneId)), csvNumber(vip.balance),
+                        csvNumber(vip.discount), toQString(store.text(vip.managerId))}) << "\n";
+    }
+
+    out << "# call;client;destination;duration;cost;started_at\n";
+    const CallStore& calls = snapshot.calls;
+    for (int i = 0; i < calls.count(); ++i) {
+        const CallRecord& call = calls.at(i);
+        out << csvLine({"call", toQString(calls.text(call.callerId)),
+                        toQString(calls.text(call.destinationId)), QString::number(call.duration),
+                        csvNumber(call.cost), csvTime(call.startTime)}) << "\n";
+    }
+
+    timer.addRows(snapshot.tariffs->tariffs().size() + snapshot.tariffs->prefixes().size() + store.count(SubscriberKind::Regular) +
+                  store.count(SubscriberKind::Vip) + calls.count());
+    out.flush();
+    if (!file.commit()) {
+        setError("Ошибка записи файла экспорта: " + file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool DataManager::importFromCSV(const QString& filePath, int* importedCount, int* duplicateCount) {
+    ATC_TIMED_OPERATION(timer, "importFromCSV");
+    const int imported = importCSVToDatabase(filePath, ProgressCallback(), duplicateCount);
+    if (imported < 0) {
+        return false;
+    }
+
+    // Записи попали только в БД - перечитываем таблицы в память
+    loadFromDatabase();
+    timer.addRows(static_cast<std::uint64_t>(imported));
+    if (importedCount) {
+        *importedCount = imported;
+    }
+    return true;
+}
+
+int DataManager::importCSVToDatabase(const QString& filePath, const ProgressCallback& progress,
+                                     int* duplicates) const {
+    ATC_TIMED_OPERATION(timer, "importCSVToDatabase");
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        setError("Не удалось открыть файл для импорта: " + filePath);
+        return -1;
+    }
+
+    QTextStream in(&file);
+    in.setEncoding(QStringConverter::Utf8);
+
+    // Весь файл импортируется одной транзакцией: на порядки быстрее построчного autocommit
+    QSqlDatabase db = database();
+    db.transaction();
+
+    // Те же тексты, что в addTariff/addClient/addVIPClient - выражения берутся из общего кэша.
+    // Дубликаты ключей отклоняются SQLite и считаются пропущенными строками.
+    CachedStatement& insertTariff = statementCache().prepare(
+        "INSERT INTO tariffs (city, price, fee, active) VALUES (:city, :price, :fee, 1) "
+        "ON CONFLICT(city) DO UPDATE SET price = excluded.price, fee = excluded.fee, active = 1 "
+        "WHERE tariffs.active = 0");
+    CachedStatement& insertPrefix = statementCache().prepare(
+        "INSERT OR REPLACE INTO tariff_prefixes (prefix, city) VALUES (:prefix, :city)");
+    CachedStatement& insertClient = statementCache().prepare("INSERT INTO subscribers (name, phone, balance) VALUES (:name, :phone, :balance)");
+    CachedStatement& insertVip = statementCache().prepare(
+        "INSERT INTO vip_subscribers (subscriber_id, discount, manager) "
+        "SELECT id, :discount, :manager FROM subscribers WHERE name = :name");
+    // Проверка целостности выполняется в SQL: звонок вставляется, только если клиент существует
+    // Повторные CDR отсекаются фильтром и ключом cdr_hash (см. writeCalls)
+    CachedStatement& insertCall = statementCache().prepare("INSERT OR IGNORE INTO calls "
+                  "(client_id, tariff_id, duration, cost, started_at, cdr_hash) "
+                  "SELECT id, :dest, :dur, :cost, :started, :hash FROM subscribers WHERE name = :name "
+                  "AND NOT EXISTS (SELECT 1 FROM archived_cdr_hashes WHERE cdr_hash = :archived)");
+    std::unordered_map<std::string, qint64> destinations;
+
+    const qint64 fileSize = file.size();
+    int imported = 0;
+    int skipped = 0;
+    int dropped = 0;
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        if (progress && ++lineNumber % 1000 == 0 && !progress(file.pos(), fileSize)) {
+            db.rollback();
+            setError("Импорт CSV отменен");
+            return -1;
+        }
+        if (line.trimmed().isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        const QStringList fields = parseCsvLine(line);
+        const QString kind = fields[0].trimmed();
+        bool ok1 = true, ok2 = true;
+        CachedStatement* statement = nullptr;
+        qint64 callHash = 0;
+
+        if (kind == "tariff" && fields.size() >= 4) {
+            double price = parseCsvNumber(fields[2], &ok1);
+            double fee = parseCsvNumber(fields[3], &ok2);
+            statement = &insertTariff;
+            statement->query.bindValue(":city", fields[1]);
+            statement->query.bindValue(":price", price);
+            statement->query.bindValue(":fee", fee);
+        } else if (kind == "prefix" && fields.size() >= 3) {
+            const std::string digits = RoutingTable::normalizeNumber(fields[1].toStdString());
+            ok1 = !digits.empty();
+            statement = &insertPrefix;
+            statement->query.bindValue(":prefix", QString::fromStdString(digits));
+            statement->query.bindValue(":city", fields[2].trimmed());
+        } else if (kind == "client" && fields.size() >= 4) {
+            double balance = parseCsvNumber(fields[3], &ok1);
+            statement = &insertClient;
+            statement->query.bindValue(":name", fields[1]);
+            statement->query.bindValue(":phone", fields[2]);
+            statement->query.bindValue(":balance", balance);
+        } else if (kind == "vip" && fields.size() >= 6) {
+            double balance = parseCsvNumber(fields[3], &ok1);
+            // Скидка в файле только проверяется: ее задает уровень, пересчитанный при загрузке
+            parseCsvNumber(fields[4], &ok2);
+            // Сначала строка абонента, затем расширение VIP к ней
+            insertClient.query.bindValue(":name", fields[1]);
+            insertClient.query.bindValue(":phone", fields[2]);
+            insertClient.query.bindValue(":balance", balance);
+            if (!ok1 || !ok2 || !insertClient.exec()) {
+                ++skipped;
+                continue;
+            }
+            statement = &insertVip;
+            statement->query.bindValue(":name", fields[1]);
+            statement->query.bindValue(":discount", LoyaltyEngine::tier(0).discount);
+            statement->query.bindValue(":manager", fields[5]);
+        } else if (kind == "call" && fields.size() >= 5) {
+            int duration = fields[3].trimmed().toInt(&ok1);
+            double cost = parseCsvNumber(fields[4], &ok2);
+            ok1 = ok1 && duration > 0;
+            const qint64 started = fields.size() >= 6 ? parseCsvTime(fields[5]) : 0;
+            callHash = cdrHash(fields[1].toStdString(), fields[2].toStdString(), started, duration);
+            if (ok1 && ok2 && isDuplicateCdr(callHash)) {
+                ++dropped;
+                continue;
+            }
+            const qint64 destination = destinationId(fields[2].toStdString(), &destinations);
+            if (destination < 0) {
+                db.rollback();
+                return -1;
+            }
+            statement = &insertCall;
+            statement->query.bindValue(":name", fields[1]);
+            statement->query.bindValue(":dest", destination);
+            statement->query.bindValue(":dur", duration);
+            statement->query.bindValue(":cost", cost);
+            statement->query.bindValue(":started", started);
+            statement->query.bindValue(":hash", cdrHashValue(callHash));
+            statement->query.bindValue(":archived", cdrHashValue(callHash));
+        }
+
+        if (statement && ok1 && ok2 && statement->exec() && statement->query.numRowsAffected() > 0) {
+            ++imported;
+            rememberCdr(callHash);
+        } else {
+            ++skipped;
+        }
+    }
+
+    if (!commitTimed(db)) {
+        setError("SQL Error (importFromCSV): " + db.lastError().text());
+        db.rollback();
+        return -1;
+    }
+    if (progress) progress(fileSize, fileSize);
+
+    if (skipped > 0) {
+        qCInfo(lcData) << "Импорт CSV: пропущено строк:" << skipped;
+    }
+    if (dropped > 0) {
+        qCInfo(lcData) << "Импорт CSV: пропущено дубликатов звонков:" << dropped;
+    }
+    if (duplicates) {
+        *duplicates = dropped;
+    }
+    timer.addRows(static_cast<std::uint64_t>(imported));
+    return imported;
+}
+
+
+std::vector<StatementStats> DataManager::statementCacheStats() const {
+    return pool ? statementCache().statistics() : std::vector<StatementStats>();
+}
+
+bool DataManager::exportMetrics(const QString& filePath) {
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        setError("Не удалось открыть файл метрик: " + filePath);
+        return false;
+    }
+
+    // Файл подменяется атомарно (QSaveFile), поэтому textfile collector
+    // никогда не увидит недописанный файл
+    file.write(QByteArray::fromStdString(MetricsRegistry::instance().toPrometheusText()));
+    if (!file.commit()) {
+        setError("Ошибка записи файла метрик: " + file.errorString());
+        return false;
+    }
+    return true;
+}
+
+
+void DataManager::clearAll() {
+    ATC_TIMED_OPERATION(timer, "clearAll");
+    QSqlDatabase db = database();
+    QSqlQuery query(db);
+    db.transaction();
+    execTimed(query, ATC_SQL_METRIC("calls.delete_all"), "DELETE FROM calls");
+    execTimed(query, ATC_SQL_METRIC("call_archives.delete_all"), "DELETE FROM call_archives");
+    execTimed(query, ATC_SQL_METRIC("archived_cdr_hashes.delete_all"), "DELETE FROM archived_cdr_hashes");
+    // Расширения VIP удаляются каскадом; звонков к этому моменту уже нет
+    execTimed(query, ATC_SQL_METRIC("subscribers.delete_all"), "DELETE FROM subscribers");
+    execTimed(query, ATC_SQL_METRIC("tariff_prefixes.delete_all"), "DELETE FROM tariff_prefixes");
+    execTimed(query, ATC_SQL_METRIC("tariffs.delete_all"), "DELETE FROM tariffs");
+    if (!commitTimed(db)) {
+        setError("SQL Error (clearAll): " + db.lastError().text());
+        db.rollback();
+    }
+    QDir(archiveDirectory()).removeRecursively();
+    invalidateCdrFilter();
+
+    publishTariffs(std::make_shared<const TariffSet>());
+    subscriberStore.clear();
+    subscriberIndex.reset();
+    callStore.clear();
+    loyalty.clear();
+    touchData(true);
 }
 void DataManager::initializeTestData() {
+    ATC_TIMED_OPERATION(timer, "initializeTestData");
     clearAll();
     // Пример данных
     addTariff(Tariff("Москва", 2.50, 0.50));
     addTariff(Tariff("Санкт-Петербург", 2.30, 0.50));
     addTariff(Tariff("Минск", 1.80, 0.20));
+    addTariffPrefix("7495", "Москва");
+    addTariffPrefix("7499", "Москва");
+    addTariffPrefix("7812", "Санкт-Петербург");
+    addTariffPrefix("37517", "Минск");
 
     addClient(Client("Иванов", "+79001234567", 100.0));
     addClient(Client("Петров", "+79007654321", 50.0));
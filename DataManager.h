@@ -3,62 +3,411 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
 #include <QSqlDatabase>
-#include <QSqlQuery>
-#include <QSqlError>
-#include <QVariant>
-#include <QDebug>
-#include <QFileInfo>
-#include <QDir>
-#include <QFile>
+#include <QString>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
 
 #include "Tariff.h"
 #include "Client.h"
 #include "VIPClient.h"
 #include "Call.h"
+#include "SubscriberStore.h"
+#include "SubscriberIndex.h"
+#include "RoutingTable.h"
+#include "TariffSet.h"
+#include "CallStore.h"
+#include "StatementCache.h"
+#include "BloomFilter.h"
+#include "ConnectionPool.h"
+#include "LoyaltyEngine.h"
 
+class CallArchive;
+class CallHistory;
+
+// Строки отчетов: считаются SQL-запросами (и по файлам архива), без обращения к данным в памяти
+struct ClientUsage {
+    std::string clientName;
+    int callCount;
+    long long totalDuration;
+    double totalCost;
+};
+
+struct DestinationRevenue {
+    std::string destination;
+    int callCount;
+    double revenue;
+};
+
+// Выручка по текущим и предлагаемым тарифам (DataManager::simulateTariffs)
+struct RevenueDelta {
+    std::string name;           // направление или группа абонентов
+    long long callCount = 0;
+    double currentRevenue = 0.0;
+    double proposedRevenue = 0.0;
+
+    double delta() const { return proposedRevenue - currentRevenue; }
+};
+
+struct TariffSimulation {
+    // По убыванию изменения выручки (по модулю)
+    std::vector<RevenueDelta> destinations;
+    RevenueDelta regular;       // обычные клиенты и абоненты, которых уже нет
+    RevenueDelta vip;
+    RevenueDelta total;
+    // Звонки направлений без тарифа в одном из наборов: стоимость остается прежней
+    long long unratedCalls = 0;
+};
+
+// Абонент из полнотекстового поиска (DataManager::searchSubscribersFullText)
+struct SubscriberHit {
+    std::string name;
+    std::string phone;
+    std::string manager;        // пусто у обычного клиента
+    SubscriberKind kind;
+};
+
+// Строка из хранилища абонентов (UTF-8) в QString
+inline QString toQString(std::string_view text) {
+    return QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size()));
+}
+
+// Содержимое всех таблиц, прочитанное из БД (в том числе в рабочем потоке)
+struct LoadedTables {
+    std::vector<Tariff> tariffs;
+    std::vector<TariffPrefix> tariffPrefixes;
+    std::vector<TariffVersion> tariffVersions;
+    SubscriberStore subscribers;
+    CallStore calls;
+    // Набор тарифов с таблицей маршрутов, построенный загружающим потоком
+    std::shared_ptr<const TariffSet> tariffSet;
+    // Индекс автодополнения, если его построил загружающий поток (id строк - те же)
+    std::shared_ptr<SubscriberIndex> subscriberIndex;
+    // false - только справочные таблицы (ReferenceTablesCallback): звонков еще нет,
+    // и уровни лояльности по ним не пересчитываются
+    bool callsLoaded = true;
+};
+
+// Новые уровни лояльности VIP для записи в БД: имена берутся в потоке-владельце,
+// и запись (writeLoyaltyTiers) не обращается к хранилищу абонентов
+struct LoyaltyTierUpdate {
+    std::vector<TierChange> changes;
+    QStringList names;              // по порядку changes
+};
+
+// CDR с номерами вместо имен: абонент определяется по номеру A, направление -
+// по самому длинному префиксу набранного номера B
+struct DialedCall {
+    std::string callerNumber;
+    std::string dialedNumber;
+    int duration = 0;
+    std::int64_t startTime = 0;
+};
+
+// Строка CDR коммутатора "номер_абонента;набранный_номер;длительность[;начало ISO 8601]";
+// false - строка не разобрана
+bool parseDialedCall(const QString& line, DialedCall* call);
+
+// Позиция чтения файла CDR (CdrTailer): байт после последней записанной строки и
+// отпечаток первой строки, по которому видно, что под тем же именем уже другой файл.
+// Хранится в БД и фиксируется той же транзакцией, что и звонки.
+struct CdrCheckpoint {
+    QString source;
+    qint64 offset = 0;
+    qint64 fingerprint = 0;
+};
+
+// Условие массового удаления звонков (DataManager::removeCallsWhere). Поля по
+// умолчанию не ограничивают; условия объединяются через И.
+struct CallFilter {
+    std::string callerName;
+    std::string destination;
+    qint64 startedFrom = 0;         // started_at >= startedFrom
+    qint64 startedBefore = 0;       // started_at < startedBefore
+    int minDuration = 0;
+    int maxDuration = 0;
+
+    bool isEmpty() const;
+};
+
+// Итог тарификации пакета DialedCall: отброшенные звонки по причинам
+struct RatingStats {
+    int rated = 0;
+    int unknownCaller = 0;
+    int unrouted = 0;
+    int invalid = 0;
+};
+
+// Неизменный согласованный срез данных в памяти (DataManager::snapshot) для долгих
+// отчетов и экспорта в рабочих потоках: владелец тем временем продолжает менять
+// данные. Звонки делят блоки с DataManager и копируются только при изменении,
+// абоненты копируются один раз после каждого их изменения, тарифы не копируются.
+struct DataSnapshot {
+    // Номер изменения данных в памяти, на котором сделан срез
+    quint64 version = 0;
+    std::shared_ptr<const TariffSet> tariffs;
+    std::shared_ptr<const SubscriberStore> subscribers;
+    CallStore calls;
+
+    // Статистика по звонкам среза, как у одноименных методов DataManager
+    double totalRevenue() const;
+    double clientTotalCost(const std::string& clientName) const;
+    int clientCallCount(const std::string& clientName) const;
+};
+
+// Прогресс длительной операции (выполнено, всего); вернуть false - прервать операцию
+using ProgressCallback = std::function<bool(qint64 done, qint64 total)>;
+// Тарифы и абоненты, прочитанные раньше звонков (calls пуст); вызывается в потоке чтения
+using ReferenceTablesCallback = std::function<void(LoadedTables&& reference)>;
+
+// Ядро системы: хранит данные в памяти и синхронизирует их с SQLite.
+// Зависит только от QtCore и QtSql, поэтому используется и GUI, и atc-cli.
 class DataManager {
 private:
-    std::vector<Tariff> tariffs;
-    std::vector<Client> clients;
-    std::vector<VIPClient> vipClients;
-    std::vector<Call> calls;
+    // Тарифы и префиксы номеров (префикс без тарифа ни к чему не ведет). Набор
+    // не меняется, а заменяется целиком: только через std::atomic_load/atomic_store
+    std::shared_ptr<const TariffSet> publishedTariffs;
+    // Клиенты и VIP-клиенты в компактном виде (плоские записи + интернированные строки)
+    SubscriberStore subscriberStore;
+    CallStore callStore;
+    // Траты VIP за скользящее окно и уровни лояльности (ключ - id имени в subscriberStore)
+    LoyaltyEngine loyalty;
+    // Строится при первом поиске, если не пришел готовым вместе с таблицами
+    mutable std::shared_ptr<SubscriberIndex> subscriberIndex;
+    // В SQLite есть FTS5 и таблица subscribers_fts создана (createTables)
+    mutable std::atomic<bool> fullTextReady{false};
+    // Последний выданный срез, пока он у кого-то есть. Слабая ссылка: сильная держала
+    // бы блоки звонков, и каждая запись копировала бы последний блок.
+    mutable std::weak_ptr<const DataSnapshot> lastSnapshot;
+    // Копия абонентов для срезов; сбрасывается при изменении абонентов
+    mutable std::shared_ptr<const SubscriberStore> subscriberCopy;
+    quint64 dataVersion = 0;
 
-    QSqlDatabase db;
     QString dbPath;
+    // Соединения по одному на поток, у каждого свой кэш выражений
+    std::unique_ptr<ConnectionPool> pool;
+    // Потоки параллельных отчетов (отдельно от глобального пула, чтобы не было взаимоблокировок)
+    mutable QThreadPool reportPool;
+
+    mutable QMutex errorMutex;
+    mutable QString lastErrorText;
 
-    void createTables();
+    // Хэши CDR из calls (колонка cdr_hash с уникальным индексом) и archived_cdr_hashes
+    // (звонки, перенесенные в архив). Фильтр Блума
+    // строится лениво при первой записи звонков и отсекает новые CDR без запроса
+    // к БД; точная проверка - только для "возможно есть". Общий для потоков.
+    mutable QMutex cdrMutex;
+    mutable BloomFilter cdrFilter;
+    mutable bool cdrFilterReady = false;
+
+    void createTables() const;
     void loadFromDatabase();
+    // Чтение таблиц запросами; false при отмене через progress
+    bool readTablesFromSql(LoadedTables* tables, const ProgressCallback& progress,
+                           const ReferenceTablesCallback& referenceLoaded) const;
+    // Двоичный снимок данных рядом с БД и текущая ревизия (таблица db_revision)
+    QString snapshotPath() const;
+    bool readRevision(qint64* revision) const;
+    void setError(const QString& message) const;
+    // Одиночное изменение отдельной транзакцией (commitTimed увеличивает ревизию);
+    // затронутые строки или -1 при ошибке (записана в lastError с именем operation)
+    int execWrite(CachedStatement& statement, const char* operation) const;
+    // true - такой CDR уже есть в calls или в архиве (hash 0 - звонок без ключа, не проверяется)
+    bool isDuplicateCdr(qint64 hash) const;
+    // id строки tariffs для направления звонка (звонок хранит только его); направление
+    // без тарифа получает выключенную строку. cache - на пакет звонков; -1 при ошибке
+    qint64 destinationId(const std::string& city, std::unordered_map<std::string, qint64>* cache = nullptr) const;
+    int writeCallBatch(const std::vector<Call>& batch, const std::vector<CdrCheckpoint>* checkpoints,
+                       std::vector<qint64>* insertedIds, const ProgressCallback& progress, int* duplicates) const;
+    void rememberCdr(qint64 hash) const;
+    void rebuildCdrFilter() const;
+    void invalidateCdrFilter() const;
+    const SubscriberIndex& searchIndex() const;
+    // Отметка об изменении данных в памяти (subscribers - изменились и абоненты)
+    void touchData(bool subscribers = false);
+    // Новый набор после правки тарифов через CRUD (в потоке-владельце)
+    void replaceTariffs(std::vector<Tariff> tariffs, std::vector<TariffPrefix> prefixes);
+    // Окна трат заново по звонкам в памяти (после загрузки); в БД ничего не пишет
+    void rebuildLoyalty();
+    // Уровни VIP по загруженным звонкам - в БД и в tables (до записи снимка);
+    // число изменений или -1 при ошибке записи
+    int settleLoyaltyTiers(LoadedTables* tables) const;
+    // Звонок в окно трат абонента (если это VIP)
+    void recordLoyalty(const Call& call);
+    // Удаленный звонок из окна трат абонента (если это VIP)
+    void unrecordLoyalty(const CallRecord& record);
+
+    // Соединение и кэш выражений вызывающего потока
+    QSqlDatabase database() const;
+    StatementCache& statementCache() const;
+
+    std::vector<ClientUsage> clientUsageInRange(qlonglong fromId, qlonglong toId) const;
+    // Файлы архива из call_archives; недоступные пропускаются с записью в lastError
+    QStringList archivePaths() const;
+    void forEachArchive(const QStringList& paths, const std::function<void(const CallArchive&)>& visit) const;
+    // Ключи массовой операции во временной таблице соединения (temp.bulk_ids или
+    // temp.bulk_names) для DELETE ... IN (SELECT ...); вызывается внутри транзакции
+    bool stageBulkIds(const std::vector<qint64>& ids, QString* error) const;
+    bool stageBulkNames(const QStringList& names, QString* error) const;
 
 public:
-    DataManager();
+    // Пустой путь означает путь по умолчанию (см. defaultDatabasePath).
+    // loadData = false: только подключение и схема, данные загружает вызывающая
+    // сторона (GUI - в фоне через AsyncDataManager::load, чтобы окно появилось сразу)
+    explicit DataManager(const QString& databasePath = QString(), bool loadData = true);
     ~DataManager();
 
+    // Путь к БД: переменная окружения ATC_DB_PATH или каталог данных пользователя
+    static QString defaultDatabasePath();
+
     bool connectToDatabase();
+    bool isConnected() const;
+    QString databasePath() const;
+    QString lastError() const;
 
-    // CRUD методы
-    void addTariff(const Tariff& tariff);
+    // CRUD методы. Ссылки и указатели на тарифы и префиксы действительны до
+    // следующей публикации набора тарифов (в потоке-владельце - до его изменения).
+    bool addTariff(const Tariff& tariff);
     void removeTariff(int index);
-    void updateTariff(int index, const Tariff& tariff);
+    // Изменение одной транзакцией (UPSERT), запись остается на своем месте; false -
+    // ошибка в lastError, данные не изменены. Новый город не может быть городом
+    // действующего тарифа; направление удаленного тарифа с тем же городом сливается
+    bool updateTariff(int index, const Tariff& tariff);
     const std::vector<Tariff>& getTariffs() const;
-    Tariff* findTariffByCity(const std::string& city);
+    const Tariff* findTariffByCity(const std::string& city) const;
+
+    // Маршрутизация по номеру: префикс (цифры E.164) ведет к тарифу направления.
+    // Повторное добавление префикса переназначает его.
+    bool addTariffPrefix(const std::string& prefix, const std::string& city);
+    bool removeTariffPrefix(const std::string& prefix);
+    const std::vector<TariffPrefix>& getTariffPrefixes() const;
+    // Тариф по самому длинному подходящему префиксу номера (nullptr - маршрута нет)
+    const Tariff* findTariffByNumber(const std::string& number) const;
+
+    // Горячая замена тарифов. Текущий набор можно взять в любом потоке: он остается
+    // целым, пока на него есть ссылка, поэтому пакет тарифицируется по одной версии.
+    std::shared_ptr<const TariffSet> currentTariffs() const;
+    // Публикует набор одной атомарной заменой указателя; потокобезопасно. БД не
+    // трогает: набор должен быть уже записан (writeTariffSet) или прочитан из нее.
+    void publishTariffs(std::shared_ptr<const TariffSet> tariffs);
+    // Чтение и проверка набора целиком (потокобезопасно); nullptr - ошибка в lastError.
+    // Файл - CSV экспорта, учитываются только записи tariff и prefix.
+    std::shared_ptr<const TariffSet> readTariffSet() const;
+    std::shared_ptr<const TariffSet> readTariffFile(const QString& filePath) const;
+    // Замена таблиц tariffs и tariff_prefixes одной транзакцией. Версии цен пишут
+    // триггеры БД, поэтому для публикации набор перечитывается (readTariffSet)
+    bool writeTariffSet(const TariffSet& tariffs) const;
+    // Все версии цен направления (и удаленного тарифа) по началу действия; потокобезопасно
+    std::vector<TariffVersion> tariffVersions(const std::string& city) const;
 
-    void addClient(const Client& client);
+    bool addClient(const Client& client);
     void removeClient(int index);
-    void updateClient(int index, const Client& client);
-    const std::vector<Client>& getClients() const;
+    bool updateClient(int index, const Client& client);
+    int clientCount() const;
+    Client clientAt(int index) const;
     bool clientExists(const std::string& name) const;
 
-    void addVIPClient(const VIPClient& client);
+    bool addVIPClient(const VIPClient& client);
     void removeVIPClient(int index);
-    void updateVIPClient(int index, const VIPClient& client);
-    const std::vector<VIPClient>& getVIPClients() const;
+    bool updateVIPClient(int index, const VIPClient& client);
+    int vipClientCount() const;
+    VIPClient vipClientAt(int index) const;
+
+    // Абонент любого типа по имени (nullptr, если такого нет)
+    const SubscriberRecord* findSubscriber(const std::string& name) const;
+    // Программа лояльности VIP: уровень назначается по тратам за последние
+    // LoyaltyEngine::WindowDays дней и пересчитывается с каждым принятым звонком
+    // (addCall, adoptCalls), а не обходом всех звонков. Новый уровень задает скидку
+    // VIP; изменения пакета звонков записываются в БД одной транзакцией (writeLoyaltyTiers).
+    // Траты - по звонкам в памяти: архив старше окна. Ключ - id имени в subscribers()
+    const LoyaltyEngine& loyaltyEngine() const;
+    // Прямой доступ к записям без сборки объектов Client/VIPClient
+    const SubscriberStore& subscribers() const;
+    // Автодополнение: до limit абонентов, чье имя (без учета регистра) или номер
+    // начинается с prefix. Id строк в результате - из subscribers().
+    std::vector<SubscriberMatch> searchSubscribers(const QString& prefix, int limit) const;
+    // Поиск по любому фрагменту имени, номера или менеджера VIP (FTS5, триграммы),
+    // лучшие совпадения первыми: имя весит больше номера, номер - больше менеджера.
+    // Слова короче 3 символов не ищутся; все слова должны найтись. Только БД,
+    // поэтому безопасен в любом потоке. Пусто, если искать нечего или FTS5 нет
+    std::vector<SubscriberHit> searchSubscribersFullText(const QString& text, int limit) const;
+    bool hasFullTextSearch() const;
+    // Запрос FTS5 из строки оператора; пустой, если в ней нет слов от 3 символов
+    static QString fullTextQuery(const QString& text);
 
     bool addCall(const Call& call);
     void removeCall(int index);
-    const std::vector<Call>& getCalls() const;
+    // Массовое удаление: одна транзакция с одним DELETE по множеству ключей и один
+    // проход сжатия по звонкам в памяти. Возвращают число удаленных строк или -1.
+    // Звонки по номерам строк в calls() (выделение в таблице)
+    int removeCalls(const std::vector<int>& indices);
+    // Звонки по условию; пустое условие отклоняется (для этого есть clearAll)
+    int removeCallsWhere(const CallFilter& filter);
+    // Абоненты одного типа по номерам строк, withCalls - вместе с их звонками
+    // (кроме перенесенных в архив); число удаленных звонков - в removedCalls.
+    // Без withCalls абоненты со звонками не удаляются: -1, не удален никто
+    int removeSubscribers(SubscriberKind kind, const std::vector<int>& indices, bool withCalls,
+                          int* removedCalls = nullptr);
+    int callCount() const;
+    Call callAt(int index) const;
+    // Записи звонков с id строк в БД (строки - через calls().text(id))
+    const CallStore& calls() const;
+
+    // Тарификация: стоимость звонка с учетом скидки VIP (-1, если тарифа нет) по ценам,
+    // действовавшим в startTime (0 - по текущим)
+    double calculateCallCost(const std::string& callerName, const std::string& destination,
+                             int duration, qint64 startTime = 0) const;
+    // Пакетная тарификация CDR по номерам: абонент - по индексу номеров телефонов,
+    // тариф - по префиксу набранного номера, без сравнения названий городов; цены - на
+    // момент начала звонка.
+    // Звонки без абонента или маршрута отбрасываются и считаются в stats; origins[i] -
+    // номер в batch, из которого получен i-й звонок результата.
+    std::vector<Call> rateDialedCalls(const std::vector<DialedCall>& batch, RatingStats* stats = nullptr,
+                                      std::vector<std::size_t>* origins = nullptr) const;
+    // Пересчитывает стоимость всех звонков по ценам, действовавшим в момент звонка
+    // (версии тарифов), возвращает число измененных звонков или -1 при ошибке
+    int rerateCalls();
+
+    // Потокобезопасные отчеты: работают через соединение вызывающего потока
+    // и не читают векторы в памяти, поэтому их можно запускать из рабочих потоков.
+    // Учитывают и оперативные звонки, и перенесенные в архив.
+    std::vector<ClientUsage> reportClientUsage() const;
+    // Тот же отчет, разбитый по диапазонам id на несколько потоков (0 - по числу ядер).
+    // Если во время отчета звонки ушли в архив, он повторяется через reportClientUsage
+    std::vector<ClientUsage> reportClientUsageParallel(int workers = 0) const;
+    std::vector<DestinationRevenue> reportRevenueByDestination() const;
+    double reportTotalRevenue() const;
 
-    // Статистика
+    // Холодный архив: звонки, начавшиеся раньше cutoff (секунды Unix), переносятся
+    // в колоночный файл в <БД>.archive и удаляются из calls и из памяти. cutoff не
+    // новее LoyaltyEngine::WindowDays дней назад. Возвращает число перенесенных
+    // звонков или -1 при ошибке. Звонки с неизвестным временем (started_at = 0)
+    // остаются в calls.
+    int archiveCallsBefore(qint64 cutoff);
+    qint64 archivedCallCount() const;
+    QString archiveDirectory() const;
+    // VACUUM: возвращает ОС место, освобожденное после переноса в архив
+    bool compactDatabase();
+    // Вся история (архив, затем оперативные звонки) в сжатом виде для аналитики.
+    // Потокобезопасно: читает БД и файлы архива, звонки в памяти не затрагивает.
+    bool readCallHistory(CallHistory* history) const;
+    // Что будет с выручкой при наборе proposed: вся история пересчитывается по текущим
+    // и по предлагаемым тарифам со скидками VIP из subscribers, блоки истории делятся
+    // между потоками отчетов (workers 0 - по числу ядер). Ни данные, ни БД не меняются;
+    // потокобезопасно, если subscribers не меняется (например, из среза)
+    TariffSimulation simulateTariffs(const CallHistory& history, const SubscriberStore& subscribers,
+                                     const TariffSet& proposed, int workers = 0) const;
+
+    // Срез данных в памяти для чтения в других потоках (вызывается в потоке-владельце).
+    // Пока данные не менялись, возвращается тот же срез.
+    std::shared_ptr<const DataSnapshot> snapshot() const;
+
+    // Статистика по звонкам в памяти (без архива)
     double calculateClientTotalCost(const std::string& clientName) const;
     int getClientCallCount(const std::string& clientName) const;
     double calculateTotalRevenue() const;
@@ -70,9 +419,59 @@ public:
     void sortCallsByDuration(bool ascending = true);
 
     // Бэкап и Восстановление
-    bool backupDatabase(const QString& destinationPath);
+    bool backupDatabase(const QString& destinationPath) const;
     bool restoreDatabase(const QString& sourcePath);
 
+    // Импорт/экспорт CSV (UTF-8 с BOM, разделитель ';', первая колонка - тип записи)
+    bool exportToCSV(const QString& filePath);
+    // Экспорт среза: потокобезопасно, данные в памяти не читает
+    bool exportToCSV(const DataSnapshot& snapshot, const QString& filePath) const;
+    // Дубликаты звонков (тот же абонент, направление, начало и длительность) пропускаются
+    bool importFromCSV(const QString& filePath, int* importedCount = nullptr, int* duplicateCount = nullptr);
+
+    // Операции в два этапа для AsyncDataManager. Методы *const работают только с БД
+    // через соединение вызывающего потока и могут выполняться в рабочем потоке;
+    // adopt* применяют результат к данным в памяти и вызываются в потоке-владельце.
+    // readTables берет данные из снимка, если его ревизия совпадает с БД, иначе читает
+    // таблицы, записывает пересчитанные уровни лояльности (поэтому вызывается только в
+    // потоке записи) и перезаписывает снимок. При чтении запросами referenceLoaded получает
+    // копию тарифов и абонентов до того, как начнется чтение звонков.
+    LoadedTables readTables(const ProgressCallback& progress = ProgressCallback(),
+                            const ReferenceTablesCallback& referenceLoaded = ReferenceTablesCallback()) const;
+    void adoptTables(LoadedTables&& tables);
+    // Пакетная вставка звонков одной транзакцией; число вставленных или -1 при ошибке
+    // или отмене. В insertedIds попадают id новых строк (для adoptCalls), 0 - для
+    // отброшенных дубликатов; их число - в duplicates.
+    int writeCalls(const std::vector<Call>& batch, std::vector<qint64>* insertedIds,
+                   const ProgressCallback& progress = ProgressCallback(), int* duplicates = nullptr) const;
+    // То же вместе с позициями источников CDR: после сбоя прием продолжится ровно
+    // с первой незаписанной строки
+    int writeCalls(const std::vector<Call>& batch, const std::vector<CdrCheckpoint>& checkpoints,
+                   std::vector<qint64>* insertedIds, int* duplicates = nullptr) const;
+    std::vector<CdrCheckpoint> readCdrCheckpoints() const;
+    void adoptCalls(const std::vector<Call>& batch, const std::vector<qint64>& ids);
+    // Уровни лояльности тоже в два этапа: adopt* меняют их только в памяти,
+    // pendingLoyaltyTiers (в потоке-владельце) собирает изменения, writeLoyaltyTiers
+    // пишет их одной транзакцией в потоке записи, adoptLoyaltyTiers отмечает
+    // записанное. При ошибке изменения остаются до следующей записи.
+    // saveLoyaltyTiers - все три шага в вызывающем потоке (синхронные операции)
+    LoyaltyTierUpdate pendingLoyaltyTiers() const;
+    bool writeLoyaltyTiers(const LoyaltyTierUpdate& update) const;
+    void adoptLoyaltyTiers(const LoyaltyTierUpdate& update);
+    bool saveLoyaltyTiers();
+    // Импорт CSV только в БД (одна транзакция); -1 при ошибке или отмене
+    int importCSVToDatabase(const QString& filePath, const ProgressCallback& progress = ProgressCallback(),
+                            int* duplicates = nullptr) const;
+    // Подмена файла БД копией: закрывает все соединения пула, поэтому другие
+    // запросы в это время выполняться не должны. Копия прежней схемы переводится на новую
+    bool replaceDatabaseFile(const QString& sourcePath) const;
+
+    // Статистика кэша подготовленных выражений вызывающего потока: попадания и время выполнения
+    std::vector<StatementStats> statementCacheStats() const;
+
+    // Метрики операций и SQL (MetricsRegistry) в формате Prometheus
+    bool exportMetrics(const QString& filePath);
+
     void clearAll();
 
     void initializeTestData();
@@ -0,0 +1,447 @@
+#include "IngestServer.h"
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QMetaObject>
+#include <QSemaphore>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include "Metrics.h"
+#include "MpscQueue.h"
+
+// Строки одного чтения из одного соединения
+struct IngestChunk {
+    int worker = -1;
+    quint64 connection = 0;
+    // Номер последней строки соединения в этом пакете (пустые тоже считаются)
+    qint64 lastLine = 0;
+    std::vector<DialedCall> calls;
+    int malformed = 0;
+};
+
+// Общее для потоков ввода-вывода и потока записи
+struct IngestShared {
+    MpscQueue<IngestChunk> queue;
+    // По разрешению на каждый пакет в очереди: поток записи спит, пока их нет
+    QSemaphore pending;
+    std::atomic<bool> accepting{true};
+    std::atomic<quint64> nextConnection{1};
+    std::atomic<qint64> connections{0};
+    std::atomic<qint64> received{0};
+    std::atomic<qint64> committed{0};
+    std::atomic<qint64> rejected{0};
+    std::atomic<qint64> duplicates{0};
+    std::atomic<qint64> groups{0};
+};
+
+Q_LOGGING_CATEGORY(lcIngest, "atc.ingest")
+
+namespace {
+
+// Дальше поток ввода-вывода перестает читать сокеты: данные ждут в буферах ядра,
+// и отправитель останавливается на записи
+const std::size_t MaxQueuedChunks = 512;
+const qint64 SocketBufferSize = 256 * 1024;
+const int BackpressureRetryMs = 5;
+
+// Групповая фиксация: транзакция закрывается по объему или через окно после первого пакета
+const int MaxGroupRecords = 20000;
+const int GroupWindowMs = 5;
+
+} // namespace
+
+// Соединения одного потока ввода-вывода. Все методы - в потоке объекта.
+class IngestWorker : public QObject {
+public:
+    IngestWorker(int index, IngestShared *shared) : index(index), shared(shared) {}
+
+    void accept(quintptr descriptor) {
+        auto *socket = new QLocalSocket(this);
+        if (!socket->setSocketDescriptor(descriptor)) {
+            delete socket;
+            return;
+        }
+        socket->setReadBufferSize(SocketBufferSize);
+        const quint64 id = shared->nextConnection.fetch_add(1);
+        connections[id].socket = socket;
+        shared->connections.fetch_add(1);
+        connect(socket, &QLocalSocket::readyRead, this, [this, id]() { readFrom(id); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, id]() { drop(id); });
+    }
+
+    // Ответы потока записи; соединение могло закрыться, пока пакет записывался
+    void acknowledge(quint64 id, qint64 lines, int rejected) {
+        auto it = connections.find(id);
+        if (it != connections.end()) {
+            it->second.socket->write(QByteArray("ACK ") + QByteArray::number(lines) + ' ' +
+                                     QByteArray::number(rejected) + '\n');
+        }
+    }
+
+    // После ERR соединение закрывается: ACK следующего пакета подтвердил бы и строки
+    // незаписанного. Отправитель переподключается и повторяет все после последнего ACK
+    void reportError(quint64 id, const QString& message) {
+        auto it = connections.find(id);
+        if (it == connections.end()) {
+            return;
+        }
+        QLocalSocket *socket = it->second.socket;
+        socket->write("ERR " + message.toUtf8().replace('\n', ' ') + '\n');
+        socket->flush();
+        // Запись убирается сразу: ответы на пакеты, уже стоящие в очереди, не уйдут
+        connections.erase(it);
+        shared->connections.fetch_sub(1);
+        socket->disconnectFromServer();
+        socket->deleteLater();
+    }
+
+    void closeAll() {
+        for (auto& entry : connections) {
+            entry.second.socket->flush();
+            entry.second.socket->disconnectFromServer();
+            entry.second.socket->deleteLater();
+        }
+        shared->connections.fetch_sub(static_cast<qint64>(connections.size()));
+        connections.clear();
+    }
+
+private:
+    struct Connection {
+        QLocalSocket *socket = nullptr;
+        QByteArray partial;
+        qint64 lines = 0;
+    };
+
+    void readFrom(quint64 id) {
+        auto it = connections.find(id);
+        if (it == connections.end() || !shared->accepting.load()) {
+            return;
+        }
+        if (shared->queue.size() >= MaxQueuedChunks) {
+            QTimer::singleShot(BackpressureRetryMs, this, [this, id]() { readFrom(id); });
+            return;
+        }
+        Connection& connection = it->second;
+        QByteArray data = connection.partial + connection.socket->readAll();
+        const qsizetype end = data.lastIndexOf('\n');
+        if (end < 0) {
+            connection.partial = data;
+            return;
+        }
+        connection.partial = data.mid(end + 1);
+
+        const qint64 before = connection.lines;
+        IngestChunk chunk;
+        chunk.worker = index;
+        chunk.connection = id;
+        qsizetype position = 0;
+        while (position <= end) {
+            const qsizetype next = data.indexOf('\n', position);
+            const QString text = QString::fromUtf8(data.mid(position, next - position)).trimmed();
+            position = next + 1;
+            // Считается каждая строка, и пустая: отправитель считает так же
+            ++connection.lines;
+            if (text.isEmpty() || text.startsWith('#')) {
+                continue;
+            }
+            DialedCall call;
+            if (parseDialedCall(text, &call)) {
+                chunk.calls.push_back(std::move(call));
+            } else {
+                ++chunk.malformed;
+            }
+        }
+        if (connection.lines == before) {
+            return;
+        }
+        chunk.lastLine = connection.lines;
+        shared->received.fetch_add(connection.lines - before);
+        shared->queue.push(std::move(chunk));
+        shared->pending.release();
+    }
+
+    void drop(quint64 id) {
+        auto it = connections.find(id);
+        if (it == connections.end()) {
+            return;
+        }
+        // Недописанная последняя строка не подтверждена - отправитель повторит ее
+        it->second.socket->deleteLater();
+        connections.erase(it);
+        shared->connections.fetch_sub(1);
+    }
+
+    int index;
+    IngestShared *shared;
+    std::unordered_map<quint64, Connection> connections;
+};
+
+// Единственный писатель: собирает пакеты всех соединений в одну транзакцию
+class IngestCommitter : public QThread {
+public:
+    IngestCommitter(DataManager *dataManager, IngestShared *shared, const std::vector<IngestWorker*>& workers)
+        : dataManager(dataManager), shared(shared), workers(workers) {}
+
+protected:
+    void run() override {
+        std::vector<IngestChunk> group;
+        // После stop() очередь дописывается до конца
+        while (shared->accepting.load() || shared->queue.size() > 0) {
+            IngestChunk chunk;
+            if (!shared->queue.pop(chunk)) {
+                shared->pending.tryAcquire(1, 100);
+                continue;
+            }
+            QElapsedTimer window;
+            window.start();
+            group.clear();
+            int records = 0;
+            for (;;) {
+                records += static_cast<int>(chunk.calls.size()) + chunk.malformed;
+                group.push_back(std::move(chunk));
+                if (records >= MaxGroupRecords) {
+                    break;
+                }
+                // Пустая очередь - ждем других отправителей до конца окна
+                bool popped = false;
+                while (!(popped = shared->queue.pop(chunk))) {
+                    const qint64 left = GroupWindowMs - window.elapsed();
+                    if (left <= 0 || !shared->pending.tryAcquire(1, static_cast<int>(left))) {
+                        break;
+                    }
+                }
+                if (!popped) {
+                    break;
+                }
+            }
+            commit(group);
+        }
+    }
+
+private:
+    void commit(const std::vector<IngestChunk>& group) {
+        ATC_TIMED_OPERATION(timer, "ingestServer.groupCommit");
+        std::vector<DialedCall> batch;
+        std::vector<std::size_t> chunkOf;
+        for (std::size_t i = 0; i < group.size(); ++i) {
+            for (const DialedCall& call : group[i].calls) {
+                batch.push_back(call);
+                chunkOf.push_back(i);
+            }
+        }
+
+        RatingStats stats;
+        std::vector<std::size_t> origins;
+        const std::vector<Call> rated = dataManager->rateDialedCalls(batch, &stats, &origins);
+        std::vector<int> ratedInChunk(group.size(), 0);
+        for (std::size_t origin : origins) {
+            ++ratedInChunk[chunkOf[origin]];
+        }
+
+        std::vector<qint64> ids;
+        int duplicates = 0;
+        const int written = dataManager->writeCalls(rated, &ids, ProgressCallback(), &duplicates);
+        if (written < 0) {
+            // Ничего не записано: ACK не отправляется, отправители повторят строки
+            const QString message = dataManager->lastError();
+            for (const IngestChunk& chunk : group) {
+                IngestWorker *worker = workers[chunk.worker];
+                const quint64 connection = chunk.connection;
+                QMetaObject::invokeMethod(worker, [worker, connection, message]() {
+                    worker->reportError(connection, message);
+                }, Qt::QueuedConnection);
+            }
+            qCWarning(lcIngest) << "Прием CDR: пакет не записан:" << message;
+            return;
+        }
+        dataManager->adoptCalls(rated, ids);
+        // Поток записи здесь один - этот, уровни лояльности пишутся сразу
+        dataManager->saveLoyaltyTiers();
+        timer.addRows(written);
+
+        // Один ACK на соединение: последняя строка группы и отброшенные в ней
+        std::map<std::pair<int, quint64>, std::pair<qint64, int>> acks;
+        int rejected = 0;
+        for (std::size_t i = 0; i < group.size(); ++i) {
+            const IngestChunk& chunk = group[i];
+            const int dropped = chunk.malformed + static_cast<int>(chunk.calls.size()) - ratedInChunk[i];
+            auto& ack = acks[{chunk.worker, chunk.connection}];
+            ack.first = std::max(ack.first, chunk.lastLine);
+            ack.second += dropped;
+            rejected += dropped;
+        }
+        for (const auto& entry : acks) {
+            IngestWorker *worker = workers[entry.first.first];
+            const quint64 connection = entry.first.second;
+            const qint64 lines = entry.second.first;
+            const int dropped = entry.second.second;
+            QMetaObject::invokeMethod(worker, [worker, connection, lines, dropped]() {
+                worker->acknowledge(connection, lines, dropped);
+            }, Qt::QueuedConnection);
+        }
+
+        shared->committed.fetch_add(written);
+        shared->duplicates.fetch_add(duplicates);
+        shared->rejected.fetch_add(rejected);
+        shared->groups.fetch_add(1);
+    }
+
+    DataManager *dataManager;
+    IngestShared *shared;
+    std::vector<IngestWorker*> workers;
+};
+
+IngestServer::IngestServer(DataManager *dataManager, int ioThreads, QObject *parent)
+    : QLocalServer(parent), dataManager(dataManager), shared(std::make_shared<IngestShared>()) {
+    threadCount = ioThreads > 0 ? ioThreads : std::clamp(QThread::idealThreadCount(), 1, 8);
+}
+
+IngestServer::~IngestServer() {
+    stop();
+}
+
+bool IngestServer::start(const QString& name) {
+    stop();
+    shared = std::make_shared<IngestShared>();
+    // Сокет, оставшийся после аварийного завершения, мешает listen
+    QLocalServer::removeServer(name);
+    if (!listen(name)) {
+        return false;
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        auto *thread = new QThread();
+        auto *worker = new IngestWorker(i, shared.get());
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        thread->start();
+        workers.push_back(worker);
+        workerThreads.push_back(thread);
+    }
+    committer = new IngestCommitter(dataManager, shared.get(), workers);
+    committer->start();
+    qCInfo(lcIngest) << "Прием CDR: сокет" << fullServerName() << ", потоков ввода-вывода:" << threadCount;
+    return true;
+}
+
+void IngestServer::stop() {
+    if (!committer) {
+        return;
+    }
+    close();
+    shared->accepting.store(false);
+    shared->pending.release();
+    committer->wait();
+    delete committer;
+    committer = nullptr;
+
+    // Ответы потока записи уже в очередях событий рабочих и уйдут раньше закрытия
+    for (std::size_t i = 0; i < workers.size(); ++i) {
+        IngestWorker *worker = workers[i];
+        QMetaObject::invokeMethod(worker, [worker]() { worker->closeAll(); }, Qt::BlockingQueuedConnection);
+        workerThreads[i]->quit();
+        workerThreads[i]->wait();
+        delete workerThreads[i];
+    }
+    workers.clear();
+    workerThreads.clear();
+}
+
+IngestServerStats IngestServer::stats() const {
+    IngestServerStats result;
+    result.connections = shared->connections.load();
+    result.received = shared->received.load();
+    result.committed = shared->committed.load();
+    result.rejected = shared->rejected.load();
+    result.duplicates = shared->duplicates.load();
+    result.groups = shared->groups.load();
+    result.queued = static_cast<qint64>(shared->queue.size());
+    return result;
+}
+
+void IngestServer::incomingConnection(quintptr descriptor) {
+    if (workers.empty()) {
+        return;
+    }
+    IngestWorker *worker = workers[nextWorker];
+    nextWorker = (nextWorker + 1) % static_cast<int>(workers.size());
+    QMetaObject::invokeMethod(worker, [worker, descriptor]() { worker->accept(descriptor); }, Qt::QueuedConnection);
+}
+
+bool IngestClient::connectTo(const QString& name, int timeoutMs) {
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(timeoutMs)) {
+        error = socket.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool IngestClient::send(const std::vector<QByteArray>& lines) {
+    for (const QByteArray& line : lines) {
+        // Окно заполнено - ждем подтверждений, иначе сервер перестанет читать
+        while (sent - acked >= Window) {
+            if (!readReplies(30000)) {
+                return false;
+            }
+        }
+        socket.write(line);
+        socket.write("\n", 1);
+        ++sent;
+        if (sent % 1000 == 0) {
+            socket.waitForBytesWritten(0);
+            if (socket.bytesAvailable() > 0 && !readReplies(0)) {
+                return false;
+            }
+        }
+    }
+    socket.flush();
+    while (acked < sent) {
+        if (!readReplies(30000)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IngestClient::readReplies(int timeoutMs) {
+    // Без цикла событий данные уходят только в waitFor*
+    if (socket.bytesToWrite() > 0) {
+        socket.waitForBytesWritten(timeoutMs);
+    }
+    if (!socket.canReadLine() && !socket.waitForReadyRead(timeoutMs)) {
+        if (timeoutMs > 0) {
+            error = "нет подтверждения от сервера: " + socket.errorString();
+            return false;
+        }
+        return true;
+    }
+    while (socket.canReadLine()) {
+        const QByteArray reply = socket.readLine().trimmed();
+        if (reply.startsWith("ERR ")) {
+            error = QString::fromUtf8(reply.mid(4));
+            return false;
+        }
+        const QList<QByteArray> parts = reply.split(' ');
+        if (parts.size() != 3 || parts[0] != "ACK") {
+            error = "неизвестный ответ сервера: " + QString::fromUtf8(reply);
+            return false;
+        }
+        acked = parts[1].toLongLong();
+        rejectedLines += parts[2].toLongLong();
+    }
+    return true;
+}
+
+qint64 IngestClient::acknowledged() const {
+    return acked;
+}
+
+qint64 IngestClient::rejected() const {
+    return rejectedLines;
+}
+
+QString IngestClient::errorString() const {
+    return error;
+}
@@ -0,0 +1,89 @@
+#ifndef INGESTSERVER_H
+#define INGESTSERVER_H
+
+#include <memory>
+#include <vector>
+#include <QByteArray>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QString>
+
+#include "DataManager.h"
+
+class IngestWorker;
+class IngestCommitter;
+struct IngestShared;
+
+// Счетчики сервера приема (снимок, читается из любого потока)
+struct IngestServerStats {
+    qint64 connections = 0;   // открыто сейчас
+    qint64 received = 0;      // строк принято от отправителей
+    qint64 committed = 0;     // звонков записано
+    qint64 rejected = 0;      // неизвестный абонент, нет маршрута, ошибка формата
+    qint64 duplicates = 0;
+    qint64 groups = 0;        // групповых фиксаций
+    qint64 queued = 0;        // пакетов строк ждут записи
+};
+
+// Прием CDR от процессов медиации через локальный сокет (Unix domain socket, в Windows -
+// именованный канал). Протокол - строки parseDialedCall, по строке на CDR. Соединения
+// распределяются по нескольким потокам ввода-вывода; разобранные строки идут через
+// очередь без блокировок (MpscQueue) в один поток записи, который собирает строки
+// всех отправителей в одну транзакцию (групповая фиксация) и только после нее
+// отвечает каждому "ACK <n> <r>": n - сколько его строк (включая пустые) обработано с начала
+// соединения, r - сколько из подтвержденных сейчас отброшено. Строки после последнего
+// ACK не записаны: после обрыва их отправляют заново (повторы отсекает ключ CDR).
+// Ошибка записи - "ERR <текст>" без ACK, после чего сервер закрывает соединение.
+//
+// DataManager на время работы сервера принадлежит потоку записи: тарификация и
+// добавление звонков в память идут только в нем.
+class IngestServer : public QLocalServer {
+    Q_OBJECT
+
+public:
+    // ioThreads = 0 - по числу ядер (не больше 8)
+    explicit IngestServer(DataManager *dataManager, int ioThreads = 0, QObject *parent = nullptr);
+    ~IngestServer();
+
+    bool start(const QString& name);
+    // Дописывает очередь, отправляет последние ACK и закрывает соединения
+    void stop();
+    IngestServerStats stats() const;
+
+protected:
+    void incomingConnection(quintptr descriptor) override;
+
+private:
+    DataManager *dataManager;
+    std::shared_ptr<IngestShared> shared;
+    std::vector<IngestWorker*> workers;
+    std::vector<QThread*> workerThreads;
+    IngestCommitter *committer = nullptr;
+    int nextWorker = 0;
+    int threadCount;
+};
+
+// Отправитель для atc-cli send и bench-ingest: строки идут потоком, не дожидаясь
+// подтверждений, пока неподтвержденных не больше окна. Блокирующий, для рабочих потоков.
+class IngestClient {
+public:
+    bool connectTo(const QString& name, int timeoutMs = 5000);
+    // Отправляет строки (без перевода строки) и ждет подтверждения всех
+    bool send(const std::vector<QByteArray>& lines);
+    qint64 acknowledged() const;
+    qint64 rejected() const;
+    QString errorString() const;
+
+private:
+    bool readReplies(int timeoutMs);
+
+    static const int Window = 20000;
+
+    QLocalSocket socket;
+    qint64 sent = 0;
+    qint64 acked = 0;
+    qint64 rejectedLines = 0;
+    QString error;
+};
+
+#endif
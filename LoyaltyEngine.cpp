@@ -0,0 +1,233 @@
+#include "LoyaltyEngine.h"
+#include <algorithm>
+#include <ctime>
+
+namespace {
+
+// Пороги - траты в рублях за окно (с учетом уже действующей скидки)
+const LoyaltyTier Tiers[LoyaltyEngine::TierCount] = {
+    {"Базовый", 0.0, 0.0},
+    {"Серебряный", 1000.0, 5.0},
+    {"Золотой", 5000.0, 10.0},
+    {"Платиновый", 20000.0, 15.0},
+};
+
+// Сумма, собранная из дробных стоимостей, может недотянуть до порога на ошибку округления
+const double SpendEpsilon = 1e-6;
+
+} // namespace
+
+const LoyaltyTier& LoyaltyEngine::tier(int level) {
+    return Tiers[std::clamp(level, 0, TierCount - 1)];
+}
+
+int LoyaltyEngine::tierForSpend(double spend) {
+    int level = 0;
+    while (level + 1 < TierCount && spend + SpendEpsilon >= Tiers[level + 1].minSpend) {
+        ++level;
+    }
+    return level;
+}
+
+void LoyaltyEngine::clear() {
+    windows.clear();
+    expiries = decltype(expiries)();
+    changed.clear();
+    today = 0;
+}
+
+void LoyaltyEngine::track(std::uint32_t clientId, int tier) {
+    Window& window = windows[clientId];
+    window.savedTier = static_cast<std::uint8_t>(std::clamp(tier, 0, TierCount - 1));
+    updateTier(clientId, window);
+}
+
+void LoyaltyEngine::forget(std::uint32_t clientId) {
+    // Записи в очереди сроков и в changed пропускаются, когда до них дойдет очередь
+    windows.erase(clientId);
+}
+
+void LoyaltyEngine::rename(std::uint32_t from, std::uint32_t to) {
+    const auto it = windows.find(from);
+    if (from == to || it == windows.end()) {
+        return;
+    }
+    Window window = std::move(it->second);
+    windows.erase(it);
+    window.listed = false;
+    Window& moved = windows[to] = std::move(window);
+    if (!moved.days.empty()) {
+        expiries.push({moved.days.front().day + WindowDays, to});
+    }
+    updateTier(to, moved);
+}
+
+bool LoyaltyEngine::isTracked(std::uint32_t clientId) const {
+    return windows.count(clientId) != 0;
+}
+
+bool LoyaltyEngine::record(std::uint32_t clientId, std::int64_t startTime, double cost) {
+    const auto it = windows.find(clientId);
+    if (it == windows.end() || startTime <= 0) {
+        return false;
+    }
+    const std::int64_t day = startTime / SecondsPerDay;
+    if (day > today) {
+        if (day > static_cast<std::int64_t>(std::time(nullptr)) / SecondsPerDay + FutureDays) {
+            return false;
+        }
+        advance(day);
+    }
+    if (day <= today - WindowDays) {
+        return false;
+    }
+
+    // Звонки приходят почти по порядку: обычно это последний день абонента или новый
+    Window& window = it->second;
+    auto position = window.days.end();
+    if (!window.days.empty() && window.days.back().day >= day) {
+        position = std::lower_bound(window.days.begin(), window.days.end(), day,
+                                    [](const DaySpend& entry, std::int64_t value) { return entry.day < value; });
+    }
+    if (position != window.days.end() && position->day == day) {
+        position->spend += cost;
+    } else {
+        // В очереди сроков у абонента только самый ранний день
+        if (position == window.days.begin()) {
+            expiries.push({day + WindowDays, clientId});
+        }
+        window.days.insert(position, {day, cost});
+    }
+    window.spend += cost;
+    updateTier(clientId, window);
+    return true;
+}
+
+bool LoyaltyEngine::unrecord(std::uint32_t clientId, std::int64_t startTime, double cost) {
+    const auto it = windows.find(clientId);
+    if (it == windows.end() || startTime <= 0) {
+        return false;
+    }
+    const std::int64_t day = startTime / SecondsPerDay;
+    Window& window = it->second;
+    const auto position = std::lower_bound(window.days.begin(), window.days.end(), day,
+                                           [](const DaySpend& entry, std::int64_t value) { return entry.day < value; });
+    // Дня нет - он уже вышел из окна, и звонок из суммы вычтен
+    if (position == window.days.end() || position->day != day) {
+        return false;
+    }
+    position->spend -= cost;
+    if (position->spend <= SpendEpsilon) {
+        const bool front = position == window.days.begin();
+        window.days.erase(position);
+        // Запись очереди для удаленного дня устареет сама; новому первому дню нужна своя
+        if (front && !window.days.empty()) {
+            expiries.push({window.days.front().day + WindowDays, clientId});
+        }
+    }
+    recount(window);
+    updateTier(clientId, window);
+    return true;
+}
+
+int LoyaltyEngine::tierOf(std::uint32_t clientId) const {
+    const auto it = windows.find(clientId);
+    return it != windows.end() ? it->second.tier : 0;
+}
+
+double LoyaltyEngine::spendOf(std::uint32_t clientId) const {
+    const auto it = windows.find(clientId);
+    return it != windows.end() ? it->second.spend : 0.0;
+}
+
+std::int64_t LoyaltyEngine::currentDay() const {
+    return today;
+}
+
+std::size_t LoyaltyEngine::clientCount() const {
+    return windows.size();
+}
+
+std::vector<TierChange> LoyaltyEngine::changes() const {
+    std::vector<TierChange> result;
+    for (std::uint32_t clientId : changed) {
+        const auto it = windows.find(clientId);
+        if (it != windows.end() && it->second.tier != it->second.savedTier) {
+            result.push_back({clientId, it->second.tier});
+        }
+    }
+    std::sort(result.begin(), result.end(),
+              [](const TierChange& a, const TierChange& b) { return a.clientId < b.clientId; });
+    result.erase(std::unique(result.begin(), result.end(),
+                             [](const TierChange& a, const TierChange& b) { return a.clientId == b.clientId; }),
+                 result.end());
+    return result;
+}
+
+void LoyaltyEngine::markSaved(const std::vector<TierChange>& saved) {
+    for (const TierChange& change : saved) {
+        const auto it = windows.find(change.clientId);
+        if (it != windows.end()) {
+            it->second.savedTier = change.tier;
+        }
+    }
+    // В списке остаются те, чей уровень успел измениться еще раз
+    std::size_t kept = 0;
+    for (std::uint32_t clientId : changed) {
+        const auto it = windows.find(clientId);
+        if (it == windows.end()) {
+            continue;
+        }
+        if (it->second.tier != it->second.savedTier) {
+            changed[kept++] = clientId;
+        } else {
+            it->second.listed = false;
+        }
+    }
+    changed.resize(kept);
+}
+
+void LoyaltyEngine::advance(std::int64_t day) {
+    today = day;
+    while (!expiries.empty() && expiries.top().first <= today) {
+        const std::uint32_t clientId = expiries.top().second;
+        expiries.pop();
+        const auto it = windows.find(clientId);
+        if (it != windows.end()) {
+            expire(clientId, it->second);
+        }
+    }
+}
+
+void LoyaltyEngine::expire(std::uint32_t clientId, Window& window) {
+    const std::int64_t first = today - WindowDays + 1;
+    const auto end = std::find_if(window.days.begin(), window.days.end(),
+                                  [first](const DaySpend& entry) { return entry.day >= first; });
+    // Ничего не вышло - запись очереди устарела: раньше в окно попал более ранний день
+    if (end == window.days.begin()) {
+        return;
+    }
+    window.days.erase(window.days.begin(), end);
+    if (!window.days.empty()) {
+        expiries.push({window.days.front().day + WindowDays, clientId});
+    }
+    recount(window);
+    updateTier(clientId, window);
+}
+
+void LoyaltyEngine::recount(Window& window) {
+    // Сумма пересчитывается по дням (их не больше WindowDays), чтобы вычитания не
+    // копили ошибку округления
+    window.spend = 0.0;
+    for (const DaySpend& entry : window.days) {
+        window.spend += entry.spend;
+    }
+}
+
+void LoyaltyEngine::updateTier(std::uint32_t clientId, Window& window) {
+    window.tier = static_cast<std::uint8_t>(tierForSpend(window.spend));
+    if (window.tier != window.savedTier && !window.listed) {
+        window.listed = true;
+        changed.push_back(clientId);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef LOYALTYENGINE_H
+#define LOYALTYENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Уровень программы лояльности: с какой суммы трат за окно он дается и скидка VIP на нем
+struct LoyaltyTier {
+    const char* name;
+    double minSpend;
+    double discount;
+};
+
+// Новый уровень абонента (LoyaltyEngine::changes)
+struct TierChange {
+    std::uint32_t clientId;
+    std::uint8_t tier;
+};
+
+// Уровни лояльности по тратам за скользящее окно в WindowDays дней.
+// У абонента хранятся суммы только по дням, в которые он звонил, и их общая сумма:
+// звонок прибавляется к сумме своего дня (удаленный - вычитается из нее), день,
+// вышедший из окна, вычитается.
+// Какие абоненты затронуты сдвигом окна, видно по очереди сроков (min-куча по дню
+// выхода самого раннего дня абонента), поэтому ни звонок, ни сдвиг не обходят всех абонентов.
+// Время окна - самое позднее начало учтенного звонка, а не часы машины: CDR
+// загружаются и задним числом. Звонок позже текущих суток машины больше чем на
+// FutureDays не учитывается: один CDR с неверным временем сдвинул бы окно вперед
+// и сбросил бы траты всех абонентов. Клиент - любой 32-битный ключ (id имени в пуле строк).
+class LoyaltyEngine {
+public:
+    static const int WindowDays = 30;
+    static const int TierCount = 4;
+    static const std::int64_t SecondsPerDay = 86400;
+    // Допуск на часовые пояса и расхождение часов АТС и машины
+    static const int FutureDays = 1;
+
+    // Уровни по возрастанию порога; 0 - базовый, с него начинает каждый абонент
+    static const LoyaltyTier& tier(int level);
+    static int tierForSpend(double spend);
+
+    void clear();
+    // Абонент, чьи звонки учитываются; tier - уровень, уже сохраненный в БД:
+    // изменением считается только отличие от него
+    void track(std::uint32_t clientId, int tier);
+    void forget(std::uint32_t clientId);
+    // Новый ключ того же абонента (переименование) с накопленными тратами
+    void rename(std::uint32_t from, std::uint32_t to);
+    bool isTracked(std::uint32_t clientId) const;
+
+    // Звонок абонента на сумму cost, начавшийся в startTime. false - не учтен:
+    // абонент не отслеживается, звонок старше окна, из будущего или его время неизвестно (0)
+    bool record(std::uint32_t clientId, std::int64_t startTime, double cost);
+    // Удаленный звонок: его стоимость вычитается из суммы его дня. false - звонок
+    // не входил в окно (или абонент не отслеживается)
+    bool unrecord(std::uint32_t clientId, std::int64_t startTime, double cost);
+
+    int tierOf(std::uint32_t clientId) const;
+    double spendOf(std::uint32_t clientId) const;
+    // Текущий день окна (дни от эпохи Unix)
+    std::int64_t currentDay() const;
+    std::size_t clientCount() const;
+
+    // Абоненты, чей уровень отличается от сохраненного (track или markSaved), по id
+    std::vector<TierChange> changes() const;
+    // Уровни записаны в БД; при ошибке записи не вызывается, и изменения остаются
+    void markSaved(const std::vector<TierChange>& saved);
+
+private:
+    struct DaySpend {
+        std::int64_t day;
+        double spend;
+    };
+
+    struct Window {
+        std::vector<DaySpend> days;     // по возрастанию дня
+        double spend = 0.0;
+        std::uint8_t tier = 0;
+        std::uint8_t savedTier = 0;
+        bool listed = false;            // уже в списке changed
+    };
+
+    // День, с которого сумма дня уже не входит в окно, и абонент
+    using Expiry = std::pair<std::int64_t, std::uint32_t>;
+
+    void advance(std::int64_t day);
+    void expire(std::uint32_t clientId, Window& window);
+    void recount(Window& window);
+    void updateTier(std::uint32_t clientId, Window& window);
+
+    std::unordered_map<std::uint32_t, Window> windows;
+    std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry>> expiries;
+    // Абоненты, у которых уровень менялся после сохранения (могут быть повторы)
+    std::vector<std::uint32_t> changed;
+    std::int64_t today = 0;
+};
+
+#endif
@@ -10,12 +10,7 @@ LoyaltyProgram::LoyaltyProgram()
 
 // Параметризованный конструктор
 LoyaltyProgram::LoyaltyProgram(const string& status, double discount)
-    : Person(), vipStatus(status), discountPercent(discount) {
-    
-    // Валидация процента скидки
-    if (discountPercent < 0) discountPercent = 0;
-    if (discountPercent > 50) discountPercent = 50;
-}
+    : Person(), vipStatus(status), discountPercent(clampDiscount(discount)) {}
 
 // Деструктор
 LoyaltyProgram::~LoyaltyProgram() {}
@@ -35,9 +30,13 @@ void LoyaltyProgram::setVIPStatus(const string& status) {
 }
 
 void LoyaltyProgram::setDiscountPercent(double discount) {
-    if (discount < 0) discount = 0;
-    if (discount > 50) discount = 50;
-    this->discountPercent = discount;
+    this->discountPercent = clampDiscount(discount);
+}
+
+double LoyaltyProgram::clampDiscount(double discount) {
+    if (discount < 0) return 0;
+    if (discount > 50) return 50;
+    return discount;
 }
 
 double LoyaltyProgram::applyDiscount(double price) const {
@@ -24,6 +24,9 @@ public:
     void setVIPStatus(const std::string& status);
     void setDiscountPercent(double discount);
     
+    // Скидка в допустимых пределах программы (0-50%)
+    static double clampDiscount(double discount);
+
     // Применение скидки к цене
     double applyDiscount(double price) const;
     
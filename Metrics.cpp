@@ -0,0 +1,203 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+void OperationHistogram::record(std::uint64_t nanos, std::uint64_t rows) {
+    buckets[bucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+    sumNanos.fetch_add(nanos, std::memory_order_relaxed);
+    if (rows) {
+        rowsTouched.fetch_add(rows, std::memory_order_relaxed);
+    }
+
+    std::uint64_t current = max.load(std::memory_order_relaxed);
+    while (nanos > current && !max.compare_exchange_weak(current, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+void OperationHistogram::addRows(std::uint64_t rows) {
+    rowsTouched.fetch_add(rows, std::memory_order_relaxed);
+}
+
+void OperationHistogram::reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    samples.store(0, std::memory_order_relaxed);
+    sumNanos.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+    rowsTouched.store(0, std::memory_order_relaxed);
+}
+
+std::uint64_t OperationHistogram::count() const {
+    return samples.load(std::memory_order_relaxed);
+}
+
+std::uint64_t OperationHistogram::totalNanos() const {
+    return sumNanos.load(std::memory_order_relaxed);
+}
+
+std::uint64_t OperationHistogram::maxNanos() const {
+    return max.load(std::memory_order_relaxed);
+}
+
+std::uint64_t OperationHistogram::rows() const {
+    return rowsTouched.load(std::memory_order_relaxed);
+}
+
+std::uint64_t OperationHistogram::percentileNanos(double quantile) const {
+    std::uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    std::uint64_t rank = static_cast<std::uint64_t>(quantile * static_cast<double>(total));
+    if (rank >= total) {
+        rank = total - 1;
+    }
+
+    std::uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen > rank) {
+            // Верхняя граница корзины, но не больше наблюдавшегося максимума
+            std::uint64_t upper = (i + 1 < BucketCount) ? bucketLowerBound(i + 1) - 1 : maxNanos();
+            return std::min(upper, maxNanos());
+        }
+    }
+    return maxNanos();
+}
+
+int OperationHistogram::bucketIndex(std::uint64_t nanos) {
+    if (nanos < 4) {
+        return static_cast<int>(nanos);
+    }
+#if defined(_MSC_VER)
+    unsigned long highBit = 0;
+    _BitScanReverse64(&highBit, nanos);
+    int exponent = static_cast<int>(highBit);
+#else
+    int exponent = 63 - __builtin_clzll(nanos);
+#endif
+    int mantissa = static_cast<int>((nanos >> (exponent - 2)) & 3);
+    return 4 + (exponent - 2) * 4 + mantissa;
+}
+
+std::uint64_t OperationHistogram::bucketLowerBound(int index) {
+    if (index < 4) {
+        return static_cast<std::uint64_t>(index);
+    }
+    int exponent = (index - 4) / 4 + 2;
+    std::uint64_t mantissa = static_cast<std::uint64_t>((index - 4) % 4);
+    return (4 + mantissa) << (exponent - 2);
+}
+
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+OperationHistogram& MetricsRegistry::operation(const std::string& name) {
+    return histogram("operation", name);
+}
+
+OperationHistogram& MetricsRegistry::sql(const std::string& name) {
+    return histogram("sql", name);
+}
+
+OperationHistogram& MetricsRegistry::histogram(const std::string& kind, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = histograms[{kind, name}];
+    if (!slot) {
+        slot.reset(new OperationHistogram());
+    }
+    return *slot;
+}
+
+std::vector<MetricSnapshot> MetricsRegistry::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<MetricSnapshot> result;
+    result.reserve(histograms.size());
+    for (const auto& entry : histograms) {
+        const OperationHistogram& h = *entry.second;
+        result.push_back({entry.first.first, entry.first.second, h.count(), h.totalNanos(),
+                          h.percentileNanos(0.50), h.percentileNanos(0.99), h.maxNanos(), h.rows()});
+    }
+    return result;
+}
+
+void MetricsRegistry::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : histograms) {
+        entry.second->reset();
+    }
+}
+
+namespace {
+
+std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char ch : value) {
+        if (ch == '\\' || ch == '"') {
+            escaped += '\\';
+            escaped += ch;
+        } else if (ch == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += ch;
+        }
+    }
+    return escaped;
+}
+
+std::string seconds(std::uint64_t nanos) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9f", static_cast<double>(nanos) / 1e9);
+    return buffer;
+}
+
+} // namespace
+
+std::string MetricsRegistry::toPrometheusText() const {
+    std::vector<MetricSnapshot> metrics = snapshot();
+    std::ostringstream out;
+
+    for (const std::string kind : {"operation", "sql"}) {
+        const std::string family = "atc_" + kind;
+        const std::string label = (kind == "sql") ? "statement" : "op";
+
+        out << "# HELP " << family << "_duration_seconds Latency of " << kind << " calls.\n";
+        out << "# TYPE " << family << "_duration_seconds summary\n";
+        for (const auto& m : metrics) {
+            if (m.kind != kind) continue;
+            std::string labels = label + "=\"" + escapeLabel(m.name) + "\"";
+            out << family << "_duration_seconds{" << labels << ",quantile=\"0.5\"} " << seconds(m.p50Nanos) << "\n";
+            out << family << "_duration_seconds{" << labels << ",quantile=\"0.99\"} " << seconds(m.p99Nanos) << "\n";
+            out << family << "_duration_seconds_sum{" << labels << "} " << seconds(m.totalNanos) << "\n";
+            out << family << "_duration_seconds_count{" << labels << "} " << m.count << "\n";
+        }
+
+        out << "# HELP " << family << "_duration_max_seconds Slowest observed " << kind << " call.\n";
+        out << "# TYPE " << family << "_duration_max_seconds gauge\n";
+        for (const auto& m : metrics) {
+            if (m.kind != kind) continue;
+            out << family << "_duration_max_seconds{" << label << "=\"" << escapeLabel(m.name) << "\"} "
+                << seconds(m.maxNanos) << "\n";
+        }
+
+        out << "# HELP " << family << "_rows_total Rows touched by " << kind << " calls.\n";
+        out << "# TYPE " << family << "_rows_total counter\n";
+        for (const auto& m : metrics) {
+            if (m.kind != kind) continue;
+            out << family << "_rows_total{" << label << "=\"" << escapeLabel(m.name) << "\"} " << m.rows << "\n";
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,106 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Гистограмма задержек с логарифмическими корзинами (4 корзины на степень двойки,
+// погрешность перцентилей ~20%). Запись - несколько relaxed-атомиков, без блокировок.
+class OperationHistogram {
+public:
+    static const int BucketCount = 252;
+
+    void record(std::uint64_t nanos, std::uint64_t rows = 0);
+    void addRows(std::uint64_t rows);
+    void reset();
+
+    std::uint64_t count() const;
+    std::uint64_t totalNanos() const;
+    std::uint64_t maxNanos() const;
+    std::uint64_t rows() const;
+    // Верхняя граница корзины, в которую попадает заданный перцентиль (0..1)
+    std::uint64_t percentileNanos(double quantile) const;
+
+    static int bucketIndex(std::uint64_t nanos);
+    static std::uint64_t bucketLowerBound(int index);
+
+private:
+    std::array<std::atomic<std::uint64_t>, BucketCount> buckets{};
+    std::atomic<std::uint64_t> samples{0};
+    std::atomic<std::uint64_t> sumNanos{0};
+    std::atomic<std::uint64_t> max{0};
+    std::atomic<std::uint64_t> rowsTouched{0};
+};
+
+// Снимок одной метрики для диалога диагностики и экспорта
+struct MetricSnapshot {
+    std::string kind;   // "operation" - метод DataManager, "sql" - SQL-выражение
+    std::string name;
+    std::uint64_t count;
+    std::uint64_t totalNanos;
+    std::uint64_t p50Nanos;
+    std::uint64_t p99Nanos;
+    std::uint64_t maxNanos;
+    std::uint64_t rows;
+};
+
+// Реестр всех гистограмм процесса. Гистограммы никогда не удаляются,
+// поэтому ссылку можно закэшировать в static-переменной в месте вызова.
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    OperationHistogram& operation(const std::string& name);
+    OperationHistogram& sql(const std::string& name);
+
+    std::vector<MetricSnapshot> snapshot() const;
+    void reset();
+
+    // Текстовый формат экспозиции Prometheus (для textfile collector)
+    std::string toPrometheusText() const;
+
+private:
+    MetricsRegistry() = default;
+    OperationHistogram& histogram(const std::string& kind, const std::string& name);
+
+    mutable std::mutex mutex;
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<OperationHistogram>> histograms;
+};
+
+// Замер длительности области видимости
+class ScopedTimer {
+public:
+    explicit ScopedTimer(OperationHistogram& histogram)
+        : histogram(histogram), started(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        histogram.record(static_cast<std::uint64_t>(
+                             std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                         rows);
+    }
+
+    void addRows(std::uint64_t count) { rows += count; }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    OperationHistogram& histogram;
+    std::chrono::steady_clock::time_point started;
+    std::uint64_t rows = 0;
+};
+
+// Замер операции: гистограмма ищется в реестре один раз на место вызова
+#define ATC_TIMED_OPERATION(timer, name) \
+    static OperationHistogram& timer##Histogram = MetricsRegistry::instance().operation(name); \
+    ScopedTimer timer(timer##Histogram)
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Очередь без блокировок: много производителей, один потребитель (схема Вьюкова).
+// push - один atomic exchange и одна запись указателя, без мьютекса и без ожидания
+// других производителей. Порядок элементов одного производителя сохраняется.
+// Между exchange и записью next производитель на мгновение "разрывает" цепочку:
+// потребитель тогда видит очередь короче, чем она есть, и дочитает ее в следующий раз.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head(new Node()), tail(head.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Любой поток
+    void push(T value) {
+        Node *node = new Node();
+        node->value = std::move(value);
+        // Счетчик - до публикации узла: иначе потребитель успел бы его забрать и
+        // вычесть раньше, чем он прибавлен, и size_t ушел бы через ноль
+        count.fetch_add(1, std::memory_order_relaxed);
+        Node *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Только поток-потребитель; false - очередь пуста
+    bool pop(T& value) {
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+        count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Приблизительная длина (для ограничения притока)
+    std::size_t size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Node {
+        T value{};
+        std::atomic<Node*> next{nullptr};
+    };
+
+    // Производители и потребитель пишут в разные строки кэша
+    alignas(64) std::atomic<Node*> head;
+    alignas(64) Node *tail;
+    alignas(64) std::atomic<std::size_t> count{0};
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "RoutingTable.h"
+#include <algorithm>
+
+namespace {
+
+const std::uint64_t Powers[] = {1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+                                100000000ull, 1000000000ull, 10000000000ull, 100000000000ull,
+                                1000000000000ull, 10000000000000ull, 100000000000000ull,
+                                1000000000000000ull};
+
+// Номер или префикс, дополненный нулями до 15 цифр; false - не цифры или слишком длинный
+bool paddedKey(std::string_view digits, std::uint64_t* key) {
+    if (digits.empty() || digits.size() > static_cast<std::size_t>(RoutingTable::MaxDigits)) {
+        return false;
+    }
+    std::uint64_t value = 0;
+    for (char c : digits) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<std::uint64_t>(c - '0');
+    }
+    *key = value * Powers[RoutingTable::MaxDigits - digits.size()];
+    return true;
+}
+
+} // namespace
+
+std::string RoutingTable::normalizeNumber(std::string_view number) {
+    std::string digits;
+    for (char c : number) {
+        if (c >= '0' && c <= '9') {
+            digits += c;
+        } else if (c != '+' && c != '-' && c != '(' && c != ')' && c != ' ') {
+            return std::string();
+        }
+    }
+    if (digits.size() > static_cast<std::size_t>(MaxDigits)) {
+        return std::string();
+    }
+    return digits;
+}
+
+void RoutingTable::build(const std::vector<std::pair<std::string, int>>& prefixes) {
+    struct Range {
+        std::uint64_t low;
+        std::uint64_t high;
+        int target;
+        std::uint8_t length;
+    };
+    std::vector<Range> ranges;
+    ranges.reserve(prefixes.size());
+    sortedPrefixes.clear();
+    for (const auto& prefix : prefixes) {
+        std::uint64_t low = 0;
+        if (prefix.second >= 0 && paddedKey(prefix.first, &low)) {
+            ranges.push_back({low, low + Powers[MaxDigits - prefix.first.size()], prefix.second,
+                              static_cast<std::uint8_t>(prefix.first.size())});
+            sortedPrefixes.push_back(prefix);
+        }
+    }
+    // Повтор префикса: действует последний, как и при развороте диапазонов ниже
+    std::stable_sort(sortedPrefixes.begin(), sortedPrefixes.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::size_t unique = 0;
+    for (std::size_t i = 0; i < sortedPrefixes.size(); ++i) {
+        if (unique > 0 && sortedPrefixes[unique - 1].first == sortedPrefixes[i].first) {
+            sortedPrefixes[unique - 1] = std::move(sortedPrefixes[i]);
+        } else {
+            if (unique != i) {
+                sortedPrefixes[unique] = std::move(sortedPrefixes[i]);
+            }
+            ++unique;
+        }
+    }
+    sortedPrefixes.resize(unique);
+    // Диапазоны префиксов либо вложены, либо не пересекаются: при обходе по началу
+    // (внешний раньше вложенного) открытые диапазоны образуют стек
+    std::stable_sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+        return a.low != b.low ? a.low < b.low : a.high > b.high;
+    });
+
+    starts.clear();
+    targets.clear();
+    lengths.clear();
+    auto emit = [this](std::uint64_t start, int target, std::uint8_t length) {
+        if (!starts.empty() && starts.back() == start) {
+            targets.back() = target;
+            lengths.back() = length;
+            if (targets.size() >= 2 && targets[targets.size() - 2] == target &&
+                lengths[lengths.size() - 2] == length) {
+                starts.pop_back();
+                targets.pop_back();
+                lengths.pop_back();
+            }
+        } else if (targets.empty() || targets.back() != target || lengths.back() != length) {
+            starts.push_back(start);
+            targets.push_back(target);
+            lengths.push_back(length);
+        }
+    };
+
+    std::vector<const Range*> open;
+    auto close = [&open, &emit]() {
+        const Range* range = open.back();
+        open.pop_back();
+        if (open.empty()) {
+            emit(range->high, -1, 0);
+        } else {
+            emit(range->high, open.back()->target, open.back()->length);
+        }
+    };
+    emit(0, -1, 0);
+    for (const Range& range : ranges) {
+        while (!open.empty() && open.back()->high <= range.low) {
+            close();
+        }
+        emit(range.low, range.target, range.length);
+        open.push_back(&range);
+    }
+    while (!open.empty()) {
+        close();
+    }
+    starts.shrink_to_fit();
+    targets.shrink_to_fit();
+    lengths.shrink_to_fit();
+    built = true;
+}
+
+bool RoutingTable::isBuilt() const {
+    return built;
+}
+
+void RoutingTable::clear() {
+    starts.clear();
+    targets.clear();
+    lengths.clear();
+    sortedPrefixes.clear();
+    built = false;
+}
+
+int RoutingTable::route(std::string_view digits) const {
+    std::uint64_t key = 0;
+    if (starts.empty() || !paddedKey(digits, &key)) {
+        return -1;
+    }
+    const std::size_t segment = static_cast<std::size_t>(std::upper_bound(starts.begin(), starts.end(), key) -
+                                                         starts.begin()) - 1;
+    return lengths[segment] <= digits.size() ? targets[segment] : routeShort(digits);
+}
+
+int RoutingTable::routeShort(std::string_view digits) const {
+    for (std::size_t length = digits.size(); length > 0; --length) {
+        const std::string_view prefix = digits.substr(0, length);
+        const auto it = std::lower_bound(sortedPrefixes.begin(), sortedPrefixes.end(), prefix,
+                                         [](const auto& entry, std::string_view value) { return entry.first < value; });
+        if (it != sortedPrefixes.end() && it->first == prefix) {
+            return it->second;
+        }
+    }
+    return -1;
+}
+
+void RoutingTable::route(const std::vector<std::string_view>& numbers, std::vector<int>* routes) const {
+    routes->assign(numbers.size(), -1);
+    if (starts.empty()) {
+        return;
+    }
+    std::vector<std::pair<std::uint64_t, std::size_t>> keys;
+    keys.reserve(numbers.size());
+    for (std::size_t i = 0; i < numbers.size(); ++i) {
+        std::uint64_t key = 0;
+        if (paddedKey(numbers[i], &key)) {
+            keys.emplace_back(key, i);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // starts[0] == 0, поэтому отрезок для любого номера существует
+    auto from = starts.begin();
+    for (const auto& key : keys) {
+        from = std::upper_bound(from, starts.end(), key.first) - 1;
+        const std::size_t segment = static_cast<std::size_t>(from - starts.begin());
+        const std::string_view digits = numbers[key.second];
+        (*routes)[key.second] = lengths[segment] <= digits.size() ? targets[segment] : routeShort(digits);
+    }
+}
+
+std::size_t RoutingTable::rangeCount() const {
+    return starts.size();
+}
+
+std::size_t RoutingTable::memoryUsage() const {
+    std::size_t bytes = starts.capacity() * sizeof(std::uint64_t) + targets.capacity() * sizeof(int) +
+                        lengths.capacity() + sortedPrefixes.capacity() * sizeof(std::pair<std::string, int>);
+    for (const auto& prefix : sortedPrefixes) {
+        bytes += prefix.first.capacity();
+    }
+    return bytes;
+}
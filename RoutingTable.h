@@ -0,0 +1,57 @@
+#ifndef ROUTINGTABLE_H
+#define ROUTINGTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Префикс номера E.164 и направление (город тарифа), куда он ведет
+struct TariffPrefix {
+    std::string prefix;
+    std::string city;
+};
+
+// Маршрутизация по самому длинному префиксу номера. Номер - до 15 цифр (E.164),
+// дополненный нулями справа до 15 знаков, поэтому префикс - диапазон чисел
+// [p * 10^k, (p + 1) * 10^k). Вложенные диапазоны при построении разворачиваются
+// в непересекающиеся отрезки, у каждого - направление самого длинного префикса,
+// и поиск сводится к двоичному поиску начала отрезка. Номер короче найденного
+// префикса (дополнение нулями совпало с его хвостом) проверяется по самим префиксам.
+class RoutingTable {
+public:
+    static const int MaxDigits = 15;
+
+    // Цифры номера: "+7 (495) 123-45-67" -> "74951234567"; пустая строка, если это
+    // не номер (буквы, больше 15 цифр)
+    static std::string normalizeNumber(std::string_view number);
+
+    // prefixes - нормализованные префиксы и номер направления (target >= 0)
+    void build(const std::vector<std::pair<std::string, int>>& prefixes);
+    bool isBuilt() const;
+    void clear();
+
+    // Направление номера (нормализованного) или -1, если ни один префикс не подходит
+    int route(std::string_view digits) const;
+    // Пакет номеров: поиск идет по возрастанию номеров, и каждый следующий двоичный
+    // поиск начинается с отрезка предыдущего номера. routes[i] - для numbers[i].
+    void route(const std::vector<std::string_view>& numbers, std::vector<int>* routes) const;
+
+    std::size_t rangeCount() const;
+    std::size_t memoryUsage() const;
+
+private:
+    int routeShort(std::string_view digits) const;
+
+    // Отрезок [starts[i], starts[i + 1]) ведет в targets[i] по префиксу длины lengths[i]
+    std::vector<std::uint64_t> starts;
+    std::vector<int> targets;
+    std::vector<std::uint8_t> lengths;
+    // Исходные префиксы по возрастанию, для номеров короче префикса
+    std::vector<std::pair<std::string, int>> sortedPrefixes;
+    bool built = false;
+};
+
+#endif
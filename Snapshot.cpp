@@ -0,0 +1,323 @@
+#include "Snapshot.h"
+#include <QFile>
+#include <QSaveFile>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "DataManager.h"
+#include "Metrics.h"
+
+namespace {
+
+const char Magic[8] = {'A', 'T', 'C', 'S', 'N', 'A', 'P', '\0'};
+// Записывается в порядке байт машины: на машине с другим порядком не совпадет
+const quint32 ByteOrderMark = 0x01020304u;
+const quint64 SectionCount = 13;
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint32 subscriberRecordSize;
+    quint32 callRecordSize;
+    qint64 revision;
+    quint64 sectionCount;
+    quint64 checksum;       // заголовка с нулевым полем checksum
+};
+
+// Перед каждой секцией; данные секции дополняются нулями до кратного 8 размера
+struct SectionHeader {
+    quint64 size;
+    quint64 checksum;
+};
+
+// Перемешивание по 8-байтовым словам: в разы быстрее побайтовых хэшей
+// и надежно ловит обрезанный или испорченный файл. Данные можно подавать
+// частями, если все части, кроме последней, кратны 8 байтам.
+class Checksum {
+public:
+    explicit Checksum(std::size_t totalSize) : hash(0x9E3779B97F4A7C15ull ^ totalSize) {}
+
+    void add(const void* data, std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        std::size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            quint64 word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 32;
+        }
+        if (size > i) {
+            std::memcpy(&tail, bytes + i, size - i);
+        }
+    }
+
+    quint64 result() const {
+        const quint64 mixed = (hash ^ tail) * 0xFF51AFD7ED558CCDull;
+        return mixed ^ (mixed >> 29);
+    }
+
+private:
+    quint64 hash;
+    quint64 tail = 0;
+};
+
+quint64 checksum(const void* data, std::size_t size) {
+    Checksum sum(size);
+    sum.add(data, size);
+    return sum.result();
+}
+
+quint64 paddingFor(quint64 size) {
+    return (8 - size % 8) % 8;
+}
+
+bool fail(QString* error, const QString& message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+class SectionWriter {
+public:
+    explicit SectionWriter(QIODevice* device) : device(device) {}
+
+    template <typename T>
+    void add(const T* data, std::size_t count) {
+        addBytes(data, count * sizeof(T));
+    }
+
+    // Одна секция из нескольких кусков (блоки CallStore); размер T кратен 8
+    template <typename T>
+    void addParts(const std::vector<std::pair<const T*, std::size_t>>& parts) {
+        static_assert(sizeof(T) % 8 == 0, "части секции должны быть кратны 8 байтам");
+        std::size_t size = 0;
+        for (const auto& part : parts) {
+            size += part.second * sizeof(T);
+        }
+        Checksum sum(size);
+        for (const auto& part : parts) {
+            sum.add(part.first, part.second * sizeof(T));
+        }
+        const SectionHeader header = {size, sum.result()};
+        writeRaw(&header, sizeof(header));
+        for (const auto& part : parts) {
+            writeRaw(part.first, part.second * sizeof(T));
+        }
+    }
+
+    bool ok() const { return good; }
+
+private:
+    void addBytes(const void* data, std::size_t size) {
+        static const char zeros[8] = {};
+        const SectionHeader header = {size, checksum(data, size)};
+        writeRaw(&header, sizeof(header));
+        writeRaw(data, size);
+        writeRaw(zeros, paddingFor(size));
+    }
+
+    void writeRaw(const void* data, std::size_t size) {
+        if (good && size > 0) {
+            good = device->write(static_cast<const char*>(data), static_cast<qint64>(size)) ==
+                   static_cast<qint64>(size);
+        }
+    }
+
+    QIODevice* device;
+    bool good = true;
+};
+
+// Разбор секций отображенного файла: границы и контрольная сумма проверяются до выдачи данных
+class SectionReader {
+public:
+    SectionReader(const uchar* begin, const uchar* end) : cursor(begin), end(end) {}
+
+    template <typename T>
+    bool next(const T** data, std::size_t* count) {
+        SectionHeader header;
+        if (static_cast<quint64>(end - cursor) < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, cursor, sizeof(header));
+        cursor += sizeof(header);
+        if (header.size % sizeof(T) != 0 ||
+            static_cast<quint64>(end - cursor) < header.size + paddingFor(header.size) ||
+            checksum(cursor, header.size) != header.checksum) {
+            return false;
+        }
+        *data = reinterpret_cast<const T*>(cursor);
+        *count = header.size / sizeof(T);
+        cursor += header.size + paddingFor(header.size);
+        return true;
+    }
+
+    bool next(StringPool::Image* image) {
+        return next(&image->bytes, &image->byteCount) && next(&image->offsets, &image->offsetCount) &&
+               next(&image->buckets, &image->bucketCount);
+    }
+
+private:
+    const uchar* cursor;
+    const uchar* end;
+};
+
+bool parse(const uchar* data, qint64 size, qint64 revision, LoadedTables* tables, QString* error) {
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    const quint64 stored = header.checksum;
+    header.checksum = 0;
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || checksum(&header, sizeof(header)) != stored) {
+        return fail(error, "не является снимком или заголовок поврежден");
+    }
+    if (header.version != Snapshot::FormatVersion || header.byteOrder != ByteOrderMark ||
+        header.subscriberRecordSize != sizeof(SubscriberRecord) || header.callRecordSize != sizeof(CallRecord) ||
+        header.sectionCount != SectionCount) {
+        return fail(error, "другая версия формата");
+    }
+    if (header.revision != revision) {
+        return fail(error, QString("устарел (ревизия %1, в БД %2)").arg(header.revision).arg(revision));
+    }
+
+    SectionReader reader(data + sizeof(header), data + size);
+    const double* prices = nullptr;
+    const double* fees = nullptr;
+    const quint32* cityOffsets = nullptr;
+    const char* cityBytes = nullptr;
+    std::size_t tariffCount = 0;
+    std::size_t feeCount = 0;
+    std::size_t cityOffsetCount = 0;
+    std::size_t cityByteCount = 0;
+    StringPool::Image subscriberStrings;
+    StringPool::Image callStrings;
+    const SubscriberRecord* clients = nullptr;
+    const SubscriberRecord* vipClients = nullptr;
+    const CallRecord* calls = nullptr;
+    std::size_t clientCount = 0;
+    std::size_t vipCount = 0;
+    std::size_t callCount = 0;
+
+    if (!reader.next(&prices, &tariffCount) || !reader.next(&fees, &feeCount) ||
+        !reader.next(&cityOffsets, &cityOffsetCount) || !reader.next(&cityBytes, &cityByteCount) ||
+        !reader.next(&subscriberStrings) || !reader.next(&clients, &clientCount) ||
+        !reader.next(&vipClients, &vipCount) || !reader.next(&callStrings) || !reader.next(&calls, &callCount)) {
+        return fail(error, "файл обрезан или поврежден");
+    }
+    if (feeCount != tariffCount || cityOffsetCount != tariffCount + 1 || cityOffsets[tariffCount] != cityByteCount) {
+        return fail(error, "несогласованная секция тарифов");
+    }
+
+    LoadedTables loaded;
+    loaded.tariffs.reserve(tariffCount);
+    for (std::size_t i = 0; i < tariffCount; ++i) {
+        loaded.tariffs.push_back(Tariff(std::string(cityBytes + cityOffsets[i], cityOffsets[i + 1] - cityOffsets[i]),
+                                        prices[i], fees[i]));
+    }
+    if (!loaded.subscribers.assign(subscriberStrings, clients, clientCount, vipClients, vipCount) ||
+        !loaded.calls.assign(callStrings, calls, callCount)) {
+        return fail(error, "несогласованный пул строк");
+    }
+    *tables = std::move(loaded);
+    return true;
+}
+
+} // namespace
+
+QString Snapshot::pathFor(const QString& databasePath) {
+    if (databasePath.isEmpty() || databasePath == ":memory:") {
+        return QString();
+    }
+    return databasePath + ".snapshot";
+}
+
+bool Snapshot::write(const QString& path, qint64 revision, const LoadedTables& tables, QString* error) {
+    ATC_TIMED_OPERATION(timer, "snapshot.write");
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail(error, "не удалось создать файл снимка: " + file.errorString());
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.byteOrder = ByteOrderMark;
+    header.subscriberRecordSize = sizeof(SubscriberRecord);
+    header.callRecordSize = sizeof(CallRecord);
+    header.revision = revision;
+    header.sectionCount = SectionCount;
+    header.checksum = checksum(&header, sizeof(header));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Тарифов единицы: раскладываем их в те же массивы, что и остальные секции
+    std::vector<double> prices;
+    std::vector<double> fees;
+    std::vector<quint32> cityOffsets(1, 0);
+    std::string cityBytes;
+    for (const auto& tariff : tables.tariffs) {
+        prices.push_back(tariff.getPricePerMinute());
+        fees.push_back(tariff.getConnectionFee());
+        cityBytes += tariff.getCity();
+        cityOffsets.push_back(static_cast<quint32>(cityBytes.size()));
+    }
+
+    SectionWriter writer(&file);
+    writer.add(prices.data(), prices.size());
+    writer.add(fees.data(), fees.size());
+    writer.add(cityOffsets.data(), cityOffsets.size());
+    writer.add(cityBytes.data(), cityBytes.size());
+
+    const SubscriberStore& subscribers = tables.subscribers;
+    const StringPool::Image subscriberStrings = subscribers.strings().image();
+    writer.add(subscriberStrings.bytes, subscriberStrings.byteCount);
+    writer.add(subscriberStrings.offsets, subscriberStrings.offsetCount);
+    writer.add(subscriberStrings.buckets, subscriberStrings.bucketCount);
+    writer.add(subscribers.data(SubscriberKind::Regular), subscribers.count(SubscriberKind::Regular));
+    writer.add(subscribers.data(SubscriberKind::Vip), subscribers.count(SubscriberKind::Vip));
+
+    const StringPool::Image callStrings = tables.calls.strings().image();
+    writer.add(callStrings.bytes, callStrings.byteCount);
+    writer.add(callStrings.offsets, callStrings.offsetCount);
+    writer.add(callStrings.buckets, callStrings.bucketCount);
+    std::vector<std::pair<const CallRecord*, std::size_t>> callChunks;
+    tables.calls.forEachChunk([&callChunks](const CallRecord* records, std::size_t count) {
+        callChunks.emplace_back(records, count);
+    });
+    writer.addParts(callChunks);
+
+    if (!writer.ok() || !file.commit()) {
+        file.cancelWriting();
+        return fail(error, "ошибка записи снимка: " + file.errorString());
+    }
+    timer.addRows(tables.tariffs.size() + subscribers.count(SubscriberKind::Regular) +
+                  subscribers.count(SubscriberKind::Vip) + tables.calls.count());
+    return true;
+}
+
+bool Snapshot::read(const QString& path, qint64 revision, LoadedTables* tables, QString* error) {
+    ATC_TIMED_OPERATION(timer, "snapshot.read");
+    QFile file(path);
+    if (!file.exists()) {
+        return fail(error, "снимка нет");
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(error, "не удалось открыть снимок: " + file.errorString());
+    }
+    const qint64 size = file.size();
+    if (size < static_cast<qint64>(sizeof(Header))) {
+        return fail(error, "файл обрезан или поврежден");
+    }
+
+    // Файл отображается в память: страницы подгружает ядро, без промежуточных буферов
+    uchar* data = file.map(0, size);
+    if (!data) {
+        return fail(error, "не удалось отобразить снимок в память: " + file.errorString());
+    }
+    const bool loaded = parse(data, size, revision, tables, error);
+    file.unmap(data);
+    if (loaded) {
+        timer.addRows(tables->tariffs.size() + tables->subscribers.count(SubscriberKind::Regular) +
+                      tables->subscribers.count(SubscriberKind::Vip) + tables->calls.count());
+    }
+    return loaded;
+}
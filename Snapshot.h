@@ -0,0 +1,31 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QString>
+#include <QtGlobal>
+
+struct LoadedTables;
+
+// Двоичный снимок данных DataManager рядом с файлом БД (<db>.snapshot).
+// Массивы хранилищ пишутся как есть, с выравниванием на 8 байт и контрольной
+// суммой каждой секции; при загрузке файл отображается в память (mmap) и
+// массивы копируются в арены одним куском, без разбора строк и SQL.
+//
+// Снимок действителен только для той ревизии БД, при которой он записан
+// (счетчик db_revision увеличивается при фиксации каждой транзакции записи
+// DataManager; правка файла в обход него, например из sqlite3, снимок не сбрасывает -
+// его нужно удалить вручную).
+class Snapshot {
+public:
+    static const quint32 FormatVersion = 3;
+
+    // Путь снимка для файла БД (пустой для БД в памяти)
+    static QString pathFor(const QString& databasePath);
+
+    // Запись через временный файл: прежний снимок заменяется только целиком
+    static bool write(const QString& path, qint64 revision, const LoadedTables& tables, QString* error);
+    // false, если снимка нет, он другой версии или ревизии либо поврежден (причина - в error)
+    static bool read(const QString& path, qint64 revision, LoadedTables* tables, QString* error);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "StatementCache.h"
+#include <QSqlError>
+#include <algorithm>
+#include "Metrics.h"
+
+bool CachedStatement::exec() {
+    if (!prepared) {
+        return false;
+    }
+    ScopedTimer timer(*metric);
+    bool ok = query.exec();
+    if (ok && !query.isSelect()) {
+        timer.addRows(static_cast<std::uint64_t>(std::max(0, query.numRowsAffected())));
+    }
+    return ok;
+}
+
+
+StatementCache::StatementCache(const QSqlDatabase& db) : db(db) {}
+
+StatementCache::~StatementCache() {
+    clear();
+}
+
+CachedStatement& StatementCache::prepare(const QString& sql) {
+    auto& slot = statements[sql];
+    if (!slot) {
+        slot.reset(new CachedStatement());
+        slot->query = QSqlQuery(db);
+        // Метрики выражения общие для всех соединений: ключ - тот же текст SQL
+        slot->metric = &MetricsRegistry::instance().sql(sql.simplified().toStdString());
+    }
+
+    CachedStatement& statement = *slot;
+    statement.lookups++;
+    if (!statement.prepared) {
+        // Неудачная подготовка (например, таблицы еще нет) повторится при следующем обращении
+        statement.prepares++;
+        statement.prepared = statement.query.prepare(sql);
+    }
+    return statement;
+}
+
+void StatementCache::clear() {
+    statements.clear();
+}
+
+std::uint64_t StatementCache::lookups() const {
+    std::uint64_t total = 0;
+    for (const auto& entry : statements) {
+        total += entry.second->lookups;
+    }
+    return total;
+}
+
+std::uint64_t StatementCache::hits() const {
+    std::uint64_t total = 0;
+    for (const auto& entry : statements) {
+        total += entry.second->lookups - entry.second->prepares;
+    }
+    return total;
+}
+
+std::vector<StatementStats> StatementCache::statistics() const {
+    std::vector<StatementStats> result;
+    result.reserve(statements.size());
+    for (const auto& entry : statements) {
+        const CachedStatement& s = *entry.second;
+        result.push_back({entry.first.simplified(), s.lookups, s.lookups - s.prepares, s.prepares,
+                          s.metric->count(), s.metric->totalNanos(),
+                          s.metric->percentileNanos(0.50), s.metric->percentileNanos(0.99)});
+    }
+    return result;
+}
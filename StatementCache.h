@@ -0,0 +1,63 @@
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+
+class OperationHistogram;
+
+// Подготовленное выражение из кэша. Параметры привязываются к query,
+// выполнение - через exec(), чтобы время попало в метрики выражения.
+struct CachedStatement {
+    QSqlQuery query;
+    OperationHistogram* metric = nullptr;
+    bool prepared = false;
+    std::uint64_t lookups = 0;
+    std::uint64_t prepares = 0;
+
+    bool exec();
+};
+
+// Статистика одного выражения для окна диагностики
+struct StatementStats {
+    QString sql;
+    std::uint64_t lookups;
+    std::uint64_t hits;
+    std::uint64_t prepares;
+    std::uint64_t executions;
+    std::uint64_t totalNanos;
+    std::uint64_t p50Nanos;
+    std::uint64_t p99Nanos;
+};
+
+// Кэш подготовленных выражений одного соединения, ключ - текст SQL.
+// Выражение компилируется (prepare) один раз и переиспользуется между вызовами.
+class StatementCache {
+public:
+    explicit StatementCache(const QSqlDatabase& db);
+    ~StatementCache();
+
+    // Возвращает подготовленное выражение; при промахе - готовит и кэширует
+    CachedStatement& prepare(const QString& sql);
+
+    // Освобождает все выражения (перед закрытием соединения)
+    void clear();
+
+    std::uint64_t lookups() const;
+    std::uint64_t hits() const;
+    std::vector<StatementStats> statistics() const;
+
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+private:
+    QSqlDatabase db;
+    std::unordered_map<QString, std::unique_ptr<CachedStatement>> statements;
+};
+
+#endif
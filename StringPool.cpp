@@ -0,0 +1,114 @@
+#include "StringPool.h"
+
+namespace {
+
+// FNV-1a: результат не зависит от стандартной библиотеки, поэтому индекс из снимка
+// остается верным после пересборки программы
+std::uint32_t stringHash(std::string_view value) {
+    std::uint32_t hash = 2166136261u;
+    for (char ch : value) {
+        hash = (hash ^ static_cast<unsigned char>(ch)) * 16777619u;
+    }
+    return hash;
+}
+
+} // namespace
+
+std::size_t stringHeapBytes(std::size_t length) {
+    // Емкость пустой строки - размер встроенного буфера (SSO) текущей стандартной библиотеки
+    static const std::size_t inlineCapacity = std::string().capacity();
+    return length > inlineCapacity ? length + 1 : 0;
+}
+
+StringPool::StringPool(std::pmr::memory_resource* resource)
+    : bytes(resource), offsets(resource), buckets(resource) {
+    clear();
+}
+
+std::size_t StringPool::bucketFor(std::string_view value) const {
+    const std::size_t mask = buckets.size() - 1;
+    std::size_t bucket = stringHash(value) & mask;
+    while (buckets[bucket] != 0 && at(buckets[bucket] - 1) != value) {
+        bucket = (bucket + 1) & mask;
+    }
+    return bucket;
+}
+
+void StringPool::rehash(std::size_t bucketCount) {
+    std::pmr::vector<std::uint32_t> old(bucketCount, 0, buckets.get_allocator());
+    old.swap(buckets);
+    for (std::uint32_t entry : old) {
+        if (entry != 0) {
+            buckets[bucketFor(at(entry - 1))] = entry;
+        }
+    }
+}
+
+std::uint32_t StringPool::intern(std::string_view value) {
+    std::size_t bucket = bucketFor(value);
+    if (buckets[bucket] != 0) {
+        return buckets[bucket] - 1;
+    }
+
+    const std::uint32_t id = static_cast<std::uint32_t>(size());
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    offsets.push_back(static_cast<std::uint32_t>(bytes.size()));
+    buckets[bucket] = id + 1;
+    if (size() * 2 > buckets.size()) {
+        rehash(buckets.size() * 2);
+    }
+    return id;
+}
+
+std::uint32_t StringPool::find(std::string_view value) const {
+    const std::uint32_t entry = buckets[bucketFor(value)];
+    return entry == 0 ? NotFound : entry - 1;
+}
+
+std::string_view StringPool::at(std::uint32_t id) const {
+    return std::string_view(bytes.data() + offsets[id], offsets[id + 1] - offsets[id]);
+}
+
+void StringPool::reserve(std::size_t count, std::size_t byteCount) {
+    bytes.reserve(bytes.size() + byteCount);
+    offsets.reserve(offsets.size() + count);
+    std::size_t bucketCount = buckets.size();
+    while (bucketCount < (size() + count) * 2) {
+        bucketCount *= 2;
+    }
+    if (bucketCount != buckets.size()) {
+        rehash(bucketCount);
+    }
+}
+
+StringPool::Image StringPool::image() const {
+    return {bytes.data(), bytes.size(), offsets.data(), offsets.size(), buckets.data(), buckets.size()};
+}
+
+bool StringPool::assign(const Image& image) {
+    const bool powerOfTwo = image.bucketCount != 0 && (image.bucketCount & (image.bucketCount - 1)) == 0;
+    if (image.offsetCount < 2 || image.offsets[0] != 0 || image.offsets[image.offsetCount - 1] != image.byteCount ||
+        !powerOfTwo || image.bucketCount < (image.offsetCount - 1) * 2) {
+        return false;
+    }
+    bytes.assign(image.bytes, image.bytes + image.byteCount);
+    offsets.assign(image.offsets, image.offsets + image.offsetCount);
+    buckets.assign(image.buckets, image.buckets + image.bucketCount);
+    return true;
+}
+
+std::size_t StringPool::size() const {
+    return offsets.size() - 1;
+}
+
+std::size_t StringPool::memoryUsage() const {
+    return bytes.capacity() + (offsets.capacity() + buckets.capacity()) * sizeof(std::uint32_t);
+}
+
+void StringPool::clear() {
+    bytes.clear();
+    offsets.assign(1, 0);
+    buckets.assign(16, 0);
+    // id 0 - пустая строка, чтобы у обычных клиентов не было отдельного признака "нет менеджера"
+    intern(std::string_view());
+}
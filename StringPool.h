@@ -0,0 +1,69 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Интернирование строк: каждая различная строка хранится один раз и заменяется
+// 32-битным id (например, имя персонального менеджера у тысяч VIP-клиентов).
+// Все байты лежат подряд в одном буфере, индекс - открытая адресация по id,
+// поэтому на строку нет ни отдельного std::string, ни узла хэш-таблицы.
+// Строки не удаляются до clear(), поэтому id остаются действительными.
+//
+// Память берется из переданного ресурса (у хранилищ - монотонная арена),
+// поэтому пул нельзя ни копировать, ни перемещать: он живет вместе с ареной.
+class StringPool {
+public:
+    static const std::uint32_t NotFound = 0xFFFFFFFFu;
+
+    explicit StringPool(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    std::uint32_t intern(std::string_view value);
+    // id без добавления; NotFound, если такой строки нет
+    std::uint32_t find(std::string_view value) const;
+    // Действительна до следующего intern (буфер может переехать)
+    std::string_view at(std::uint32_t id) const;
+
+    // Память под count новых строк общей длиной byteCount
+    void reserve(std::size_t count, std::size_t byteCount);
+
+    // Сырые массивы пула для двоичного снимка (Snapshot). Индекс сохраняется
+    // как есть, поэтому хэш строк свой (FNV-1a), а не std::hash реализации.
+    struct Image {
+        const char* bytes;
+        std::size_t byteCount;
+        const std::uint32_t* offsets;
+        std::size_t offsetCount;
+        const std::uint32_t* buckets;
+        std::size_t bucketCount;
+    };
+    Image image() const;
+    // Замена содержимого массивами снимка без пересчета хэшей;
+    // false (пул не изменен), если массивы не согласованы между собой
+    bool assign(const Image& image);
+
+    std::size_t size() const;
+    std::size_t memoryUsage() const;
+    void clear();
+
+private:
+    std::size_t bucketFor(std::string_view value) const;
+    void rehash(std::size_t bucketCount);
+
+    std::pmr::vector<char> bytes;
+    // offsets[id] - начало строки id, offsets[id + 1] - ее конец
+    std::pmr::vector<std::uint32_t> offsets;
+    // id + 1 либо 0 для пустого слота; размер - степень двойки, заполнение не больше половины
+    std::pmr::vector<std::uint32_t> buckets;
+};
+
+// Байт в куче под std::string длины length (короткие строки хранятся внутри объекта)
+std::size_t stringHeapBytes(std::size_t length);
+
+#endif
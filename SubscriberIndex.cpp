@@ -0,0 +1,141 @@
+#include "SubscriberIndex.h"
+#include <QString>
+#include <algorithm>
+
+std::string SubscriberIndex::searchKey(std::string_view text) {
+    const QString value = QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size())).trimmed();
+    // Номер узнается по составу символов: "+7 (900) 123-45-67" ищется как "79001234567"
+    bool phone = !value.isEmpty();
+    for (const QChar c : value) {
+        if (!c.isDigit() && c != '+' && c != '-' && c != '(' && c != ')' && c != ' ') {
+            phone = false;
+            break;
+        }
+    }
+    if (!phone) {
+        return value.toLower().toStdString();
+    }
+    std::string digits;
+    for (const QChar c : value) {
+        if (c.isDigit()) {
+            digits += static_cast<char>(c.unicode());
+        }
+    }
+    return digits;
+}
+
+std::string_view SubscriberIndex::key(const Entry& entry) const {
+    return std::string_view(keys).substr(entry.keyOffset, entry.keyLength);
+}
+
+SubscriberIndex::Entry SubscriberIndex::makeEntry(std::string_view text, const SubscriberRecord& record,
+                                                  bool phone) {
+    const std::string normalized = searchKey(text);
+    const Entry entry = {static_cast<std::uint32_t>(keys.size()), static_cast<std::uint32_t>(normalized.size()),
+                         record.nameId, record.phoneId, record.kind, phone};
+    keys += normalized;
+    return entry;
+}
+
+void SubscriberIndex::build(const SubscriberStore& store) {
+    clear();
+    const std::size_t count = store.count(SubscriberKind::Regular) + store.count(SubscriberKind::Vip);
+    entries.reserve(count * 2);
+    for (SubscriberKind kind : {SubscriberKind::Regular, SubscriberKind::Vip}) {
+        for (int i = 0; i < store.count(kind); ++i) {
+            const SubscriberRecord& record = store.at(kind, i);
+            entries.push_back(makeEntry(store.text(record.nameId), record, false));
+            entries.push_back(makeEntry(store.text(record.phoneId), record, true));
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [this](const Entry& a, const Entry& b) {
+        return key(a) < key(b);
+    });
+    built = true;
+}
+
+bool SubscriberIndex::isBuilt() const {
+    return built;
+}
+
+void SubscriberIndex::clear() {
+    keys.clear();
+    keys.shrink_to_fit();
+    entries.clear();
+    entries.shrink_to_fit();
+    built = false;
+}
+
+void SubscriberIndex::add(const SubscriberStore& store, const SubscriberRecord& record) {
+    for (const bool phone : {false, true}) {
+        const Entry entry = makeEntry(store.text(phone ? record.phoneId : record.nameId), record, phone);
+        const auto position = std::upper_bound(entries.begin(), entries.end(), key(entry),
+                                               [this](std::string_view value, const Entry& other) {
+                                                   return value < key(other);
+                                               });
+        entries.insert(position, entry);
+    }
+}
+
+// Обычный клиент и VIP-клиент могут носить одно имя (разные таблицы)
+void SubscriberIndex::remove(const std::vector<std::uint32_t>& nameIds, SubscriberKind kind) {
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&nameIds, kind](const Entry& entry) {
+                                     return entry.kind == kind &&
+                                            std::binary_search(nameIds.begin(), nameIds.end(), entry.nameId);
+                                 }),
+                  entries.end());
+}
+
+void SubscriberIndex::remove(std::uint32_t nameId, SubscriberKind kind) {
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [nameId, kind](const Entry& entry) {
+                                     return entry.nameId == nameId && entry.kind == kind;
+                                 }),
+                  entries.end());
+}
+
+std::vector<SubscriberMatch> SubscriberIndex::find(std::string_view prefix, std::size_t limit) const {
+    std::vector<SubscriberMatch> matches;
+    if (prefix.empty()) {
+        return matches;
+    }
+    auto it = std::lower_bound(entries.begin(), entries.end(), prefix, [this](const Entry& entry, std::string_view value) {
+        return key(entry) < value;
+    });
+    for (; it != entries.end() && matches.size() < limit; ++it) {
+        const std::string_view entryKey = key(*it);
+        if (entryKey.substr(0, prefix.size()) != prefix) {
+            break;
+        }
+        // Имя и номер одного абонента могут начинаться одинаково
+        const Entry& entry = *it;
+        if (std::none_of(matches.begin(), matches.end(), [&entry](const SubscriberMatch& match) {
+                return match.nameId == entry.nameId && match.kind == entry.kind;
+            })) {
+            matches.push_back({it->nameId, it->phoneId, it->kind});
+        }
+    }
+    return matches;
+}
+
+// Имя из одних цифр дает такой же ключ, как номер, поэтому записи сверяются по флагу
+bool SubscriberIndex::findPhone(std::string_view digits, SubscriberMatch* match) const {
+    if (digits.empty()) {
+        return false;
+    }
+    auto it = std::lower_bound(entries.begin(), entries.end(), digits, [this](const Entry& entry, std::string_view value) {
+        return key(entry) < value;
+    });
+    for (; it != entries.end() && key(*it) == digits; ++it) {
+        if (it->phone) {
+            *match = {it->nameId, it->phoneId, it->kind};
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t SubscriberIndex::memoryUsage() const {
+    return keys.capacity() + entries.capacity() * sizeof(Entry);
+}
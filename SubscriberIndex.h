@@ -0,0 +1,64 @@
+#ifndef SUBSCRIBERINDEX_H
+#define SUBSCRIBERINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SubscriberStore.h"
+
+// Найденный абонент: id строк в пуле SubscriberStore
+struct SubscriberMatch {
+    std::uint32_t nameId;
+    std::uint32_t phoneId;
+    SubscriberKind kind;
+};
+
+// Отсортированный индекс префиксов по именам и номерам абонентов для автодополнения.
+// Ключи нормализованы (searchKey): имена - в нижнем регистре, номера - только цифры.
+// Поиск - двоичный поиск начала диапазона и проход по первым limit записям, поэтому
+// время не зависит от числа абонентов. Записи хранят id строк пула, а не номера
+// записей, поэтому сортировки хранилища индекс не затрагивают.
+class SubscriberIndex {
+public:
+    // Нормализация и текста абонента, и строки, введенной оператором
+    static std::string searchKey(std::string_view text);
+
+    void build(const SubscriberStore& store);
+    bool isBuilt() const;
+    void clear();
+
+    // Поддержка после построения: добавление в отсортированный массив и удаление по имени
+    void add(const SubscriberStore& store, const SubscriberRecord& record);
+    void remove(std::uint32_t nameId, SubscriberKind kind);
+    // Удаление многих абонентов одним проходом; nameIds отсортированы
+    void remove(const std::vector<std::uint32_t>& nameIds, SubscriberKind kind);
+
+    // Первые limit абонентов, у которых имя или номер начинается с prefix (уже нормализованного)
+    std::vector<SubscriberMatch> find(std::string_view prefix, std::size_t limit) const;
+    // Абонент с точно таким номером (digits - цифры номера); false, если его нет
+    bool findPhone(std::string_view digits, SubscriberMatch* match) const;
+    std::size_t memoryUsage() const;
+
+private:
+    struct Entry {
+        std::uint32_t keyOffset;
+        std::uint32_t keyLength;
+        std::uint32_t nameId;
+        std::uint32_t phoneId;
+        SubscriberKind kind;
+        bool phone;
+    };
+
+    std::string_view key(const Entry& entry) const;
+    Entry makeEntry(std::string_view text, const SubscriberRecord& record, bool phone);
+
+    // Ключи всех записей подряд; удаленные записи оставляют байты до clear()
+    std::string keys;
+    std::vector<Entry> entries;
+    bool built = false;
+};
+
+#endif
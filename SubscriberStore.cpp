@@ -0,0 +1,217 @@
+#include "SubscriberStore.h"
+#include "LoyaltyEngine.h"
+#include <algorithm>
+#include <string>
+
+namespace {
+
+// Первый буфер арены для пустого хранилища (GUI с несколькими клиентами)
+const std::size_t DefaultArenaBytes = 4096;
+
+std::size_t bucketBytes(std::size_t stringCount) {
+    std::size_t buckets = 16;
+    while (buckets < stringCount * 2) {
+        buckets *= 2;
+    }
+    return buckets * sizeof(std::uint32_t);
+}
+
+} // namespace
+
+SubscriberStore::Storage::Storage(std::size_t initialBytes)
+    : arena(initialBytes), strings(&arena), clients(&arena), vipClients(&arena) {}
+
+SubscriberStore::SubscriberStore() : storage(new Storage(DefaultArenaBytes)) {}
+
+std::pmr::vector<SubscriberRecord>& SubscriberStore::records(SubscriberKind kind) {
+    return kind == SubscriberKind::Vip ? storage->vipClients : storage->clients;
+}
+
+const std::pmr::vector<SubscriberRecord>& SubscriberStore::records(SubscriberKind kind) const {
+    return kind == SubscriberKind::Vip ? storage->vipClients : storage->clients;
+}
+
+void SubscriberStore::add(const Client& client) {
+    addRegular(client.getName(), client.getPhoneNumber(), client.getBalance());
+}
+
+void SubscriberStore::add(const VIPClient& client) {
+    addVip(client.getName(), client.getPhoneNumber(), client.getBalance(),
+           LoyaltyEngine::tier(0).discount, client.getPersonalManager());
+}
+
+void SubscriberStore::addRegular(std::string_view name, std::string_view phone, double balance) {
+    StringPool& strings = storage->strings;
+    storage->clients.push_back({balance, 0.0, strings.intern(name), strings.intern(phone), 0,
+                                SubscriberKind::Regular, 0});
+}
+
+void SubscriberStore::addVip(std::string_view name, std::string_view phone, double balance,
+                             double discount, std::string_view manager, std::uint8_t tier) {
+    StringPool& strings = storage->strings;
+    // Скидка из БД или CSV могла быть записана до ограничения 0-50%
+    storage->vipClients.push_back({balance, LoyaltyProgram::clampDiscount(discount), strings.intern(name),
+                                   strings.intern(phone), strings.intern(manager), SubscriberKind::Vip, tier});
+}
+
+void SubscriberStore::remove(SubscriberKind kind, int index) {
+    auto& list = records(kind);
+    if (index >= 0 && index < static_cast<int>(list.size())) {
+        list.erase(list.begin() + index);
+    }
+}
+
+void SubscriberStore::remove(SubscriberKind kind, const std::vector<int>& indices) {
+    auto& list = records(kind);
+    std::size_t kept = 0;
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < list.size(); ++i) {
+        while (next < indices.size() && indices[next] < static_cast<int>(i)) {
+            ++next;
+        }
+        if (next < indices.size() && indices[next] == static_cast<int>(i)) {
+            continue;
+        }
+        list[kept++] = list[i];
+    }
+    list.resize(kept);
+}
+
+void SubscriberStore::update(int index, const Client& client) {
+    if (index >= 0 && index < static_cast<int>(storage->clients.size())) {
+        StringPool& strings = storage->strings;
+        storage->clients[static_cast<std::size_t>(index)] = {
+            client.getBalance(), 0.0, strings.intern(client.getName()), strings.intern(client.getPhoneNumber()), 0,
+            SubscriberKind::Regular, 0};
+    }
+}
+
+void SubscriberStore::update(int index, const VIPClient& client) {
+    if (index >= 0 && index < static_cast<int>(storage->vipClients.size())) {
+        StringPool& strings = storage->strings;
+        SubscriberRecord& record = storage->vipClients[static_cast<std::size_t>(index)];
+        record = {client.getBalance(), LoyaltyEngine::tier(record.tier).discount, strings.intern(client.getName()),
+                  strings.intern(client.getPhoneNumber()), strings.intern(client.getPersonalManager()),
+                  SubscriberKind::Vip, record.tier};
+    }
+}
+
+bool SubscriberStore::setLoyaltyTier(std::uint32_t nameId, std::uint8_t tier, double discount) {
+    for (auto& record : storage->vipClients) {
+        if (record.nameId == nameId) {
+            record.tier = tier;
+            record.discount = LoyaltyProgram::clampDiscount(discount);
+            return true;
+        }
+    }
+    return false;
+}
+
+void SubscriberStore::reset(std::size_t regularCount, std::size_t vipCount, std::size_t stringBytes) {
+    // Верхняя оценка числа строк: имя, телефон и менеджер у каждой записи
+    const std::size_t stringCount = regularCount * 2 + vipCount * 3 + 1;
+    const std::size_t arenaBytes = (regularCount + vipCount) * sizeof(SubscriberRecord) + stringBytes +
+                                   stringCount * sizeof(std::uint32_t) + bucketBytes(stringCount) + 1024;
+
+    // Старая арена освобождается целиком, без обхода записей
+    storage.reset(new Storage(std::max(arenaBytes, DefaultArenaBytes)));
+    storage->clients.reserve(regularCount);
+    storage->vipClients.reserve(vipCount);
+    storage->strings.reserve(stringCount, stringBytes);
+}
+
+void SubscriberStore::clear() {
+    storage.reset(new Storage(DefaultArenaBytes));
+}
+
+int SubscriberStore::count(SubscriberKind kind) const {
+    return static_cast<int>(records(kind).size());
+}
+
+const SubscriberRecord& SubscriberStore::at(SubscriberKind kind, int index) const {
+    return records(kind)[index];
+}
+
+std::string_view SubscriberStore::text(std::uint32_t id) const {
+    return storage->strings.at(id);
+}
+
+std::uint32_t SubscriberStore::textId(std::string_view value) const {
+    return storage->strings.find(value);
+}
+
+Client SubscriberStore::clientAt(int index) const {
+    const SubscriberRecord& record = storage->clients[index];
+    return Client(std::string(text(record.nameId)), std::string(text(record.phoneId)), record.balance);
+}
+
+VIPClient SubscriberStore::vipClientAt(int index) const {
+    const SubscriberRecord& record = storage->vipClients[index];
+    VIPClient client(std::string(text(record.nameId)), std::string(text(record.phoneId)),
+                     record.balance, record.discount, std::string(text(record.managerId)));
+    client.getLoyaltyProgram().setVIPStatus(LoyaltyEngine::tier(record.tier).name);
+    return client;
+}
+
+const SubscriberRecord* SubscriberStore::find(std::string_view name) const {
+    const std::uint32_t nameId = textId(name);
+    if (nameId == StringPool::NotFound) {
+        return nullptr;
+    }
+    for (const auto* list : {&storage->clients, &storage->vipClients}) {
+        for (const auto& record : *list) {
+            if (record.nameId == nameId) {
+                return &record;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void SubscriberStore::sortByName(SubscriberKind kind, bool ascending) {
+    auto& list = records(kind);
+    std::sort(list.begin(), list.end(), [this, ascending](const SubscriberRecord& a, const SubscriberRecord& b) {
+        return ascending ? text(a.nameId) < text(b.nameId) : text(a.nameId) > text(b.nameId);
+    });
+}
+
+void SubscriberStore::sortByDiscount(SubscriberKind kind, bool ascending) {
+    auto& list = records(kind);
+    std::sort(list.begin(), list.end(), [ascending](const SubscriberRecord& a, const SubscriberRecord& b) {
+        return ascending ? a.discount < b.discount : a.discount > b.discount;
+    });
+}
+
+std::size_t SubscriberStore::memoryUsage() const {
+    return (storage->clients.capacity() + storage->vipClients.capacity()) * sizeof(SubscriberRecord) +
+           storage->strings.memoryUsage();
+}
+
+const StringPool& SubscriberStore::strings() const {
+    return storage->strings;
+}
+
+const SubscriberRecord* SubscriberStore::data(SubscriberKind kind) const {
+    return records(kind).data();
+}
+
+SubscriberStore SubscriberStore::clone() const {
+    SubscriberStore copy;
+    copy.assign(storage->strings.image(), storage->clients.data(), storage->clients.size(),
+                storage->vipClients.data(), storage->vipClients.size());
+    return copy;
+}
+
+bool SubscriberStore::assign(const StringPool::Image& strings, const SubscriberRecord* clients,
+                             std::size_t clientCount, const SubscriberRecord* vipClients, std::size_t vipCount) {
+    const std::size_t arenaBytes = (clientCount + vipCount) * sizeof(SubscriberRecord) + strings.byteCount +
+                                   (strings.offsetCount + strings.bucketCount) * sizeof(std::uint32_t) + 1024;
+    std::unique_ptr<Storage> loaded(new Storage(std::max(arenaBytes, DefaultArenaBytes)));
+    if (!loaded->strings.assign(strings)) {
+        return false;
+    }
+    loaded->clients.assign(clients, clients + clientCount);
+    loaded->vipClients.assign(vipClients, vipClients + vipCount);
+    storage = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef SUBSCRIBERSTORE_H
+#define SUBSCRIBERSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "Client.h"
+#include "VIPClient.h"
+#include "StringPool.h"
+
+enum class SubscriberKind : std::uint8_t {
+    Regular,
+    Vip
+};
+
+// Плоская запись абонента: 32 байта вместо Client/VIPClient с vptr, виртуальной
+// базой Person и пустой второй парой name/phoneNumber внутри LoyaltyProgram
+struct SubscriberRecord {
+    double balance;
+    double discount;            // у обычного клиента 0
+    std::uint32_t nameId;
+    std::uint32_t phoneId;
+    std::uint32_t managerId;    // у обычного клиента - пустая строка
+    SubscriberKind kind;
+    std::uint8_t tier;          // уровень лояльности VIP (LoyaltyEngine::tier)
+};
+
+// Хранилище клиентов и VIP-клиентов DataManager. Иерархия Person/Client/VIPClient
+// используется только как представление: clientAt/vipClientAt собирают объект по записи.
+class SubscriberStore {
+public:
+    SubscriberStore();
+    SubscriberStore(SubscriberStore&&) = default;
+    SubscriberStore& operator=(SubscriberStore&&) = default;
+
+    void add(const Client& client);
+    // Скидка VIPClient не используется: новый VIP получает скидку нулевого уровня
+    void add(const VIPClient& client);
+    void addRegular(std::string_view name, std::string_view phone, double balance);
+    void addVip(std::string_view name, std::string_view phone, double balance,
+                double discount, std::string_view manager, std::uint8_t tier = 0);
+    void remove(SubscriberKind kind, int index);
+    // Удаление многих записей одним проходом со сдвигом; indices отсортированы
+    void remove(SubscriberKind kind, const std::vector<int>& indices);
+    // Замена записи на месте: позиция в списке сохраняется, строки интернируются.
+    // Уровень лояльности VIP и его скидка не меняются: их назначает только LoyaltyEngine
+    void update(int index, const Client& client);
+    void update(int index, const VIPClient& client);
+    // Новый уровень VIP по id имени и скидка этого уровня; false - такого VIP нет
+    bool setLoyaltyTier(std::uint32_t nameId, std::uint8_t tier, double discount);
+
+    // Пустое хранилище, сразу рассчитанное на заданное число записей и байт строк:
+    // вся память выделяется из арены одним куском
+    void reset(std::size_t regularCount, std::size_t vipCount, std::size_t stringBytes);
+    void clear();
+
+    int count(SubscriberKind kind) const;
+    const SubscriberRecord& at(SubscriberKind kind, int index) const;
+    std::string_view text(std::uint32_t id) const;
+    // id строки в пуле или StringPool::NotFound
+    std::uint32_t textId(std::string_view value) const;
+
+    // Представления записей в виде классов модели
+    Client clientAt(int index) const;
+    VIPClient vipClientAt(int index) const;
+
+    // Поиск по имени среди обоих типов: строка ищется в пуле один раз,
+    // дальше сравниваются только 32-битные id
+    const SubscriberRecord* find(std::string_view name) const;
+
+    void sortByName(SubscriberKind kind, bool ascending);
+    void sortByDiscount(SubscriberKind kind, bool ascending);
+
+    // Оценка занимаемой памяти (без служебных данных аллокатора)
+    std::size_t memoryUsage() const;
+
+    // Двоичный снимок (Snapshot): сырые массивы и загрузка их одним копированием
+    const StringPool& strings() const;
+    const SubscriberRecord* data(SubscriberKind kind) const;
+    bool assign(const StringPool::Image& strings, const SubscriberRecord* clients, std::size_t clientCount,
+                const SubscriberRecord* vipClients, std::size_t vipCount);
+    // Независимая копия (те же массивы, скопированные в новую арену)
+    SubscriberStore clone() const;
+
+private:
+    // Все контейнеры выделяются из одной монотонной арены и освобождаются разом,
+    // когда хранилище очищается или заменяется (перезагрузка, восстановление БД).
+    // Арена живет в куче, поэтому перемещение хранилища - это перенос указателя.
+    struct Storage {
+        explicit Storage(std::size_t initialBytes);
+
+        std::pmr::monotonic_buffer_resource arena;
+        StringPool strings;
+        std::pmr::vector<SubscriberRecord> clients;
+        std::pmr::vector<SubscriberRecord> vipClients;
+    };
+
+    std::pmr::vector<SubscriberRecord>& records(SubscriberKind kind);
+    const std::pmr::vector<SubscriberRecord>& records(SubscriberKind kind) const;
+
+    std::unique_ptr<Storage> storage;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "TariffSet.h"
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+TariffSet::TariffSet(std::vector<Tariff> tariffs, std::vector<TariffPrefix> prefixes,
+                     std::vector<TariffVersion> versions)
+    : tariffList(std::move(tariffs)), prefixList(std::move(prefixes)), versionList(tariffList.size()) {
+    // Повторный город (возможен только в старых БД) - как раньше, находится первый
+    for (std::size_t i = 0; i < tariffList.size(); ++i) {
+        cityIndex.emplace(tariffList[i].getCity(), static_cast<int>(i));
+    }
+    for (TariffVersion& version : versions) {
+        const auto city = cityIndex.find(version.tariff.getCity());
+        if (city != cityIndex.end()) {
+            versionList[static_cast<std::size_t>(city->second)].push_back(std::move(version));
+        }
+    }
+    for (auto& cityVersions : versionList) {
+        std::sort(cityVersions.begin(), cityVersions.end(), [](const TariffVersion& a, const TariffVersion& b) {
+            return a.effectiveFrom < b.effectiveFrom;
+        });
+    }
+    std::vector<std::pair<std::string, int>> routed;
+    routed.reserve(prefixList.size());
+    for (const TariffPrefix& entry : prefixList) {
+        const auto city = cityIndex.find(entry.city);
+        if (city != cityIndex.end()) {
+            routed.emplace_back(entry.prefix, city->second);
+        }
+    }
+    routingTable.build(routed);
+}
+
+bool TariffSet::validate(const std::vector<Tariff>& tariffs, const std::vector<TariffPrefix>& prefixes,
+                         std::string* error) {
+    auto fail = [error](const std::string& message) {
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+    std::unordered_set<std::string> cities;
+    for (const Tariff& tariff : tariffs) {
+        const std::string city = tariff.getCity();
+        if (city.empty()) {
+            return fail("тариф без города");
+        }
+        if (!cities.insert(city).second) {
+            return fail("город указан дважды: " + city);
+        }
+        if (tariff.getPricePerMinute() < 0 || tariff.getConnectionFee() < 0) {
+            return fail("отрицательная цена у тарифа " + city);
+        }
+    }
+    std::unordered_set<std::string> seen;
+    for (const TariffPrefix& entry : prefixes) {
+        if (entry.prefix.empty() || RoutingTable::normalizeNumber(entry.prefix) != entry.prefix) {
+            return fail("префикс должен состоять из цифр номера (не больше 15): " + entry.prefix);
+        }
+        if (!seen.insert(entry.prefix).second) {
+            return fail("префикс указан дважды: " + entry.prefix);
+        }
+        if (cities.count(entry.city) == 0) {
+            return fail("префикс " + entry.prefix + " ведет к городу без тарифа: " + entry.city);
+        }
+    }
+    return true;
+}
+
+const std::vector<Tariff>& TariffSet::tariffs() const {
+    return tariffList;
+}
+
+const std::vector<TariffPrefix>& TariffSet::prefixes() const {
+    return prefixList;
+}
+
+const Tariff& TariffSet::at(int index) const {
+    return tariffList[static_cast<std::size_t>(index)];
+}
+
+const Tariff* TariffSet::findByCity(const std::string& city) const {
+    const auto it = cityIndex.find(city);
+    return it != cityIndex.end() ? &tariffList[static_cast<std::size_t>(it->second)] : nullptr;
+}
+
+const Tariff& TariffSet::at(int index, std::int64_t time) const {
+    const std::vector<TariffVersion>& cityVersions = versionList[static_cast<std::size_t>(index)];
+    if (time == 0 || cityVersions.empty()) {
+        return at(index);
+    }
+    // Последняя версия, начавшаяся не позже time
+    auto version = std::upper_bound(cityVersions.begin(), cityVersions.end(), time,
+                                    [](std::int64_t value, const TariffVersion& entry) {
+                                        return value < entry.effectiveFrom;
+                                    });
+    if (version == cityVersions.begin() || time >= (--version)->effectiveTo) {
+        return at(index);
+    }
+    return version->tariff;
+}
+
+const Tariff* TariffSet::findByCity(const std::string& city, std::int64_t time) const {
+    const auto it = cityIndex.find(city);
+    return it != cityIndex.end() ? &at(it->second, time) : nullptr;
+}
+
+const std::vector<TariffVersion>& TariffSet::versions(int index) const {
+    return versionList[static_cast<std::size_t>(index)];
+}
+
+const Tariff* TariffSet::findByNumber(std::string_view digits) const {
+    const int index = routingTable.route(digits);
+    return index >= 0 ? &tariffList[static_cast<std::size_t>(index)] : nullptr;
+}
+
+const RoutingTable& TariffSet::routes() const {
+    return routingTable;
+}
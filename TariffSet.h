@@ -0,0 +1,66 @@
+#ifndef TARIFFSET_H
+#define TARIFFSET_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Tariff.h"
+#include "RoutingTable.h"
+
+// Цены тарифа, действовавшие в [effectiveFrom, effectiveTo) (секунды Unix).
+// Версии хранятся в таблице tariff_versions, их ведут триггеры на tariffs
+struct TariffVersion {
+    static constexpr std::int64_t OpenEnded = std::numeric_limits<std::int64_t>::max();
+
+    Tariff tariff;
+    std::int64_t effectiveFrom = 0;
+    std::int64_t effectiveTo = OpenEnded;    // OpenEnded - действует сейчас
+};
+
+// Неизменяемый набор тарифов вместе с маршрутами по префиксам номеров.
+// DataManager держит текущий набор под std::shared_ptr и заменяет его целиком
+// одной атомарной записью указателя: тарификация берет набор в начале пакета и
+// дорабатывает пакет по нему, даже если тем временем опубликован новый. Таблица
+// маршрутов строится в конструкторе - для перезагрузки это делает рабочий поток.
+class TariffSet {
+public:
+    TariffSet() = default;
+    // Версии городов, которых нет в tariffs, отбрасываются
+    TariffSet(std::vector<Tariff> tariffs, std::vector<TariffPrefix> prefixes,
+              std::vector<TariffVersion> versions = {});
+
+    // Набор, который нельзя публиковать целиком: пустой или повторяющийся город,
+    // отрицательная цена, префикс не из цифр, повторяется или ведет к городу без тарифа
+    static bool validate(const std::vector<Tariff>& tariffs, const std::vector<TariffPrefix>& prefixes,
+                         std::string* error);
+
+    const std::vector<Tariff>& tariffs() const;
+    const std::vector<TariffPrefix>& prefixes() const;
+    const Tariff& at(int index) const;
+    const Tariff* findByCity(const std::string& city) const;
+    // Цены, действовавшие в момент time: двоичный поиск по отсортированным версиям
+    // направления. time 0 (момент неизвестен), направление без версий или момент вне
+    // всех интервалов - текущий тариф
+    const Tariff& at(int index, std::int64_t time) const;
+    const Tariff* findByCity(const std::string& city, std::int64_t time) const;
+    // Версии направления по началу действия
+    const std::vector<TariffVersion>& versions(int index) const;
+    // digits - нормализованный номер (RoutingTable::normalizeNumber)
+    const Tariff* findByNumber(std::string_view digits) const;
+    // Направления - индексы в tariffs()
+    const RoutingTable& routes() const;
+
+private:
+    std::vector<Tariff> tariffList;
+    std::vector<TariffPrefix> prefixList;
+    std::unordered_map<std::string, int> cityIndex;
+    // По индексу тарифа; интервалы одного направления не пересекаются
+    std::vector<std::vector<TariffVersion>> versionList;
+    RoutingTable routingTable;
+};
+
+#endif
@@ -1,7 +1,7 @@
 #include "VIPClient.h"
 #include <iostream>
 
-VIPClient::VIPClient() : Client(), discount(0.0), personalManager(""), loyaltyProgram() {}
+VIPClient::VIPClient() : Client(), personalManager(""), loyaltyProgram() {}
 
 // --- ИСПРАВЛЕННАЯ СТРОКА ---
 // БЫЛО: loyaltyProgram(discount, 0)
@@ -9,16 +9,16 @@ VIPClient::VIPClient() : Client(), discount(0.0), personalManager(""), loyaltyPr
 // Мы передаем "VIP" как строку статуса и discount как скидку.
 VIPClient::VIPClient(const std::string& name, const std::string& phoneNumber,
                      double balance, double discount, const std::string& manager)
-    : Client(name, phoneNumber, balance), discount(discount),
+    : Client(name, phoneNumber, balance),
     personalManager(manager), loyaltyProgram("VIP", discount) {}
 
 // ДОБАВЬТЕ:
 double VIPClient::getDiscount() const {
-    return discount;
+    return loyaltyProgram.getDiscountPercent();
 }
 
 void VIPClient::setDiscount(double discount) {
-    this->discount = discount;
+    loyaltyProgram.setDiscountPercent(discount);
 }
 
 std::string VIPClient::getPersonalManager() const {
@@ -33,9 +33,13 @@ LoyaltyProgram& VIPClient::getLoyaltyProgram() {
     return loyaltyProgram;
 }
 
+const LoyaltyProgram& VIPClient::getLoyaltyProgram() const {
+    return loyaltyProgram;
+}
+
 void VIPClient::display() const {
     Client::display();
-    std::cout << "Скидка: " << discount << "%" << std::endl;
+    std::cout << "Скидка: " << getDiscount() << "%" << std::endl;
     std::cout << "Персональный менеджер: " << personalManager << std::endl;
     // loyaltyProgram.display(); // У LoyaltyProgram нет метода display()
     loyaltyProgram.displayLoyaltyInfo(); // У нее есть displayLoyaltyInfo()
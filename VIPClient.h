@@ -7,8 +7,8 @@
 
 class VIPClient : public Client {
 private:
-    double discount;
     std::string personalManager;
+    // Скидка VIP хранится только здесь (вместе с уровнем), в пределах 0-50%
     LoyaltyProgram loyaltyProgram;
 
 public:
@@ -23,6 +23,7 @@ public:
     void setPersonalManager(const std::string& manager);
 
     LoyaltyProgram& getLoyaltyProgram();
+    const LoyaltyProgram& getLoyaltyProgram() const;
 
     void display() const override;
 };
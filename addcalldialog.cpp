@@ -5,6 +5,7 @@
 #include <QFormLayout>
 #include <QPushButton>
 #include <QMessageBox>
+#include <QDateTime>
 
 AddCallDialog::AddCallDialog(QWidget *parent, DataManager *dm)
     : QDialog(parent), dataManager(dm), calculatedCost(0.0) {
@@ -22,30 +23,35 @@ void AddCallDialog::setupUI() {
 
     QFormLayout *formLayout = new QFormLayout();
 
-    callerComboBox = new QComboBox(this);
-    // ЗАЩИТА: Запрещаем ручной ввод, разрешаем только выбор из списка
-    callerComboBox->setEditable(false);
-
-    const auto& clients = dataManager->getClients();
-    for (const auto& client : clients) {
-        callerComboBox->addItem(QString::fromStdString(client.getName()));
-    }
-    const auto& vipClients = dataManager->getVIPClients();
-    for (const auto& vip : vipClients) {
-        callerComboBox->addItem(QString::fromStdString(vip.getName()) + " (VIP)");
-    }
-
-    if (callerComboBox->count() == 0) {
+    if (dataManager->clientCount() + dataManager->vipClientCount() == 0) {
         QMessageBox::warning(this, "Предупреждение", "Сначала добавьте клиентов!");
         reject();
         return;
     }
 
+    callerEdit = new QLineEdit(this);
+    callerEdit->setPlaceholderText("Имя или номер телефона");
+    callerEdit->setClearButtonEnabled(true);
+    // Подсказки подбирает DataManager, completer только показывает их как есть.
+    // Completer не привязан к полю через setCompleter: иначе он вставил бы в поле
+    // текст подсказки (с номером), а не имя абонента.
+    callerModel = new QStringListModel(this);
+    callerCompleter = new QCompleter(callerModel, this);
+    callerCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    callerCompleter->setMaxVisibleItems(MaxSuggestions);
+    callerCompleter->setWidget(callerEdit);
+
+    // Тарифов - единицы и десятки: обычный список с поиском по вхождению
     destinationComboBox = new QComboBox(this);
     const auto& tariffs = dataManager->getTariffs();
     for (const auto& tariff : tariffs) {
         destinationComboBox->addItem(QString::fromStdString(tariff.getCity()));
     }
+    destinationComboBox->setEditable(true);
+    destinationComboBox->setInsertPolicy(QComboBox::NoInsert);
+    destinationComboBox->completer()->setCompletionMode(QCompleter::PopupCompletion);
+    destinationComboBox->completer()->setFilterMode(Qt::MatchContains);
+    destinationComboBox->setToolTip("Город или набранный номер: направление определяется по префиксу номера");
 
     if (destinationComboBox->count() == 0) {
         QMessageBox::warning(this, "Предупреждение", "Сначала добавьте тарифы!");
@@ -61,7 +67,7 @@ void AddCallDialog::setupUI() {
     costLabel = new QLabel("0.00 ₽", this);
     costLabel->setStyleSheet("QLabel { font-size: 14pt; font-weight: bold; color: green; }");
 
-    formLayout->addRow("Абонент:", callerComboBox);
+    formLayout->addRow("Абонент:", callerEdit);
     formLayout->addRow("Направление:", destinationComboBox);
     formLayout->addRow("Длительность:", durationSpinBox);
     formLayout->addRow("Стоимость звонка:", costLabel);
@@ -82,8 +88,12 @@ void AddCallDialog::setupUI() {
     connect(cancelButton, &QPushButton::clicked, this, &AddCallDialog::onCancel);
     connect(destinationComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &AddCallDialog::onDestinationChanged);
+    connect(destinationComboBox, &QComboBox::editTextChanged, this, &AddCallDialog::onDestinationChanged);
     connect(durationSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &AddCallDialog::onDurationChanged);
+    connect(callerEdit, &QLineEdit::textEdited, this, &AddCallDialog::onCallerEdited);
+    connect(callerCompleter, QOverload<const QModelIndex&>::of(&QCompleter::activated),
+            this, &AddCallDialog::onCallerChosen);
 
     updateCost();
 }
@@ -104,39 +114,68 @@ void AddCallDialog::onDurationChanged() {
     updateCost();
 }
 
+void AddCallDialog::onCallerEdited(const QString& text) {
+    QStringList suggestions;
+    suggestedNames.clear();
+    const SubscriberStore& subscribers = dataManager->subscribers();
+    for (const SubscriberMatch& match : dataManager->searchSubscribers(text, MaxSuggestions)) {
+        const QString name = toQString(subscribers.text(match.nameId));
+        QString suggestion = name + "  " + toQString(subscribers.text(match.phoneId));
+        if (match.kind == SubscriberKind::Vip) {
+            suggestion += " (VIP)";
+        }
+        suggestions << suggestion;
+        suggestedNames << name;
+    }
+    callerModel->setStringList(suggestions);
+    if (!suggestions.isEmpty()) {
+        callerCompleter->complete();
+    }
+    updateCost();
+}
+
+void AddCallDialog::onCallerChosen(const QModelIndex& index) {
+    if (index.row() >= 0 && index.row() < suggestedNames.size()) {
+        callerEdit->setText(suggestedNames[index.row()]);
+        updateCost();
+    }
+}
+
+QString AddCallDialog::callerName() const {
+    return callerEdit->text().trimmed();
+}
+
+QString AddCallDialog::destinationCity() const {
+    const QString text = destinationComboBox->currentText().trimmed();
+    if (dataManager->findTariffByCity(text.toStdString())) {
+        return text;
+    }
+    const Tariff* tariff = dataManager->findTariffByNumber(text.toStdString());
+    return tariff ? QString::fromStdString(tariff->getCity()) : text;
+}
+
 void AddCallDialog::updateCost() {
-    QString destination = destinationComboBox->currentText();
+    QString destination = destinationCity();
     int duration = durationSpinBox->value();
 
-    Tariff* tariff = dataManager->findTariffByCity(destination.toStdString());
-    if (tariff) {
-        calculatedCost = tariff->getConnectionFee() + (tariff->getPricePerMinute() * duration);
-
-        QString caller = callerComboBox->currentText();
-        if (caller.contains("(VIP)")) {
-            const auto& vipClients = dataManager->getVIPClients();
-            QString cleanName = caller.replace(" (VIP)", "");
-            for (const auto& vip : vipClients) {
-                if (QString::fromStdString(vip.getName()) == cleanName) {
-                    double discount = vip.getDiscount() / 100.0;
-                    calculatedCost *= (1.0 - discount);
-                    break;
-                }
-            }
-        }
+    const QString caller = callerName();
 
+    // Тарификация (включая скидку VIP) выполняется ядром, как и в atc-cli
+    double cost = dataManager->calculateCallCost(caller.toStdString(), destination.toStdString(), duration);
+    if (cost >= 0) {
+        calculatedCost = cost;
         costLabel->setText(QString::number(calculatedCost, 'f', 2) + " ₽");
     }
 }
 
 void AddCallDialog::validateAndAccept() {
-    if (callerComboBox->currentIndex() < 0) {
-        QMessageBox::warning(this, "Ошибка", "Выберите абонента!");
+    if (!dataManager->clientExists(callerName().toStdString())) {
+        QMessageBox::warning(this, "Ошибка", "Выберите абонента из списка подсказок!");
         return;
     }
 
-    if (destinationComboBox->currentIndex() < 0) {
-        QMessageBox::warning(this, "Ошибка", "Выберите направление!");
+    if (dataManager->findTariffByCity(destinationCity().toStdString()) == nullptr) {
+        QMessageBox::warning(this, "Ошибка", "Выберите направление или введите номер с известным префиксом!");
         return;
     }
 
@@ -149,13 +188,11 @@ void AddCallDialog::validateAndAccept() {
 }
 
 Call AddCallDialog::getCall() const {
-    QString caller = callerComboBox->currentText();
-    caller = caller.replace(" (VIP)", "");
-
     return Call(
-        caller.toStdString(),
-        destinationComboBox->currentText().toStdString(),
+        callerName().toStdString(),
+        destinationCity().toStdString(),
         durationSpinBox->value(),
-        calculatedCost
+        calculatedCost,
+        QDateTime::currentSecsSinceEpoch()
         );
 }
@@ -6,6 +6,9 @@
 
 #include <QDialog>
 #include <QComboBox>
+#include <QCompleter>
+#include <QLineEdit>
+#include <QStringListModel>
 #include <QSpinBox>
 #include <QLabel>
 #include "Call.h"
@@ -25,19 +28,32 @@ private slots:
     void onCancel();
     void onDestinationChanged();
     void onDurationChanged();
+    void onCallerEdited(const QString& text);
+    void onCallerChosen(const QModelIndex& index);
     
 private:
-    QComboBox *callerComboBox;
+    // Абонент вводится с автодополнением по индексу DataManager (имя или номер):
+    // список из миллиона абонентов в окно не загружается
+    QLineEdit *callerEdit;
+    QCompleter *callerCompleter;
+    QStringListModel *callerModel;
+    // Имена абонентов для строк текущего списка подсказок
+    QStringList suggestedNames;
     QComboBox *destinationComboBox;
     QSpinBox *durationSpinBox;
     QLabel *costLabel;
     
+    static const int MaxSuggestions = 20;
+
     DataManager *dataManager;
     double calculatedCost;
     
     void setupUI();
     void validateAndAccept();
     void updateCost();
+    QString callerName() const;
+    // Город направления: выбранный из списка или найденный по префиксу набранного номера
+    QString destinationCity() const;
 };
 
 #endif // ADDCALLDIALOG_H
\ No newline at end of file
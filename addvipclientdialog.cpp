@@ -6,6 +6,7 @@
 #include <QPushButton>
 #include <QMessageBox>
 #include <QRegularExpression>
+#include "LoyaltyEngine.h"
 
 AddVIPClientDialog::AddVIPClientDialog(QWidget *parent)
     : QDialog(parent), isEditMode(false) {
@@ -47,11 +48,16 @@ void AddVIPClientDialog::setupUI() {
     balanceSpinBox->setSuffix(" ₽");
     balanceSpinBox->setValue(1000.0);
     
+    // Скидку задает уровень лояльности (LoyaltyEngine), поле только для просмотра;
+    // новый клиент начинает с нулевого уровня
     discountSpinBox = new QDoubleSpinBox(this);
-    discountSpinBox->setRange(0.0, 100.0);
+    discountSpinBox->setRange(0.0, 50.0);
     discountSpinBox->setDecimals(1);
     discountSpinBox->setSuffix(" %");
-    discountSpinBox->setValue(10.0);
+    discountSpinBox->setReadOnly(true);
+    discountSpinBox->setButtonSymbols(QAbstractSpinBox::NoButtons);
+    discountSpinBox->setToolTip("Скидка определяется уровнем лояльности");
+    discountSpinBox->setValue(LoyaltyEngine::tier(0).discount);
     
     managerEdit = new QLineEdit(this);
     managerEdit->setPlaceholderText("Менеджер Анна");
@@ -110,11 +116,6 @@ void AddVIPClientDialog::validateAndAccept() {
         return;
     }
     
-    if (discountSpinBox->value() < 0 || discountSpinBox->value() > 100) {
-        QMessageBox::warning(this, "Ошибка", "Скидка должна быть от 0 до 100%!");
-        return;
-    }
-    
     QString manager = managerEdit->text().trimmed();
     if (manager.isEmpty()) {
         QMessageBox::warning(this, "Ошибка", "Введите имя персонального менеджера!");
@@ -0,0 +1,20 @@
+# Корневой проект: собирает ядро, консольную утилиту, GUI и тесты
+TEMPLATE = subdirs
+
+SUBDIRS = core cli gui tests
+
+# Все подпроекты лежат в одном каталоге, поэтому у каждого свой Makefile
+core.file = atc_core.pro
+core.makefile = Makefile.core
+
+cli.file = atc_cli.pro
+cli.makefile = Makefile.cli
+cli.depends = core
+
+gui.file = atc_gui.pro
+gui.makefile = Makefile.gui
+gui.depends = core
+
+tests.file = atc_tests.pro
+tests.makefile = Makefile.tests
+tests.depends = core
@@ -0,0 +1,30 @@
+# Консольная утилита для пакетных запусков на серверах (без дисплея)
+QT = core sql network
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = atc-cli
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    cli_main.cpp \
+    IngestServer.cpp
+
+HEADERS += \
+    IngestServer.h
+
+include(atc_core.pri)
+
+MOC_DIR = build/cli/moc
+OBJECTS_DIR = build/cli/obj
+
+macx {
+    QMAKE_MACOSX_DEPLOYMENT_TARGET = 13.0
+}
+
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/ATC_System/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,8 @@
+# Подключение статической библиотеки atc_core к приложениям (GUI, atc-cli)
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+LIBS += -L$$OUT_PWD/build/lib -latc_core
+
+win32-msvc*: PRE_TARGETDEPS += $$OUT_PWD/build/lib/atc_core.lib
+else: PRE_TARGETDEPS += $$OUT_PWD/build/lib/libatc_core.a
@@ -0,0 +1,68 @@
+# Статическая библиотека ядра: модели и DataManager без зависимости от GUI
+QT = core sql
+
+CONFIG += staticlib c++17
+
+TARGET = atc_core
+TEMPLATE = lib
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    Person.cpp \
+    Client.cpp \
+    LoyaltyProgram.cpp \
+    VIPClient.cpp \
+    Tariff.cpp \
+    Call.cpp \
+    StringPool.cpp \
+    SubscriberStore.cpp \
+    SubscriberIndex.cpp \
+    RoutingTable.cpp \
+    TariffSet.cpp \
+    CallStore.cpp \
+    LoyaltyEngine.cpp \
+    Snapshot.cpp \
+    CallArchive.cpp \
+    CallHistory.cpp \
+    BloomFilter.cpp \
+    Metrics.cpp \
+    StatementCache.cpp \
+    ConnectionPool.cpp \
+    DataManager.cpp \
+    CdrTailer.cpp \
+    AsyncDataManager.cpp
+
+HEADERS += \
+    Person.h \
+    Client.h \
+    LoyaltyProgram.h \
+    VIPClient.h \
+    Tariff.h \
+    Call.h \
+    StringPool.h \
+    SubscriberStore.h \
+    SubscriberIndex.h \
+    RoutingTable.h \
+    TariffSet.h \
+    CallStore.h \
+    LoyaltyEngine.h \
+    Snapshot.h \
+    CallArchive.h \
+    CallHistory.h \
+    BloomFilter.h \
+    Metrics.h \
+    StatementCache.h \
+    ConnectionPool.h \
+    DataManager.h \
+    CdrTailer.h \
+    MpscQueue.h \
+    AsyncDataManager.h
+
+DESTDIR = $$OUT_PWD/build/lib
+MOC_DIR = build/core/moc
+OBJECTS_DIR = build/core/obj
+
+macx {
+    QMAKE_MACOSX_DEPLOYMENT_TARGET = 13.0
+}
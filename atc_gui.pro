@@ -2,7 +2,7 @@ QT       += core gui widgets sql
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-CONFIG += c++11
+CONFIG += c++17
 
 TARGET = ATC_System
 TEMPLATE = app
@@ -16,13 +16,7 @@ SOURCES += \
     addclientdialog.cpp \
     addvipclientdialog.cpp \
     addcalldialog.cpp \
-    Person.cpp \
-    Client.cpp \
-    LoyaltyProgram.cpp \
-    VIPClient.cpp \
-    Tariff.cpp \
-    Call.cpp \
-    DataManager.cpp
+    diagnosticsdialog.cpp
 
 HEADERS += \
     mainwindow.h \
@@ -30,13 +24,10 @@ HEADERS += \
     addclientdialog.h \
     addvipclientdialog.h \
     addcalldialog.h \
-    Person.h \
-    Client.h \
-    LoyaltyProgram.h \
-    VIPClient.h \
-    Tariff.h \
-    Call.h \
-    DataManager.h
+    diagnosticsdialog.h
+
+# Модели и DataManager собираются в библиотеку atc_core (atc_core.pro)
+include(atc_core.pri)
 
 # НЕ НУЖНЫ .ui файлы - UI создается в коде!
 
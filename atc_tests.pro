@@ -0,0 +1,24 @@
+# Модульные тесты ядра (QtTest): make check
+QT = core sql testlib
+
+CONFIG += console c++17 testcase
+CONFIG -= app_bundle
+
+TARGET = atc-tests
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    tests/tests_main.cpp \
+    tests/CallArchiveTest.cpp \
+    tests/CallHistoryTest.cpp
+
+HEADERS += \
+    tests/CallArchiveTest.h \
+    tests/CallHistoryTest.h
+
+include(atc_core.pri)
+
+MOC_DIR = build/tests/moc
+OBJECTS_DIR = build/tests/obj
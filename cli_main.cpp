@@ -0,0 +1,991 @@
+// cli_main.cpp
+// Консольная утилита atc-cli: пакетные операции над БД без графического интерфейса
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include "DataManager.h"
+#include "AsyncDataManager.h"
+#include "CdrTailer.h"
+#include "IngestServer.h"
+#include "CallHistory.h"
+
+namespace {
+
+QTextStream& out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream& err() {
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+int fail(const QString& message) {
+    err() << "atc-cli: " << message << Qt::endl;
+    return 1;
+}
+
+int runImport(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("import: укажите CSV-файл");
+    }
+    int imported = 0;
+    int duplicates = 0;
+    if (!dm.importFromCSV(args.first(), &imported, &duplicates)) {
+        return fail(dm.lastError());
+    }
+    out() << "Импортировано записей: " << imported << Qt::endl;
+    if (duplicates > 0) {
+        out() << "Пропущено повторных звонков: " << duplicates << Qt::endl;
+    }
+    return 0;
+}
+
+int runExport(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("export: укажите CSV-файл");
+    }
+    if (!dm.exportToCSV(args.first())) {
+        return fail(dm.lastError());
+    }
+    out() << "Экспорт выполнен: " << args.first() << Qt::endl;
+    return 0;
+}
+
+int runRate(DataManager& dm) {
+    int changed = dm.rerateCalls();
+    if (changed < 0) {
+        return fail(dm.lastError());
+    }
+    out() << "Пересчитано звонков: " << changed << Qt::endl;
+    return 0;
+}
+
+// Направление и тариф для каждого номера по самому длинному префиксу
+int runRoute(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("route: укажите номер");
+    }
+    for (const QString& number : args) {
+        const Tariff* tariff = dm.findTariffByNumber(number.toStdString());
+        out() << number << ": ";
+        if (tariff) {
+            out() << QString::fromStdString(tariff->getCity()) << " ("
+                  << QString::number(tariff->getPricePerMinute(), 'f', 2) << " за минуту)" << Qt::endl;
+        } else {
+            out() << "маршрут не найден" << Qt::endl;
+        }
+    }
+    return 0;
+}
+
+// CDR коммутатора: номер_абонента;набранный_номер;длительность;начало (ISO 8601).
+// Абонент и направление определяются по номерам, стоимость - по тарифам.
+int runImportCdr(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("import-cdr: укажите файл CDR");
+    }
+    QFile file(args.first());
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return fail("import-cdr: не удалось открыть " + args.first());
+    }
+    QTextStream in(&file);
+    std::vector<DialedCall> batch;
+    int malformed = 0;
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        DialedCall call;
+        if (!parseDialedCall(line, &call)) {
+            ++malformed;
+            continue;
+        }
+        batch.push_back(call);
+    }
+
+    RatingStats stats;
+    const std::vector<Call> rated = dm.rateDialedCalls(batch, &stats);
+    std::vector<qint64> ids;
+    int duplicates = 0;
+    const int inserted = dm.writeCalls(rated, &ids, ProgressCallback(), &duplicates);
+    if (inserted < 0) {
+        return fail(dm.lastError());
+    }
+    out() << "Записано звонков: " << inserted << Qt::endl;
+    if (duplicates > 0) {
+        out() << "Пропущено повторных звонков: " << duplicates << Qt::endl;
+    }
+    const int rejected = malformed + stats.invalid + stats.unknownCaller + stats.unrouted;
+    if (rejected > 0) {
+        out() << "Отброшено CDR: " << rejected << " (неизвестный абонент: " << stats.unknownCaller
+              << ", нет маршрута: " << stats.unrouted << ", ошибки формата: " << malformed + stats.invalid
+              << ")" << Qt::endl;
+    }
+    return 0;
+}
+
+// Замена тарифов из файла (CSV, записи tariff и prefix): проверка и запись в БД -
+// в потоке-писателе, публикация - одной заменой указателя. Прием не прерывается:
+// начатые пакеты дотарифицируются по прежнему набору.
+int runLoadTariffs(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("load-tariffs: укажите файл тарифов");
+    }
+    std::shared_ptr<const TariffSet> tariffs = dm.readTariffFile(args.first());
+    if (!tariffs || !dm.writeTariffSet(*tariffs)) {
+        return fail(dm.lastError());
+    }
+    // Публикуется набор из БД: с версиями цен, которые записали триггеры
+    tariffs = dm.readTariffSet();
+    if (!tariffs) {
+        return fail(dm.lastError());
+    }
+    dm.publishTariffs(tariffs);
+    out() << "Тарифов: " << tariffs->tariffs().size() << ", префиксов номеров: " << tariffs->prefixes().size()
+          << Qt::endl;
+    return 0;
+}
+
+// Цены направления по периодам действия (tariff_versions)
+int runTariffHistory(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("tariff-history: укажите город");
+    }
+    const std::vector<TariffVersion> versions = dm.tariffVersions(args.join(' ').toStdString());
+    if (versions.empty()) {
+        return fail("tariff-history: нет версий тарифа " + args.join(' '));
+    }
+    auto moment = [](qint64 time) { return QDateTime::fromSecsSinceEpoch(time).toString(Qt::ISODate); };
+    for (const TariffVersion& version : versions) {
+        out() << (version.effectiveFrom == 0 ? QString("с начала") : "с " + moment(version.effectiveFrom)) << " "
+              << (version.effectiveTo == TariffVersion::OpenEnded ? QString("по сей день")
+                                                                  : "до " + moment(version.effectiveTo))
+              << ": " << QString::number(version.tariff.getPricePerMinute(), 'f', 2) << " за минуту, соединение "
+              << QString::number(version.tariff.getConnectionFee(), 'f', 2) << Qt::endl;
+    }
+    return 0;
+}
+
+// Уровни VIP по тратам за окно. Загрузка данных уже пересчитала их по звонкам
+// и записала изменения (в том числе после import-cdr, который пишет только в БД)
+int runLoyalty(DataManager& dm) {
+    const LoyaltyEngine& loyalty = dm.loyaltyEngine();
+    const SubscriberStore& store = dm.subscribers();
+    // Дни окна считаются в UTC
+    const qint64 lastDay = loyalty.currentDay();
+    out() << "Окно: " << LoyaltyEngine::WindowDays << " дн."
+          << (lastDay > 0 ? " по " + QDate(1970, 1, 1).addDays(lastDay).toString(Qt::ISODate)
+                          : QString(" (звонков с известным временем нет)"))
+          << Qt::endl;
+    for (int i = 0; i < store.count(SubscriberKind::Vip); ++i) {
+        const SubscriberRecord& vip = store.at(SubscriberKind::Vip, i);
+        out() << toQString(store.text(vip.nameId)) << ": " << LoyaltyEngine::tier(vip.tier).name << ", траты "
+              << QString::number(loyalty.spendOf(vip.nameId), 'f', 2) << ", скидка "
+              << QString::number(vip.discount, 'f', 1) << "%" << Qt::endl;
+    }
+    return 0;
+}
+
+// --tariffs для tail и serve: файл перечитывается после каждого изменения. Редакторы
+// часто пишут новый файл и переименовывают его, поэтому путь добавляется заново, а
+// серия событий сводится к одной перезагрузке.
+void watchTariffFile(DataManager& dm, AsyncDataManager& async, QFileSystemWatcher& watcher, QTimer& debounce,
+                     const QString& path) {
+    debounce.setSingleShot(true);
+    debounce.setInterval(500);
+    QObject::connect(&watcher, &QFileSystemWatcher::fileChanged, [&debounce]() { debounce.start(); });
+    QObject::connect(&debounce, &QTimer::timeout, [&dm, &async, &watcher, path]() {
+        if (!watcher.files().contains(path)) {
+            watcher.addPath(path);
+        }
+        async.reloadTariffs(path).then(&async, [&dm, path](bool reloaded) {
+            if (reloaded) {
+                out() << QDateTime::currentDateTime().toString(Qt::ISODate) << " тарифы перезагружены из " << path
+                      << Qt::endl;
+            } else {
+                err() << "atc-cli: тарифы не перезагружены, действует прежний набор: "
+                      << dm.lastError() << Qt::endl;
+            }
+        });
+    });
+    watcher.addPath(path);
+}
+
+// Непрерывный прием CDR без окна. Позиции файлов фиксируются вместе со звонками,
+// поэтому процесс можно прервать (Ctrl+C, systemd stop) в любой момент.
+int runTail(DataManager& dm, const QStringList& args, const QString& tariffsPath) {
+    if (args.isEmpty()) {
+        return fail("tail: укажите каталог CDR или именованный канал");
+    }
+    AsyncDataManager async(&dm);
+    QFileSystemWatcher tariffWatcher;
+    QTimer tariffDebounce;
+    if (!tariffsPath.isEmpty()) {
+        watchTariffFile(dm, async, tariffWatcher, tariffDebounce, tariffsPath);
+    }
+    CdrTailer tailer(&async, &dm);
+    if (!tailer.start(args.first())) {
+        return fail(tailer.status().lastError);
+    }
+
+    QString reportedError;
+    QObject::connect(&tailer, &CdrTailer::statusChanged, [&tailer, &reportedError]() {
+        const QString error = tailer.status().lastError;
+        if (!error.isEmpty() && error != reportedError) {
+            err() << "atc-cli: " << error << Qt::endl;
+        }
+        reportedError = error;
+    });
+    QTimer report;
+    QObject::connect(&report, &QTimer::timeout, [&tailer]() {
+        const CdrIngestStatus status = tailer.status();
+        out() << QDateTime::currentDateTime().toString(Qt::ISODate) << " записано " << status.ingested
+              << ", " << QString::number(status.callsPerSecond, 'f', 0) << " зв./с, очередь "
+              << status.backlogBytes << " байт, отставание " << status.lagSeconds << " с, отброшено "
+              << status.rejected << ", повторов " << status.duplicates << Qt::endl;
+    });
+    report.start(10000);
+    return QCoreApplication::exec();
+}
+
+// Сервер приема CDR на локальном сокете; DataManager передается потоку записи сервера
+int runServe(DataManager& dm, const QStringList& args, const QString& tariffsPath) {
+    if (args.isEmpty()) {
+        return fail("serve: укажите имя или путь сокета");
+    }
+    // Поток записи сервера берет набор тарифов в начале каждой группы
+    AsyncDataManager async(&dm);
+    QFileSystemWatcher tariffWatcher;
+    QTimer tariffDebounce;
+    if (!tariffsPath.isEmpty()) {
+        watchTariffFile(dm, async, tariffWatcher, tariffDebounce, tariffsPath);
+    }
+    IngestServer server(&dm, args.size() > 1 ? args[1].toInt() : 0);
+    if (!server.start(args.first())) {
+        return fail("serve: " + server.errorString());
+    }
+    out() << "Прием CDR на сокете " << server.fullServerName() << Qt::endl;
+    QTimer report;
+    QObject::connect(&report, &QTimer::timeout, [&server]() {
+        const IngestServerStats stats = server.stats();
+        out() << QDateTime::currentDateTime().toString(Qt::ISODate) << " соединений " << stats.connections
+              << ", принято " << stats.received << ", записано " << stats.committed << " за "
+              << stats.groups << " транзакций, отброшено " << stats.rejected << ", повторов "
+              << stats.duplicates << ", в очереди " << stats.queued << Qt::endl;
+    });
+    report.start(10000);
+    return QCoreApplication::exec();
+}
+
+// Отправка файла CDR серверу serve; завершается после подтверждения всех строк
+int runSend(const QStringList& args) {
+    if (args.size() < 2) {
+        return fail("send: укажите сокет и файл CDR");
+    }
+    QFile file(args[1]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail("send: не удалось открыть " + args[1]);
+    }
+    std::vector<QByteArray> lines;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (!line.isEmpty()) {
+            lines.push_back(line);
+        }
+    }
+    IngestClient client;
+    if (!client.connectTo(args[0]) || !client.send(lines)) {
+        return fail("send: " + client.errorString());
+    }
+    out() << "Подтверждено строк: " << client.acknowledged() << ", отброшено: " << client.rejected() << Qt::endl;
+    return 0;
+}
+
+// Нагрузочный тест serve: несколько отправителей одновременно, номера абонентов и
+// префиксы - из той же БД, что у сервера (--db), время начала у каждого запуска свое
+int runBenchIngest(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("bench-ingest: укажите сокет");
+    }
+    const QString name = args[0];
+    const int producers = args.size() > 1 ? args[1].toInt() : 8;
+    const int records = args.size() > 2 ? args[2].toInt() : 100000;
+    if (producers <= 0 || records <= 0) {
+        return fail("bench-ingest: неверное число отправителей или записей");
+    }
+
+    std::vector<QByteArray> phones;
+    const SubscriberStore& subscribers = dm.subscribers();
+    for (SubscriberKind kind : {SubscriberKind::Regular, SubscriberKind::Vip}) {
+        for (int i = 0; i < subscribers.count(kind); ++i) {
+            const std::string_view phone = subscribers.text(subscribers.at(kind, i).phoneId);
+            if (!phone.empty()) {
+                phones.push_back(QByteArray(phone.data(), static_cast<qsizetype>(phone.size())));
+            }
+        }
+    }
+    std::vector<QByteArray> prefixes;
+    for (const TariffPrefix& prefix : dm.getTariffPrefixes()) {
+        prefixes.push_back(QByteArray::fromStdString(prefix.prefix));
+    }
+    if (phones.empty() || prefixes.empty()) {
+        return fail("bench-ingest: в БД нужны абоненты с номерами и префиксы тарифов");
+    }
+
+    const qint64 base = QDateTime::currentSecsSinceEpoch() - qint64(producers) * records;
+    std::atomic<qint64> acknowledged{0};
+    std::atomic<qint64> rejected{0};
+    std::atomic<int> failed{0};
+    std::vector<QThread*> threads;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    for (int p = 0; p < producers; ++p) {
+        threads.push_back(QThread::create([&, p]() {
+            std::vector<QByteArray> lines;
+            lines.reserve(static_cast<std::size_t>(records));
+            for (int i = 0; i < records; ++i) {
+                const std::uint32_t mix = static_cast<std::uint32_t>(p * records + i) * 2654435761u;
+                QByteArray dialed = prefixes[mix % prefixes.size()];
+                while (dialed.size() < 11) {
+                    dialed += char('0' + (mix >> (dialed.size() % 24)) % 10);
+                }
+                const qint64 start = base + qint64(p) * records + i;
+                lines.push_back(phones[(mix >> 8) % phones.size()] + ';' + dialed + ';' +
+                                QByteArray::number(1 + int((mix >> 16) % 60)) + ';' +
+                                QDateTime::fromSecsSinceEpoch(start).toString(Qt::ISODate).toUtf8());
+            }
+            IngestClient client;
+            if (!client.connectTo(name) || !client.send(lines)) {
+                err() << "atc-cli: bench-ingest: " << client.errorString() << Qt::endl;
+                failed.fetch_add(1);
+            }
+            acknowledged.fetch_add(client.acknowledged());
+            rejected.fetch_add(client.rejected());
+        }));
+        threads.back()->start();
+    }
+    for (QThread* thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+    const double seconds = std::max<qint64>(elapsed.elapsed(), 1) / 1000.0;
+    out() << "Отправителей: " << producers << ", подтверждено " << acknowledged.load() << " из "
+          << qint64(producers) * records << " CDR за " << QString::number(seconds, 'f', 2) << " с ("
+          << QString::number(acknowledged.load() / seconds, 'f', 0) << " CDR/с), отброшено "
+          << rejected.load() << Qt::endl;
+    return failed.load() > 0 ? 1 : 0;
+}
+
+int runStats(DataManager& dm) {
+    out() << "Тарифов: " << dm.getTariffs().size() << " (префиксов номеров: " << dm.getTariffPrefixes().size() << ")"
+          << Qt::endl;
+    out() << "Клиентов: " << dm.clientCount()
+          << " (VIP: " << dm.vipClientCount() << ")" << Qt::endl;
+    out() << "Звонков: " << dm.callCount() << " (в архиве: " << dm.archivedCallCount() << ")" << Qt::endl;
+    out() << "Общая выручка: " << QString::number(dm.reportTotalRevenue(), 'f', 2) << Qt::endl;
+
+    // Агрегаты считаются в SQLite параллельно по диапазонам id (WAL + пул соединений)
+    for (const auto& usage : dm.reportClientUsageParallel()) {
+        out() << "  " << QString::fromStdString(usage.clientName) << ": " << usage.callCount
+              << " звонков, " << QString::number(usage.totalCost, 'f', 2) << Qt::endl;
+    }
+
+    out() << "По направлениям:" << Qt::endl;
+    for (const auto& destination : dm.reportRevenueByDestination()) {
+        out() << "  " << QString::fromStdString(destination.destination) << ": " << destination.callCount
+              << " звонков, " << QString::number(destination.revenue, 'f', 2) << Qt::endl;
+    }
+    return 0;
+}
+
+int runArchive(DataManager& dm, const QStringList& args) {
+    const int days = args.isEmpty() ? 0 : args.first().toInt();
+    if (days <= 0) {
+        return fail("archive: укажите возраст звонков в днях");
+    }
+    if (days < LoyaltyEngine::WindowDays) {
+        return fail(QString("archive: возраст не меньше %1 дней - более новые звонки входят в окно "
+                            "программы лояльности").arg(LoyaltyEngine::WindowDays));
+    }
+    const qint64 cutoff = QDateTime::currentSecsSinceEpoch() - qint64(days) * 86400;
+    const int archived = dm.archiveCallsBefore(cutoff);
+    if (archived < 0) {
+        return fail(dm.lastError());
+    }
+    out() << "Перенесено в архив звонков: " << archived << Qt::endl;
+    // Место после удаления возвращается ОС только после VACUUM
+    if (archived > 0 && !dm.compactDatabase()) {
+        return fail(dm.lastError());
+    }
+    return 0;
+}
+
+// Вся история звонков (с архивом) в сжатом виде и отчеты по ней без SQL
+int runHistory(DataManager& dm) {
+    QElapsedTimer elapsed;
+    elapsed.start();
+    CallHistory history;
+    if (!dm.readCallHistory(&history)) {
+        return fail(dm.lastError());
+    }
+    const qint64 loadMs = elapsed.restart();
+    const double revenue = history.totalRevenue();
+    const std::vector<DestinationRevenue> destinations = history.revenueByDestination();
+    const qint64 scanMs = elapsed.elapsed();
+
+    const std::size_t count = std::max<std::size_t>(history.count(), 1);
+    out() << "Звонков в истории: " << history.count() << " (загрузка " << loadMs << " мс)" << Qt::endl;
+    out() << "Память: " << QString::number(double(history.memoryUsage()) / count, 'f', 1) << " байт/звонок"
+          << Qt::endl;
+    out() << "Общая выручка: " << QString::number(revenue, 'f', 2) << " (отчеты " << scanMs << " мс)" << Qt::endl;
+    for (const auto& destination : destinations) {
+        out() << "  " << QString::fromStdString(destination.destination) << ": " << destination.callCount
+              << " звонков, " << QString::number(destination.revenue, 'f', 2) << Qt::endl;
+    }
+    return 0;
+}
+
+// Строка отчета моделирования: выручка сейчас, по новым тарифам и разница
+QString formatRevenueDelta(const RevenueDelta& row) {
+    const double percent = row.currentRevenue != 0.0 ? row.delta() / row.currentRevenue * 100.0 : 0.0;
+    return QString::fromStdString(row.name) + ": " + QString::number(row.callCount) + " звонков, " +
+           QString::number(row.currentRevenue, 'f', 2) + " -> " + QString::number(row.proposedRevenue, 'f', 2) +
+           " (" + (row.delta() >= 0 ? "+" : "") + QString::number(row.delta(), 'f', 2) + ", " +
+           (percent >= 0 ? "+" : "") + QString::number(percent, 'f', 1) + "%)";
+}
+
+// Моделирование тарифов из CSV (записи tariff и prefix) по всей истории с архивом.
+// Ни тарифы, ни звонки не меняются
+int runSimulate(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("simulate: укажите файл тарифов");
+    }
+    std::shared_ptr<const TariffSet> proposed = dm.readTariffFile(args.first());
+    if (!proposed) {
+        return fail(dm.lastError());
+    }
+    QElapsedTimer elapsed;
+    elapsed.start();
+    CallHistory history;
+    if (!dm.readCallHistory(&history)) {
+        return fail(dm.lastError());
+    }
+    const qint64 loadMs = elapsed.restart();
+    const TariffSimulation simulation = dm.simulateTariffs(history, dm.subscribers(), *proposed);
+    const qint64 simulateMs = elapsed.elapsed();
+
+    out() << "Звонков в истории: " << history.count() << " (загрузка " << loadMs << " мс, пересчет "
+          << simulateMs << " мс)" << Qt::endl;
+    out() << formatRevenueDelta(simulation.total) << Qt::endl;
+    out() << "  " << formatRevenueDelta(simulation.regular) << Qt::endl;
+    out() << "  " << formatRevenueDelta(simulation.vip) << Qt::endl;
+    if (simulation.unratedCalls > 0) {
+        out() << "Без тарифа в одном из наборов (стоимость прежняя): " << simulation.unratedCalls << " звонков"
+              << Qt::endl;
+    }
+    out() << "По направлениям:" << Qt::endl;
+    for (const auto& destination : simulation.destinations) {
+        out() << "  " << formatRevenueDelta(destination) << Qt::endl;
+    }
+    return 0;
+}
+
+// Массовое удаление звонков по условию: client=, destination=, from= и before=
+// (дата ISO 8601), min= и max= (минуты). Одна транзакция.
+int runPurgeCalls(DataManager& dm, const QStringList& args) {
+    CallFilter filter;
+    for (const QString& arg : args) {
+        const QString key = arg.section('=', 0, 0);
+        const QString value = arg.section('=', 1);
+        bool ok = true;
+        if (key == "client") {
+            filter.callerName = value.toStdString();
+        } else if (key == "destination") {
+            filter.destination = value.toStdString();
+        } else if (key == "from" || key == "before") {
+            const QDateTime time = QDateTime::fromString(value, Qt::ISODate);
+            ok = time.isValid();
+            (key == "from" ? filter.startedFrom : filter.startedBefore) = time.toSecsSinceEpoch();
+        } else if (key == "min") {
+            filter.minDuration = value.toInt(&ok);
+        } else if (key == "max") {
+            filter.maxDuration = value.toInt(&ok);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return fail("purge-calls: неверное условие " + arg);
+        }
+    }
+    const int removed = dm.removeCallsWhere(filter);
+    if (removed < 0) {
+        return fail(dm.lastError());
+    }
+    out() << "Удалено звонков: " << removed << Qt::endl;
+    return 0;
+}
+
+int runBackup(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("backup: укажите файл резервной копии");
+    }
+    if (!dm.backupDatabase(args.first())) {
+        return fail(dm.lastError());
+    }
+    out() << "Резервная копия создана: " << args.first() << Qt::endl;
+    return 0;
+}
+
+int runRestore(DataManager& dm, const QStringList& args) {
+    if (args.isEmpty()) {
+        return fail("restore: укажите файл резервной копии");
+    }
+    if (!dm.restoreDatabase(args.first())) {
+        return fail(dm.lastError());
+    }
+    out() << "База данных восстановлена из: " << args.first() << Qt::endl;
+    return 0;
+}
+
+// Память на абонента: прежнее представление (векторы Client/VIPClient) против
+// SubscriberStore. Синтетические абоненты, каждый пятый - VIP с одним из 50 менеджеров.
+int runBenchMemory(const QStringList& args) {
+    const int count = args.isEmpty() ? 1000000 : args.first().toInt();
+    if (count <= 0) {
+        return fail("bench-memory: неверное число абонентов");
+    }
+
+    auto name = [](int i) { return "Абонент " + QString::number(i).rightJustified(7, '0').toStdString(); };
+    auto phone = [](int i) { return "+7900" + QString::number(i).rightJustified(7, '0').toStdString(); };
+    auto manager = [](int i) { return "Менеджер " + std::to_string(i % 50); };
+
+    std::size_t legacyBytes = 0;
+    {
+        std::vector<Client> clients;
+        std::vector<VIPClient> vipClients;
+        for (int i = 0; i < count; ++i) {
+            if (i % 5 == 0) {
+                vipClients.push_back(VIPClient(name(i), phone(i), 100.0, 10.0, manager(i)));
+            } else {
+                clients.push_back(Client(name(i), phone(i), 100.0));
+            }
+        }
+        legacyBytes = clients.capacity() * sizeof(Client) + vipClients.capacity() * sizeof(VIPClient);
+        for (const auto& client : clients) {
+            legacyBytes += stringHeapBytes(client.getName().size()) + stringHeapBytes(client.getPhoneNumber().size());
+        }
+        for (auto& vip : vipClients) {
+            legacyBytes += stringHeapBytes(vip.getName().size()) + stringHeapBytes(vip.getPhoneNumber().size()) +
+                           stringHeapBytes(vip.getPersonalManager().size()) +
+                           stringHeapBytes(vip.getLoyaltyProgram().getVIPStatus().size());
+        }
+    }
+
+    SubscriberStore store;
+    for (int i = 0; i < count; ++i) {
+        if (i % 5 == 0) {
+            store.add(VIPClient(name(i), phone(i), 100.0, 10.0, manager(i)));
+        } else {
+            store.add(Client(name(i), phone(i), 100.0));
+        }
+    }
+
+    out() << "Абонентов: " << count << Qt::endl;
+    out() << "sizeof(Client) = " << sizeof(Client) << ", sizeof(VIPClient) = " << sizeof(VIPClient)
+          << ", sizeof(SubscriberRecord) = " << sizeof(SubscriberRecord) << Qt::endl;
+    out() << "Client/VIPClient: " << QString::number(double(legacyBytes) / count, 'f', 1) << " байт/абонент" << Qt::endl;
+    out() << "SubscriberStore:  " << QString::number(double(store.memoryUsage()) / count, 'f', 1) << " байт/абонент" << Qt::endl;
+    return 0;
+}
+
+// Память и скорость агрегатов: CallStore против сжатых блоков CallHistory, и
+// моделирование тарифов по истории.
+// Синтетические звонки: 10000 абонентов, 200 направлений, 1-60 минут.
+int runBenchCalls(const QStringList& args) {
+    const int count = args.isEmpty() ? 1000000 : args.first().toInt();
+    if (count <= 0) {
+        return fail("bench-calls: неверное число звонков");
+    }
+
+    std::vector<std::string> callers;
+    for (int i = 0; i < 10000; ++i) {
+        callers.push_back("Абонент " + std::to_string(i));
+    }
+    std::vector<std::string> destinations;
+    for (int i = 0; i < 200; ++i) {
+        destinations.push_back("Город " + std::to_string(i));
+    }
+
+    CallStore store;
+    store.reset(static_cast<std::size_t>(count));
+    CallHistory history;
+    std::size_t legacyBytes = 0;
+    qint64 startTime = 1700000000;
+    for (int i = 0; i < count; ++i) {
+        const std::uint32_t mix = static_cast<std::uint32_t>(i) * 2654435761u;
+        const std::string& caller = callers[mix % callers.size()];
+        const std::string& destination = destinations[(mix >> 16) % destinations.size()];
+        const int duration = 1 + static_cast<int>((mix >> 8) % 60);
+        const double cost = 2.5 + (1.0 + (mix >> 16) % 7 * 0.25) * duration;
+        startTime += (mix >> 24) % 60;
+        store.add(i + 1, caller, destination, duration, cost, startTime);
+        history.append(i + 1, caller, destination, duration, cost, startTime);
+        legacyBytes += sizeof(Call) + stringHeapBytes(caller.size()) + stringHeapBytes(destination.size());
+    }
+
+    // Тот же отчет по CallStore: суммы по id пула строк
+    QElapsedTimer elapsed;
+    elapsed.start();
+    std::vector<double> storeCosts(store.strings().size(), 0.0);
+    std::vector<int> storeCalls(store.strings().size(), 0);
+    std::vector<long long> storeDurations(store.strings().size(), 0);
+    for (int i = 0; i < store.count(); ++i) {
+        const CallRecord& call = store.at(i);
+        storeCosts[call.callerId] += call.cost;
+        storeCalls[call.callerId] += 1;
+        storeDurations[call.callerId] += call.duration;
+    }
+    const qint64 storeNs = std::max<qint64>(elapsed.nsecsElapsed(), 1);
+    elapsed.restart();
+    const std::vector<ClientUsage> usage = history.clientUsage();
+    const qint64 historyNs = std::max<qint64>(elapsed.nsecsElapsed(), 1);
+    elapsed.restart();
+    history.totalRevenue();
+    const qint64 revenueNs = std::max<qint64>(elapsed.nsecsElapsed(), 1);
+
+    // Моделирование тарифов: каждый десятый абонент - VIP, у 10 направлений цена выше на 10%
+    SubscriberStore subscribers;
+    for (std::size_t i = 0; i < callers.size(); ++i) {
+        if (i % 10 == 0) {
+            subscribers.addVip(callers[i], std::to_string(i), 0.0, 15.0, "Менеджер");
+        } else {
+            subscribers.addRegular(callers[i], std::to_string(i), 0.0);
+        }
+    }
+    std::vector<Tariff> currentTariffs;
+    std::vector<Tariff> proposedTariffs;
+    for (std::size_t i = 0; i < destinations.size(); ++i) {
+        const double price = 1.0 + i % 7 * 0.25;
+        currentTariffs.emplace_back(destinations[i], price, 2.5);
+        proposedTariffs.emplace_back(destinations[i], i < 10 ? price * 1.1 : price, 2.5);
+    }
+    const TariffSet current(std::move(currentTariffs), {});
+    const TariffSet proposed(std::move(proposedTariffs), {});
+    QThreadPool pool;
+    elapsed.restart();
+    history.simulateTariffs(current, proposed, subscribers, &pool, 0);
+    const qint64 simulateNs = std::max<qint64>(elapsed.nsecsElapsed(), 1);
+
+    auto perCall = [count](std::size_t bytes) { return QString::number(double(bytes) / count, 'f', 1); };
+    auto rate = [count](qint64 ns) { return QString::number(double(count) * 1000.0 / ns, 'f', 0); };
+    out() << "Звонков: " << count << ", абонентов в отчете: " << usage.size() << Qt::endl;
+    out() << "std::vector<Call>: " << perCall(legacyBytes) << " байт/звонок" << Qt::endl;
+    out() << "CallStore:         " << perCall(store.memoryUsage()) << " байт/звонок" << Qt::endl;
+    out() << "CallHistory:       " << perCall(history.memoryUsage()) << " байт/звонок" << Qt::endl;
+    out() << "Отчет по абонентам: CallStore " << rate(storeNs) << " млн звонков/с, CallHistory "
+          << rate(historyNs) << " млн звонков/с" << Qt::endl;
+    out() << "Общая выручка (CallHistory): " << rate(revenueNs) << " млн звонков/с" << Qt::endl;
+    out() << "Моделирование тарифов (" << pool.maxThreadCount() << " потоков): " << rate(simulateNs)
+          << " млн звонков/с" << Qt::endl;
+    return 0;
+}
+
+// Соединение замера в обход пула DataManager, с теми же режимами журнала
+QSqlDatabase openBenchDatabase(const QString& path) {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "bench-schema");
+    db.setDatabaseName(path);
+    if (db.open()) {
+        QSqlQuery pragma(db);
+        pragma.exec("PRAGMA journal_mode=WAL");
+        pragma.exec("PRAGMA synchronous=NORMAL");
+        pragma.exec("PRAGMA foreign_keys=ON");
+    }
+    return db;
+}
+
+// Время прохода по всем строкам запроса, нс
+qint64 benchScan(QSqlDatabase db, const QString& sql) {
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.exec(sql);
+    const int columns = query.record().count();
+    while (query.next()) {
+        for (int column = 0; column < columns; ++column) {
+            query.value(column);
+        }
+    }
+    return std::max<qint64>(elapsed.nsecsElapsed(), 1);
+}
+
+// Размер БД и скорость звонков: прежняя схема (имена в каждой строке calls) против
+// целочисленных ключей. Файл прежней схемы переводится тем же кодом, что при
+// открытии старой БД; синтетика как в bench-calls (10000 абонентов, 200 направлений)
+int runBenchSchema(const QStringList& args) {
+    const int count = args.isEmpty() ? 1000000 : args.first().toInt();
+    if (count <= 0) {
+        return fail("bench-schema: неверное число звонков");
+    }
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        return fail("bench-schema: не удалось создать временный каталог");
+    }
+    const QString legacyPath = dir.filePath("legacy.sqlite");
+    const QString normalizedPath = dir.filePath("normalized.sqlite");
+    const int callers = 10000;
+    const int destinations = 200;
+    auto callerName = [](int i) { return QString("Абонент %1").arg(i); };
+    auto cityName = [](int i) { return QString("Город %1").arg(i); };
+
+    // Звонки в обеих схемах одни и те же; cdr_hash уникален, как у настоящих CDR
+    auto writeCalls = [&](QSqlDatabase db, const QString& sql, bool byId) {
+        QElapsedTimer elapsed;
+        elapsed.start();
+        db.transaction();
+        QSqlQuery insert(db);
+        insert.prepare(sql);
+        qint64 startTime = 1700000000;
+        for (int i = 0; i < count; ++i) {
+            const std::uint32_t mix = static_cast<std::uint32_t>(i) * 2654435761u;
+            const int destination = static_cast<int>((mix >> 16) % destinations);
+            const int duration = 1 + static_cast<int>((mix >> 8) % 60);
+            startTime += (mix >> 24) % 60;
+            insert.bindValue(":name", callerName(static_cast<int>(mix % callers)));
+            if (byId) {
+                insert.bindValue(":dest", destination + 1);
+            } else {
+                insert.bindValue(":dest", cityName(destination));
+            }
+            insert.bindValue(":dur", duration);
+            insert.bindValue(":cost", 2.5 + (1.0 + destination % 7 * 0.25) * duration);
+            insert.bindValue(":started", startTime);
+            insert.bindValue(":hash", static_cast<qint64>((static_cast<quint64>(i) + 1) * 11400714819323198485ull));
+            insert.exec();
+        }
+        db.commit();
+        return std::max<qint64>(elapsed.nsecsElapsed(), 1);
+    };
+    auto writeReference = [&](QSqlDatabase db, const QString& tariffSql, const QString& clientSql) {
+        db.transaction();
+        QSqlQuery query(db);
+        query.prepare(tariffSql);
+        for (int i = 0; i < destinations; ++i) {
+            query.bindValue(":city", cityName(i));
+            query.exec();
+        }
+        query.prepare(clientSql);
+        for (int i = 0; i < callers; ++i) {
+            query.bindValue(":name", callerName(i));
+            query.exec();
+        }
+        db.commit();
+    };
+
+    qint64 legacyInsertNs = 0, legacyScanNs = 0, legacyReportNs = 0;
+    {
+        QSqlDatabase db = openBenchDatabase(legacyPath);
+        QSqlQuery query(db);
+        for (const char* ddl : {
+                 "CREATE TABLE tariffs (city TEXT PRIMARY KEY, price REAL, fee REAL)",
+                 "CREATE TABLE clients (name TEXT PRIMARY KEY, phone TEXT, balance REAL)",
+                 "CREATE TABLE vip_clients (name TEXT PRIMARY KEY, phone TEXT, balance REAL, discount REAL, manager TEXT)",
+                 "CREATE TABLE calls (id INTEGER PRIMARY KEY AUTOINCREMENT, client_name TEXT, destination TEXT, "
+                 "duration INTEGER, cost REAL, started_at INTEGER NOT NULL DEFAULT 0, cdr_hash INTEGER)",
+                 "CREATE INDEX calls_started_at ON calls(started_at)",
+                 "CREATE INDEX calls_client_name ON calls(client_name)",
+                 "CREATE UNIQUE INDEX calls_cdr_hash ON calls(cdr_hash) WHERE cdr_hash IS NOT NULL"}) {
+            query.exec(ddl);
+        }
+        writeReference(db, "INSERT INTO tariffs (city, price, fee) VALUES (:city, 1, 0.5)",
+                       "INSERT INTO clients (name, phone, balance) VALUES (:name, '', 100)");
+        legacyInsertNs = writeCalls(db,
+            "INSERT OR IGNORE INTO calls (client_name, destination, duration, cost, started_at, cdr_hash) "
+            "VALUES (:name, :dest, :dur, :cost, :started, :hash)",
+            false);
+        legacyScanNs = benchScan(db, "SELECT id, client_name, destination, duration, cost, started_at FROM calls");
+        legacyReportNs = benchScan(db, "SELECT client_name, COUNT(*), SUM(duration), SUM(cost) FROM calls "
+                                       "GROUP BY client_name");
+        query.exec("VACUUM");
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("bench-schema");
+    const qint64 legacyBytes = QFileInfo(legacyPath).size();
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    {
+        DataManager migrated(legacyPath);
+        if (!migrated.isConnected()) {
+            return fail(migrated.lastError());
+        }
+    }
+    const qint64 migrateNs = elapsed.nsecsElapsed();
+    const qint64 migratedBytes = QFileInfo(legacyPath).size();
+
+    qint64 insertNs = 0, scanNs = 0, reportNs = 0;
+    {
+        // Пустой файл новой схемы создает DataManager
+        DataManager created(normalizedPath);
+        if (!created.isConnected()) {
+            return fail(created.lastError());
+        }
+    }
+    {
+        QSqlDatabase db = openBenchDatabase(normalizedPath);
+        writeReference(db, "INSERT INTO tariffs (city, price, fee) VALUES (:city, 1, 0.5)",
+                       "INSERT INTO subscribers (name, phone, balance) VALUES (:name, '', 100)");
+        // Тот же текст, что в DataManager::addCall; id направления известен заранее
+        insertNs = writeCalls(db,
+            "INSERT OR IGNORE INTO calls (client_id, tariff_id, duration, cost, started_at, cdr_hash) "
+            "SELECT id, :dest, :dur, :cost, :started, :hash FROM subscribers WHERE name = :name",
+            true);
+        scanNs = benchScan(db, "SELECT id, client_id, tariff_id, duration, cost, started_at FROM calls");
+        reportNs = benchScan(db, "SELECT s.name, u.calls, u.seconds, u.cost FROM (SELECT client_id, COUNT(*) AS calls, "
+                                 "SUM(duration) AS seconds, SUM(cost) AS cost FROM calls GROUP BY client_id) u "
+                                 "JOIN subscribers s ON s.id = u.client_id");
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("bench-schema");
+
+    auto perCall = [count](qint64 bytes) { return QString::number(double(bytes) / count, 'f', 1); };
+    auto rate = [count](qint64 ns) { return QString::number(double(count) * 1000.0 / ns, 'f', 3); };
+    auto ms = [](qint64 ns) { return QString::number(double(ns) / 1e6, 'f', 1); };
+    out() << "Звонков: " << count << Qt::endl;
+    out() << "Размер БД:          прежняя схема " << perCall(legacyBytes) << " байт/звонок, целые ключи "
+          << perCall(migratedBytes) << " байт/звонок" << Qt::endl;
+    out() << "Вставка звонков:    " << rate(legacyInsertNs) << " -> " << rate(insertNs) << " млн/с" << Qt::endl;
+    out() << "Чтение звонков:     " << rate(legacyScanNs) << " -> " << rate(scanNs) << " млн/с" << Qt::endl;
+    out() << "Отчет по абонентам: " << ms(legacyReportNs) << " -> " << ms(reportNs) << " мс" << Qt::endl;
+    out() << "Перевод файла прежней схемы (с загрузкой): " << ms(migrateNs) << " мс" << Qt::endl;
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("atc-cli");
+    app.setApplicationVersion("1.0");
+    app.setOrganizationName("Lab4");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Пакетные операции над БД АТС.\n\n"
+        "Команды:\n"
+        "  import <file.csv>   импорт тарифов, клиентов и звонков\n"
+        "  import-cdr <file>   CDR по номерам: абонент по номеру, тариф по префиксу\n"
+        "  tail <dir|fifo>     непрерывный прием CDR из каталога (*.cdr) или канала\n"
+        "  serve <socket> [T]  сервер приема CDR на локальном сокете (T потоков ввода-вывода)\n"
+        "  send <socket> <file>  отправка CDR серверу serve с ожиданием подтверждения\n"
+        "  bench-ingest <socket> [P] [N]  нагрузка на serve: P отправителей по N CDR\n"
+        "  route <number...>   направление номера по самому длинному префиксу\n"
+        "  load-tariffs <file.csv>  замена всех тарифов и префиксов (записи tariff и prefix)\n"
+        "  tariff-history <city>  цены направления по периодам действия\n"
+        "  loyalty             уровни лояльности VIP по тратам за последние 30 дней\n"
+        "  export <file.csv>   экспорт всех таблиц в CSV\n"
+        "  rate                пересчет стоимости звонков по ценам на момент звонка\n"
+        "  stats               сводная статистика\n"
+        "  archive <days>      перенос звонков старше N дней (N >= 30) в сжатый архив\n"
+        "  purge-calls <key=value...>  удаление звонков по условию (client, destination, from, before, min, max)\n"
+        "  backup <file>       резервная копия файла БД\n"
+        "  restore <file>      восстановление БД из копии\n"
+        "  history             вся история звонков (с архивом) в сжатом виде и отчеты по ней\n"
+        "  simulate <file.csv> выручка по всей истории при новых тарифах (данные не меняются)\n"
+        "  bench-memory [N]    память на абонента: классы модели против SubscriberStore\n"
+        "  bench-calls [N]     память и скорость агрегатов: CallStore против CallHistory\n"
+        "  bench-schema [N]    размер БД и скорость звонков: прежняя схема против целочисленных ключей");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption dbOption(QStringList() << "d" << "db",
+                                "Путь к файлу БД (по умолчанию ATC_DB_PATH или каталог данных).",
+                                "path");
+    parser.addOption(dbOption);
+    QCommandLineOption metricsOption(QStringList() << "m" << "metrics",
+                                     "Записать метрики (формат Prometheus) в файл после выполнения "
+                                     "(по умолчанию ATC_METRICS_FILE).",
+                                     "file");
+    parser.addOption(metricsOption);
+    QCommandLineOption tariffsOption(QStringList() << "t" << "tariffs",
+                                     "tail, serve: перезагружать тарифы из CSV при каждом изменении файла.",
+                                     "file");
+    parser.addOption(tariffsOption);
+    parser.addPositionalArgument("command", "import | import-cdr | tail | serve | send | bench-ingest | route | load-tariffs | tariff-history | loyalty | export | rate | stats | archive | purge-calls | history | simulate | backup | restore | bench-memory | bench-calls | bench-schema");
+    parser.addPositionalArgument("args", "Аргументы команды.", "[args...]");
+    parser.process(app);
+
+    QStringList positional = parser.positionalArguments();
+    if (positional.isEmpty()) {
+        parser.showHelp(1);
+    }
+    const QString command = positional.takeFirst();
+
+    // Синтетический замер, БД не нужна
+    if (command == "bench-memory") {
+        return runBenchMemory(positional);
+    }
+    if (command == "bench-calls") {
+        return runBenchCalls(positional);
+    }
+    if (command == "bench-schema") {
+        return runBenchSchema(positional);
+    }
+    if (command == "send") {
+        return runSend(positional);
+    }
+
+    DataManager dm(parser.value(dbOption));
+    if (!dm.isConnected()) {
+        return fail(dm.lastError());
+    }
+
+    int result = 0;
+    if (command == "import") result = runImport(dm, positional);
+    else if (command == "import-cdr") result = runImportCdr(dm, positional);
+    else if (command == "tail") result = runTail(dm, positional, parser.value(tariffsOption));
+    else if (command == "serve") result = runServe(dm, positional, parser.value(tariffsOption));
+    else if (command == "bench-ingest") result = runBenchIngest(dm, positional);
+    else if (command == "route") result = runRoute(dm, positional);
+    else if (command == "load-tariffs") result = runLoadTariffs(dm, positional);
+    else if (command == "tariff-history") result = runTariffHistory(dm, positional);
+    else if (command == "loyalty") result = runLoyalty(dm);
+    else if (command == "export") result = runExport(dm, positional);
+    else if (command == "rate") result = runRate(dm);
+    else if (command == "stats") result = runStats(dm);
+    else if (command == "archive") result = runArchive(dm, positional);
+    else if (command == "purge-calls") result = runPurgeCalls(dm, positional);
+    else if (command == "history") result = runHistory(dm);
+    else if (command == "simulate") result = runSimulate(dm, positional);
+    else if (command == "backup") result = runBackup(dm, positional);
+    else if (command == "restore") result = runRestore(dm, positional);
+    else return fail("неизвестная команда: " + command);
+
+    QString metricsFile = parser.value(metricsOption);
+    if (metricsFile.isEmpty()) {
+        metricsFile = qEnvironmentVariable("ATC_METRICS_FILE");
+    }
+    if (!metricsFile.isEmpty() && !dm.exportMetrics(metricsFile)) {
+        fail(dm.lastError());
+    }
+    return result;
+}
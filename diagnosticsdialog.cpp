@@ -0,0 +1,154 @@
+// diagnosticsdialog.cpp
+#include "diagnosticsdialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QMessageBox>
+#include "Metrics.h"
+
+namespace {
+
+// Длительность в удобных единицах: нс, мкс, мс или с
+QString formatNanos(std::uint64_t nanos) {
+    if (nanos < 1000) return QString("%1 нс").arg(static_cast<qulonglong>(nanos));
+    if (nanos < 1000000) return QString::number(nanos / 1e3, 'f', 1) + " мкс";
+    if (nanos < 1000000000) return QString::number(nanos / 1e6, 'f', 2) + " мс";
+    return QString::number(nanos / 1e9, 'f', 2) + " с";
+}
+
+} // namespace
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent, DataManager *dm)
+    : QDialog(parent), dataManager(dm) {
+    setWindowTitle("Диагностика");
+    setupUI();
+    onRefresh();
+}
+
+DiagnosticsDialog::~DiagnosticsDialog() {
+}
+
+void DiagnosticsDialog::setupUI() {
+    setMinimumSize(900, 500);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QTabWidget *tabWidget = new QTabWidget(this);
+    mainLayout->addWidget(tabWidget);
+
+    metricsTable = new QTableWidget(this);
+    metricsTable->setColumnCount(8);
+    metricsTable->setHorizontalHeaderLabels({"Тип", "Имя", "Вызовов", "p50", "p99", "max", "Всего", "Строк"});
+    metricsTable->horizontalHeader()->setStretchLastSection(true);
+    metricsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    metricsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    tabWidget->addTab(metricsTable, "Операции и SQL");
+
+    // Вкладка кэша подготовленных выражений
+    QWidget *statementsTab = new QWidget();
+    QVBoxLayout *statementsLayout = new QVBoxLayout(statementsTab);
+    cacheSummaryLabel = new QLabel(statementsTab);
+    statementsTable = new QTableWidget(statementsTab);
+    statementsTable->setColumnCount(7);
+    statementsTable->setHorizontalHeaderLabels({"SQL", "Обращений", "Попаданий", "Подготовок",
+                                                "Выполнений", "p50", "p99"});
+    statementsTable->horizontalHeader()->setStretchLastSection(true);
+    statementsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    statementsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    statementsLayout->addWidget(cacheSummaryLabel);
+    statementsLayout->addWidget(statementsTable);
+    tabWidget->addTab(statementsTab, "Кэш выражений");
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    QPushButton *refreshButton = new QPushButton("Обновить", this);
+    QPushButton *resetButton = new QPushButton("Сбросить", this);
+    QPushButton *exportButton = new QPushButton("Экспорт метрик...", this);
+    QPushButton *closeButton = new QPushButton("Закрыть", this);
+
+    buttonsLayout->addWidget(refreshButton);
+    buttonsLayout->addWidget(resetButton);
+    buttonsLayout->addWidget(exportButton);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(closeButton);
+    mainLayout->addLayout(buttonsLayout);
+
+    connect(refreshButton, &QPushButton::clicked, this, &DiagnosticsDialog::onRefresh);
+    connect(resetButton, &QPushButton::clicked, this, &DiagnosticsDialog::onReset);
+    connect(exportButton, &QPushButton::clicked, this, &DiagnosticsDialog::onExport);
+    connect(closeButton, &QPushButton::clicked, this, &DiagnosticsDialog::accept);
+}
+
+void DiagnosticsDialog::onRefresh() {
+    const std::vector<MetricSnapshot> metrics = MetricsRegistry::instance().snapshot();
+
+    metricsTable->setRowCount(0);
+    int row = 0;
+    for (const auto& m : metrics) {
+        if (m.count == 0) {
+            continue;
+        }
+        metricsTable->insertRow(row);
+        metricsTable->setItem(row, 0, new QTableWidgetItem(m.kind == "sql" ? "SQL" : "Операция"));
+        metricsTable->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(m.name)));
+        metricsTable->setItem(row, 2, new QTableWidgetItem(QString::number(static_cast<qulonglong>(m.count))));
+        metricsTable->setItem(row, 3, new QTableWidgetItem(formatNanos(m.p50Nanos)));
+        metricsTable->setItem(row, 4, new QTableWidgetItem(formatNanos(m.p99Nanos)));
+        metricsTable->setItem(row, 5, new QTableWidgetItem(formatNanos(m.maxNanos)));
+        metricsTable->setItem(row, 6, new QTableWidgetItem(formatNanos(m.totalNanos)));
+        metricsTable->setItem(row, 7, new QTableWidgetItem(QString::number(static_cast<qulonglong>(m.rows))));
+        ++row;
+    }
+    metricsTable->resizeColumnsToContents();
+
+    refreshStatements();
+}
+
+void DiagnosticsDialog::refreshStatements() {
+    const std::vector<StatementStats> stats = dataManager->statementCacheStats();
+
+    std::uint64_t lookups = 0;
+    std::uint64_t hits = 0;
+    statementsTable->setRowCount(0);
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const StatementStats& s = stats[i];
+        lookups += s.lookups;
+        hits += s.hits;
+
+        statementsTable->insertRow(i);
+        statementsTable->setItem(i, 0, new QTableWidgetItem(s.sql));
+        statementsTable->setItem(i, 1, new QTableWidgetItem(QString::number(static_cast<qulonglong>(s.lookups))));
+        statementsTable->setItem(i, 2, new QTableWidgetItem(QString::number(static_cast<qulonglong>(s.hits))));
+        statementsTable->setItem(i, 3, new QTableWidgetItem(QString::number(static_cast<qulonglong>(s.prepares))));
+        statementsTable->setItem(i, 4, new QTableWidgetItem(QString::number(static_cast<qulonglong>(s.executions))));
+        statementsTable->setItem(i, 5, new QTableWidgetItem(formatNanos(s.p50Nanos)));
+        statementsTable->setItem(i, 6, new QTableWidgetItem(formatNanos(s.p99Nanos)));
+    }
+    statementsTable->resizeColumnsToContents();
+
+    double hitRate = lookups ? 100.0 * hits / lookups : 0.0;
+    cacheSummaryLabel->setText(QString("Выражений в кэше: %1 | Обращений: %2 | Попаданий: %3%")
+                                   .arg(static_cast<int>(stats.size()))
+                                   .arg(static_cast<qulonglong>(lookups))
+                                   .arg(hitRate, 0, 'f', 1));
+}
+
+void DiagnosticsDialog::onReset() {
+    MetricsRegistry::instance().reset();
+    onRefresh();
+}
+
+void DiagnosticsDialog::onExport() {
+    QString filename = QFileDialog::getSaveFileName(this, "Экспорт метрик", "atc_metrics.prom",
+                                                    "Prometheus (*.prom);;Текст (*.txt)");
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    if (dataManager->exportMetrics(filename)) {
+        QMessageBox::information(this, "Успех", "Метрики сохранены в файл!");
+    } else {
+        QMessageBox::critical(this, "Ошибка", dataManager->lastError());
+    }
+}
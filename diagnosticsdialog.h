@@ -0,0 +1,36 @@
+// diagnosticsdialog.h
+// Диалоговое окно диагностики: счетчики и задержки операций DataManager и SQL
+
+#ifndef DIAGNOSTICSDIALOG_H
+#define DIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+#include <QTableWidget>
+#include <QTabWidget>
+#include <QLabel>
+#include "DataManager.h"
+
+class DiagnosticsDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(QWidget *parent, DataManager *dataManager);
+    ~DiagnosticsDialog();
+
+private slots:
+    void onRefresh();
+    void onReset();
+    void onExport();
+
+private:
+    QTableWidget *metricsTable;
+    QTableWidget *statementsTable;
+    QLabel *cacheSummaryLabel;
+
+    DataManager *dataManager;
+
+    void setupUI();
+    void refreshStatements();
+};
+
+#endif // DIAGNOSTICSDIALOG_H
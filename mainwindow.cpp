@@ -6,16 +6,39 @@
 #include <QAction>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QHeaderView>
 #include <QGroupBox>
 #include <QToolBar>
+#include <QStatusBar>
+#include <QDateTime>
+#include <QHash>
+#include <QItemSelectionModel>
+#include <algorithm>
 #include "addtariffdialog.h"
 #include "addclientdialog.h"
 #include "addvipclientdialog.h"
 #include "addcalldialog.h"
+#include "diagnosticsdialog.h"
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), dataManager(new DataManager()) {
+    : QMainWindow(parent), dataManager(new DataManager(QString(), false)) {
+
+    // Данные загружаются в фоне после создания окна (см. конец конструктора)
+    asyncData = new AsyncDataManager(dataManager, this);
+    connect(asyncData, &AsyncDataManager::busyChanged, this, &MainWindow::onBusyChanged);
+    connect(asyncData, &AsyncDataManager::progressChanged, this, &MainWindow::onProgressChanged);
+    connect(asyncData, &AsyncDataManager::loadingChanged, this, &MainWindow::onLoadingChanged);
+    connect(asyncData, &AsyncDataManager::referenceDataLoaded, this, &MainWindow::onReferenceDataLoaded);
+    cdrTailer = new CdrTailer(asyncData, dataManager, this);
+    connect(cdrTailer, &CdrTailer::statusChanged, this, &MainWindow::onCdrStatusChanged);
+    connect(cdrTailer, &CdrTailer::callsIngested, this, &MainWindow::onCallsIngested);
+    callsRefreshTimer.setSingleShot(true);
+    callsRefreshTimer.setInterval(2000);
+    connect(&callsRefreshTimer, &QTimer::timeout, this, [this]() {
+        updateCallsTable();
+        updateStatistics();
+    });
 
     setWindowTitle("Система управления АТС (SQLite Full)");
     setMinimumSize(1000, 700);
@@ -29,7 +52,25 @@ MainWindow::MainWindow(QWidget *parent)
     setupMenuBar();
     setupToolBar();
 
-    QTabWidget *tabWidget = new QTabWidget(this);
+    // Поиск абонента: любой фрагмент имени, номера или менеджера (FTS5 в БД),
+    // короткий запрос - по началу имени и номера в памяти
+    QHBoxLayout *searchLayout = new QHBoxLayout();
+    searchEdit = new QLineEdit(this);
+    searchEdit->setPlaceholderText("🔍 Поиск абонента: имя, номер или менеджер");
+    searchEdit->setClearButtonEnabled(true);
+    searchLayout->addWidget(searchEdit);
+    mainLayout->addLayout(searchLayout);
+    searchResults = new QListWidget(this);
+    searchResults->setMaximumHeight(160);
+    searchResults->hide();
+    mainLayout->addWidget(searchResults);
+    searchTimer.setSingleShot(true);
+    searchTimer.setInterval(150);
+    connect(searchEdit, &QLineEdit::textChanged, this, [this]() { searchTimer.start(); });
+    connect(&searchTimer, &QTimer::timeout, this, &MainWindow::onSearchSubscribers);
+    connect(searchResults, &QListWidget::itemActivated, this, &MainWindow::onSearchResultActivated);
+
+    tabWidget = new QTabWidget(this);
     mainLayout->addWidget(tabWidget);
 
     QWidget *tariffsTab = new QWidget();
@@ -129,15 +170,47 @@ MainWindow::MainWindow(QWidget *parent)
     connect(deleteCallBtn, &QPushButton::clicked, this, &MainWindow::onDeleteCall);
     connect(sortCallsBtn, &QPushButton::clicked, this, &MainWindow::onSortCalls);
     connect(statsBtn, &QPushButton::clicked, this, &MainWindow::onShowCallStatistics);
+
+    // Индикатор фоновых операций в строке состояния
+    progressBar = new QProgressBar(this);
+    progressBar->setRange(0, 100);
+    progressBar->setMaximumWidth(200);
+    progressBar->hide();
+    cancelButton = new QPushButton("Отмена", this);
+    cancelButton->hide();
+    ingestLabel = new QLabel(this);
+    ingestLabel->hide();
+    statusBar()->addPermanentWidget(ingestLabel);
+    statusBar()->addPermanentWidget(progressBar);
+    statusBar()->addPermanentWidget(cancelButton);
+    connect(cancelButton, &QPushButton::clicked, asyncData, &AsyncDataManager::cancel);
+
+    // Окно отрисуется, как только main() войдет в цикл событий; таблицы заполнятся позже
+    asyncData->load();
+
+    // Каталог приема CDR для постоянной работы; прием начнется после загрузки данных
+    const QString spool = qEnvironmentVariable("ATC_CDR_SPOOL");
+    if (!spool.isEmpty()) {
+        cdrTailer->start(spool);
+    }
 }
 
 MainWindow::~MainWindow() {
+    // Для textfile collector: при выходе сбрасываем метрики в файл из ATC_METRICS_FILE
+    const QString metricsFile = qEnvironmentVariable("ATC_METRICS_FILE");
+    if (!metricsFile.isEmpty()) {
+        dataManager->exportMetrics(metricsFile);
+    }
+    // Фоновые потоки держат соединения DataManager - останавливаем их первыми
+    delete cdrTailer;
+    delete asyncData;
     delete dataManager;
 }
 
 
 void MainWindow::setupToolBar() {
     QToolBar *toolbar = addToolBar("Main Toolbar");
+    mainToolBar = toolbar;
     toolbar->setMovable(false);
     toolbar->setIconSize(QSize(24, 24));
 
@@ -153,6 +226,17 @@ void MainWindow::setupToolBar() {
 
     toolbar->addSeparator();
 
+    // Кнопки CSV
+    QAction *exportAction = toolbar->addAction("📄 Экспорт в CSV");
+    exportAction->setToolTip("Выгрузить все таблицы в CSV (совместим с Excel)");
+    connect(exportAction, &QAction::triggered, this, &MainWindow::onExportCSV);
+
+    QAction *importAction = toolbar->addAction("📥 Импорт из CSV");
+    importAction->setToolTip("Загрузить тарифы, клиентов и звонки из CSV");
+    connect(importAction, &QAction::triggered, this, &MainWindow::onImportCSV);
+
+    toolbar->addSeparator();
+
     // Кнопка ОЧИСТИТЬ
     QAction *clearAction = toolbar->addAction("🗑️ Очистить БД");
     clearAction->setToolTip("Удалить все данные из базы");
@@ -171,24 +255,38 @@ void MainWindow::setupMenuBar() {
 
     QMenu *dataMenu = menuBar->addMenu("Данные");
     QAction *initTestAction = dataMenu->addAction("Загрузить тестовые данные");
+    QAction *archiveAction = dataMenu->addAction("Архивировать старые звонки...");
+    QAction *reloadTariffsAction = dataMenu->addAction("Перезагрузить тарифы из файла...");
+    QAction *simulateTariffsAction = dataMenu->addAction("Моделирование тарифов из файла...");
+    dataMenu->addSeparator();
+    QAction *startIngestAction = dataMenu->addAction("Прием CDR из каталога...");
+    QAction *stopIngestAction = dataMenu->addAction("Остановить прием CDR");
+    dataMenu->addSeparator();
     QAction *clearAction = dataMenu->addAction("Очистить все данные");
 
     QMenu *helpMenu = menuBar->addMenu("Справка");
+    QAction *diagnosticsAction = helpMenu->addAction("Диагностика...");
     QAction *aboutAction = helpMenu->addAction("О программе");
 
     connect(saveAction, &QAction::triggered, this, &MainWindow::onSaveData);
     connect(loadAction, &QAction::triggered, this, &MainWindow::onLoadData);
     connect(exitAction, &QAction::triggered, this, &MainWindow::close);
     connect(initTestAction, &QAction::triggered, this, &MainWindow::onInitTestData);
+    connect(archiveAction, &QAction::triggered, this, &MainWindow::onArchiveCalls);
+    connect(reloadTariffsAction, &QAction::triggered, this, &MainWindow::onReloadTariffs);
+    connect(simulateTariffsAction, &QAction::triggered, this, &MainWindow::onSimulateTariffs);
+    connect(startIngestAction, &QAction::triggered, this, &MainWindow::onStartCdrIngest);
+    connect(stopIngestAction, &QAction::triggered, this, &MainWindow::onStopCdrIngest);
     connect(clearAction, &QAction::triggered, this, &MainWindow::onClearAllData);
+    connect(diagnosticsAction, &QAction::triggered, this, &MainWindow::onShowDiagnostics);
     connect(aboutAction, &QAction::triggered, this, &MainWindow::onAbout);
 }
 
 
 void MainWindow::setupTariffsTab() {
     tariffsTable = new QTableWidget();
-    tariffsTable->setColumnCount(3);
-    tariffsTable->setHorizontalHeaderLabels({"Город", "Цена/мин (₽)", "Плата за подключение (₽)"});
+    tariffsTable->setColumnCount(4);
+    tariffsTable->setHorizontalHeaderLabels({"Город", "Цена/мин (₽)", "Плата за подключение (₽)", "Префиксы номеров"});
     tariffsTable->horizontalHeader()->setStretchLastSection(true);
     tariffsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     tariffsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
@@ -200,24 +298,28 @@ void MainWindow::setupClientsTab() {
     clientsTable->setHorizontalHeaderLabels({"Имя", "Телефон", "Баланс (₽)"});
     clientsTable->horizontalHeader()->setStretchLastSection(true);
     clientsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    clientsTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
     clientsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
 }
 
 void MainWindow::setupVIPClientsTab() {
     vipClientsTable = new QTableWidget();
-    vipClientsTable->setColumnCount(5);
-    vipClientsTable->setHorizontalHeaderLabels({"Имя", "Телефон", "Баланс (₽)", "Скидка (%)", "Персональный менеджер"});
+    vipClientsTable->setColumnCount(6);
+    vipClientsTable->setHorizontalHeaderLabels({"Имя", "Телефон", "Баланс (₽)", "Скидка (%)", "Уровень",
+                                                "Персональный менеджер"});
     vipClientsTable->horizontalHeader()->setStretchLastSection(true);
     vipClientsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    vipClientsTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
     vipClientsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
 }
 
 void MainWindow::setupCallsTab() {
     callsTable = new QTableWidget();
-    callsTable->setColumnCount(4);
-    callsTable->setHorizontalHeaderLabels({"Абонент", "Направление", "Длительность (мин)", "Стоимость (₽)"});
+    callsTable->setColumnCount(5);
+    callsTable->setHorizontalHeaderLabels({"Абонент", "Направление", "Длительность (мин)", "Стоимость (₽)", "Начало"});
     callsTable->horizontalHeader()->setStretchLastSection(true);
     callsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    callsTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
     callsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
 }
 
@@ -225,54 +327,67 @@ void MainWindow::setupCallsTab() {
 void MainWindow::updateTariffsTable() {
     tariffsTable->setRowCount(0);
     const auto& tariffs = dataManager->getTariffs();
+    QHash<QString, QStringList> prefixes;
+    for (const auto& prefix : dataManager->getTariffPrefixes()) {
+        prefixes[QString::fromStdString(prefix.city)] << QString::fromStdString(prefix.prefix);
+    }
     for (size_t i = 0; i < tariffs.size(); ++i) {
+        const QString city = QString::fromStdString(tariffs[i].getCity());
         tariffsTable->insertRow(i);
-        tariffsTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(tariffs[i].getCity())));
+        tariffsTable->setItem(i, 0, new QTableWidgetItem(city));
         tariffsTable->setItem(i, 1, new QTableWidgetItem(QString::number(tariffs[i].getPricePerMinute(), 'f', 2)));
         tariffsTable->setItem(i, 2, new QTableWidgetItem(QString::number(tariffs[i].getConnectionFee(), 'f', 2)));
+        tariffsTable->setItem(i, 3, new QTableWidgetItem(prefixes.value(city).join(", ")));
     }
 }
 
 void MainWindow::updateClientsTable() {
     clientsTable->setRowCount(0);
-    const auto& clients = dataManager->getClients();
-    for (size_t i = 0; i < clients.size(); ++i) {
+    // Строки берутся прямо из записей хранилища, без сборки объектов Client
+    const SubscriberStore& store = dataManager->subscribers();
+    for (int i = 0; i < store.count(SubscriberKind::Regular); ++i) {
+        const SubscriberRecord& client = store.at(SubscriberKind::Regular, i);
         clientsTable->insertRow(i);
-        clientsTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(clients[i].getName())));
-        clientsTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(clients[i].getPhoneNumber())));
-        clientsTable->setItem(i, 2, new QTableWidgetItem(QString::number(clients[i].getBalance(), 'f', 2)));
+        clientsTable->setItem(i, 0, new QTableWidgetItem(toQString(store.text(client.nameId))));
+        clientsTable->setItem(i, 1, new QTableWidgetItem(toQString(store.text(client.phoneId))));
+        clientsTable->setItem(i, 2, new QTableWidgetItem(QString::number(client.balance, 'f', 2)));
     }
 }
 
 void MainWindow::updateVIPClientsTable() {
     vipClientsTable->setRowCount(0);
-    const auto& vipClients = dataManager->getVIPClients();
-    for (size_t i = 0; i < vipClients.size(); ++i) {
+    const SubscriberStore& store = dataManager->subscribers();
+    for (int i = 0; i < store.count(SubscriberKind::Vip); ++i) {
+        const SubscriberRecord& vip = store.at(SubscriberKind::Vip, i);
         vipClientsTable->insertRow(i);
-        vipClientsTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(vipClients[i].getName())));
-        vipClientsTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(vipClients[i].getPhoneNumber())));
-        vipClientsTable->setItem(i, 2, new QTableWidgetItem(QString::number(vipClients[i].getBalance(), 'f', 2)));
-        vipClientsTable->setItem(i, 3, new QTableWidgetItem(QString::number(vipClients[i].getDiscount(), 'f', 2)));
-        vipClientsTable->setItem(i, 4, new QTableWidgetItem(QString::fromStdString(vipClients[i].getPersonalManager())));
+        vipClientsTable->setItem(i, 0, new QTableWidgetItem(toQString(store.text(vip.nameId))));
+        vipClientsTable->setItem(i, 1, new QTableWidgetItem(toQString(store.text(vip.phoneId))));
+        vipClientsTable->setItem(i, 2, new QTableWidgetItem(QString::number(vip.balance, 'f', 2)));
+        vipClientsTable->setItem(i, 3, new QTableWidgetItem(QString::number(vip.discount, 'f', 2)));
+        vipClientsTable->setItem(i, 4, new QTableWidgetItem(QString::fromUtf8(LoyaltyEngine::tier(vip.tier).name)));
+        vipClientsTable->setItem(i, 5, new QTableWidgetItem(toQString(store.text(vip.managerId))));
     }
 }
 
 void MainWindow::updateCallsTable() {
     callsTable->setRowCount(0);
-    const auto& calls = dataManager->getCalls();
-    for (size_t i = 0; i < calls.size(); ++i) {
+    const CallStore& calls = dataManager->calls();
+    for (int i = 0; i < calls.count(); ++i) {
+        const CallRecord& call = calls.at(i);
         callsTable->insertRow(i);
-        callsTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(calls[i].getCallerName())));
-        callsTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(calls[i].getDestination())));
-        callsTable->setItem(i, 2, new QTableWidgetItem(QString::number(calls[i].getDuration())));
-        callsTable->setItem(i, 3, new QTableWidgetItem(QString::number(calls[i].getCost(), 'f', 2)));
+        callsTable->setItem(i, 0, new QTableWidgetItem(toQString(calls.text(call.callerId))));
+        callsTable->setItem(i, 1, new QTableWidgetItem(toQString(calls.text(call.destinationId))));
+        callsTable->setItem(i, 2, new QTableWidgetItem(QString::number(call.duration)));
+        callsTable->setItem(i, 3, new QTableWidgetItem(QString::number(call.cost, 'f', 2)));
+        callsTable->setItem(i, 4, new QTableWidgetItem(call.startTime > 0
+            ? QDateTime::fromSecsSinceEpoch(call.startTime).toString("dd.MM.yyyy HH:mm") : QString("—")));
     }
 }
 
 void MainWindow::updateStatistics() {
     double totalRevenue = dataManager->calculateTotalRevenue();
-    int totalCalls = dataManager->getCalls().size();
-    int totalClients = dataManager->getClients().size() + dataManager->getVIPClients().size();
+    int totalCalls = dataManager->callCount();
+    int totalClients = dataManager->clientCount() + dataManager->vipClientCount();
 
     QString stats = QString("📊 Статистика (БД): Всего клиентов: %1 | Всего звонков: %2 | Общая выручка: %3 ₽")
                         .arg(totalClients)
@@ -282,13 +397,23 @@ void MainWindow::updateStatistics() {
     statsLabel->setText(stats);
 }
 
+void MainWindow::updateAllTables() {
+    updateTariffsTable();
+    updateClientsTable();
+    updateVIPClientsTable();
+    updateCallsTable();
+    updateStatistics();
+}
+
 
 void MainWindow::onAddTariff() {
     AddTariffDialog dialog(this);
     if (dialog.exec() == QDialog::Accepted) {
-        dataManager->addTariff(dialog.getTariff());
-        updateTariffsTable();
-        showMessage("Успех", "Тариф успешно добавлен в БД!");
+        applyChange([this, tariff = dialog.getTariff()]() {
+            dataManager->addTariff(tariff);
+            updateTariffsTable();
+            showMessage("Успех", "Тариф успешно добавлен в БД!");
+        });
     }
 }
 
@@ -301,9 +426,14 @@ void MainWindow::onEditTariff() {
     const auto& tariffs = dataManager->getTariffs();
     AddTariffDialog dialog(this, tariffs[currentRow]);
     if (dialog.exec() == QDialog::Accepted) {
-        dataManager->updateTariff(currentRow, dialog.getTariff());
-        updateTariffsTable();
-        showMessage("Успех", "Тариф обновлен в БД!");
+        applyChange([this, currentRow, tariff = dialog.getTariff()]() {
+            if (!dataManager->updateTariff(currentRow, tariff)) {
+                showError("Тариф не обновлен: " + dataManager->lastError());
+                return;
+            }
+            updateTariffsTable();
+            showMessage("Успех", "Тариф обновлен в БД!");
+        });
     }
 }
 
@@ -313,23 +443,29 @@ void MainWindow::onDeleteTariff() {
         showError("Выберите тариф для удаления!");
         return;
     }
-    dataManager->removeTariff(currentRow);
-    updateTariffsTable();
-    showMessage("Успех", "Тариф удален из БД!");
+    applyChange([this, currentRow]() {
+        dataManager->removeTariff(currentRow);
+        updateTariffsTable();
+        showMessage("Успех", "Тариф удален из БД!");
+    });
 }
 
 void MainWindow::onSortTariffs() {
-    dataManager->sortTariffsByPrice(true);
-    updateTariffsTable();
+    applyChange([this]() {
+        dataManager->sortTariffsByPrice(true);
+        updateTariffsTable();
+    });
 }
 
 void MainWindow::onAddClient() {
     AddClientDialog dialog(this);
     if (dialog.exec() == QDialog::Accepted) {
-        dataManager->addClient(dialog.getClient());
-        updateClientsTable();
-        updateStatistics();
-        showMessage("Успех", "Клиент добавлен в БД!");
+        applyChange([this, client = dialog.getClient()]() {
+            dataManager->addClient(client);
+            updateClientsTable();
+            updateStatistics();
+            showMessage("Успех", "Клиент добавлен в БД!");
+        });
     }
 }
 
@@ -339,39 +475,79 @@ void MainWindow::onEditClient() {
         showError("Выберите клиента для редактирования!");
         return;
     }
-    const auto& clients = dataManager->getClients();
-    AddClientDialog dialog(this, clients[currentRow]);
+    AddClientDialog dialog(this, dataManager->clientAt(currentRow));
     if (dialog.exec() == QDialog::Accepted) {
-        dataManager->updateClient(currentRow, dialog.getClient());
-        updateClientsTable();
-        showMessage("Успех", "Клиент обновлен в БД!");
+        applyChange([this, currentRow, client = dialog.getClient()]() {
+            if (!dataManager->updateClient(currentRow, client)) {
+                showError("Клиент не обновлен: " + dataManager->lastError());
+                return;
+            }
+            updateClientsTable();
+            showMessage("Успех", "Клиент обновлен в БД!");
+        });
     }
 }
 
-void MainWindow::onDeleteClient() {
-    int currentRow = clientsTable->currentRow();
-    if (currentRow < 0) {
-        showError("Выберите клиента для удаления!");
+std::vector<int> MainWindow::selectedRows(QTableWidget *table) const {
+    std::vector<int> rows;
+    for (const QModelIndex& index : table->selectionModel()->selectedRows()) {
+        rows.push_back(index.row());
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+// Выделенные абоненты удаляются одной транзакцией; звонки - по выбору пользователя
+void MainWindow::deleteSelectedSubscribers(SubscriberKind kind, QTableWidget *table) {
+    const std::vector<int> rows = selectedRows(table);
+    if (rows.empty()) {
+        showError(kind == SubscriberKind::Vip ? "Выберите VIP-клиента для удаления!" : "Выберите клиента для удаления!");
         return;
     }
-    dataManager->removeClient(currentRow);
-    updateClientsTable();
-    updateStatistics();
-    showMessage("Успех", "Клиент удален из БД!");
+    const QMessageBox::StandardButton reply = QMessageBox::question(
+        this, "Удаление", QString("Удалить абонентов: %1.\nУдалить вместе с ними и их звонки?").arg(rows.size()),
+        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+    if (reply == QMessageBox::Cancel) {
+        return;
+    }
+    const bool withCalls = reply == QMessageBox::Yes;
+    applyChange([this, kind, rows, withCalls]() {
+        int removedCalls = 0;
+        const int removed = dataManager->removeSubscribers(kind, rows, withCalls, &removedCalls);
+        if (removed < 0) {
+            showError("Ошибка удаления: " + dataManager->lastError());
+            return;
+        }
+        updateClientsTable();
+        updateVIPClientsTable();
+        if (withCalls) {
+            updateCallsTable();
+        }
+        updateStatistics();
+        showMessage("Успех", QString("Удалено абонентов: %1, звонков: %2").arg(removed).arg(removedCalls));
+    });
+}
+
+void MainWindow::onDeleteClient() {
+    deleteSelectedSubscribers(SubscriberKind::Regular, clientsTable);
 }
 
 void MainWindow::onSortClients() {
-    dataManager->sortClientsByName(true);
-    updateClientsTable();
+    applyChange([this]() {
+        dataManager->sortClientsByName(true);
+        updateClientsTable();
+    });
 }
 
 void MainWindow::onAddVIPClient() {
     AddVIPClientDialog dialog(this);
     if (dialog.exec() == QDialog::Accepted) {
-        dataManager->addVIPClient(dialog.getVIPClient());
-        updateVIPClientsTable();
-        updateStatistics();
-        showMessage("Успех", "VIP-клиент добавлен в БД!");
+        applyChange([this, client = dialog.getVIPClient()]() {
+            dataManager->addVIPClient(client);
+            updateVIPClientsTable();
+            updateStatistics();
+            showMessage("Успех", "VIP-клиент добавлен в БД!");
+        });
     }
 }
 
@@ -381,88 +557,90 @@ void MainWindow::onEditVIPClient() {
         showError("Выберите VIP-клиента для редактирования!");
         return;
     }
-    const auto& vipClients = dataManager->getVIPClients();
-    AddVIPClientDialog dialog(this, vipClients[currentRow]);
+    AddVIPClientDialog dialog(this, dataManager->vipClientAt(currentRow));
     if (dialog.exec() == QDialog::Accepted) {
-        dataManager->updateVIPClient(currentRow, dialog.getVIPClient());
-        updateVIPClientsTable();
-        showMessage("Успех", "VIP-клиент обновлен в БД!");
+        applyChange([this, currentRow, client = dialog.getVIPClient()]() {
+            if (!dataManager->updateVIPClient(currentRow, client)) {
+                showError("VIP-клиент не обновлен: " + dataManager->lastError());
+                return;
+            }
+            updateVIPClientsTable();
+            showMessage("Успех", "VIP-клиент обновлен в БД!");
+        });
     }
 }
 
 void MainWindow::onDeleteVIPClient() {
-    int currentRow = vipClientsTable->currentRow();
-    if (currentRow < 0) {
-        showError("Выберите VIP-клиента для удаления!");
-        return;
-    }
-    dataManager->removeVIPClient(currentRow);
-    updateVIPClientsTable();
-    updateStatistics();
-    showMessage("Успех", "VIP-клиент удален из БД!");
+    deleteSelectedSubscribers(SubscriberKind::Vip, vipClientsTable);
 }
 
 void MainWindow::onSortVIPClients() {
-    dataManager->sortVIPClientsByDiscount(true);
-    updateVIPClientsTable();
+    applyChange([this]() {
+        dataManager->sortVIPClientsByDiscount(true);
+        updateVIPClientsTable();
+    });
 }
 
 void MainWindow::onAddCall() {
     AddCallDialog dialog(this, dataManager);
     if (dialog.exec() == QDialog::Accepted) {
-        Call newCall = dialog.getCall();
-        if (dataManager->addCall(newCall)) {
-            updateCallsTable();
-            updateStatistics();
-            showMessage("Успех", "Звонок зарегистрирован в БД!");
-        } else {
-            showError("Ошибка: Клиент не найден в базе данных.");
-        }
+        // Тарифы и абоненты для диалога уже загружены; сам звонок ляжет после звонков из БД
+        applyChange([this, newCall = dialog.getCall()]() {
+            if (dataManager->addCall(newCall)) {
+                updateCallsTable();
+                updateStatistics();
+                showMessage("Успех", "Звонок зарегистрирован в БД!");
+            } else {
+                showError("Ошибка: " + dataManager->lastError());
+            }
+        });
     }
 }
 
 void MainWindow::onDeleteCall() {
-    int currentRow = callsTable->currentRow();
-    if (currentRow < 0) {
+    const std::vector<int> rows = selectedRows(callsTable);
+    if (rows.empty()) {
         showError("Выберите звонок для удаления!");
         return;
     }
-    dataManager->removeCall(currentRow);
-    updateCallsTable();
-    updateStatistics();
-    showMessage("Успех", "Звонок удален из БД!");
+    applyChange([this, rows]() {
+        const int removed = dataManager->removeCalls(rows);
+        if (removed < 0) {
+            showError("Ошибка удаления: " + dataManager->lastError());
+            return;
+        }
+        updateCallsTable();
+        updateStatistics();
+        showMessage("Успех", QString("Удалено звонков: %1").arg(removed));
+    });
 }
 
 void MainWindow::onSortCalls() {
-    dataManager->sortCallsByDuration(false);
-    updateCallsTable();
+    applyChange([this]() {
+        dataManager->sortCallsByDuration(false);
+        updateCallsTable();
+    });
 }
 
 void MainWindow::onShowCallStatistics() {
-    QString stats = "📈 Статистика по звонкам:\n\n";
-    const auto& clients = dataManager->getClients();
-    for (const auto& client : clients) {
-        int callCount = dataManager->getClientCallCount(client.getName());
-        double totalCost = dataManager->calculateClientTotalCost(client.getName());
-        if (callCount > 0) {
-            stats += QString("%1: %2 звонков, сумма: %3 ₽\n")
-                         .arg(QString::fromStdString(client.getName()))
-                         .arg(callCount)
-                         .arg(totalCost, 0, 'f', 2);
-        }
-    }
-    const auto& vipClients = dataManager->getVIPClients();
-    for (const auto& vip : vipClients) {
-        int callCount = dataManager->getClientCallCount(vip.getName());
-        double totalCost = dataManager->calculateClientTotalCost(vip.getName());
-        if (callCount > 0) {
-            stats += QString("%1 (VIP): %2 звонков, сумма: %3 ₽\n")
-                         .arg(QString::fromStdString(vip.getName()))
-                         .arg(callCount)
-                         .arg(totalCost, 0, 'f', 2);
+    statusBar()->showMessage("Подсчет статистики...");
+    // Агрегаты считаются в фоне; повторное нажатие отменяет предыдущий запрос,
+    // и его продолжение уже не выполнится
+    asyncData->statistics().then(this, [this](const StatisticsReport& report) {
+        statusBar()->clearMessage();
+        QString stats = "📈 Статистика по звонкам:\n\n";
+        for (const auto& client : report.clients) {
+            const SubscriberRecord* subscriber = dataManager->findSubscriber(client.clientName);
+            bool isVip = subscriber && subscriber->kind == SubscriberKind::Vip;
+            stats += QString("%1%2: %3 звонков, сумма: %4 ₽\n")
+                         .arg(QString::fromStdString(client.clientName))
+                         .arg(isVip ? " (VIP)" : "")
+                         .arg(client.callCount)
+                         .arg(client.totalCost, 0, 'f', 2);
         }
-    }
-    showMessage("Статистика", stats);
+        stats += QString("\nОбщая выручка: %1 ₽").arg(report.totalRevenue, 0, 'f', 2);
+        showMessage("Статистика", stats);
+    });
 }
 
 // ============ РЕАЛИЗАЦИЯ BACKUP / RESTORE ============
@@ -475,12 +653,14 @@ void MainWindow::onSaveData() {
         // Добавляем расширение, если его нет
         if (!filename.endsWith(".sqlite")) filename += ".sqlite";
 
-        // Вызываем метод бэкапа
-        if (dataManager->backupDatabase(filename)) {
-            showMessage("Успех", "Резервная копия базы данных успешно создана!");
-        } else {
-            showError("Ошибка при создании резервной копии! Возможно, нет прав на запись.");
-        }
+        // Копирование файла БД идет в фоне
+        asyncData->backup(filename).then(this, [this](bool saved) {
+            if (saved) {
+                showMessage("Успех", "Резервная копия базы данных успешно создана!");
+            } else {
+                showError("Ошибка при создании резервной копии! Возможно, нет прав на запись.");
+            }
+        });
     }
 }
 
@@ -494,31 +674,192 @@ void MainWindow::onLoadData() {
                                                                   QMessageBox::Yes | QMessageBox::No);
 
         if (reply == QMessageBox::Yes) {
-            // Вызываем метод восстановления
-            if (dataManager->restoreDatabase(filename)) {
-                // Обновляем все таблицы, так как база изменилась
-                updateTariffsTable();
-                updateClientsTable();
-                updateVIPClientsTable();
-                updateCallsTable();
-                updateStatistics();
-                showMessage("Успех", "База данных успешно восстановлена!");
+            // Замена файла и чтение таблиц идут в фоне, данные в памяти
+            // подменяются уже в потоке GUI перед вызовом продолжения
+            asyncData->restore(filename).then(this, [this](bool restored) {
+                if (restored) {
+                    // Обновляем все таблицы, так как база изменилась
+                    updateAllTables();
+                    showMessage("Успех", "База данных успешно восстановлена!");
+                } else {
+                    showError("Ошибка при восстановлении базы данных! Проверьте файл.");
+                }
+            });
+        }
+    }
+}
+
+void MainWindow::onExportCSV() {
+    QString filename = QFileDialog::getSaveFileName(this, "Экспорт в CSV", "", "CSV (*.csv)");
+    if (filename.isEmpty()) {
+        return;
+    }
+    if (!filename.endsWith(".csv")) filename += ".csv";
+
+    // Выгружаем только полностью загруженные данные; запись файла идет в фоне по срезу,
+    // поэтому правки и прием CDR в это время не ждут
+    applyChange([this, filename]() {
+        asyncData->exportCSV(filename).then(this, [this](bool exported) {
+            if (exported) {
+                showMessage("Успех", "Данные выгружены в CSV!");
             } else {
-                showError("Ошибка при восстановлении базы данных! Проверьте файл.");
+                showError("Ошибка экспорта: " + dataManager->lastError());
+            }
+        });
+    });
+}
+
+void MainWindow::onImportCSV() {
+    QString filename = QFileDialog::getOpenFileName(this, "Импорт из CSV", "", "CSV (*.csv)");
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    asyncData->importCSV(filename).then(this, [this](ImportResult result) {
+        if (result.imported >= 0) {
+            updateAllTables();
+            QString message = QString("Импортировано записей: %1").arg(result.imported);
+            if (result.duplicates > 0) {
+                message += QString("\nПропущено повторных звонков: %1").arg(result.duplicates);
             }
+            showMessage("Успех", message);
+        } else {
+            showError("Ошибка импорта: " + dataManager->lastError());
         }
+    });
+}
+
+void MainWindow::onReloadTariffs() {
+    QString filename = QFileDialog::getOpenFileName(this, "Тарифы из CSV", "", "CSV (*.csv)");
+    if (filename.isEmpty()) {
+        return;
     }
+
+    // Записи клиентов и звонков в файле пропускаются; прежний набор тарифов
+    // заменяется целиком, только если новый прошел проверку
+    applyChange([this, filename]() {
+        asyncData->reloadTariffs(filename).then(this, [this](bool reloaded) {
+            if (reloaded) {
+                updateTariffsTable();
+                showMessage("Успех", QString("Тарифы заменены: %1 направлений, %2 префиксов")
+                                         .arg(dataManager->getTariffs().size())
+                                         .arg(dataManager->getTariffPrefixes().size()));
+            } else {
+                showError("Тарифы не заменены: " + dataManager->lastError());
+            }
+        });
+    });
+}
+
+void MainWindow::onSimulateTariffs() {
+    QString filename = QFileDialog::getOpenFileName(this, "Тарифы для моделирования", "", "CSV (*.csv)");
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    statusBar()->showMessage("Моделирование тарифов...");
+    asyncData->simulateTariffs(filename).then(this, [this](const SimulationReport& report) {
+        statusBar()->clearMessage();
+        if (!report.ok) {
+            showError("Моделирование не выполнено: " + dataManager->lastError());
+            return;
+        }
+        auto line = [](const RevenueDelta& row) {
+            return QString("%1: %2 звонков, %3 → %4 ₽ (%5%6 ₽)\n")
+                .arg(QString::fromStdString(row.name))
+                .arg(row.callCount)
+                .arg(row.currentRevenue, 0, 'f', 2)
+                .arg(row.proposedRevenue, 0, 'f', 2)
+                .arg(row.delta() >= 0 ? "+" : "")
+                .arg(row.delta(), 0, 'f', 2);
+        };
+        const TariffSimulation& simulation = report.simulation;
+        QString text = "Выручка по всей истории при новых тарифах:\n\n";
+        text += line(simulation.total) + line(simulation.regular) + line(simulation.vip);
+        if (simulation.unratedCalls > 0) {
+            text += QString("Без тарифа в одном из наборов (стоимость прежняя): %1 звонков\n")
+                        .arg(simulation.unratedCalls);
+        }
+        // Направления с наибольшим изменением выручки
+        const std::size_t shown = std::min<std::size_t>(simulation.destinations.size(), 15);
+        text += "\nПо направлениям:\n";
+        for (std::size_t i = 0; i < shown; ++i) {
+            text += line(simulation.destinations[i]);
+        }
+        if (simulation.destinations.size() > shown) {
+            text += QString("... и еще %1 направлений\n").arg(simulation.destinations.size() - shown);
+        }
+        showMessage("Моделирование тарифов", text);
+    });
 }
 
 void MainWindow::onInitTestData() {
     // Используем для быстрой проверки
-    dataManager->initializeTestData();
-    updateTariffsTable();
-    updateClientsTable();
-    updateVIPClientsTable();
-    updateCallsTable();
-    updateStatistics();
-    showMessage("Успех", "Тестовые данные добавлены в БД!");
+    applyChange([this]() {
+        dataManager->initializeTestData();
+        updateAllTables();
+        showMessage("Успех", "Тестовые данные добавлены в БД!");
+    });
+}
+
+void MainWindow::onArchiveCalls() {
+    bool ok = false;
+    const int days = QInputDialog::getInt(this, "Архив звонков", "Перенести в архив звонки старше (дней):",
+                                          90, LoyaltyEngine::WindowDays, 36500, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    applyChange([this, days]() {
+        const int archived = dataManager->archiveCallsBefore(QDateTime::currentSecsSinceEpoch() - qint64(days) * 86400);
+        if (archived < 0) {
+            showError("Ошибка архивации: " + dataManager->lastError());
+            return;
+        }
+        updateAllTables();
+        showMessage("Успех", QString("Перенесено в архив звонков: %1.\nОтчеты учитывают архив.").arg(archived));
+    });
+}
+
+void MainWindow::onStartCdrIngest() {
+    const QString directory = QFileDialog::getExistingDirectory(this, "Каталог файлов CDR (*.cdr)");
+    if (directory.isEmpty()) {
+        return;
+    }
+    if (!cdrTailer->start(directory)) {
+        showError(cdrTailer->status().lastError);
+    }
+}
+
+void MainWindow::onStopCdrIngest() {
+    cdrTailer->stop();
+}
+
+void MainWindow::onCdrStatusChanged() {
+    const CdrIngestStatus status = cdrTailer->status();
+    ingestLabel->setVisible(status.running);
+    if (!status.running) {
+        return;
+    }
+    QString text = QString("CDR: %1 зв./с, записано %2, очередь %3 КБ, отставание %4 с")
+                       .arg(QString::number(status.callsPerSecond, 'f', 0))
+                       .arg(status.ingested)
+                       .arg(status.backlogBytes / 1024)
+                       .arg(status.lagSeconds);
+    if (status.rejected > 0) {
+        text += QString(", отброшено %1").arg(status.rejected);
+    }
+    if (!status.lastError.isEmpty()) {
+        text += " ⚠";
+    }
+    ingestLabel->setText(text);
+    ingestLabel->setToolTip(status.source + (status.lastError.isEmpty() ? QString() : "\n" + status.lastError));
+}
+
+void MainWindow::onCallsIngested(int) {
+    // Таблица звонков перестраивается целиком - при потоке CDR не чаще раза в 2 с
+    if (!callsRefreshTimer.isActive()) {
+        callsRefreshTimer.start();
+    }
 }
 
 void MainWindow::onClearAllData() {
@@ -527,21 +868,131 @@ void MainWindow::onClearAllData() {
                                                               QMessageBox::Yes | QMessageBox::No);
 
     if (reply == QMessageBox::Yes) {
-        dataManager->clearAll();
-        updateTariffsTable();
-        updateClientsTable();
-        updateVIPClientsTable();
-        updateCallsTable();
-        updateStatistics();
-        showMessage("Успех", "База данных очищена!");
+        applyChange([this]() {
+            dataManager->clearAll();
+            updateAllTables();
+            showMessage("Успех", "База данных очищена!");
+        });
     }
 }
 
+void MainWindow::onShowDiagnostics() {
+    DiagnosticsDialog dialog(this, dataManager);
+    dialog.exec();
+}
+
 void MainWindow::onAbout() {
     QMessageBox::about(this, "О программе",
                        "Система управления АТС (SQLite)\n\nЛабораторная работа №5\nБазы данных в десктопном приложении");
 }
 
+void MainWindow::onBusyChanged(bool busy) {
+    // Пока идет фоновая запись, данные в памяти менять нельзя
+    centralWidget()->setEnabled(!busy);
+    mainToolBar->setEnabled(!busy);
+    menuBar()->setEnabled(!busy);
+    progressBar->setVisible(busy);
+    cancelButton->setVisible(busy);
+    if (busy) {
+        progressBar->setValue(0);
+    } else {
+        statusBar()->clearMessage();
+    }
+}
+
+void MainWindow::onProgressChanged(const QString& stage, int percent) {
+    statusBar()->showMessage(stage + "...");
+    progressBar->setValue(percent);
+}
+
+void MainWindow::onLoadingChanged(bool loading) {
+    // Интерфейс не блокируется: изменения до конца загрузки откладывает applyChange
+    progressBar->setVisible(loading || asyncData->isBusy());
+    if (loading) {
+        progressBar->setValue(0);
+        statsLabel->setText("⏳ Загрузка данных...");
+    } else {
+        statusBar()->clearMessage();
+        updateAllTables();
+    }
+}
+
+void MainWindow::onReferenceDataLoaded() {
+    // Тарифы и клиенты уже есть - можно оформлять звонки, пока грузится их история
+    updateTariffsTable();
+    updateClientsTable();
+    updateVIPClientsTable();
+    statsLabel->setText("⏳ Загрузка звонков...");
+}
+
+void MainWindow::onSearchSubscribers() {
+    const int MaxSearchResults = 50;
+    const QString text = searchEdit->text().trimmed();
+    if (text.isEmpty()) {
+        searchResults->clear();
+        searchResults->hide();
+        return;
+    }
+    if (dataManager->hasFullTextSearch() && !DataManager::fullTextQuery(text).isEmpty()) {
+        // Ответ на устаревший запрос не придет: новый запрос отменяет предыдущий
+        asyncData->searchSubscribers(text, MaxSearchResults).then(this, [this](const std::vector<SubscriberHit>& hits) {
+            showSearchResults(hits);
+        });
+        return;
+    }
+    std::vector<SubscriberHit> hits;
+    const SubscriberStore& store = dataManager->subscribers();
+    for (const SubscriberMatch& match : dataManager->searchSubscribers(text, MaxSearchResults)) {
+        const SubscriberRecord* record = store.find(store.text(match.nameId));
+        hits.push_back({std::string(store.text(match.nameId)), std::string(store.text(match.phoneId)),
+                        record ? std::string(store.text(record->managerId)) : std::string(), match.kind});
+    }
+    showSearchResults(hits);
+}
+
+void MainWindow::showSearchResults(const std::vector<SubscriberHit>& hits) {
+    searchResults->clear();
+    for (const SubscriberHit& hit : hits) {
+        QString text = QString::fromStdString(hit.name) + " — " + QString::fromStdString(hit.phone);
+        if (hit.kind == SubscriberKind::Vip) {
+            text += hit.manager.empty() ? QString(" (VIP)")
+                                        : " (VIP, менеджер: " + QString::fromStdString(hit.manager) + ")";
+        }
+        QListWidgetItem *item = new QListWidgetItem(text);
+        item->setData(Qt::UserRole, QString::fromStdString(hit.name));
+        item->setData(Qt::UserRole + 1, hit.kind == SubscriberKind::Vip);
+        searchResults->addItem(item);
+    }
+    if (hits.empty()) {
+        searchResults->addItem("Ничего не найдено");
+    }
+    searchResults->show();
+}
+
+void MainWindow::onSearchResultActivated(QListWidgetItem *item) {
+    const QString name = item->data(Qt::UserRole).toString();
+    if (name.isEmpty()) {
+        return;
+    }
+    const bool vip = item->data(Qt::UserRole + 1).toBool();
+    QTableWidget *table = vip ? vipClientsTable : clientsTable;
+    tabWidget->setCurrentIndex(vip ? 2 : 1);
+    for (int row = 0; row < table->rowCount(); ++row) {
+        if (table->item(row, 0) && table->item(row, 0)->text() == name) {
+            table->selectRow(row);
+            table->scrollToItem(table->item(row, 0));
+            return;
+        }
+    }
+    statusBar()->showMessage("Абонент еще не загружен в таблицу", 3000);
+}
+
+void MainWindow::applyChange(std::function<void()> change) {
+    if (!asyncData->whenLoaded(std::move(change))) {
+        statusBar()->showMessage("Изменение будет применено после загрузки данных", 5000);
+    }
+}
+
 void MainWindow::showMessage(const QString& title, const QString& message) {
     QMessageBox::information(this, title, message);
 }
@@ -6,8 +6,15 @@
 #include <QTabWidget>
 #include <QPushButton>
 #include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
 #include <QToolBar>
+#include <QProgressBar>
+#include <QTimer>
+#include <functional>
 #include "DataManager.h"
+#include "AsyncDataManager.h"
+#include "CdrTailer.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -43,13 +50,46 @@ private slots:
 
     void onSaveData();      // Слот для кнопки Бэкапа
     void onLoadData();      // Слот для кнопки Восстановления
+    void onExportCSV();     // Экспорт всех таблиц в CSV
+    void onImportCSV();     // Импорт из CSV
+    void onReloadTariffs(); // Замена всех тарифов из CSV без остановки приема CDR
+    void onSimulateTariffs(); // Выручка по всей истории при тарифах из CSV, без их применения
     void onInitTestData();  // Слот для загрузки тестовых данных
+    void onArchiveCalls();
+    void onStartCdrIngest();
+    void onStopCdrIngest();
     void onClearAllData();
+    void onShowDiagnostics();
     void onAbout();
 
+    // Длительные операции выполняются в фоне (AsyncDataManager)
+    void onBusyChanged(bool busy);
+    void onProgressChanged(const QString& stage, int percent);
+    // Начальная загрузка: окно уже показано, таблицы заполняются по мере чтения
+    void onLoadingChanged(bool loading);
+    void onReferenceDataLoaded();
+    // Прием CDR: скорость и отставание в строке состояния, таблица звонков - не чаще раза в 2 с
+    void onCdrStatusChanged();
+    void onCallsIngested(int count);
+    // Поиск абонента по мере ввода (с задержкой) и переход к найденному в таблице
+    void onSearchSubscribers();
+    void onSearchResultActivated(QListWidgetItem *item);
+
 private:
     Ui::MainWindow *ui;
     DataManager *dataManager;
+    AsyncDataManager *asyncData;
+    CdrTailer *cdrTailer;
+
+    QToolBar *mainToolBar;
+    QProgressBar *progressBar;
+    QPushButton *cancelButton;
+    QLabel *ingestLabel;
+    QTimer callsRefreshTimer;
+    QTimer searchTimer;
+    QLineEdit *searchEdit;
+    QListWidget *searchResults;
+    QTabWidget *tabWidget;
 
     // Таблицы
     QTableWidget *tariffsTable;
@@ -64,6 +104,11 @@ private:
     void updateVIPClientsTable();
     void updateCallsTable();
     void updateStatistics();
+    void updateAllTables();
+    // Выделенные строки таблицы по возрастанию (для массового удаления)
+    std::vector<int> selectedRows(QTableWidget *table) const;
+    void deleteSelectedSubscribers(SubscriberKind kind, QTableWidget *table);
+    void showSearchResults(const std::vector<SubscriberHit>& hits);
 
     void setupTariffsTab();
     void setupClientsTab();
@@ -72,6 +117,9 @@ private:
     void setupMenuBar();
     void setupToolBar();
 
+    // Изменение данных: во время начальной загрузки откладывается до ее окончания
+    void applyChange(std::function<void()> change);
+
     void showMessage(const QString& title, const QString& message);
     void showError(const QString& message);
 };
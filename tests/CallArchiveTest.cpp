@@ -0,0 +1,105 @@
+#include "CallArchiveTest.h"
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "CallArchive.h"
+
+namespace {
+
+// Строки по возрастанию id с пропусками; время начала идет не по порядку
+// (разности отрицательные), стоимость - ровно в 1/10000 рубля
+std::vector<ArchivedCall> sampleCalls() {
+    const char* callers[] = {"Иванов", "Петров", "Сидорова", "ООО \"Ромашка\"; филиал"};
+    const char* destinations[] = {"Москва", "Минск", "Санкт-Петербург"};
+    std::mt19937 random(35);
+    std::vector<ArchivedCall> calls;
+    qint64 id = 1;
+    for (int i = 0; i < 5000; ++i) {
+        id += 1 + static_cast<qint64>(random() % 1000);
+        const qint64 start = 1700000000 + static_cast<qint64>(random() % 5000000) - 2500000;
+        const int duration = i % 97 == 0 ? std::numeric_limits<int>::max() : static_cast<int>(random() % 3600);
+        const double cost = static_cast<double>(random() % 100000000) / CallArchive::CostScale;
+        calls.push_back({id, i % 13 == 0 ? 0 : start, callers[random() % 4], destinations[random() % 3], duration,
+                         cost});
+    }
+    return calls;
+}
+
+QString writeArchive(const QTemporaryDir& directory, const std::vector<ArchivedCall>& calls) {
+    const QString path = directory.filePath("calls.cdra");
+    QString error;
+    if (!CallArchive::write(path, calls, &error)) {
+        qWarning().noquote() << error;
+        return QString();
+    }
+    return path;
+}
+
+} // namespace
+
+void CallArchiveTest::readAllMatchesInput() {
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const std::vector<ArchivedCall> calls = sampleCalls();
+    const QString path = writeArchive(directory, calls);
+    QVERIFY(!path.isEmpty());
+
+    CallArchive archive;
+    QString error;
+    QVERIFY2(archive.open(path, &error), qPrintable(error));
+    QCOMPARE(archive.rowCount(), static_cast<qint64>(calls.size()));
+    QCOMPARE(archive.firstId(), calls.front().id);
+    QCOMPARE(archive.lastId(), calls.back().id);
+
+    const std::vector<ArchivedCall> read = archive.readAll();
+    QCOMPARE(read.size(), calls.size());
+    for (std::size_t i = 0; i < calls.size(); ++i) {
+        QCOMPARE(read[i].id, calls[i].id);
+        QCOMPARE(read[i].startTime, calls[i].startTime);
+        QCOMPARE(read[i].caller, calls[i].caller);
+        QCOMPARE(read[i].destination, calls[i].destination);
+        QCOMPARE(read[i].duration, calls[i].duration);
+        QCOMPARE(read[i].cost, calls[i].cost);
+    }
+}
+
+void CallArchiveTest::aggregatesMatchInput() {
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const std::vector<ArchivedCall> calls = sampleCalls();
+    const QString path = writeArchive(directory, calls);
+    QVERIFY(!path.isEmpty());
+    CallArchive archive;
+    QVERIFY(archive.open(path, nullptr));
+
+    // Суммы в фиксированной точке, как в файле
+    struct Expected {
+        int calls = 0;
+        long long duration = 0;
+        qint64 cost = 0;
+    };
+    std::map<std::string, Expected> byCaller;
+    qint64 total = 0;
+    for (const ArchivedCall& call : calls) {
+        const qint64 amount = std::llround(call.cost * CallArchive::CostScale);
+        Expected& expected = byCaller[call.caller];
+        expected.calls += 1;
+        expected.duration += call.duration;
+        expected.cost += amount;
+        total += amount;
+    }
+    QCOMPARE(archive.totalRevenue(), static_cast<double>(total) / CallArchive::CostScale);
+
+    const std::vector<ClientUsage> usage = archive.clientUsage();
+    QCOMPARE(usage.size(), byCaller.size());
+    for (const ClientUsage& client : usage) {
+        const auto expected = byCaller.find(client.clientName);
+        QVERIFY(expected != byCaller.end());
+        QCOMPARE(client.callCount, expected->second.calls);
+        QCOMPARE(client.totalDuration, expected->second.duration);
+        QCOMPARE(client.totalCost, static_cast<double>(expected->second.cost) / CallArchive::CostScale);
+    }
+}
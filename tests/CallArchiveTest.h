@@ -0,0 +1,15 @@
+#ifndef CALLARCHIVETEST_H
+#define CALLARCHIVETEST_H
+
+#include <QObject>
+
+// Файл архива (CallArchive): запись и чтение всех колонок обратно
+class CallArchiveTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void readAllMatchesInput();
+    void aggregatesMatchInput();
+};
+
+#endif
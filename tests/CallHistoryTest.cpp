@@ -0,0 +1,188 @@
+#include "CallHistoryTest.h"
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <QThreadPool>
+#include <QtTest>
+#include "CallHistory.h"
+
+namespace {
+
+struct SampleCall {
+    std::int64_t id;
+    std::string caller;
+    std::string destination;
+    int duration;
+    double cost;                // ровно в 1/10000 рубля: колонка хранит фиксированную точку
+    std::int64_t startTime;
+};
+
+void appendAll(CallHistory& history, const std::vector<SampleCall>& calls) {
+    for (const SampleCall& call : calls) {
+        history.append(call.id, call.caller, call.destination, call.duration, call.cost, call.startTime);
+    }
+}
+
+// Случайные звонки: несколько абонентов и направлений, стоимость в 1/10000 рубля
+std::vector<SampleCall> randomCalls(std::size_t count, const std::vector<std::string>& callers,
+                                    const std::vector<std::string>& destinations, unsigned seed) {
+    std::mt19937 random(seed);
+    std::vector<SampleCall> calls;
+    calls.reserve(count);
+    std::int64_t id = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        id += 1 + static_cast<std::int64_t>(random() % 50);
+        calls.push_back({id, callers[random() % callers.size()], destinations[random() % destinations.size()],
+                         static_cast<int>(random() % 7200),
+                         static_cast<double>(random() % 10000000) / CallHistory::CostScale,
+                         1700000000 + static_cast<std::int64_t>(random() % 31536000)});
+    }
+    return calls;
+}
+
+} // namespace
+
+// Проверка всех полей звонка index; вне слота теста QCOMPARE не работает
+#define COMPARE_CALL(history, calls, index)                                            \
+    do {                                                                              \
+        const Call read = (history).callAt(index);                                    \
+        QCOMPARE(read.getCallerName(), (calls)[index].caller);                        \
+        QCOMPARE(read.getDestination(), (calls)[index].destination);                  \
+        QCOMPARE(read.getDuration(), (calls)[index].duration);                        \
+        QCOMPARE(read.getCost(), (calls)[index].cost);                                \
+        QCOMPARE(read.getStartTime(), (calls)[index].startTime);                      \
+    } while (false)
+
+void CallHistoryTest::roundTripFullWidthColumns() {
+    // Разность с минимумом блока занимает все 64 бита (id и начало), длительность -
+    // 31 бит, стоимость - отрицательная и положительная
+    const std::int64_t low = std::numeric_limits<std::int64_t>::min();
+    const std::int64_t high = std::numeric_limits<std::int64_t>::max();
+    std::vector<SampleCall> calls;
+    for (std::size_t i = 0; i < CallHistory::BlockSize + 3; ++i) {
+        const bool odd = i % 2 != 0;
+        calls.push_back({odd ? high : low, odd ? "Петров" : "Иванов", odd ? "Минск" : "Москва",
+                         odd ? std::numeric_limits<int>::max() : 0, odd ? 90000000000.1234 : -90000000000.1234,
+                         odd ? low : high});
+    }
+    CallHistory history;
+    appendAll(history, calls);
+    QCOMPARE(history.count(), calls.size());
+    for (std::size_t i = 0; i < calls.size(); ++i) {
+        COMPARE_CALL(history, calls, i);
+    }
+}
+
+void CallHistoryTest::roundTripEqualColumns() {
+    // Все значения колонок блока равны: колонки хранятся без битов (ширина 0)
+    const std::vector<SampleCall> calls(2 * CallHistory::BlockSize + 1,
+                                        SampleCall{42, "Иванов", "Москва", 60, 12.5, 1700000000});
+    CallHistory history;
+    appendAll(history, calls);
+    QCOMPARE(history.count(), calls.size());
+    for (std::size_t i = 0; i < calls.size(); ++i) {
+        COMPARE_CALL(history, calls, i);
+    }
+    QCOMPARE(history.totalRevenue(), 12.5 * static_cast<double>(calls.size()));
+}
+
+void CallHistoryTest::roundTripSealedBlocksAndTail() {
+    const std::vector<std::string> callers = {"Иванов", "Петров", "Сидорова", "Козлов"};
+    const std::vector<std::string> destinations = {"Москва", "Минск", "Санкт-Петербург"};
+    const std::vector<SampleCall> calls = randomCalls(3 * CallHistory::BlockSize + 777, callers, destinations, 36);
+    CallHistory history;
+    appendAll(history, calls);
+    QCOMPARE(history.count(), calls.size());
+    for (std::size_t i = 0; i < calls.size(); ++i) {
+        COMPARE_CALL(history, calls, i);
+    }
+
+    // Агрегаты по блокам и хвосту - как суммы по исходным звонкам в фиксированной точке
+    std::int64_t total = 0;
+    std::map<std::string, std::int64_t> byCaller;
+    for (const SampleCall& call : calls) {
+        const std::int64_t amount = std::llround(call.cost * CallHistory::CostScale);
+        total += amount;
+        byCaller[call.caller] += amount;
+    }
+    QCOMPARE(history.totalRevenue(), static_cast<double>(total) / CallHistory::CostScale);
+    for (const auto& entry : byCaller) {
+        QCOMPARE(history.clientTotalCost(entry.first), static_cast<double>(entry.second) / CallHistory::CostScale);
+    }
+}
+
+void CallHistoryTest::simulateTariffsMatchesPerCallReference() {
+    // Абоненты: обычный, два VIP и удаленный (его звонки остались в истории);
+    // направления: в обоих наборах, только в текущем, только в предлагаемом
+    SubscriberStore subscribers;
+    subscribers.addRegular("Иванов", "+79001234567", 100.0);
+    subscribers.addVip("Петров", "+79007654321", 500.0, 15.0, "Смирнова");
+    subscribers.addVip("Сидорова", "+79000000000", 0.0, 5.0, "Смирнова");
+    const TariffSet current({Tariff("Москва", 2.50, 0.50), Tariff("Минск", 1.80, 0.20), Tariff("Рига", 3.10, 0.0)}, {});
+    const TariffSet proposed({Tariff("Москва", 2.70, 0.40), Tariff("Минск", 1.75, 0.25), Tariff("Тбилиси", 4.0, 1.0)},
+                             {});
+    const std::vector<SampleCall> calls =
+        randomCalls(5 * CallHistory::BlockSize + 123, {"Иванов", "Петров", "Сидорова", "Удаленный"},
+                    {"Москва", "Минск", "Рига", "Тбилиси"}, 48);
+    CallHistory history;
+    appendAll(history, calls);
+
+    // Расчет по одному звонку: поиск абонента и тарифов на каждый звонок
+    struct Totals {
+        long long calls = 0;
+        std::int64_t current = 0;
+        std::int64_t proposed = 0;
+    };
+    std::map<std::string, Totals> destinations;
+    Totals segments[2];
+    long long unrated = 0;
+    for (std::size_t i = 0; i < history.count(); ++i) {
+        const Call call = history.callAt(i);
+        const SubscriberRecord* caller = subscribers.find(call.getCallerName());
+        const bool vip = caller && caller->kind == SubscriberKind::Vip;
+        const double factor = vip ? 1.0 - caller->discount / 100.0 : 1.0;
+        const Tariff* now = current.findByCity(call.getDestination());
+        const Tariff* next = proposed.findByCity(call.getDestination());
+        std::int64_t nowCost = std::llround(call.getCost() * CallHistory::CostScale);
+        std::int64_t nextCost = nowCost;
+        if (now && next) {
+            nowCost = std::llround((now->getConnectionFee() + now->getPricePerMinute() * call.getDuration()) * factor *
+                                   CallHistory::CostScale);
+            nextCost = std::llround((next->getConnectionFee() + next->getPricePerMinute() * call.getDuration()) *
+                                    factor * CallHistory::CostScale);
+        } else {
+            ++unrated;
+        }
+        for (Totals* totals : {&destinations[call.getDestination()], &segments[vip ? 1 : 0]}) {
+            totals->calls += 1;
+            totals->current += nowCost;
+            totals->proposed += nextCost;
+        }
+    }
+
+    auto compare = [](const RevenueDelta& actual, const Totals& expected) {
+        return actual.callCount == expected.calls &&
+               actual.currentRevenue == static_cast<double>(expected.current) / CallHistory::CostScale &&
+               actual.proposedRevenue == static_cast<double>(expected.proposed) / CallHistory::CostScale;
+    };
+    // Несколько частей в пуле и одна: итоги не зависят от разбиения
+    for (int workers : {1, 3}) {
+        QThreadPool pool;
+        const TariffSimulation simulation = history.simulateTariffs(current, proposed, subscribers, &pool, workers);
+        QCOMPARE(simulation.unratedCalls, unrated);
+        QVERIFY(compare(simulation.regular, segments[0]));
+        QVERIFY(compare(simulation.vip, segments[1]));
+        Totals total = segments[0];
+        total.calls += segments[1].calls;
+        total.current += segments[1].current;
+        total.proposed += segments[1].proposed;
+        QVERIFY(compare(simulation.total, total));
+        QCOMPARE(simulation.destinations.size(), destinations.size());
+        for (const RevenueDelta& destination : simulation.destinations) {
+            const auto expected = destinations.find(destination.name);
+            QVERIFY(expected != destinations.end());
+            QVERIFY2(compare(destination, expected->second), destination.name.c_str());
+        }
+    }
+}
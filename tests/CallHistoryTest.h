@@ -0,0 +1,18 @@
+#ifndef CALLHISTORYTEST_H
+#define CALLHISTORYTEST_H
+
+#include <QObject>
+
+// Сжатая история (CallHistory): звонки читаются обратно без потерь при любой
+// ширине колонок, а моделирование тарифов совпадает с расчетом по звонку
+class CallHistoryTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void roundTripFullWidthColumns();
+    void roundTripEqualColumns();
+    void roundTripSealedBlocksAndTail();
+    void simulateTariffsMatchesPerCallReference();
+};
+
+#endif
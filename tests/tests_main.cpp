@@ -0,0 +1,19 @@
+#include <QCoreApplication>
+#include <QtTest>
+#include "CallArchiveTest.h"
+#include "CallHistoryTest.h"
+
+// Все наборы тестов в одном исполняемом файле; код возврата - число проваленных проверок
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    int failed = 0;
+    {
+        CallArchiveTest test;
+        failed += QTest::qExec(&test, argc, argv);
+    }
+    {
+        CallHistoryTest test;
+        failed += QTest::qExec(&test, argc, argv);
+    }
+    return failed;
+}